@@ -0,0 +1,370 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * decodefuzz runs random byte streams through Instruction under all four register size combinations and
+ * compares size, addressing mode, control flow and target with an independent reference decoder. The size tables of
+ * the specialised decoders are checked against the reference as well. Afterwards it measures the throughput of
+ * Instruction, once per instruction and once through decodeSequence.
+ *
+ * usage: decodefuzz [instructions per combination] [seed]
+ *
+ * It exits with 1 if any instruction differs from the reference. ctest runs it with 200000 instructions.
+ *
+ * The reference decoder does not use the tables of Instructions.cpp. It derives everything from the
+ * structure of the opcode matrix instead: the low two bits select a group, the next three bits mostly
+ * select the addressing mode and the high three bits the operation.
+ */
+
+#include "snesdisasm/Instructions.hpp"
+#include "snesdisasm/MachineState.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct Reference {
+    unsigned int size;
+    AddressingMode mode;
+    ControlFlow flow;
+};
+
+Reference make(unsigned int size, AddressingMode mode, ControlFlow flow = ControlFlow::SEQUENTIAL) {
+    Reference reference = {size, mode, flow};
+    return reference;
+}
+
+//opcodes ending in binary 01: ORA AND EOR ADC STA LDA CMP SBC, BIT # takes the place of STA #
+Reference decodeGroup1(uint8_t opCode, bool m8) {
+    static const AddressingMode modes[8] = {
+        DIRECT_INDEXED_INDIRECT, DIRECT, IMMEDIATE, ABSOLUTE,
+        DIRECT_INDIRECT_INDEXED, DIRECT_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_Y, ABSOLUTE_INDEXED_WITH_X
+    };
+    static const unsigned int sizes[8] = {2, 2, 2, 3, 2, 2, 3, 3};
+
+    const unsigned int column = (opCode >> 2) & 0x07;
+    return make(sizes[column] + (column == 2 && !m8 ? 1 : 0), modes[column]);
+}
+
+//opcodes ending in binary 11: the long and stack relative modes plus single byte instructions
+Reference decodeGroup3(uint8_t opCode) {
+    switch((opCode >> 2) & 0x07) {
+    case 0:
+        return make(2, STACK_RELATIVE);
+    case 1:
+        return make(2, DIRECT_INDIRECT_LONG);
+    case 2: //PHD PLD PHK RTL PHB PLB WAI XBA
+        if(opCode == 0x6B) {
+            return make(1, STACK, ControlFlow::RETURN);
+        }
+        return make(1, opCode == 0xCB || opCode == 0xEB ? IMPLIED : STACK);
+    case 3:
+        return make(4, ABSOLUTE_LONG);
+    case 4:
+        return make(2, STACK_RELATIVE_INDIRECT_INDEXED);
+    case 5:
+        return make(2, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y);
+    case 6: //TCS TSC TCD TDC TXY TYX STP XCE
+        return make(1, IMPLIED, opCode == 0xDB ? ControlFlow::HALT : ControlFlow::SEQUENTIAL);
+    default:
+        return make(4, ABSOLUTE_INDEXED_LONG_WITH_X);
+    }
+}
+
+//opcodes ending in binary 10: shifts, increments, X register transfers and some oddities in column 2
+Reference decodeGroup2(uint8_t opCode, bool x8) {
+    const unsigned int row = opCode >> 5;
+
+    switch((opCode >> 2) & 0x07) {
+    case 0:
+        switch(opCode) {
+        case 0x02:
+            return make(2, STACK, ControlFlow::INTERRUPT);
+        case 0x22:
+            return make(4, ABSOLUTE_LONG, ControlFlow::CALL);
+        case 0x42:
+            return make(2, RESERVED);
+        case 0x62:
+            return make(3, STACK);
+        case 0x82:
+            return make(3, PROGRAMMCOUNTER_RELATIVE_LONG, ControlFlow::JUMP);
+        case 0xA2:
+            return make(x8 ? 2 : 3, IMMEDIATE);
+        default: //REP SEP
+            return make(2, IMMEDIATE);
+        }
+    case 1:
+        return make(2, DIRECT);
+    case 2:
+        return make(1, row < 4 ? ACCUMULATOR : IMPLIED);
+    case 3:
+        return make(3, ABSOLUTE);
+    case 4:
+        return make(2, DIRECT_INDIRECT);
+    case 5:
+        return make(2, row == 4 || row == 5 ? DIRECT_INDEXED_WITH_Y : DIRECT_INDEXED_WITH_X);
+    case 6:
+        if(row < 2) {
+            return make(1, ACCUMULATOR);
+        }
+        return make(1, row == 4 || row == 5 ? IMPLIED : STACK);
+    default:
+        if(opCode == 0x9E) {
+            return make(3, ABSOLUTE_INDEXED_WITH_X);
+        }
+        return make(3, opCode == 0xBE ? ABSOLUTE_INDEXED_WITH_Y : ABSOLUTE_INDEXED_WITH_X);
+    }
+}
+
+//opcodes ending in binary 00: branches, index register operations and the remaining control flow
+Reference decodeGroup0(uint8_t opCode, bool x8) {
+    const unsigned int row = opCode >> 5;
+    const bool odd = opCode & 0x10;
+
+    switch((opCode >> 2) & 0x03) {
+    case 0: //column 0
+        if(odd) {
+            return make(2, PROGRAMMCOUNTER_RELATIVE, ControlFlow::BRANCH);
+        }
+        switch(row) {
+        case 0:
+            return make(2, STACK, ControlFlow::INTERRUPT);
+        case 1:
+            return make(3, ABSOLUTE, ControlFlow::CALL);
+        case 2:
+        case 3:
+            return make(1, STACK, ControlFlow::RETURN);
+        case 4:
+            return make(2, PROGRAMMCOUNTER_RELATIVE, ControlFlow::JUMP);
+        default: //LDY CPY CPX
+            return make(x8 ? 2 : 3, IMMEDIATE);
+        }
+    case 1: //column 4
+        if(row == 2) {
+            return make(3, BLOCK_MOVE);
+        }
+        if(odd) {
+            if(row == 6) {
+                return make(2, STACK); //PEI
+            }
+            if(row == 7) {
+                return make(3, STACK); //PEA
+            }
+            return make(2, row == 0 ? DIRECT : DIRECT_INDEXED_WITH_X);
+        }
+        return make(2, DIRECT);
+    case 2: //column 8, all single byte
+        if(odd || row == 4 || row >= 5) {
+            return make(1, IMPLIED);
+        }
+        return make(1, STACK); //PHP PLP PHA PLA
+    default: //column C
+        switch(opCode) {
+        case 0x4C:
+            return make(3, ABSOLUTE, ControlFlow::JUMP);
+        case 0x5C:
+            return make(4, ABSOLUTE_LONG, ControlFlow::JUMP);
+        case 0x6C:
+            return make(3, ABSOLUTE_INDIRECT, ControlFlow::INDIRECT_JUMP);
+        case 0x7C:
+            return make(3, ABSOLUTE_INDEXED_INDIRECT, ControlFlow::INDIRECT_JUMP);
+        case 0xDC:
+            return make(3, ABSOLUTE_INDIRECT_LONG, ControlFlow::INDIRECT_JUMP);
+        case 0xFC:
+            return make(3, ABSOLUTE_INDEXED_INDIRECT, ControlFlow::INDIRECT_CALL);
+        case 0x3C:
+        case 0xBC:
+            return make(3, ABSOLUTE_INDEXED_WITH_X);
+        default: //TSB TRB BIT STY STZ LDY CPY CPX
+            return make(3, ABSOLUTE);
+        }
+    }
+}
+
+Reference decode(uint8_t opCode, bool m8, bool x8) {
+    switch(opCode & 0x03) {
+    case 0:
+        return decodeGroup0(opCode, x8);
+    case 1: {
+        Reference reference = decodeGroup1(opCode, m8);
+        if(opCode == 0x89) {
+            reference.mode = IMMEDIATE; //BIT #
+        }
+        return reference;
+    }
+    case 2:
+        return decodeGroup2(opCode, x8);
+    default:
+        return decodeGroup3(opCode);
+    }
+}
+
+//the target follows from the addressing mode and the control flow. Relative operands wrap within the bank.
+bool referenceTarget(const Reference &reference, const uint8_t *bytes, LongAddress address, LongAddress &target) {
+    const LongAddress bank = address & 0xFF0000;
+    const uint16_t next = address + reference.size;
+    const bool transfer = reference.flow == ControlFlow::JUMP || reference.flow == ControlFlow::CALL;
+    if(reference.mode == PROGRAMMCOUNTER_RELATIVE) {
+        target = bank | static_cast<uint16_t>(next + static_cast<int8_t>(bytes[1]));
+    } else if(reference.mode == PROGRAMMCOUNTER_RELATIVE_LONG || bytes[0] == 0x62) {
+        //PER is listed as a stack instruction, but its operand is relative like the one of BRL
+        target = bank | static_cast<uint16_t>(next + static_cast<int16_t>(bytes[1] | (bytes[2] << 8)));
+    } else if(transfer && reference.mode == ABSOLUTE) {
+        target = bank | bytes[1] | (bytes[2] << 8);
+    } else if(transfer && reference.mode == ABSOLUTE_LONG) {
+        target = bytes[1] | (bytes[2] << 8) | (bytes[3] << 16);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *flowName(ControlFlow flow) {
+    static const char *names[] = {
+        "SEQUENTIAL", "BRANCH", "JUMP", "INDIRECT_JUMP", "CALL", "INDIRECT_CALL", "RETURN", "INTERRUPT", "HALT"
+    };
+    return names[static_cast<unsigned int>(flow)];
+}
+
+//walks the stream like the production sweeps do
+struct StreamVisitor {
+    const std::vector<uint8_t> &stream;
+    std::size_t pos;
+    unsigned long remaining;
+    unsigned long checksum;
+
+    const uint8_t *fetch(LongAddress &address) {
+        address = 0x808000 + pos % 0x8000;
+        return remaining != 0 ? &stream[pos] : nullptr;
+    }
+
+    bool accept(const Instruction &instruction, const MachineState &) {
+        checksum += instruction.operand();
+        pos += instruction.size();
+        if(pos + 4 > stream.size()) {
+            pos = 0;
+        }
+        --remaining;
+        return true;
+    }
+};
+
+}
+
+int main(int argc, char *argv[]) {
+    const unsigned long count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    const unsigned long seed = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+
+    std::mt19937 random(seed);
+    std::vector<uint8_t> stream(count * 4 + 4);
+    for(uint8_t &byte : stream) {
+        byte = random();
+    }
+
+    //the mismatches of an opcode are the same for every occurrence, so report each one only once
+    std::vector<bool> reported(256 * 4, false);
+    unsigned long mismatches = 0;
+
+    for(unsigned int sizes = 0; sizes < 4; ++sizes) {
+        const bool m8 = sizes & 0x02;
+        const bool x8 = sizes & 0x01;
+        const MachineState state((m8 ? MEMORY_SELECT : 0) | (x8 ? INDEX_SELECT : 0));
+
+        std::size_t pos = 0;
+        for(unsigned long i = 0; i < count; ++i) {
+            //addresses near the end of the bank exercise the wrap of relative targets
+            const LongAddress address = 0x80FF00 + pos % 0x100;
+            const Instruction instruction(state, &stream[pos], address);
+            const Reference reference = decode(stream[pos], m8, x8);
+            LongAddress target = 0;
+            const bool hasTarget = referenceTarget(reference, &stream[pos], address, target);
+
+            if(instruction.size() != reference.size || instruction.addressingMode() != reference.mode ||
+               instruction.controlFlow() != reference.flow || instruction.hasTarget() != hasTarget ||
+               (hasTarget && instruction.target() != target)) {
+                ++mismatches;
+                if(!reported[sizes * 256 + stream[pos]]) {
+                    reported[sizes * 256 + stream[pos]] = true;
+                    std::cout << "mismatch M=" << m8 << " X=" << x8 << " opcode " << std::hex << int(stream[pos])
+                              << std::dec << " (" << instruction.mnemonic() << "): size " << int(instruction.size())
+                              << "/" << reference.size << ", mode "
+                              << addressingModeName(instruction.addressingMode()) << "/"
+                              << addressingModeName(reference.mode) << ", flow " << flowName(instruction.controlFlow())
+                              << "/" << flowName(reference.flow) << ", target " << std::hex
+                              << (instruction.hasTarget() ? instruction.target() : 0) << "/" << target << std::dec
+                              << std::endl;
+                }
+            }
+
+            //walk the stream with the reference size, so one wrong size does not hide later mismatches
+            pos += reference.size;
+            if(pos + 4 > stream.size()) {
+                pos = 0;
+            }
+        }
+    }
+
+    //the tables of the specialised decoders
+    const uint8_t *tables[4] = {
+        InstructionSizes<false, false>::sizes, InstructionSizes<false, true>::sizes,
+        InstructionSizes<true, false>::sizes, InstructionSizes<true, true>::sizes
+    };
+    for(unsigned int sizes = 0; sizes < 4; ++sizes) {
+        for(unsigned int opCode = 0; opCode < 256; ++opCode) {
+            const Reference reference = decode(opCode, sizes & 0x02, sizes & 0x01);
+            if(tables[sizes][opCode] != reference.size) {
+                ++mismatches;
+                std::cout << "mismatch in the specialised table M=" << bool(sizes & 0x02) << " X="
+                          << bool(sizes & 0x01) << " opcode " << std::hex << opCode << std::dec << ": size "
+                          << int(tables[sizes][opCode]) << "/" << reference.size << std::endl;
+            }
+        }
+    }
+
+    //throughput of the production decoder alone
+    const MachineState state(MEMORY_SELECT | INDEX_SELECT);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::size_t pos = 0;
+    unsigned long checksum = 0;
+    for(unsigned long i = 0; i < count; ++i) {
+        const Instruction instruction(state, &stream[pos], 0x808000 + pos % 0x8000);
+        checksum += instruction.operand();
+        pos += instruction.size();
+        if(pos + 4 > stream.size()) {
+            pos = 0;
+        }
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    MachineState sequenceState(MEMORY_SELECT | INDEX_SELECT);
+    StreamVisitor visitor = {stream, 0, count, 0};
+    const std::chrono::steady_clock::time_point sequenceStart = std::chrono::steady_clock::now();
+    decodeSequence(sequenceState, visitor);
+    const double sequenceSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - sequenceStart).count();
+
+    std::cout << 4 * count << " instructions compared, " << mismatches << " mismatches" << std::endl;
+    std::cout << "decoded " << count << " instructions (" << pos << " bytes into the stream, checksum " << checksum
+              << ") in " << seconds << " s, " << count / seconds / 1e6 << " M instructions/s" << std::endl;
+    std::cout << "decodeSequence: " << count << " instructions (checksum " << visitor.checksum << ") in "
+              << sequenceSeconds << " s, " << count / sequenceSeconds / 1e6 << " M instructions/s" << std::endl;
+
+    return mismatches == 0 ? 0 : 1;
+}
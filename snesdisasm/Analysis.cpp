@@ -0,0 +1,170 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Analysis.hpp"
+#include "Interpreter.hpp"
+#include "Trace.hpp"
+
+namespace {
+
+//where a block that was moved to image offset to begins in rom, in the same mirror as before if possible
+bool movedStart(const SNESROM &rom, const BasicBlock &block, ImageAddress to, LongAddress &start) {
+    std::unique_ptr<ROMAddress> address(getROMAddressObject(rom.layout()));
+    address->fromImageAddress(to);
+    const LongAddress plain = (address->bank() << 16) | address->bankAddress();
+    const LongAddress candidates[] = {plain | (block.start & 0x800000), plain};
+    for(LongAddress candidate : candidates) {
+        const LongAddress last = candidate + (block.end - 1 - block.start);
+        if((last >> 16) == (candidate >> 16) && rom.imageAddress(candidate) == to &&
+           rom.imageAddress(last) == to + (block.end - 1 - block.start)) {
+            start = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+Analysis::Analysis(SNESROM &&rom, const Annotations &annotations, const ExecutionLog *log, uint64_t traceSteps)
+    : m_ROM(std::forward<SNESROM>(rom)),
+      m_Annotations(annotations),
+      m_Graph(m_ROM, &m_Arena),
+      m_Propagation(m_Graph) {
+    m_Graph.setAnnotations(&m_Annotations);
+    m_Graph.setExecutionLog(log);
+    m_Graph.addVectorEntryPoints();
+    if(log != nullptr) {
+        log->addEntryPointsTo(m_Graph);
+    }
+    if(traceSteps != 0) {
+        Interpreter interpreter(m_ROM);
+        interpreter.run(traceSteps);
+        interpreter.addEntryPointsTo(m_Graph);
+    }
+    analyse();
+    m_Graph.setExecutionLog(nullptr);
+    m_Xrefs.reset(new CrossReferences(m_Propagation));
+    m_Index.reset(new InstructionIndex(m_Graph));
+}
+
+Analysis::Analysis(SNESROM &&rom, const Analysis &previous, const RomDiff &diff)
+    : m_ROM(std::forward<SNESROM>(rom)),
+      m_Annotations(previous.annotations()),
+      m_Graph(m_ROM, &m_Arena),
+      m_Propagation(m_Graph) {
+    m_Graph.setAnnotations(&m_Annotations);
+    const SNESROM &previousROM = previous.rom();
+    m_Graph.reuse(previous.graph(), [&](const BasicBlock & block,
+    LongAddress & start) {
+        //blocks never cross a bank, so in both layouts they are contiguous within the image
+        const ImageAddress first = previousROM.imageAddress(block.start);
+        const ImageAddress last = previousROM.imageAddress(block.end - 1);
+        if(first == ImageAddress(-1) || last == ImageAddress(-1) || first > last) {
+            return false;
+        }
+        if(last + 1 <= m_ROM.imageSize() && m_ROM.imageAddress(block.start) == first &&
+           !diff.changed(first, last + 1)) {
+            start = block.start;
+            return true;
+        }
+        std::size_t to;
+        return diff.relocated(first, last + 1, to) && movedStart(m_ROM, block, ImageAddress(to), start);
+    });
+    m_Graph.addVectorEntryPoints();
+    analyse();
+    m_Xrefs.reset(new CrossReferences(m_Propagation));
+    m_Index.reset(new InstructionIndex(m_Graph));
+}
+
+Analysis::Analysis(SNESROM &&rom, AnalysisCache &cache)
+    : m_ROM(std::forward<SNESROM>(rom)),
+      m_Graph(m_ROM, &m_Arena),
+      m_Propagation(m_Graph) {
+    if(cache.load(m_ROM, m_Graph, m_Propagation)) {
+        m_Graph.build(); //only visits the entry points, which are all known
+        m_CallGraph.reset(new CallGraph(m_Graph, &m_PassArena));
+        m_Stack.reset(new StackAnalysis(*m_CallGraph, m_Propagation)); //the dispatches are edges already
+    } else {
+        m_Graph.addVectorEntryPoints();
+        analyse();
+        cache.store(m_ROM, m_Graph, m_Propagation);
+    }
+    m_Xrefs.reset(new CrossReferences(m_Propagation));
+    m_Index.reset(new InstructionIndex(m_Graph));
+}
+
+void Analysis::analyse() {
+    //every pass but the last may add edges, so the results of the last one always match the graph
+    for(unsigned int pass = 1;; ++pass) {
+        TRACE_SCOPE("analysis_pass");
+        TRACE_ITERATIONS(pass);
+        m_Graph.build();
+        m_Stack.reset();
+        m_CallGraph.reset();
+        m_PassArena.release();
+        m_CallGraph.reset(new CallGraph(m_Graph, &m_PassArena));
+        m_Propagation.run();
+        m_Stack.reset(new StackAnalysis(*m_CallGraph, m_Propagation));
+        if(pass == MaxDispatchPasses) {
+            break;
+        }
+
+        bool added = false;
+        for(const Dispatch &dispatch : m_Stack->dispatches()) {
+            added = m_Graph.addEdge(dispatch.source, dispatch.target, EdgeKind::JUMP, dispatch.flags) || added;
+        }
+        if(!added) {
+            break;
+        }
+    }
+}
+
+MemoryReport Analysis::memoryReport() const {
+    MemoryReport report;
+    report.setArena(m_Arena.bytesUsed() + m_PassArena.bytesUsed(),
+                    m_Arena.bytesReserved() + m_PassArena.bytesReserved());
+    report.add("image", m_ROM.imageSize(), m_ROM.imageSize());
+    report.add("annotations", m_Annotations.size(), m_Annotations.memoryUsage());
+
+    std::size_t edgeBytes = 0;
+    for(const ControlFlowGraph::BlockMap::value_type &block : m_Graph.blocks()) {
+        edgeBytes += MemoryReport::vectorBytes(block.second.successors);
+    }
+    report.add("blocks", m_Graph.blocks().size(), MemoryReport::mapBytes(m_Graph.blocks()) + edgeBytes);
+    report.add("entry_points", m_Graph.entryPoints().size(), MemoryReport::vectorBytes(m_Graph.entryPoints()));
+    report.add("instruction_index", m_Index->size(), m_Index->memoryUsage());
+    report.add("entry_states", m_Propagation.entryStates().size(),
+               MemoryReport::mapBytes(m_Propagation.entryStates()));
+
+    std::size_t functionBytes = MemoryReport::vectorBytes(m_CallGraph->functions());
+    for(const Function &function : m_CallGraph->functions()) {
+        functionBytes += MemoryReport::vectorBytes(function.blocks) + MemoryReport::vectorBytes(function.exits) +
+                         MemoryReport::vectorBytes(function.callees) + MemoryReport::vectorBytes(function.callers);
+    }
+    for(const CallComponent &component : m_CallGraph->components()) {
+        functionBytes += MemoryReport::vectorBytes(component.functions);
+    }
+    report.add("functions", m_CallGraph->functions().size(), functionBytes);
+    report.add("stack_notes", m_Stack->notes().size(), MemoryReport::vectorBytes(m_Stack->notes()) +
+               MemoryReport::vectorBytes(m_Stack->dispatches()) + MemoryReport::vectorBytes(m_Stack->frames()));
+
+    //the xrefs are kept twice, sorted by target and by source
+    report.add("xrefs", m_Xrefs->xrefs().size(), 2 * MemoryReport::vectorBytes(m_Xrefs->xrefs()));
+    //every label is kept twice as well, by address and by name
+    report.add("labels", m_Xrefs->labels().size(), 2 * MemoryReport::mapBytes(m_Xrefs->labels()));
+    return report;
+}
@@ -0,0 +1,134 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include "SNESROM.hpp"
+#include "ControlFlowGraph.hpp"
+#include "ConstantPropagation.hpp"
+#include "CrossReferences.hpp"
+#include "CallGraph.hpp"
+#include "StackAnalysis.hpp"
+#include "InstructionIndex.hpp"
+#include "MemoryReport.hpp"
+#include "RomDiff.hpp"
+#include "AnalysisCache.hpp"
+#include "Annotations.hpp"
+#include "ExecutionLog.hpp"
+
+#include <memory>
+
+/*! \brief A ROM together with all results of analysing it
+ *
+ *  The constructor builds the \see ControlFlowGraph from the vectors, detects the functions of the \see CallGraph,
+ *  runs the \see ConstantPropagation and the \see StackAnalysis and collects the \see CrossReferences. Returns
+ *  the stack analysis resolves to pushed addresses become edges of the graph, and everything but the cross
+ *  references is computed again until no new ones turn up. Since the results refer to the rom, an analysis can be neither copied
+ *  nor moved. Keep it in a std::unique_ptr to pass it around.
+ *
+ *  All results are allocated from an \see Arena owned by the analysis and released in one go with it. The call
+ *  graph and the stack analysis are computed again in every pass, so they get an arena of their own that is
+ *  released before the next pass instead of piling up the results of earlier ones. The analysed
+ *  instructions are kept in a compact \see InstructionIndex only and decoded again when visited. Only the copy of
+ *  the \see Annotations stays on the heap: it is the same type the daemon edits, whose tree reallocates its nodes
+ *  with every insert.
+ */
+class Analysis {
+  private:
+    Arena m_Arena; //declared first so it is destroyed last
+    Arena m_PassArena; //the call graph and stack analysis of the current pass
+    SNESROM m_ROM;
+    Annotations m_Annotations;
+    ControlFlowGraph m_Graph;
+    ConstantPropagation m_Propagation;
+    std::unique_ptr<CallGraph> m_CallGraph;
+    std::unique_ptr<StackAnalysis> m_Stack;
+    std::unique_ptr<CrossReferences> m_Xrefs;
+    std::unique_ptr<InstructionIndex> m_Index;
+
+    enum { MaxDispatchPasses = 8 };
+
+    void analyse();
+  public:
+    /*! \brief Analyses the rom. This constructor will take ownership of the given rom.
+     *
+     *  The control flow is not followed into ranges annotations marks as data. The annotations are copied. The
+     *  entry points of log, if given, are followed in addition to the vectors, and the register sizes it recorded
+     *  take precedence over the tracked ones.
+     *
+     *  If traceSteps is not 0, the \see Interpreter runs the rom from RESET for at most traceSteps instructions
+     *  first, raising NMI and IRQ as the game enables them, and the targets of the indirect jumps and calls it
+     *  executed are followed as well.
+     */
+    explicit Analysis(SNESROM &&rom, const Annotations &annotations = Annotations(),
+                      const ExecutionLog *log = nullptr, uint64_t traceSteps = 0);
+
+    /*! \brief Analyses a rom that differs from an already analysed one by diff
+     *
+     *  Only blocks that touch a changed range of diff are decoded again. All other blocks of previous are taken
+     *  over, those within a relocation of diff rebased to where the code moved. The propagation and the cross
+     *  references are computed from scratch, since a change may affect states anywhere downstream, so entry
+     *  states and xrefs of moved code follow it. The annotations of previous are taken over.
+     */
+    Analysis(SNESROM &&rom, const Analysis &previous, const RomDiff &diff);
+
+    /*! \brief Takes the graph and the propagation from cache if it has an entry for the rom. Otherwise the rom
+     *         is analysed and the result stored in cache. The analysis has no annotations.
+     */
+    Analysis(SNESROM &&rom, AnalysisCache &cache);
+
+    Analysis(const Analysis &) = delete;
+    Analysis &operator=(const Analysis &) = delete;
+
+    const SNESROM &rom() const { return m_ROM; }
+    const Annotations &annotations() const { return m_Annotations; }
+    const ControlFlowGraph &graph() const { return m_Graph; }
+    const CallGraph &callGraph() const { return *m_CallGraph; }
+    const StackAnalysis &stack() const { return *m_Stack; }
+    const ConstantPropagation &propagation() const { return m_Propagation; }
+    const CrossReferences &xrefs() const { return *m_Xrefs; }
+    const InstructionIndex &instructions() const { return *m_Index; }
+    const Arena &arena() const { return m_Arena; }
+
+    /*! \brief Measures the memory taken by the rom and every result
+     */
+    MemoryReport memoryReport() const;
+
+    /*! \brief Calls f(address, instruction, state) for every analysed instruction in [start, end) in order
+     */
+    template<class F>
+    void forEachInstructionIn(LongAddress start, LongAddress end, F f) const;
+};
+
+template<class F>
+void Analysis::forEachInstructionIn(LongAddress start, LongAddress end, F f) const {
+    ControlFlowGraph::BlockMap::const_iterator it = m_Graph.blocks().upper_bound(start);
+    if(it != m_Graph.blocks().begin()) {
+        --it; //the previous block may reach into the range
+    }
+
+    for(; it != m_Graph.blocks().end() && it->first < end; ++it) {
+        m_Graph.forEachInstruction(it->second, [&](LongAddress address, const Instruction & instruction,
+        const MachineState & state) {
+            if(address >= start && address < end) {
+                f(address, instruction, state);
+            }
+        });
+    }
+}
+
+#endif // ANALYSIS_HPP
@@ -0,0 +1,384 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AnalysisCache.hpp"
+#include "Logger.hpp"
+#include "snesdisasmConfig.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace {
+
+const char Magic[4] = {'S', 'N', 'D', 'C'};
+const char *const Extension = ".sndc";
+const char *const TemporaryExtension = ".tmp";
+const std::time_t TemporaryLifetime = 60 * 60; //left behind by crashed writers after this many seconds
+
+std::atomic<unsigned int> s_TemporaryCounter(0);
+
+class Writer {
+  private:
+    std::string m_Data;
+  public:
+    void put8(uint8_t value) { m_Data += static_cast<char>(value); }
+    void put16(uint16_t value) {
+        put8(value);
+        put8(value >> 8);
+    }
+    void put32(uint32_t value) {
+        put16(value);
+        put16(value >> 16);
+    }
+    void put64(uint64_t value) {
+        put32(value);
+        put32(value >> 32);
+    }
+    void putBytes(const char *data, std::size_t length) { m_Data.append(data, length); }
+
+    void putValue(const AbstractValue &value) {
+        put16(value.value);
+        put16(value.known);
+    }
+
+    const std::string &data() const { return m_Data; }
+};
+
+class Reader {
+  private:
+    const uint8_t *m_Position;
+    const uint8_t *m_End;
+    bool m_Valid;
+  public:
+    Reader(const uint8_t *data, std::size_t length) : m_Position(data), m_End(data + length), m_Valid(true) {}
+
+    bool valid() const { return m_Valid; }
+    bool atEnd() const { return m_Position == m_End; }
+
+    uint8_t get8() {
+        if(m_Position == m_End) {
+            m_Valid = false;
+            return 0;
+        }
+        return *m_Position++;
+    }
+    uint16_t get16() {
+        const uint16_t low = get8();
+        return low | (get8() << 8);
+    }
+    uint32_t get32() {
+        const uint32_t low = get16();
+        return low | (static_cast<uint32_t>(get16()) << 16);
+    }
+    uint64_t get64() {
+        const uint64_t low = get32();
+        return low | (static_cast<uint64_t>(get32()) << 32);
+    }
+
+    bool getBytes(const char *expected, std::size_t length) {
+        for(std::size_t i = 0; i < length; ++i) {
+            if(get8() != static_cast<uint8_t>(expected[i])) {
+                m_Valid = false;
+            }
+        }
+        return m_Valid;
+    }
+
+    AbstractValue getValue() {
+        const uint16_t value = get16();
+        return AbstractValue(value, get16());
+    }
+};
+
+bool endsWith(const std::string &text, const char *suffix) {
+    const std::size_t length = std::strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+void makeDirectories(const std::string &path) {
+    for(std::size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        const std::string prefix = path.substr(0, slash);
+        if(mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            LOG_SRC(WARNING, "Cannot create the cache directory " + prefix);
+            return;
+        }
+        if(slash == std::string::npos) {
+            return;
+        }
+    }
+}
+
+void writeHeader(Writer &writer, const SNESROM &rom) {
+    const std::size_t versionLength = std::strlen(snesdisasm::version_string);
+    writer.putBytes(Magic, sizeof(Magic));
+    writer.put16(AnalysisCache::FormatVersion);
+    writer.put16(versionLength);
+    writer.putBytes(snesdisasm::version_string, versionLength);
+    writer.put64(rom.contentHash());
+    writer.put32(rom.imageSize());
+}
+
+bool readHeader(Reader &reader, const SNESROM &rom) {
+    const std::size_t versionLength = std::strlen(snesdisasm::version_string);
+    return reader.getBytes(Magic, sizeof(Magic)) && reader.get16() == AnalysisCache::FormatVersion &&
+           reader.get16() == versionLength && reader.getBytes(snesdisasm::version_string, versionLength) &&
+           reader.get64() == rom.contentHash() && reader.get32() == rom.imageSize();
+}
+
+}
+
+AnalysisCache::AnalysisCache(const std::string &directory, uint64_t sizeLimit)
+    : m_Directory(directory),
+      m_SizeLimit(sizeLimit) {
+    while(m_Directory.size() > 1 && m_Directory[m_Directory.size() - 1] == '/') {
+        m_Directory.erase(m_Directory.size() - 1);
+    }
+    makeDirectories(m_Directory);
+}
+
+std::string AnalysisCache::defaultDirectory() {
+    const char *cache = std::getenv("XDG_CACHE_HOME");
+    if(cache != nullptr && cache[0] != '\0') {
+        return std::string(cache) + "/snesdisasm";
+    }
+    const char *home = std::getenv("HOME");
+    if(home != nullptr && home[0] != '\0') {
+        return std::string(home) + "/.cache/snesdisasm";
+    }
+    return "snesdisasm-cache";
+}
+
+std::string AnalysisCache::pathOf(const SNESROM &rom) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx-%zx-v%s", static_cast<unsigned long long>(rom.contentHash()),
+                  rom.imageSize(), snesdisasm::version_string);
+    return m_Directory + "/" + name + Extension;
+}
+
+bool AnalysisCache::load(const SNESROM &rom, ControlFlowGraph &graph, ConstantPropagation &propagation) const {
+    const std::string path = pathOf(rom);
+    std::ifstream file(path, std::ifstream::binary);
+    if(!file.is_open()) {
+        return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+
+    //the last 8 bytes are the hash of everything before them
+    if(data.size() < 8) {
+        return false;
+    }
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.data());
+    const std::size_t length = data.size() - 8;
+    Reader checksum(bytes + length, 8);
+    if(checksum.get64() != SNESROM::hash(bytes, length)) {
+        LOG_SRC(WARNING, "Ignoring the damaged cache entry " + path);
+        return false;
+    }
+
+    Reader reader(bytes, length);
+    if(!readHeader(reader, rom)) {
+        return false;
+    }
+
+    //everything is read before anything is applied, so graph and propagation stay empty on errors
+    std::vector<ControlFlowGraph::EntryPoint> entryPoints(reader.get32());
+    for(ControlFlowGraph::EntryPoint &entry : entryPoints) {
+        entry.address = reader.get32();
+        entry.flags = reader.get8();
+    }
+
+    std::vector<BasicBlock> blocks(reader.valid() ? reader.get32() : 0);
+    for(BasicBlock &block : blocks) {
+        block.start = reader.get32();
+        block.end = reader.get32();
+        block.entryFlags = reader.get8();
+        const uint8_t exit = reader.get8();
+        block.exit = static_cast<ControlFlow>(exit);
+        block.instructionCount = reader.get16();
+        const uint16_t successors = reader.get16();
+        for(uint16_t i = 0; i < successors && reader.valid(); ++i) {
+            const LongAddress target = reader.get32();
+            const uint8_t kind = reader.get8();
+            if(kind > static_cast<uint8_t>(EdgeKind::CALL)) {
+                return false;
+            }
+            block.successors.push_back(Edge(target, static_cast<EdgeKind>(kind)));
+        }
+        if(exit > static_cast<uint8_t>(ControlFlow::HALT) || !reader.valid()) {
+            return false;
+        }
+    }
+
+    std::vector<std::pair<LongAddress, RegisterState> > states(reader.valid() ? reader.get32() : 0);
+    for(std::pair<LongAddress, RegisterState> &state : states) {
+        state.first = reader.get32();
+        state.second.accumulator = reader.getValue();
+        state.second.indexX = reader.getValue();
+        state.second.indexY = reader.getValue();
+        state.second.directPage = reader.getValue();
+        state.second.dataBank = reader.getValue();
+        state.second.stackDepth = reader.get8();
+        if(state.second.stackDepth > RegisterState::MaxStackDepth) {
+            return false;
+        }
+        for(uint8_t i = 0; i < state.second.stackDepth; ++i) {
+            state.second.stack[i] = reader.getValue();
+        }
+        if(!reader.valid()) {
+            return false;
+        }
+    }
+
+    if(!reader.valid() || !reader.atEnd()) {
+        return false;
+    }
+
+    for(const ControlFlowGraph::EntryPoint &entry : entryPoints) {
+        graph.addEntryPoint(entry.address, entry.flags);
+    }
+    for(const BasicBlock &block : blocks) {
+        graph.addBlock(block);
+    }
+    for(const std::pair<LongAddress, RegisterState> &state : states) {
+        propagation.restore(state.first, state.second);
+    }
+
+    //mark the entry as recently used
+    utime(path.c_str(), nullptr);
+    return true;
+}
+
+bool AnalysisCache::store(const SNESROM &rom, const ControlFlowGraph &graph,
+                          const ConstantPropagation &propagation) {
+    Writer writer;
+    writeHeader(writer, rom);
+
+    writer.put32(graph.entryPoints().size());
+    for(const ControlFlowGraph::EntryPoint &entry : graph.entryPoints()) {
+        writer.put32(entry.address);
+        writer.put8(entry.flags);
+    }
+
+    writer.put32(graph.blocks().size());
+    for(const ControlFlowGraph::BlockMap::value_type &entry : graph.blocks()) {
+        const BasicBlock &block = entry.second;
+        writer.put32(block.start);
+        writer.put32(block.end);
+        writer.put8(block.entryFlags);
+        writer.put8(static_cast<uint8_t>(block.exit));
+        writer.put16(block.instructionCount);
+        writer.put16(block.successors.size());
+        for(const Edge &edge : block.successors) {
+            writer.put32(edge.target);
+            writer.put8(static_cast<uint8_t>(edge.kind));
+        }
+    }
+
+    writer.put32(propagation.entryStates().size());
+    for(const ConstantPropagation::StateMap::value_type &entry : propagation.entryStates()) {
+        const RegisterState &state = entry.second;
+        writer.put32(entry.first);
+        writer.putValue(state.accumulator);
+        writer.putValue(state.indexX);
+        writer.putValue(state.indexY);
+        writer.putValue(state.directPage);
+        writer.putValue(state.dataBank);
+        writer.put8(state.stackDepth);
+        for(uint8_t i = 0; i < state.stackDepth; ++i) {
+            writer.putValue(state.stack[i]);
+        }
+    }
+
+    writer.put64(SNESROM::hash(reinterpret_cast<const uint8_t *>(writer.data().data()), writer.data().size()));
+
+    //other processes only ever see complete entries
+    const std::string path = pathOf(rom);
+    std::ostringstream temporary;
+    temporary << path << '.' << getpid() << '.' << s_TemporaryCounter++ << TemporaryExtension;
+
+    std::ofstream file(temporary.str(), std::ofstream::binary | std::ofstream::trunc);
+    file.write(writer.data().data(), writer.data().size());
+    file.close();
+    if(!file || std::rename(temporary.str().c_str(), path.c_str()) != 0) {
+        LOG_SRC(WARNING, "Cannot write the cache entry " + path);
+        std::remove(temporary.str().c_str());
+        return false;
+    }
+
+    trim();
+    return true;
+}
+
+void AnalysisCache::trim() {
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        std::time_t used;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    const std::time_t now = std::time(nullptr);
+
+    DIR *directory = opendir(m_Directory.c_str());
+    if(directory == nullptr) {
+        return;
+    }
+    for(dirent *file = readdir(directory); file != nullptr; file = readdir(directory)) {
+        const std::string name(file->d_name);
+        const std::string path = m_Directory + "/" + name;
+        struct stat status;
+        if(stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode)) {
+            continue;
+        }
+
+        if(endsWith(name, TemporaryExtension)) {
+            if(now - status.st_mtime > TemporaryLifetime) {
+                std::remove(path.c_str());
+            }
+        } else if(endsWith(name, Extension)) {
+            Entry entry = {path, static_cast<uint64_t>(status.st_size), status.st_mtime};
+            entries.push_back(entry);
+            total += entry.size;
+        }
+    }
+    closedir(directory);
+
+    std::sort(entries.begin(), entries.end(), [](const Entry & a, const Entry & b) {
+        return a.used < b.used;
+    });
+
+    //another process may have removed an entry already, which is fine
+    for(std::size_t i = 0; i < entries.size() && total > m_SizeLimit; ++i) {
+        std::remove(entries[i].path.c_str());
+        total -= entries[i].size;
+    }
+}
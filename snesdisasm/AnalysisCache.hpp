@@ -0,0 +1,77 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ANALYSISCACHE_HPP
+#define ANALYSISCACHE_HPP
+
+#include "SNESROM.hpp"
+#include "ControlFlowGraph.hpp"
+#include "ConstantPropagation.hpp"
+
+#include <cstdint>
+#include <string>
+
+/*! \brief A directory of analysis results keyed by the content hash of the ROM and the library version
+ *
+ *  Byte-identical images share an entry, whatever their file name and whether they carry an SMC header. An
+ *  entry holds the blocks and entry points of the \see ControlFlowGraph and the block entry states of the
+ *  \see ConstantPropagation; everything else is cheap to derive from them.
+ *
+ *  Several processes may use the same directory at once. Entries are written to a temporary file and renamed
+ *  into place, so readers never see partial entries, and a damaged entry is treated as missing. When the
+ *  directory grows beyond its size limit, the least recently used entries are removed.
+ */
+class AnalysisCache {
+  public:
+    enum { FormatVersion = 2 };
+
+    static const uint64_t DefaultSizeLimit = 1024ULL * 1024 * 1024;
+  private:
+    std::string m_Directory;
+    uint64_t m_SizeLimit;
+
+    std::string pathOf(const SNESROM &rom) const;
+  public:
+    /*! \brief Uses directory, which is created if needed
+     *
+     *  \param sizeLimit the number of bytes all entries may occupy together
+     */
+    explicit AnalysisCache(const std::string &directory, uint64_t sizeLimit = DefaultSizeLimit);
+
+    /*! \brief Returns $XDG_CACHE_HOME/snesdisasm or ~/.cache/snesdisasm
+     */
+    static std::string defaultDirectory();
+
+    const std::string &directory() const { return m_Directory; }
+
+    /*! \brief Fills an empty graph and propagation of rom with a cached result
+     *
+     *  \return false if there is no valid entry for rom
+     */
+    bool load(const SNESROM &rom, ControlFlowGraph &graph, ConstantPropagation &propagation) const;
+
+    /*! \brief Stores the result of a finished analysis and trims the directory to its size limit
+     *
+     *  \return false if the entry could not be written
+     */
+    bool store(const SNESROM &rom, const ControlFlowGraph &graph, const ConstantPropagation &propagation);
+
+    /*! \brief Removes the least recently used entries until the directory fits into the size limit
+     */
+    void trim();
+};
+
+#endif // ANALYSISCACHE_HPP
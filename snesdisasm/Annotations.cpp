@@ -0,0 +1,74 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Annotations.hpp"
+
+namespace {
+
+const char *kindNames[] = {"code", "data", "text", "graphics", "compressed", "comment"};
+
+}
+
+void Annotations::add(uint32_t start, uint32_t end, RegionKind kind, const std::string &text) {
+    if(start < end) {
+        Annotation annotation = {kind, text};
+        m_Regions.insert(start, end, annotation);
+    }
+}
+
+void Annotations::assign(const std::vector<Region> &regions) {
+    std::vector<Region> nonEmpty;
+    nonEmpty.reserve(regions.size());
+    for(const Region &region : regions) {
+        if(region.start < region.end) {
+            nonEmpty.push_back(region);
+        }
+    }
+    m_Regions.assign(nonEmpty);
+}
+
+std::size_t Annotations::remove(uint32_t start, uint32_t end) {
+    return m_Regions.removeIf([start, end](const Region & region) {
+        return region.start < end && region.end > start;
+    });
+}
+
+const Annotations::Region *Annotations::dataAt(uint32_t offset) const {
+    const Region *data = nullptr;
+    bool code = false;
+    m_Regions.forEachContaining(offset, [&](const Region & region) {
+        if(region.value.kind == RegionKind::CODE) {
+            code = true;
+        } else if(region.value.kind != RegionKind::COMMENT && (data == nullptr || region.end > data->end)) {
+            data = &region;
+        }
+    });
+    return code ? nullptr : data;
+}
+
+const char *Annotations::kindName(RegionKind kind) {
+    return kindNames[static_cast<unsigned int>(kind)];
+}
+
+bool Annotations::parseKind(const std::string &name, RegionKind &kind) {
+    for(unsigned int i = 0; i < sizeof(kindNames) / sizeof(kindNames[0]); ++i) {
+        if(name == kindNames[i]) {
+            kind = static_cast<RegionKind>(i);
+            return true;
+        }
+    }
+    return false;
+}
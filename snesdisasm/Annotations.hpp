@@ -0,0 +1,113 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ANNOTATIONS_HPP
+#define ANNOTATIONS_HPP
+
+#include "IntervalTree.hpp"
+
+#include <string>
+#include <vector>
+
+/*! \brief What an annotated range of a ROM holds
+ */
+enum class RegionKind : unsigned char {
+    CODE,       //instructions, overrides data regions it overlaps
+    DATA,       //tables and other binary data
+    TEXT,       //character strings
+    GRAPHICS,   //tiles, palettes and tilemaps
+    COMPRESSED, //compressed blobs of any kind
+    COMMENT     //only carries a comment and does not say what the range holds
+};
+
+struct Annotation {
+    RegionKind kind;
+    std::string text; //a comment, may be empty
+};
+
+/*! \brief Metadata attached to ranges of a ROM image
+ *
+ *  Ranges are given as image offsets (\see SNESROM::imageAddress), so all mirrors of a byte share the same
+ *  annotations. They may overlap and nest. The ranges are kept in an \see IntervalTree, so looking up the
+ *  annotations of one line of a listing takes O(log n) no matter how many there are.
+ */
+class Annotations {
+  public:
+    typedef IntervalTree<Annotation>::Interval Region;
+  private:
+    IntervalTree<Annotation> m_Regions;
+  public:
+    /*! \brief Annotates [start, end). Empty ranges are ignored.
+     */
+    void add(uint32_t start, uint32_t end, RegionKind kind, const std::string &text = std::string());
+
+    /*! \brief Replaces all annotations. Regions sorted by start are taken over in O(n).
+     */
+    void assign(const std::vector<Region> &regions);
+
+    /*! \brief Removes all annotations overlapping [start, end)
+     *
+     *  \return the number of removed annotations
+     */
+    std::size_t remove(uint32_t start, uint32_t end);
+
+    void clear() { m_Regions.clear(); }
+    bool empty() const { return m_Regions.empty(); }
+    std::size_t size() const { return m_Regions.size(); }
+    std::size_t memoryUsage() const { return m_Regions.memoryUsage(); }
+
+    /*! \brief Calls f(region) for every region overlapping [start, end), ordered by start
+     */
+    template<class F>
+    void forEachOverlapping(uint32_t start, uint32_t end, F f) const {
+        m_Regions.forEachOverlapping(start, end, f);
+    }
+
+    /*! \brief Calls f(region) for every region containing offset, ordered by start
+     */
+    template<class F>
+    void forEachAt(uint32_t offset, F f) const {
+        m_Regions.forEachContaining(offset, f);
+    }
+
+    /*! \brief Calls f(region) for all regions, ordered by start
+     */
+    template<class F>
+    void forEach(F f) const {
+        m_Regions.forEach(f);
+    }
+
+    /*! \brief Returns the data region containing offset or nullptr if it is not data
+     *
+     *  Data regions are those of a kind other than CODE and COMMENT. Offsets within a CODE region are never data.
+     *  Of nested data regions the one ending last is returned.
+     */
+    const Region *dataAt(uint32_t offset) const;
+
+    bool isData(uint32_t offset) const { return dataAt(offset) != nullptr; }
+
+    /*! \brief Returns the name of a kind, e.g. "graphics"
+     */
+    static const char *kindName(RegionKind kind);
+
+    /*! \brief Looks up a kind by its name
+     *
+     *  \return false if there is no such kind
+     */
+    static bool parseKind(const std::string &name, RegionKind &kind);
+};
+
+#endif // ANNOTATIONS_HPP
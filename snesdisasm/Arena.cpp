@@ -0,0 +1,66 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Arena.hpp"
+
+#include <cassert>
+
+Arena::Arena(std::size_t blockSize)
+    : m_Blocks(nullptr),
+      m_Position(nullptr),
+      m_End(nullptr),
+      m_BlockSize(blockSize),
+      m_BytesUsed(0),
+      m_BytesReserved(0) {
+    assert(blockSize > sizeof(Block));
+}
+
+Arena::~Arena() {
+    release();
+}
+
+void *Arena::allocateSlow(std::size_t size, std::size_t alignment) {
+    assert((alignment & (alignment - 1)) == 0);
+
+    //large requests get a block of their own
+    const std::size_t header = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    std::size_t blockSize = m_BlockSize;
+    if(header + size + alignment > blockSize) {
+        blockSize = header + size + alignment;
+    }
+
+    Block *block = static_cast<Block *>(::operator new(blockSize));
+    block->next = m_Blocks;
+    m_Blocks = block;
+    m_BytesReserved += blockSize;
+
+    m_Position = reinterpret_cast<char *>(block) + header;
+    m_End = reinterpret_cast<char *>(block) + blockSize;
+
+    return allocate(size, alignment);
+}
+
+void Arena::release() {
+    while(m_Blocks != nullptr) {
+        Block *next = m_Blocks->next;
+        ::operator delete(m_Blocks);
+        m_Blocks = next;
+    }
+    m_Position = nullptr;
+    m_End = nullptr;
+    m_BytesUsed = 0;
+    m_BytesReserved = 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+/*! \brief A monotonic allocator that hands out memory from large blocks
+ *
+ *  Allocating only moves a pointer and deallocating does nothing. All memory is returned at once when the arena
+ *  is destroyed or \see release is called, so objects allocated from it must not be used afterwards. An arena
+ *  is not thread-safe.
+ */
+class Arena {
+  public:
+    enum { DefaultBlockSize = 64 * 1024 };
+  private:
+    struct Block {
+        Block *next;
+    };
+
+    Block *m_Blocks;
+    char *m_Position;
+    char *m_End;
+    std::size_t m_BlockSize;
+    std::size_t m_BytesUsed;
+    std::size_t m_BytesReserved;
+
+    void *allocateSlow(std::size_t size, std::size_t alignment);
+  public:
+    /*! \brief Constructs an empty arena. Memory is reserved in blocks of at least blockSize bytes.
+     */
+    explicit Arena(std::size_t blockSize = DefaultBlockSize);
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /*! \brief Returns size bytes aligned to alignment, which has to be a power of two
+     */
+    void *allocate(std::size_t size, std::size_t alignment) {
+        const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(m_Position) + alignment - 1) & ~(alignment - 1);
+        if(m_Position != nullptr && aligned + size <= reinterpret_cast<std::uintptr_t>(m_End)) {
+            m_Position = reinterpret_cast<char *>(aligned + size);
+            m_BytesUsed += size;
+            return reinterpret_cast<void *>(aligned);
+        }
+        return allocateSlow(size, alignment);
+    }
+
+    /*! \brief Frees all blocks
+     */
+    void release();
+
+    /*! \brief Returns the number of bytes handed out since construction or the last \see release
+     */
+    std::size_t bytesUsed() const { return m_BytesUsed; }
+
+    /*! \brief Returns the number of bytes currently reserved from the heap
+     */
+    std::size_t bytesReserved() const { return m_BytesReserved; }
+};
+
+/*! \brief A standard allocator that takes its memory from an \see Arena
+ *
+ *  A default constructed allocator has no arena and uses the heap, so containers using it can still be
+ *  used on their own. Containers only compare equal if they use the same arena.
+ */
+template<class T>
+class ArenaAllocator {
+  private:
+    Arena *m_Arena;
+  public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : m_Arena(nullptr) {}
+    explicit ArenaAllocator(Arena *arena) : m_Arena(arena) {}
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_Arena(other.arena()) {}
+
+    T *allocate(std::size_t count) {
+        if(m_Arena == nullptr) {
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        }
+        return static_cast<T *>(m_Arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *pointer, std::size_t) {
+        if(m_Arena == nullptr) {
+            ::operator delete(pointer);
+        }
+    }
+
+    Arena *arena() const { return m_Arena; }
+};
+
+template<class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena() == b.arena();
+}
+
+template<class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena() != b.arena();
+}
+
+#endif // ARENA_HPP
@@ -0,0 +1,168 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "BankCache.hpp"
+#include "InstructionLengths.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+
+BankListing::BankListing(const SNESROM &rom, ImageAddress start, uint32_t length,
+                         const std::vector<ImageAddress> &vectors)
+    : m_Start(start) {
+    INSTRUMENT_PHASE(DECODE);
+    const InstructionLengths lengths(rom.image() + start, length);
+    std::vector<ImageAddress>::const_iterator vector = std::lower_bound(vectors.begin(), vectors.end(), start);
+
+    const uint8_t resetFlags = MachineState(MEMORY_SELECT | INDEX_SELECT).getCPUStateRef().FlagRegister();
+    uint8_t flags = resetFlags;
+    uint32_t offset = 0;
+
+    m_Entries.reserve(length / 2);
+    while(offset < length) {
+        if(vector != vectors.end() && *vector == start + offset) {
+            flags = resetFlags;
+        }
+
+        //an instruction may overlap a vector, the sweep then continues behind it unchanged
+        while(vector != vectors.end() && *vector <= start + offset) {
+            ++vector;
+        }
+        const uint32_t stop = vector != vectors.end() && *vector < start + length ? *vector - start : length;
+        offset = lengths.sweep(offset, stop, flags, [this](std::size_t offset, uint8_t flags) {
+            const Entry entry = {static_cast<uint16_t>(offset), flags};
+            m_Entries.push_back(entry);
+        });
+    }
+    m_Entries.shrink_to_fit();
+}
+
+std::size_t BankListing::lowerBound(uint16_t offset) const {
+    return std::lower_bound(m_Entries.begin(), m_Entries.end(), offset, [](const Entry & entry, uint16_t value) {
+        return entry.offset < value;
+    }) - m_Entries.begin();
+}
+
+BankCache::BankCache(const SNESROM &rom, std::size_t budget)
+    : m_ROM(rom),
+      m_BankSize(rom.bankSize()),
+      m_Budget(budget),
+      m_MemoryUsage(0),
+      m_Hits(0),
+      m_Misses(0) {
+    if(rom.header()) {
+        const SNESROMHeader &header = rom.header();
+        ROMAddress *vectors[] = {
+            header.getInterruptDest(EmulationIV::RESET()),
+            header.getInterruptDest(NativeIV::NMT()),
+            header.getInterruptDest(NativeIV::IRQ()),
+            header.getInterruptDest(NativeIV::BRK()),
+            header.getInterruptDest(NativeIV::COP())
+        };
+        for(ROMAddress *vector : vectors) {
+            const ImageAddress image = rom.imageAddress((vector->bank() << 16) | vector->bankAddress());
+            if(image != ImageAddress(-1)) {
+                m_Vectors.push_back(image);
+            }
+            delete vector;
+        }
+        std::sort(m_Vectors.begin(), m_Vectors.end());
+    }
+}
+
+BankCache::ListingPtr BankCache::listing(LongAddress address) {
+    const ImageAddress image = m_ROM.imageAddress(address);
+    if(image == ImageAddress(-1)) {
+        return ListingPtr();
+    }
+    const uint32_t bank = image / m_BankSize;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::unordered_map<uint32_t, LRUList::iterator>::iterator it = m_Index.find(bank);
+        if(it != m_Index.end()) {
+            m_LRU.splice(m_LRU.begin(), m_LRU, it->second);
+            ++m_Hits;
+            INSTRUMENT_COUNT(CACHE_HITS, 1);
+            return it->second->second;
+        }
+        ++m_Misses;
+        INSTRUMENT_COUNT(CACHE_MISSES, 1);
+    }
+
+    const ImageAddress start(bank * m_BankSize);
+    const uint32_t length = std::min<std::size_t>(m_BankSize, m_ROM.imageSize() - start);
+    ListingPtr listing(new BankListing(m_ROM, start, length, m_Vectors));
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::unordered_map<uint32_t, LRUList::iterator>::iterator it = m_Index.find(bank);
+    if(it != m_Index.end()) {
+        //another thread was faster
+        return it->second->second;
+    }
+    m_LRU.push_front(std::make_pair(bank, listing));
+    m_Index[bank] = m_LRU.begin();
+    m_MemoryUsage += listing->memoryUsage();
+    evict();
+    return listing;
+}
+
+void BankCache::evict() {
+    //the most recently used listing is always kept
+    while(m_MemoryUsage > m_Budget && m_LRU.size() > 1) {
+        m_MemoryUsage -= m_LRU.back().second->memoryUsage();
+        m_Index.erase(m_LRU.back().first);
+        m_LRU.pop_back();
+    }
+}
+
+void BankCache::setBudget(std::size_t budget) {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Budget = budget;
+    evict();
+}
+
+void BankCache::clear() {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_LRU.clear();
+    m_Index.clear();
+    m_MemoryUsage = 0;
+}
+
+std::size_t BankCache::budget() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Budget;
+}
+
+std::size_t BankCache::memoryUsage() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_MemoryUsage;
+}
+
+std::size_t BankCache::cachedBanks() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_LRU.size();
+}
+
+uint64_t BankCache::hits() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Hits;
+}
+
+uint64_t BankCache::misses() const {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Misses;
+}
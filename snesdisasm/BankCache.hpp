@@ -0,0 +1,164 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BANKCACHE_HPP
+#define BANKCACHE_HPP
+
+#include "SNESROM.hpp"
+#include "Instructions.hpp"
+#include "MachineState.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*! \brief The instructions found by a linear sweep over one bank of the image
+ *
+ *  On LoROM a bank holds 32 KB of the image, on HiROM and ExHiROM 64 KB. The sweep starts with 8 bit registers and follows
+ *  REP and SEP. At interrupt vectors the registers are assumed to be 8 bit again. The sweep walks the
+ *  \see InstructionLengths of the bank instead of decoding. Only the offset and the processorflags of each
+ *  instruction are kept; the instruction itself is decoded when it is visited.
+ */
+class BankListing {
+  public:
+    struct Entry {
+        uint16_t offset; //from the start of the bank
+        uint8_t flags;   //the processorflags the instruction was decoded with
+    };
+  private:
+    ImageAddress m_Start;
+    std::vector<Entry> m_Entries;
+  public:
+    /*! \brief Sweeps over length bytes of the image beginning at start
+     *
+     *  \param vectors the image offsets of the interrupt vectors, sorted
+     */
+    BankListing(const SNESROM &rom, ImageAddress start, uint32_t length, const std::vector<ImageAddress> &vectors);
+
+    ImageAddress start() const { return m_Start; }
+    const std::vector<Entry> &entries() const { return m_Entries; }
+
+    /*! \brief Returns the number of bytes the listing occupies
+     */
+    std::size_t memoryUsage() const { return sizeof(*this) + m_Entries.capacity() * sizeof(Entry); }
+
+    /*! \brief Returns the index of the first entry at or after offset
+     */
+    std::size_t lowerBound(uint16_t offset) const;
+};
+
+/*! \brief Analyses the banks of a rom on first access and keeps the results in an LRU cache
+ *
+ *  Creating the cache does no work. Each bank is swept when an address in it is first requested. When the
+ *  listings exceed the memory budget, the least recently used ones are dropped; they are swept again if
+ *  requested later. A listing that is still referenced by a caller stays alive until it is released, so the
+ *  budget may be exceeded by the listings callers hold on to.
+ *
+ *  All methods may be called from several threads. Sweeping happens outside the lock, so two threads may
+ *  sweep the same bank at once; the first result to arrive is kept.
+ */
+class BankCache {
+  public:
+    typedef std::shared_ptr<const BankListing> ListingPtr;
+
+    enum { DefaultBudget = 64 * 1024 * 1024 };
+  private:
+    typedef std::list<std::pair<uint32_t, ListingPtr> > LRUList; //most recently used first
+
+    const SNESROM &m_ROM;
+    const uint32_t m_BankSize;
+    std::vector<ImageAddress> m_Vectors;
+
+    mutable std::mutex m_Mutex;
+    std::size_t m_Budget;
+    std::size_t m_MemoryUsage;
+    LRUList m_LRU;
+    std::unordered_map<uint32_t, LRUList::iterator> m_Index;
+    uint64_t m_Hits;
+    uint64_t m_Misses;
+
+    void evict();
+  public:
+    /*! \brief Constructs an empty cache. The rom has to outlive it.
+     *
+     *  \param budget the number of bytes the cached listings may occupy
+     */
+    explicit BankCache(const SNESROM &rom, std::size_t budget = DefaultBudget);
+
+    /*! \brief Returns the listing of the bank containing the CPU address or nullptr if it is not in the image
+     */
+    ListingPtr listing(LongAddress address);
+
+    /*! \brief Changes the budget and drops listings until it is met
+     */
+    void setBudget(std::size_t budget);
+
+    /*! \brief Drops all listings
+     */
+    void clear();
+
+    uint32_t bankSize() const { return m_BankSize; }
+    std::size_t budget() const;
+    std::size_t memoryUsage() const;
+    std::size_t cachedBanks() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+    /*! \brief Calls f(address, instruction, state) for every instruction in [start, end) in order
+     *
+     *  The range may span several banks. Addresses are reported in the banks of start and end, so mirrors can be
+     *  browsed as well.
+     */
+    template<class F>
+    void forEachInstructionIn(LongAddress start, LongAddress end, F f);
+};
+
+template<class F>
+void BankCache::forEachInstructionIn(LongAddress start, LongAddress end, F f) {
+    LongAddress bankStart = start;
+    while(bankStart < end) {
+        const ImageAddress image = m_ROM.imageAddress(bankStart);
+        ListingPtr bank = listing(bankStart);
+        if(!bank) {
+            //skip to the next half bank that may map into the image
+            bankStart = (bankStart & 0xFFFF) < 0x8000 ? (bankStart & 0xFF0000) | 0x8000 : (bankStart & 0xFF0000) + 0x10000;
+            continue;
+        }
+
+        const uint32_t offset = image - bank->start();
+        const LongAddress base = bankStart - offset;
+        const std::vector<BankListing::Entry> &entries = bank->entries();
+
+        for(std::size_t i = bank->lowerBound(offset); i < entries.size(); ++i) {
+            const LongAddress address = base + entries[i].offset;
+            if(address >= end) {
+                return;
+            }
+
+            const uint8_t *bytes = m_ROM.image() + bank->start() + entries[i].offset;
+            const MachineState state(entries[i].flags);
+            f(address, Instruction(state, bytes, address), state);
+        }
+
+        bankStart = base + m_BankSize;
+    }
+}
+
+#endif // BANKCACHE_HPP
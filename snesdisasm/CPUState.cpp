@@ -37,7 +37,7 @@ uint16_t CPUState::getIndexX() {
 }
 
 uint16_t CPUState::getIndexY() {
-    if (areFlagsSet(MEMORY_SELECT)) {
+    if (areFlagsSet(INDEX_SELECT)) {
         //if the flag is set, the indexY uses the lower 8 bit
         return (m_IndexY & 0x00FF);
     } else {
@@ -96,5 +96,49 @@ void CPUState::setFlagRegister(uint8_t flagRegisterNamesBitmask) {
 }
 
 void CPUState::resetFlagRegister(uint8_t flagRegisterNamesBitmask) {
-    m_FlagRegister &= !flagRegisterNamesBitmask;
+    m_FlagRegister &= ~flagRegisterNamesBitmask;
+}
+
+uint8_t CPUState::FlagRegister() const {
+    return m_FlagRegister;
+}
+
+uint16_t *CPUState::StackPointer() const {
+    return m_StackPointer;
+}
+
+void CPUState::setStackPointer(uint16_t *StackPointer) {
+    m_StackPointer = StackPointer;
+}
+
+uint8_t CPUState::DataBank() const {
+    return m_DataBank;
+}
+
+void CPUState::setDataBank(const uint8_t &DataBank) {
+    m_DataBank = DataBank;
+}
+
+uint16_t CPUState::DirectPage() const {
+    return m_DirectPage;
+}
+
+void CPUState::setDirectPage(const uint16_t &DirectPage) {
+    m_DirectPage = DirectPage;
+}
+
+uint8_t CPUState::ProgramBank() const {
+    return m_ProgramBank;
+}
+
+void CPUState::setProgramBank(const uint8_t &ProgramBank) {
+    m_ProgramBank = ProgramBank;
+}
+
+uint16_t CPUState::ProgramCounter() const {
+    return m_ProgramCounter;
+}
+
+void CPUState::setProgramCounter(const uint16_t &ProgramCounter) {
+    m_ProgramCounter = ProgramCounter;
 }
@@ -90,6 +90,10 @@ public:
      * \param flagRegisterNameBitmask is a bitmask where all bits which are set to 1 will be reset.
      */
     void resetFlagRegister(uint8_t flagRegisterNamesBitmask);
+    /**
+     * \brief FlagRegister returns the complete bitmask of processorflags.
+     */
+    uint8_t FlagRegister() const;
 
 
     //automatically generated getter- and setter-functions by Qt Creator
@@ -0,0 +1,252 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CallGraph.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <set>
+
+CallGraph::CallGraph(const ControlFlowGraph &graph, Arena *arena)
+    : m_Graph(graph),
+      m_Arena(arena),
+      m_Functions(FunctionList::allocator_type(arena)),
+      m_Components(ComponentList::allocator_type(arena)),
+      m_Levels(LevelList::allocator_type(arena)) {
+    INSTRUMENT_PHASE(ANALYSIS);
+    const ControlFlowGraph::BlockMap &blocks = graph.blocks();
+
+    std::vector<LongAddress> entries;
+    for(const ControlFlowGraph::EntryPoint &entry : graph.entryPoints()) {
+        entries.push_back(entry.address);
+    }
+    for(const ControlFlowGraph::BlockMap::value_type &block : blocks) {
+        for(const Edge &edge : block.second.successors) {
+            //a jump into another bank is a JML, which is how long subroutines are usually tail called
+            if(edge.kind == EdgeKind::CALL ||
+                    (edge.kind == EdgeKind::JUMP && (edge.target & 0xFF0000) != (block.first & 0xFF0000))) {
+                entries.push_back(edge.target);
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    m_Functions.reserve(entries.size());
+    for(LongAddress entry : entries) {
+        if(blocks.count(entry) != 0) {
+            Function function(m_Arena);
+            function.entry = entry;
+            m_Functions.push_back(std::move(function));
+        }
+    }
+
+    collectBodies();
+    findComponents();
+    assignLevels();
+}
+
+void CallGraph::collectBodies() {
+    const ControlFlowGraph::BlockMap &blocks = m_Graph.blocks();
+    std::vector<std::vector<std::size_t> > callers(m_Functions.size());
+
+    for(std::size_t i = 0; i < m_Functions.size(); ++i) {
+        Function &function = m_Functions[i];
+        std::set<LongAddress> visited;
+        std::vector<LongAddress> worklist(1, function.entry);
+        std::vector<LongAddress> exits;
+        std::vector<std::size_t> callees;
+
+        while(!worklist.empty()) {
+            const LongAddress address = worklist.back();
+            worklist.pop_back();
+
+            ControlFlowGraph::BlockMap::const_iterator block = blocks.find(address);
+            if(block == blocks.end() || !visited.insert(address).second) {
+                continue;
+            }
+
+            switch(block->second.exit) {
+            case ControlFlow::RETURN:
+                //a return dispatching to a pushed address has successors and does not leave the function
+                if(block->second.successors.empty()) {
+                    exits.push_back(address);
+                }
+                break;
+            case ControlFlow::INDIRECT_JUMP:
+            case ControlFlow::INDIRECT_CALL:
+                function.indirect = true;
+                break;
+            default:
+                break;
+            }
+
+            for(const Edge &edge : block->second.successors) {
+                const std::size_t callee = indexOf(edge.target);
+                if(edge.kind == EdgeKind::CALL) {
+                    if(callee < m_Functions.size()) {
+                        callees.push_back(callee);
+                    }
+                } else if(callee < m_Functions.size() && callee != i) {
+                    callees.push_back(callee); //tail call
+                } else {
+                    worklist.push_back(edge.target);
+                }
+            }
+        }
+
+        //visited is ordered, so the blocks come out sorted
+        function.blocks.assign(visited.begin(), visited.end());
+        std::sort(exits.begin(), exits.end());
+        function.exits.assign(exits.begin(), exits.end());
+        std::sort(callees.begin(), callees.end());
+        callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+        function.callees.assign(callees.begin(), callees.end());
+
+        for(std::size_t callee : callees) {
+            callers[callee].push_back(i);
+        }
+    }
+
+    //callers were added in ascending order of i
+    for(std::size_t i = 0; i < m_Functions.size(); ++i) {
+        m_Functions[i].callers.assign(callers[i].begin(), callers[i].end());
+    }
+}
+
+void CallGraph::findComponents() {
+    //Tarjan's algorithm with an explicit stack, since call chains may be deep
+    const std::size_t count = m_Functions.size();
+    const std::size_t unvisited = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> index(count, unvisited);
+    std::vector<std::size_t> lowlink(count, 0);
+    std::vector<bool> onStack(count, false);
+    std::vector<std::size_t> stack;
+    std::vector<std::pair<std::size_t, std::size_t> > frames; //function, next callee to visit
+    std::vector<CallComponent> components;
+    std::size_t counter = 0;
+
+    for(std::size_t root = 0; root < count; ++root) {
+        if(index[root] != unvisited) {
+            continue;
+        }
+
+        index[root] = lowlink[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = true;
+        frames.push_back(std::make_pair(root, 0));
+
+        while(!frames.empty()) {
+            const std::size_t current = frames.back().first;
+            const Function::IndexList &callees = m_Functions[current].callees;
+
+            if(frames.back().second < callees.size()) {
+                const std::size_t callee = callees[frames.back().second++];
+                if(index[callee] == unvisited) {
+                    index[callee] = lowlink[callee] = counter++;
+                    stack.push_back(callee);
+                    onStack[callee] = true;
+                    frames.push_back(std::make_pair(callee, 0));
+                } else if(onStack[callee]) {
+                    lowlink[current] = std::min(lowlink[current], index[callee]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if(!frames.empty()) {
+                const std::size_t caller = frames.back().first;
+                lowlink[caller] = std::min(lowlink[caller], lowlink[current]);
+            }
+
+            if(lowlink[current] != index[current]) {
+                continue;
+            }
+
+            //current is the root of a component
+            std::vector<std::size_t> members;
+            std::size_t member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                m_Functions[member].component = components.size();
+                members.push_back(member);
+            } while(member != current);
+            std::sort(members.begin(), members.end());
+
+            CallComponent component(m_Arena);
+            component.functions.assign(members.begin(), members.end());
+            component.recursive = members.size() > 1 ||
+                                  std::binary_search(callees.begin(), callees.end(), current);
+            components.push_back(std::move(component));
+        }
+    }
+
+    m_Components.reserve(components.size());
+    for(CallComponent &component : components) {
+        m_Components.push_back(std::move(component));
+    }
+}
+
+void CallGraph::assignLevels() {
+    std::vector<std::size_t> levelSizes;
+
+    //all callees of a component come before it
+    for(std::size_t i = 0; i < m_Components.size(); ++i) {
+        CallComponent &component = m_Components[i];
+        for(std::size_t function : component.functions) {
+            for(std::size_t callee : m_Functions[function].callees) {
+                const std::size_t other = m_Functions[callee].component;
+                if(other != i) {
+                    component.level = std::max(component.level, m_Components[other].level + 1);
+                }
+            }
+        }
+
+        if(component.level >= levelSizes.size()) {
+            levelSizes.resize(component.level + 1, 0);
+        }
+        ++levelSizes[component.level];
+    }
+
+    m_Levels.reserve(levelSizes.size());
+    for(std::size_t size : levelSizes) {
+        Function::IndexList level{Function::IndexList::allocator_type(m_Arena)};
+        level.reserve(size);
+        m_Levels.push_back(std::move(level));
+    }
+    for(std::size_t i = 0; i < m_Components.size(); ++i) {
+        m_Levels[m_Components[i].level].push_back(i);
+    }
+}
+
+const Function *CallGraph::functionAt(LongAddress entry) const {
+    const std::size_t index = indexOf(entry);
+    return index < m_Functions.size() ? &m_Functions[index] : nullptr;
+}
+
+std::size_t CallGraph::indexOf(LongAddress entry) const {
+    FunctionList::const_iterator it = std::lower_bound(m_Functions.begin(), m_Functions.end(), entry,
+    [](const Function & function, LongAddress address) {
+        return function.entry < address;
+    });
+    if(it != m_Functions.end() && it->entry == entry) {
+        return it - m_Functions.begin();
+    }
+    return m_Functions.size();
+}
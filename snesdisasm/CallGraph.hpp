@@ -0,0 +1,158 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CALLGRAPH_HPP
+#define CALLGRAPH_HPP
+
+#include "ControlFlowGraph.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/*! \brief A subroutine of an analysed ROM
+ */
+struct Function {
+    typedef std::vector<LongAddress, ArenaAllocator<LongAddress> > AddressList;
+    typedef std::vector<std::size_t, ArenaAllocator<std::size_t> > IndexList;
+
+    /*! \brief The address of the first instruction
+     */
+    LongAddress entry;
+
+    /*! \brief The start of every block belonging to the function in ascending order
+     *
+     *  Code that is jumped to from several functions belongs to all of them.
+     */
+    AddressList blocks;
+
+    /*! \brief The start of every block ending with RTS, RTL or RTI in ascending order. Returns that dispatch
+     *         to a known target (see \see StackAnalysis) are not exits.
+     */
+    AddressList exits;
+
+    /*! \brief The indices of all functions called or tail jumped to, in ascending order
+     */
+    IndexList callees;
+
+    /*! \brief The indices of all functions calling or tail jumping to this one, in ascending order
+     */
+    IndexList callers;
+
+    /*! \brief The index of the strongly connected component of the call graph the function belongs to
+     */
+    std::size_t component;
+
+    /*! \brief True if the function contains an indirect jump or call. Its callees may be incomplete then.
+     */
+    bool indirect;
+
+    explicit Function(Arena *arena)
+        : entry(0), blocks(AddressList::allocator_type(arena)), exits(AddressList::allocator_type(arena)),
+          callees(IndexList::allocator_type(arena)), callers(IndexList::allocator_type(arena)), component(0),
+          indirect(false) {}
+};
+
+/*! \brief A strongly connected component of the call graph, i.e. a set of mutually recursive functions
+ */
+struct CallComponent {
+    /*! \brief The indices of the functions in the component
+     */
+    Function::IndexList functions;
+
+    /*! \brief 0 for components that call nothing outside themselves, otherwise one more than the highest level
+     *         of a component called
+     */
+    unsigned int level;
+
+    /*! \brief True if a function of the component calls itself or another one of the component
+     */
+    bool recursive;
+
+    explicit CallComponent(Arena *arena)
+        : functions(Function::IndexList::allocator_type(arena)), level(0), recursive(false) {}
+};
+
+/*! \brief The functions of a \see ControlFlowGraph and the calls between them
+ *
+ *  Functions start at the entry points of the graph, at the targets of JSR and JSL and at the targets of jumps
+ *  into another bank. A function consists of all blocks reachable from its entry without following calls. A
+ *  jump or fall through to the entry of another function ends the function there and counts as a tail call.
+ *
+ *  The strongly connected components of the call graph are computed with Tarjan's algorithm and listed bottom
+ *  up: every component comes after all components it calls. Components of the same level do not call each
+ *  other, so they may be analysed in parallel once all lower levels are done. Everything is allocated from the
+ *  arena passed to the constructor, which need not be the one of the graph: results that are computed again for
+ *  every pass over a growing graph can be released without losing the graph.
+ */
+class CallGraph {
+  public:
+    typedef std::vector<Function, ArenaAllocator<Function> > FunctionList;
+    typedef std::vector<CallComponent, ArenaAllocator<CallComponent> > ComponentList;
+    typedef std::vector<Function::IndexList, ArenaAllocator<Function::IndexList> > LevelList;
+  private:
+    const ControlFlowGraph &m_Graph;
+    Arena *m_Arena;
+    FunctionList m_Functions; //sorted by entry
+    ComponentList m_Components;
+    LevelList m_Levels;
+
+    void collectBodies();
+    void findComponents();
+    void assignLevels();
+  public:
+    /*! \brief Detects the functions of a built graph. The graph has to outlive the call graph and so does arena,
+     *  unless it is nullptr to allocate from the heap.
+     */
+    CallGraph(const ControlFlowGraph &graph, Arena *arena);
+
+    Arena *arena() const { return m_Arena; }
+
+    const FunctionList &functions() const { return m_Functions; }
+
+    /*! \brief Returns the components in bottom-up order
+     */
+    const ComponentList &components() const { return m_Components; }
+
+    /*! \brief Returns the indices of the components of every level, starting with level 0
+     */
+    const LevelList &levels() const { return m_Levels; }
+
+    /*! \brief Returns the function starting at entry or nullptr if there is none
+     */
+    const Function *functionAt(LongAddress entry) const;
+
+    /*! \brief Returns the index of the function starting at entry or functions().size() if there is none
+     */
+    std::size_t indexOf(LongAddress entry) const;
+
+    /*! \brief Calls f(function) for every function, callees before callers
+     *
+     *  Within a recursive component the order is unspecified.
+     */
+    template<class F>
+    void forEachBottomUp(F f) const;
+};
+
+template<class F>
+void CallGraph::forEachBottomUp(F f) const {
+    for(const CallComponent &component : m_Components) {
+        for(std::size_t index : component.functions) {
+            f(m_Functions[index]);
+        }
+    }
+}
+
+#endif // CALLGRAPH_HPP
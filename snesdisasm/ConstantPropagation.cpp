@@ -0,0 +1,473 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ConstantPropagation.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+
+#include <cstring>
+#include <set>
+
+namespace {
+
+enum ClobberedRegisters : uint8_t {
+    CLOBBERS_A = 0x01,
+    CLOBBERS_X = 0x02,
+    CLOBBERS_Y = 0x04
+};
+
+/*! \brief Lists for every opcode which registers it overwrites with values the propagation does not model
+ */
+struct ClobberTable {
+    uint8_t registers[256];
+
+    ClobberTable() {
+        const MachineState state;
+        for(unsigned int opCode = 0; opCode < 256; ++opCode) {
+            const uint8_t bytes[4] = {static_cast<uint8_t>(opCode), 0, 0, 0};
+            const Instruction instruction(state, bytes, 0);
+            const char *m = instruction.mnemonic();
+
+            registers[opCode] = 0;
+            if(!std::strcmp(m, "LDA") || !std::strcmp(m, "ADC") || !std::strcmp(m, "SBC") ||
+               !std::strcmp(m, "AND") || !std::strcmp(m, "ORA") || !std::strcmp(m, "EOR") ||
+               !std::strcmp(m, "TSC")) {
+                registers[opCode] |= CLOBBERS_A;
+            }
+            if(instruction.addressingMode() == ACCUMULATOR) {
+                registers[opCode] |= CLOBBERS_A; //shifts and rotates
+            }
+            if(!std::strcmp(m, "LDX") || !std::strcmp(m, "TSX")) {
+                registers[opCode] |= CLOBBERS_X;
+            }
+            if(!std::strcmp(m, "LDY")) {
+                registers[opCode] |= CLOBBERS_Y;
+            }
+        }
+    }
+};
+
+const ClobberTable &clobberTable() {
+    static const ClobberTable table;
+    return table;
+}
+
+//replaces the low byte of reg
+AbstractValue withLow(const AbstractValue &reg, const AbstractValue &low) {
+    return AbstractValue((reg.value & 0xFF00) | (low.value & 0x00FF), (reg.known & 0xFF00) | (low.known & 0x00FF));
+}
+
+//loads a register honoring its size. 8 bit index registers have a high byte of zero.
+AbstractValue loadAccumulator(const AbstractValue &reg, const AbstractValue &value, bool is8Bit) {
+    return is8Bit ? withLow(reg, value) : value;
+}
+
+AbstractValue loadIndex(const AbstractValue &value, bool is8Bit) {
+    return is8Bit ? withLow(AbstractValue::constant(0), value) : value;
+}
+
+AbstractValue add(const AbstractValue &reg, int delta, bool is8Bit) {
+    if(is8Bit) {
+        if(!reg.isKnown(0x00FF)) {
+            return AbstractValue(reg.value, reg.known & 0xFF00);
+        }
+        return withLow(reg, AbstractValue::constant(reg.value + delta));
+    }
+    if(!reg.isKnown()) {
+        return AbstractValue::unknown();
+    }
+    return AbstractValue::constant(reg.value + delta);
+}
+
+}
+
+RegisterState RegisterState::powerOn() {
+    RegisterState state;
+    state.directPage = AbstractValue::constant(0x0000);
+    state.dataBank = AbstractValue::constant(0x00);
+    return state;
+}
+
+void RegisterState::push(const AbstractValue &byte) {
+    if(stackDepth == MaxStackDepth) {
+        //forget the oldest entry
+        for(unsigned int i = 1; i < MaxStackDepth; ++i) {
+            stack[i - 1] = stack[i];
+        }
+        --stackDepth;
+    }
+    stack[stackDepth++] = AbstractValue(byte.value, byte.known & 0x00FF);
+}
+
+void RegisterState::push16(const AbstractValue &word) {
+    push(AbstractValue(word.value >> 8, word.known >> 8));
+    push(word);
+}
+
+AbstractValue RegisterState::pull() {
+    if(stackDepth == 0) {
+        return AbstractValue::unknown();
+    }
+    return stack[--stackDepth];
+}
+
+AbstractValue RegisterState::pull16() {
+    const AbstractValue low = pull();
+    const AbstractValue high = pull();
+    return AbstractValue((high.value << 8) | low.value, (high.known << 8) | low.known);
+}
+
+bool RegisterState::meet(const RegisterState &other) {
+    RegisterState result;
+    result.accumulator = accumulator.meet(other.accumulator);
+    result.indexX = indexX.meet(other.indexX);
+    result.indexY = indexY.meet(other.indexY);
+    result.directPage = directPage.meet(other.directPage);
+    result.dataBank = dataBank.meet(other.dataBank);
+
+    //the stacks are aligned at their top
+    result.stackDepth = stackDepth < other.stackDepth ? stackDepth : other.stackDepth;
+    for(unsigned int i = 1; i <= result.stackDepth; ++i) {
+        result.stack[result.stackDepth - i] = stack[stackDepth - i].meet(other.stack[other.stackDepth - i]);
+    }
+
+    bool changed = result.accumulator != accumulator || result.indexX != indexX || result.indexY != indexY ||
+                   result.directPage != directPage || result.dataBank != dataBank ||
+                   result.stackDepth != stackDepth;
+    for(unsigned int i = 0; !changed && i < stackDepth; ++i) {
+        changed = result.stack[i] != stack[i];
+    }
+
+    *this = result;
+    return changed;
+}
+
+ConstantPropagation::ConstantPropagation(const ControlFlowGraph &graph)
+    : m_Graph(graph),
+      m_EntryStates(StateMap::key_compare(), StateMap::allocator_type(graph.arena())) {
+}
+
+void ConstantPropagation::restore(LongAddress address, const RegisterState &state) {
+    m_EntryStates[address] = state;
+}
+
+void ConstantPropagation::seed(LongAddress address, const RegisterState &state) {
+    m_EntryStates[address] = state;
+}
+
+bool ConstantPropagation::propagate(LongAddress target, const RegisterState &state) {
+    StateMap::iterator it = m_EntryStates.find(target);
+    if(it == m_EntryStates.end()) {
+        m_EntryStates.insert(std::make_pair(target, state));
+        return true;
+    }
+    return it->second.meet(state);
+}
+
+void ConstantPropagation::run() {
+    INSTRUMENT_PHASE(ANALYSIS);
+    TRACE_SCOPE("propagation");
+    LongAddress resetVector = 0xFFFFFFFF;
+    if(m_Graph.rom().header()) {
+        ROMAddress *reset = m_Graph.rom().header().getInterruptDest(EmulationIV::RESET());
+        resetVector = (reset->bank() << 16) | reset->bankAddress();
+        delete reset;
+    }
+
+    std::vector<LongAddress> worklist;
+    std::set<LongAddress> queued;
+
+    for(const ControlFlowGraph::EntryPoint &entry : m_Graph.entryPoints()) {
+        if(m_EntryStates.count(entry.address) == 0) {
+            m_EntryStates[entry.address] = entry.address == resetVector ? RegisterState::powerOn()
+                                                                        : RegisterState::unknown();
+        }
+    }
+    for(const StateMap::value_type &entry : m_EntryStates) {
+        worklist.push_back(entry.first);
+        INSTRUMENT_COUNT(WORKLIST_PUSHES, 1);
+        queued.insert(entry.first);
+    }
+
+    uint64_t iterations = 0;
+    while(!worklist.empty()) {
+        const LongAddress address = worklist.back();
+        worklist.pop_back();
+        queued.erase(address);
+        ++iterations;
+
+        ControlFlowGraph::BlockMap::const_iterator it = m_Graph.blocks().find(address);
+        if(it == m_Graph.blocks().end()) {
+            continue;
+        }
+        const BasicBlock &block = it->second;
+
+        RegisterState state = m_EntryStates[address];
+        m_Graph.forEachInstruction(block, [&state](LongAddress address, const Instruction & instruction,
+        const MachineState & machineState) {
+            step(state, address, instruction, machineState);
+        });
+
+        for(const Edge &edge : block.successors) {
+            RegisterState successor = state;
+            if(edge.kind == EdgeKind::CALL) {
+                //the subroutine starts with its own stack frame
+                successor.stackDepth = 0;
+            } else if(edge.kind == EdgeKind::FALLTHROUGH &&
+                      (block.exit == ControlFlow::CALL || block.exit == ControlFlow::INDIRECT_CALL)) {
+                successor.accumulator = AbstractValue::unknown();
+                successor.indexX = AbstractValue::unknown();
+                successor.indexY = AbstractValue::unknown();
+            }
+
+            if(propagate(edge.target, successor) && queued.insert(edge.target).second) {
+                worklist.push_back(edge.target);
+                INSTRUMENT_COUNT(WORKLIST_PUSHES, 1);
+            }
+        }
+    }
+    TRACE_ITERATIONS(iterations);
+}
+
+bool ConstantPropagation::stateBefore(LongAddress address, RegisterState &state) const {
+    const BasicBlock *block = m_Graph.blockAt(address);
+    if(block == nullptr) {
+        return false;
+    }
+    StateMap::const_iterator entry = m_EntryStates.find(block->start);
+    if(entry == m_EntryStates.end()) {
+        return false;
+    }
+
+    RegisterState current = entry->second;
+    bool found = false;
+    m_Graph.forEachInstruction(*block, [&](LongAddress pos, const Instruction & instruction,
+    const MachineState & machineState) {
+        if(pos == address) {
+            state = current;
+            found = true;
+        }
+        if(!found) {
+            step(current, pos, instruction, machineState);
+        }
+    });
+    return found;
+}
+
+void ConstantPropagation::step(RegisterState &state, LongAddress address, const Instruction &instruction,
+                               const MachineState &machineState) {
+    const bool m8 = machineState.getCPUStateRef().areFlagsSet(MEMORY_SELECT);
+    const bool x8 = machineState.getCPUStateRef().areFlagsSet(INDEX_SELECT);
+    const AbstractValue operand = AbstractValue::constant(instruction.operand());
+
+    switch(instruction.opCode()) {
+    case 0xA9: //LDA #
+        state.accumulator = loadAccumulator(state.accumulator, operand, m8);
+        break;
+    case 0xA2: //LDX #
+        state.indexX = loadIndex(operand, x8);
+        break;
+    case 0xA0: //LDY #
+        state.indexY = loadIndex(operand, x8);
+        break;
+    case 0xAA: //TAX
+        state.indexX = loadIndex(state.accumulator, x8);
+        break;
+    case 0xA8: //TAY
+        state.indexY = loadIndex(state.accumulator, x8);
+        break;
+    case 0x8A: //TXA
+        state.accumulator = loadAccumulator(state.accumulator, state.indexX, m8);
+        break;
+    case 0x98: //TYA
+        state.accumulator = loadAccumulator(state.accumulator, state.indexY, m8);
+        break;
+    case 0x9B: //TXY
+        state.indexY = loadIndex(state.indexX, x8);
+        break;
+    case 0xBB: //TYX
+        state.indexX = loadIndex(state.indexY, x8);
+        break;
+    case 0x5B: //TCD
+        state.directPage = state.accumulator;
+        break;
+    case 0x7B: //TDC
+        state.accumulator = state.directPage;
+        break;
+    case 0xEB: //XBA
+        state.accumulator = AbstractValue((state.accumulator.value << 8) | (state.accumulator.value >> 8),
+                                          (state.accumulator.known << 8) | (state.accumulator.known >> 8));
+        break;
+    case 0x1A: //INC A
+        state.accumulator = add(state.accumulator, 1, m8);
+        break;
+    case 0x3A: //DEC A
+        state.accumulator = add(state.accumulator, -1, m8);
+        break;
+    case 0xE8: //INX
+        state.indexX = add(state.indexX, 1, x8);
+        break;
+    case 0xCA: //DEX
+        state.indexX = add(state.indexX, -1, x8);
+        break;
+    case 0xC8: //INY
+        state.indexY = add(state.indexY, 1, x8);
+        break;
+    case 0x88: //DEY
+        state.indexY = add(state.indexY, -1, x8);
+        break;
+    case 0x8B: //PHB
+        state.push(state.dataBank);
+        break;
+    case 0x4B: //PHK
+        state.push(AbstractValue::constant(address >> 16));
+        break;
+    case 0x0B: //PHD
+        state.push16(state.directPage);
+        break;
+    case 0xF4: //PEA
+        state.push16(operand);
+        break;
+    case 0xD4: //PEI
+        state.push16(AbstractValue::unknown());
+        break;
+    case 0x62: //PER
+        state.push16(AbstractValue::constant(instruction.target() & 0xFFFF));
+        break;
+    case 0x48: //PHA
+        m8 ? state.push(state.accumulator) : state.push16(state.accumulator);
+        break;
+    case 0xDA: //PHX
+        x8 ? state.push(state.indexX) : state.push16(state.indexX);
+        break;
+    case 0x5A: //PHY
+        x8 ? state.push(state.indexY) : state.push16(state.indexY);
+        break;
+    case 0x08: //PHP
+        state.push(AbstractValue::unknown());
+        break;
+    case 0xAB: //PLB
+        state.dataBank = state.pull();
+        break;
+    case 0x2B: //PLD
+        state.directPage = state.pull16();
+        break;
+    case 0x68: //PLA
+        state.accumulator = loadAccumulator(state.accumulator, m8 ? state.pull() : state.pull16(), m8);
+        break;
+    case 0xFA: //PLX
+        state.indexX = loadIndex(x8 ? state.pull() : state.pull16(), x8);
+        break;
+    case 0x7A: //PLY
+        state.indexY = loadIndex(x8 ? state.pull() : state.pull16(), x8);
+        break;
+    case 0x28: //PLP
+        state.pull();
+        break;
+    case 0x60: //RTS
+        state.pull16();
+        break;
+    case 0x6B: //RTL
+        state.pull16();
+        state.pull();
+        break;
+    case 0x40: //RTI, in native mode
+        state.pull();
+        state.pull16();
+        state.pull();
+        break;
+    case 0x1B: //TCS
+    case 0x9A: //TXS
+        state.stackDepth = 0;
+        break;
+    case 0x44: //MVP
+    case 0x54: //MVN
+        //the data bank becomes the destination bank, which is the first argument byte
+        state.dataBank = AbstractValue::constant(instruction.operand() & 0xFF);
+        state.accumulator = AbstractValue::constant(0xFFFF);
+        state.indexX = AbstractValue::unknown();
+        state.indexY = AbstractValue::unknown();
+        break;
+    case 0xE2: //SEP
+        if(instruction.operand() & INDEX_SELECT) {
+            state.indexX = withLow(AbstractValue::constant(0), state.indexX);
+            state.indexY = withLow(AbstractValue::constant(0), state.indexY);
+        }
+        break;
+    default: {
+        const uint8_t clobbered = clobberTable().registers[instruction.opCode()];
+        if(clobbered & CLOBBERS_A) {
+            state.accumulator = m8 ? AbstractValue(state.accumulator.value, state.accumulator.known & 0xFF00)
+                                : AbstractValue::unknown();
+        }
+        if(clobbered & CLOBBERS_X) {
+            state.indexX = loadIndex(AbstractValue::unknown(), x8);
+        }
+        if(clobbered & CLOBBERS_Y) {
+            state.indexY = loadIndex(AbstractValue::unknown(), x8);
+        }
+        break;
+    }
+    }
+}
+
+bool ConstantPropagation::resolveOperand(LongAddress address, const Instruction &instruction,
+        const RegisterState &state, LongAddress &target) {
+    const ControlFlow flow = instruction.controlFlow();
+    if(flow == ControlFlow::JUMP || flow == ControlFlow::CALL || flow == ControlFlow::BRANCH) {
+        return false;
+    }
+
+    switch(instruction.addressingMode()) {
+    case ABSOLUTE:
+    case ABSOLUTE_INDEXED_WITH_X:
+    case ABSOLUTE_INDEXED_WITH_Y:
+        if(!state.dataBank.isKnown(0x00FF)) {
+            return false;
+        }
+        target = (state.dataBank.value << 16) | instruction.operand();
+        return true;
+    case ABSOLUTE_LONG:
+    case ABSOLUTE_INDEXED_LONG_WITH_X:
+        target = instruction.operand();
+        return true;
+    case DIRECT:
+    case DIRECT_INDEXED_WITH_X:
+    case DIRECT_INDEXED_WITH_Y:
+    case DIRECT_INDIRECT:
+    case DIRECT_INDEXED_INDIRECT:
+    case DIRECT_INDIRECT_INDEXED:
+    case DIRECT_INDIRECT_LONG:
+    case DIRECT_INDIRECT_LONG_INDEXED_WITH_Y:
+        //the direct page always lies in bank 0
+        if(!state.directPage.isKnown()) {
+            return false;
+        }
+        target = (state.directPage.value + instruction.operand()) & 0xFFFF;
+        return true;
+    case ABSOLUTE_INDIRECT:
+    case ABSOLUTE_INDIRECT_LONG:
+        //the pointer of JMP (a) and JML [a] lies in bank 0
+        target = instruction.operand();
+        return true;
+    case ABSOLUTE_INDEXED_INDIRECT:
+        //the pointer of JMP (a,x) and JSR (a,x) lies in the program bank
+        target = (address & 0xFF0000) | instruction.operand();
+        return true;
+    default:
+        return false;
+    }
+}
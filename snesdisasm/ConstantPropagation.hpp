@@ -0,0 +1,177 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CONSTANTPROPAGATION_HPP
+#define CONSTANTPROPAGATION_HPP
+
+#include "ControlFlowGraph.hpp"
+
+#include <map>
+
+/*! \brief A 16 bit register value of which only some bits may be known
+ */
+struct AbstractValue {
+    uint16_t value;
+    /*! \brief Bitmask of the bits of value that are known. The other bits of value are 0.
+     */
+    uint16_t known;
+
+    static AbstractValue unknown() { return AbstractValue(0, 0x0000); }
+    static AbstractValue constant(uint16_t value) { return AbstractValue(value, 0xFFFF); }
+
+    AbstractValue() : value(0), known(0) {}
+    AbstractValue(uint16_t value_, uint16_t known_) : value(value_ & known_), known(known_) {}
+
+    /*! \brief Returns true if all bits in mask are known
+     */
+    bool isKnown(uint16_t mask = 0xFFFF) const { return (known & mask) == mask; }
+
+    /*! \brief Returns the value that is true for both paths. Bits which differ become unknown.
+     */
+    AbstractValue meet(const AbstractValue &other) const {
+        return AbstractValue(value, known & other.known & ~(value ^ other.value));
+    }
+
+    bool operator==(const AbstractValue &other) const { return value == other.value && known == other.known; }
+    bool operator!=(const AbstractValue &other) const { return !(*this == other); }
+};
+
+/*! \brief The abstract register contents at a program point
+ *
+ *  Only the low byte of dataBank and of each stack entry is used. The stack models the topmost bytes pushed
+ *  within the current subroutine; stack[stackDepth - 1] is the last pushed byte.
+ */
+struct RegisterState {
+    enum { MaxStackDepth = 16 };
+
+    AbstractValue accumulator;
+    AbstractValue indexX;
+    AbstractValue indexY;
+    AbstractValue directPage;
+    AbstractValue dataBank;
+    uint8_t stackDepth;
+    AbstractValue stack[MaxStackDepth];
+
+    RegisterState() : stackDepth(0) {}
+
+    /*! \brief Returns a state where nothing is known
+     */
+    static RegisterState unknown() { return RegisterState(); }
+
+    /*! \brief Returns the state after a reset: direct page and data bank are 0
+     */
+    static RegisterState powerOn();
+
+    void push(const AbstractValue &byte);
+    void push16(const AbstractValue &word);
+    AbstractValue pull();
+    AbstractValue pull16();
+
+    /*! \brief Meets other into this state
+     *
+     *  \return true if the state changed
+     */
+    bool meet(const RegisterState &other);
+};
+
+/*! \brief A sparse constant propagation of DBR, D, A, X and Y over a \see ControlFlowGraph
+ *
+ *  The propagation runs a worklist to a fixed point and stores states only at block entries. The state at
+ *  any other instruction is recomputed from the entry of its block. Subroutines are assumed to preserve DBR
+ *  and D but to clobber A, X and Y.
+ */
+class ConstantPropagation {
+  public:
+    typedef std::map<LongAddress, RegisterState, std::less<LongAddress>,
+            ArenaAllocator<std::pair<const LongAddress, RegisterState> > > StateMap;
+  private:
+    const ControlFlowGraph &m_Graph;
+    StateMap m_EntryStates;
+
+    bool propagate(LongAddress target, const RegisterState &state);
+  public:
+    /*! \brief Constructs the propagation. The graph has to outlive it. States are allocated from the arena of the graph.
+     */
+    explicit ConstantPropagation(const ControlFlowGraph &graph);
+
+    /*! \brief Sets the state at an entry point. Entry points without a seed start with an unknown state,
+     *         except for the RESET vector which starts with \see RegisterState::powerOn.
+     */
+    void seed(LongAddress address, const RegisterState &state);
+
+    /*! \brief Runs the propagation until a fixed point is reached
+     */
+    void run();
+
+    /*! \brief Sets the state at a block entry to the one a previous run computed, e.g. one loaded from an
+     *         \see AnalysisCache. Restoring all states replaces \see run.
+     */
+    void restore(LongAddress address, const RegisterState &state);
+
+    const ControlFlowGraph &graph() const { return m_Graph; }
+    const StateMap &entryStates() const { return m_EntryStates; }
+
+    /*! \brief Computes the state before the instruction at address
+     *
+     *  \return false if address does not belong to any analysed block
+     */
+    bool stateBefore(LongAddress address, RegisterState &state) const;
+
+    /*! \brief Applies the effect of an instruction to state
+     *
+     *  \param address the address of the instruction
+     *  \param machineState the state the instruction was decoded with
+     */
+    static void step(RegisterState &state, LongAddress address, const Instruction &instruction,
+                     const MachineState &machineState);
+
+    /*! \brief Computes the full 24 bit address of the memory an instruction accesses
+     *
+     *  Indexed modes resolve to their base address and indirect modes to the address of the pointer.
+     *  Code references of jumps and calls are not resolved here since they are edges of the graph.
+     *
+     *  \return false if the operand does not reference memory or depends on an unknown register
+     */
+    static bool resolveOperand(LongAddress address, const Instruction &instruction, const RegisterState &state,
+                               LongAddress &target);
+
+    /*! \brief Calls f(address, instruction, target) for every instruction whose operand resolves to target
+     */
+    template<class F>
+    void forEachResolvedOperand(F f) const;
+};
+
+template<class F>
+void ConstantPropagation::forEachResolvedOperand(F f) const {
+    for(const StateMap::value_type &entry : m_EntryStates) {
+        ControlFlowGraph::BlockMap::const_iterator block = m_Graph.blocks().find(entry.first);
+        if(block == m_Graph.blocks().end()) {
+            continue;
+        }
+
+        RegisterState state = entry.second;
+        m_Graph.forEachInstruction(block->second, [&](LongAddress address, const Instruction & instruction,
+        const MachineState & machineState) {
+            LongAddress target;
+            if(resolveOperand(address, instruction, state, target)) {
+                f(address, instruction, target);
+            }
+            step(state, address, instruction, machineState);
+        });
+    }
+}
+
+#endif // CONSTANTPROPAGATION_HPP
@@ -0,0 +1,370 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ControlFlowGraph.hpp"
+#include "ExecutionLog.hpp"
+#include "Logger.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+
+#include <set>
+
+ControlFlowGraph::ControlFlowGraph(const SNESROM &rom, Arena *arena)
+    : m_ROM(rom),
+      m_Arena(arena),
+      m_Annotations(nullptr),
+      m_Log(nullptr),
+      m_Blocks(BlockMap::key_compare(), BlockMap::allocator_type(arena)),
+      m_EntryPoints(EntryPointList::allocator_type(arena)),
+      m_DecodedBlocks(0),
+      m_Reused(false) {
+}
+
+void ControlFlowGraph::addEntryPoint(LongAddress address, uint8_t flags) {
+    EntryPoint entry = {address, flags};
+    m_EntryPoints.push_back(entry);
+    m_Worklist.push_back(entry);
+    INSTRUMENT_COUNT(WORKLIST_PUSHES, 1);
+}
+
+void ControlFlowGraph::addVectorEntryPoints() {
+    if(!m_ROM.header()) {
+        LOG_SRC(WARNING, "There is no SNES header to read the vectors from");
+        return;
+    }
+
+    std::vector<ROMAddress *> vectors;
+    vectors.push_back(m_ROM.header().getInterruptDest(EmulationIV::RESET()));
+    vectors.push_back(m_ROM.header().getInterruptDest(NativeIV::NMT()));
+    vectors.push_back(m_ROM.header().getInterruptDest(NativeIV::IRQ()));
+    vectors.push_back(m_ROM.header().getInterruptDest(NativeIV::BRK()));
+    vectors.push_back(m_ROM.header().getInterruptDest(NativeIV::COP()));
+
+    for(ROMAddress *vector : vectors) {
+        const LongAddress address = (vector->bank() << 16) | vector->bankAddress();
+        //unused vectors usually point to RAM or contain garbage
+        if(m_ROM.data(address) != nullptr) {
+            addEntryPoint(address, MEMORY_SELECT | INDEX_SELECT);
+        }
+        delete vector;
+    }
+}
+
+void ControlFlowGraph::addBlock(const BasicBlock &block) {
+    m_Blocks.insert(m_Blocks.end(), std::make_pair(block.start, BasicBlock(block, m_Arena)));
+}
+
+bool ControlFlowGraph::addEdge(LongAddress source, LongAddress target, EdgeKind kind, uint8_t flags) {
+    BlockMap::iterator it = m_Blocks.upper_bound(source);
+    if(it == m_Blocks.begin()) {
+        return false;
+    }
+    --it;
+    BasicBlock &block = it->second;
+    if(source < block.start || source >= block.end) {
+        return false;
+    }
+    for(const Edge &edge : block.successors) {
+        if(edge.target == target && edge.kind == kind) {
+            return false;
+        }
+    }
+
+    block.successors.push_back(Edge(target, kind));
+    EntryPoint entry = {target, flags};
+    m_Worklist.push_back(entry);
+    INSTRUMENT_COUNT(WORKLIST_PUSHES, 1);
+    return true;
+}
+
+void ControlFlowGraph::build() {
+    INSTRUMENT_PHASE(DECODE);
+    TRACE_SCOPE("graph_build");
+    uint64_t iterations = 0;
+    while(!m_Worklist.empty()) {
+        EntryPoint entry = m_Worklist.back();
+        m_Worklist.pop_back();
+        visit(entry);
+        ++iterations;
+    }
+    TRACE_ITERATIONS(iterations);
+
+    if(m_Reused) {
+        removeUnreachable();
+        m_Reused = false;
+    }
+}
+
+void ControlFlowGraph::removeUnreachable() {
+    //every edge target and entry point of a built graph is a block start unless nothing could be decoded there
+    std::set<LongAddress> reached;
+    std::vector<LongAddress> pending;
+    for(const EntryPoint &entry : m_EntryPoints) {
+        pending.push_back(entry.address);
+    }
+    while(!pending.empty()) {
+        const LongAddress address = pending.back();
+        pending.pop_back();
+        BlockMap::const_iterator it = m_Blocks.find(address);
+        if(it == m_Blocks.end() || !reached.insert(address).second) {
+            continue;
+        }
+        for(const Edge &edge : it->second.successors) {
+            pending.push_back(edge.target);
+        }
+    }
+
+    for(BlockMap::iterator it = m_Blocks.begin(); it != m_Blocks.end();) {
+        if(reached.count(it->first) == 0) {
+            it = m_Blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+const BasicBlock *ControlFlowGraph::blockAt(LongAddress address) const {
+    BlockMap::const_iterator it = m_Blocks.upper_bound(address);
+    if(it == m_Blocks.begin()) {
+        return nullptr;
+    }
+    --it;
+
+    if(address >= it->second.start && address < it->second.end) {
+        return &it->second;
+    }
+    return nullptr;
+}
+
+const uint8_t *ControlFlowGraph::BlockDecoder::fetch(LongAddress &next) {
+    next = address;
+    if(annotations != nullptr && annotations->isData(rom.imageAddress(address))) {
+        return nullptr;
+    }
+
+    const uint8_t *bytes = rom.data(address, sizeof(buffer));
+    if(bytes != nullptr) {
+        return bytes;
+    }
+    if(rom.data(address) == nullptr) {
+        return nullptr;
+    }
+
+    //near the end of the image there may be less than 4 bytes left
+    for(std::size_t i = 0; i < sizeof(buffer); ++i) {
+        const uint8_t *byte = rom.data(address + i);
+        buffer[i] = byte != nullptr ? *byte : 0;
+    }
+    return buffer;
+}
+
+bool ControlFlowGraph::BlockDecoder::accept(const Instruction &instruction, const MachineState &state) {
+    if(rom.data(address, instruction.size()) == nullptr) {
+        return false;
+    }
+
+    const LongAddress next = instruction.nextAddress();
+    ++block.instructionCount;
+    block.end = next;
+    block.exit = instruction.controlFlow();
+
+    bool finished = true;
+    switch(block.exit) {
+    case ControlFlow::SEQUENTIAL:
+        finished = blocks.count(next) != 0 || block.instructionCount == 0xFFFF ||
+                   differsFromLog(instruction, state);
+        if(finished) {
+            block.successors.push_back(Edge(next, EdgeKind::FALLTHROUGH));
+        }
+        break;
+    case ControlFlow::BRANCH:
+        block.successors.push_back(Edge(instruction.target(), EdgeKind::BRANCH));
+        block.successors.push_back(Edge(next, EdgeKind::FALLTHROUGH));
+        break;
+    case ControlFlow::JUMP:
+        block.successors.push_back(Edge(instruction.target(), EdgeKind::JUMP));
+        break;
+    case ControlFlow::CALL:
+        block.successors.push_back(Edge(instruction.target(), EdgeKind::CALL));
+        block.successors.push_back(Edge(next, EdgeKind::FALLTHROUGH));
+        break;
+    case ControlFlow::INDIRECT_CALL:
+        block.successors.push_back(Edge(next, EdgeKind::FALLTHROUGH));
+        break;
+    default:
+        //indirect jumps, returns, interrupts and STP end the block without known successors
+        break;
+    }
+
+    address = next;
+    return !finished;
+}
+
+bool ControlFlowGraph::BlockDecoder::differsFromLog(const Instruction &instruction, const MachineState &state) const {
+    uint8_t logged;
+    if(log == nullptr || !log->registerSizes(rom.imageAddress(instruction.nextAddress()), logged)) {
+        return false;
+    }
+    //state does not include the instruction yet
+    uint8_t flags = state.getCPUStateRef().FlagRegister();
+    if(instruction.opCode() == 0xC2) {
+        flags &= ~instruction.operand();
+    } else if(instruction.opCode() == 0xE2) {
+        flags |= instruction.operand();
+    }
+    return (flags & (MEMORY_SELECT | INDEX_SELECT)) != logged;
+}
+
+void ControlFlowGraph::visit(const EntryPoint &entry) {
+    BlockMap::iterator it = m_Blocks.find(entry.address);
+    if(it != m_Blocks.end()) {
+        return; //already known
+    }
+
+    //jumping into the middle of a known block splits it
+    it = m_Blocks.upper_bound(entry.address);
+    if(it != m_Blocks.begin()) {
+        --it;
+        if(entry.address < it->second.end && split(it->second, entry.address)) {
+            return;
+        }
+    }
+
+    decodeBlock(entry);
+}
+
+bool ControlFlowGraph::split(BasicBlock &block, LongAddress address) {
+    MachineState state(block.entryFlags);
+    LongAddress pos = block.start;
+
+    for(uint16_t i = 0; i < block.instructionCount; ++i) {
+        if(pos == address) {
+            BasicBlock tail(m_Arena);
+            tail.start = address;
+            tail.end = block.end;
+            tail.entryFlags = state.getCPUStateRef().FlagRegister();
+            tail.exit = block.exit;
+            tail.instructionCount = block.instructionCount - i;
+            tail.successors.swap(block.successors);
+
+            block.end = address;
+            block.exit = ControlFlow::SEQUENTIAL;
+            block.instructionCount = i;
+            block.successors.push_back(Edge(address, EdgeKind::FALLTHROUGH));
+
+            m_Blocks.insert(std::make_pair(address, std::move(tail)));
+            return true;
+        }
+
+        Instruction instruction(state, m_ROM.data(pos), pos);
+        state.update(instruction);
+        pos = instruction.nextAddress();
+    }
+
+    //the address points into the middle of an instruction. The code overlaps.
+    return false;
+}
+
+void ControlFlowGraph::decodeBlock(const EntryPoint &entry) {
+    const ExecutionLog *log = m_Log != nullptr && !m_Log->empty() ? m_Log : nullptr;
+    uint8_t flags = entry.flags;
+    uint8_t logged;
+    if(log != nullptr && log->registerSizes(m_ROM.imageAddress(entry.address), logged)) {
+        flags = (flags & ~(MEMORY_SELECT | INDEX_SELECT)) | logged;
+    }
+
+    BasicBlock block(m_Arena);
+    block.start = entry.address;
+    block.end = entry.address;
+    block.entryFlags = flags;
+    block.exit = ControlFlow::SEQUENTIAL;
+    block.instructionCount = 0;
+
+    MachineState state(flags);
+    BlockDecoder decoder = {m_ROM, m_Blocks, m_Annotations != nullptr && !m_Annotations->empty() ? m_Annotations : nullptr,
+                            log, block, entry.address, {0, 0, 0, 0}};
+    decodeSequence(state, decoder);
+
+    if(block.instructionCount == 0) {
+        LOG_SRC(HINT, m_ROM.data(entry.address) == nullptr ? "Control flow leaves the ROM" : "Control flow enters data");
+        return;
+    }
+
+    //the register sizes at the end of the block are passed on to all successors
+    const uint8_t exitFlags = state.getCPUStateRef().FlagRegister();
+    for(const Edge &edge : block.successors) {
+        EntryPoint successor = {edge.target, exitFlags};
+        m_Worklist.push_back(successor);
+    }
+    INSTRUMENT_COUNT(WORKLIST_PUSHES, block.successors.size());
+
+    m_Blocks.insert(std::make_pair(block.start, std::move(block)));
+    ++m_DecodedBlocks;
+}
+
+bool ControlFlowGraph::overlaps(LongAddress start, LongAddress end) const {
+    BlockMap::const_iterator it = m_Blocks.lower_bound(start);
+    if(it != m_Blocks.end() && it->first < end) {
+        return true;
+    }
+    return it != m_Blocks.begin() && (--it)->second.end > start;
+}
+
+bool ControlFlowGraph::rebase(const BasicBlock &block, LongAddress start, BasicBlock &moved) const {
+    moved.start = start;
+    moved.end = start + (block.end - block.start);
+    moved.entryFlags = block.entryFlags;
+    moved.exit = block.exit;
+    moved.instructionCount = block.instructionCount;
+
+    //only the last instruction has a target. Its start is unknown, so every length a branch, jump or call can
+    //have is tried until decoding there at the old address explains an edge of the block.
+    bool found = false;
+    LongAddress oldTarget = 0;
+    LongAddress newTarget = 0;
+    if(block.exit == ControlFlow::BRANCH || block.exit == ControlFlow::JUMP || block.exit == ControlFlow::CALL) {
+        const MachineState state(block.entryFlags);
+        for(unsigned int length = 2; length <= 4 && !found; ++length) {
+            const uint8_t *bytes = m_ROM.data(moved.end - length, length);
+            if(bytes == nullptr || block.end - block.start < length) {
+                break;
+            }
+            const Instruction old(state, bytes, block.end - length);
+            if(old.size() != length || old.controlFlow() != block.exit || !old.hasTarget()) {
+                continue;
+            }
+            for(const Edge &edge : block.successors) {
+                if(edge.kind != EdgeKind::FALLTHROUGH && edge.target == old.target()) {
+                    found = true;
+                    oldTarget = old.target();
+                    newTarget = Instruction(state, bytes, moved.end - length).target();
+                }
+            }
+        }
+        if(!found) {
+            return false;
+        }
+    }
+
+    for(const Edge &edge : block.successors) {
+        if(edge.kind == EdgeKind::FALLTHROUGH) {
+            moved.successors.push_back(Edge(moved.end, EdgeKind::FALLTHROUGH));
+        } else if(found && edge.target == oldTarget) {
+            moved.successors.push_back(Edge(newTarget, edge.kind));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,293 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CONTROLFLOWGRAPH_HPP
+#define CONTROLFLOWGRAPH_HPP
+
+#include "SNESROM.hpp"
+#include "Instructions.hpp"
+#include "MachineState.hpp"
+#include "ROMAddress.hpp"
+#include "Arena.hpp"
+#include "Annotations.hpp"
+
+#include <map>
+#include <vector>
+
+class ExecutionLog;
+
+/*! \brief The kind of a transition between two basic blocks
+ */
+enum class EdgeKind : unsigned char {
+    FALLTHROUGH, //the target directly follows the source in memory
+    BRANCH,      //the target of a conditional branch
+    JUMP,        //the target of an unconditional jump
+    CALL         //the target of a subroutine call. The caller continues with its FALLTHROUGH edge
+};
+
+/*! \brief A directed edge within the \see ControlFlowGraph
+ */
+struct Edge {
+    LongAddress target;
+    EdgeKind kind;
+
+    Edge(LongAddress target_, EdgeKind kind_) : target(target_), kind(kind_) {}
+};
+
+typedef std::vector<Edge, ArenaAllocator<Edge> > EdgeList;
+
+/*! \brief A maximal sequence of instructions that is only entered at the first and only left after the last one
+ */
+struct BasicBlock {
+    /*! \brief The first byte of the first instruction
+     */
+    LongAddress start;
+
+    /*! \brief The first byte after the last instruction
+     */
+    LongAddress end;
+
+    /*! \brief The processorflags (only MEMORY_SELECT and INDEX_SELECT matter) the block was decoded with
+     */
+    uint8_t entryFlags;
+
+    /*! \brief The control flow of the last instruction
+     */
+    ControlFlow exit;
+
+    uint16_t instructionCount;
+
+    EdgeList successors;
+
+    BasicBlock() {}
+
+    /*! \brief Constructs an empty block whose successors are allocated from arena
+     */
+    explicit BasicBlock(Arena *arena) : successors(ArenaAllocator<Edge>(arena)) {}
+
+    /*! \brief Copies other into arena
+     */
+    BasicBlock(const BasicBlock &other, Arena *arena)
+        : start(other.start), end(other.end), entryFlags(other.entryFlags), exit(other.exit),
+          instructionCount(other.instructionCount),
+          successors(other.successors.begin(), other.successors.end(), ArenaAllocator<Edge>(arena)) {}
+};
+
+/*! \brief The control flow graph of a \see SNESROM
+ *
+ *  The graph is built by a recursive traversal starting at a set of entry points. It tracks REP and SEP to
+ *  decode immediates with the correct size. Subroutines are assumed to return to the instruction following the
+ *  call and to preserve the register sizes of the caller.
+ *
+ *  All blocks, edges and entry points are allocated from the \see Arena passed to the constructor. Analyses
+ *  built on top of the graph use the same arena, so the whole analysis is freed at once with it.
+ */
+class ControlFlowGraph {
+  public:
+    typedef std::map<LongAddress, BasicBlock, std::less<LongAddress>,
+            ArenaAllocator<std::pair<const LongAddress, BasicBlock> > > BlockMap;
+
+    struct EntryPoint {
+        LongAddress address;
+        uint8_t flags;
+    };
+
+    typedef std::vector<EntryPoint, ArenaAllocator<EntryPoint> > EntryPointList;
+  private:
+    const SNESROM &m_ROM;
+    Arena *m_Arena;
+    const Annotations *m_Annotations;
+    const ExecutionLog *m_Log;
+    BlockMap m_Blocks;
+    EntryPointList m_EntryPoints;
+    std::vector<EntryPoint> m_Worklist; //shrinks and grows again, so it stays on the heap
+    std::size_t m_DecodedBlocks;
+    bool m_Reused; //blocks were taken over since the last build, some may no longer be reachable
+
+    //feeds the instructions of a block to decodeSequence until one of them ends the block
+    struct BlockDecoder {
+        const SNESROM &rom;
+        const BlockMap &blocks;
+        const Annotations *annotations;
+        const ExecutionLog *log;
+        BasicBlock &block;
+        LongAddress address;
+        uint8_t buffer[4];
+
+        const uint8_t *fetch(LongAddress &next);
+        bool accept(const Instruction &instruction, const MachineState &state);
+        //true if the log recorded other register sizes for the next instruction than it will be decoded with
+        bool differsFromLog(const Instruction &instruction, const MachineState &state) const;
+    };
+
+    void visit(const EntryPoint &entry);
+    bool split(BasicBlock &block, LongAddress address);
+    void decodeBlock(const EntryPoint &entry);
+    bool overlaps(LongAddress start, LongAddress end) const;
+    bool rebase(const BasicBlock &block, LongAddress start, BasicBlock &moved) const;
+    void removeUnreachable();
+  public:
+    /*! \brief Constructs an empty graph. The rom and the arena have to outlive the graph.
+     *
+     *  \param arena the arena to allocate from. Without one the graph uses the heap.
+     */
+    explicit ControlFlowGraph(const SNESROM &rom, Arena *arena = nullptr);
+
+    /*! \brief Makes the traversal stop at ranges annotated as data. annotations has to outlive all calls to
+     *         \see build or be reset to nullptr.
+     */
+    void setAnnotations(const Annotations *annotations) { m_Annotations = annotations; }
+
+    /*! \brief Makes the traversal use the register sizes log recorded instead of the tracked ones. Blocks start
+     *         with the logged sizes and end where the logged sizes differ from the tracked ones, e.g. after PLP,
+     *         RTI or XCE. log has to outlive all calls to \see build or be reset to nullptr.
+     */
+    void setExecutionLog(const ExecutionLog *log) { m_Log = log; }
+
+    /*! \brief Adds an address the traversal starts at
+     *
+     *  \param address the CPU address of the first instruction
+     *  \param flags the processorflags at that address
+     */
+    void addEntryPoint(LongAddress address, uint8_t flags);
+
+    /*! \brief Adds the RESET vector and all native interrupt vectors as entry points.
+     *
+     *  RESET starts in emulation mode and thus with 8 bit registers. The native vectors are assumed to be
+     *  entered with 8 bit registers as well.
+     */
+    void addVectorEntryPoints();
+
+    /*! \brief Discovers all blocks reachable from the entry points added so far
+     *
+     *  It may be called again after adding further entry points. The first build after \see reuse removes the
+     *  blocks it does not reach from the entry points, e.g. those only a changed jump led to.
+     */
+    void build();
+
+    /*! \brief Takes over the blocks of another graph of a similar rom
+     *
+     *  locate(block, start) returns true if the bytes of a block of other are unchanged in this graph's rom and
+     *  sets start to where the block begins now, which differs from block.start if the code was moved. Blocks
+     *  that stayed are copied unchanged. Moved blocks are copied with their start, end and edge targets rebased:
+     *  relative targets move along, absolute ones do not. Edges other than those of the last instruction, which
+     *  later analyses added, are left to be found again. Every other block is queued to be decoded again by the
+     *  next \see build, at its new start if it was moved. All entry points of other are added as well, moved
+     *  along with the blocks starting at them. Blocks that are no longer reachable are removed by the next
+     *  \see build.
+     */
+    template<class F>
+    void reuse(const ControlFlowGraph &other, F locate);
+
+    /*! \brief Adds an edge found by a later analysis, e.g. a \see Dispatch of the \see StackAnalysis
+     *
+     *  The edge leaves the block containing source. Its target is queued for the next \see build.
+     *
+     *  \param flags the processorflags at target
+     *  \return false if there is no such block or it already has the edge
+     */
+    bool addEdge(LongAddress source, LongAddress target, EdgeKind kind, uint8_t flags);
+
+    /*! \brief Inserts a block decoded earlier, e.g. one loaded from an \see AnalysisCache
+     *
+     *  The successors are not queued. Entry points have to be added separately.
+     */
+    void addBlock(const BasicBlock &block);
+
+    const SNESROM &rom() const { return m_ROM; }
+    Arena *arena() const { return m_Arena; }
+    const BlockMap &blocks() const { return m_Blocks; }
+    const EntryPointList &entryPoints() const { return m_EntryPoints; }
+
+    /*! \brief Returns the number of blocks decoded so far, not counting the ones taken over or added
+     */
+    std::size_t decodedBlocks() const { return m_DecodedBlocks; }
+
+    /*! \brief Returns the block containing address or nullptr if there is none
+     */
+    const BasicBlock *blockAt(LongAddress address) const;
+
+    /*! \brief Calls f(address, instruction, state) for every instruction of block in order.
+     *
+     *  state is the \see MachineState the instruction was decoded with.
+     */
+    template<class F>
+    void forEachInstruction(const BasicBlock &block, F f) const;
+};
+
+template<class F>
+void ControlFlowGraph::forEachInstruction(const BasicBlock &block, F f) const {
+    struct Visitor {
+        const SNESROM &rom;
+        F &f;
+        LongAddress address;
+        uint16_t remaining;
+
+        const uint8_t *fetch(LongAddress &next) {
+            next = address;
+            return remaining != 0 ? rom.data(address) : nullptr;
+        }
+
+        bool accept(const Instruction &instruction, const MachineState &state) {
+            f(address, instruction, state);
+            address = instruction.nextAddress();
+            --remaining;
+            return true;
+        }
+    };
+
+    MachineState state(block.entryFlags);
+    Visitor visitor = {m_ROM, f, block.start, block.instructionCount};
+    decodeSequence(state, visitor);
+}
+
+template<class F>
+void ControlFlowGraph::reuse(const ControlFlowGraph &other, F locate) {
+    //the blocks that stayed first, so moved blocks can be checked against them
+    std::vector<std::pair<const BasicBlock *, LongAddress> > moved;
+    for(const BlockMap::value_type &block : other.m_Blocks) {
+        LongAddress start;
+        if(!locate(block.second, start)) {
+            EntryPoint entry = {block.first, block.second.entryFlags};
+            m_Worklist.push_back(entry);
+        } else if(start == block.first) {
+            //the block is copied into this graph's arena since other may be freed first
+            m_Blocks.insert(m_Blocks.end(), std::make_pair(block.first, BasicBlock(block.second, m_Arena)));
+        } else {
+            moved.push_back(std::make_pair(&block.second, start));
+        }
+    }
+    m_Reused = true;
+
+    std::map<LongAddress, LongAddress> starts; //of the moved blocks, by their old start
+    for(const std::pair<const BasicBlock *, LongAddress> &block : moved) {
+        BasicBlock rebased(m_Arena);
+        if(rebase(*block.first, block.second, rebased) && !overlaps(rebased.start, rebased.end)) {
+            m_Blocks.insert(std::make_pair(rebased.start, std::move(rebased)));
+            starts[block.first->start] = block.second;
+        } else {
+            EntryPoint entry = {block.second, block.first->entryFlags};
+            m_Worklist.push_back(entry);
+        }
+    }
+
+    for(const EntryPoint &entry : other.m_EntryPoints) {
+        std::map<LongAddress, LongAddress>::const_iterator start = starts.find(entry.address);
+        addEntryPoint(start != starts.end() ? start->second : entry.address, entry.flags);
+    }
+}
+
+#endif // CONTROLFLOWGRAPH_HPP
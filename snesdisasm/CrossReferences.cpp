@@ -0,0 +1,226 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CrossReferences.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+bool bySource(const Xref &a, const Xref &b) {
+    return a.from != b.from ? a.from < b.from : a.to < b.to;
+}
+
+bool byTarget(const Xref &a, const Xref &b) {
+    return a.to != b.to ? a.to < b.to : a.from < b.from;
+}
+
+bool isPointerMode(AddressingMode mode) {
+    switch(mode) {
+    case DIRECT_INDIRECT:
+    case DIRECT_INDEXED_INDIRECT:
+    case DIRECT_INDIRECT_INDEXED:
+    case DIRECT_INDIRECT_LONG:
+    case DIRECT_INDIRECT_LONG_INDEXED_WITH_Y:
+    case ABSOLUTE_INDIRECT:
+    case ABSOLUTE_INDIRECT_LONG:
+    case ABSOLUTE_INDEXED_INDIRECT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool writesMemory(const Instruction &instruction) {
+    static const char *writers[] = {"STA", "STX", "STY", "STZ", "ASL", "LSR", "ROL", "ROR", "INC", "DEC", "TSB",
+                                    "TRB"
+                                   };
+    for(const char *mnemonic : writers) {
+        if(std::strcmp(instruction.mnemonic(), mnemonic) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//the lower the rank, the more a label prefix says about an address
+enum LabelRank { VECTOR, SUBROUTINE, CODE, DATA };
+
+std::string makeLabel(const char *prefix, LongAddress address) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%s_%06X", prefix, address);
+    return buffer;
+}
+
+const char *dataPrefix(const SNESROM &rom, LongAddress address) {
+    const uint8_t bank = address >> 16;
+    const uint16_t bankAddress = address & 0xFFFF;
+
+    if(rom.data(address) != nullptr) {
+        return "data";
+    }
+    if(bank == 0x7E || bank == 0x7F || ((bank & 0x40) == 0 && bankAddress < 0x2000)) {
+        return "ram";
+    }
+    if((bank & 0x40) == 0 && bankAddress < 0x6000) {
+        return "reg";
+    }
+    return "mem";
+}
+
+}
+
+CrossReferences::CrossReferences(const ConstantPropagation &propagation)
+    : m_ByTarget(XrefList::allocator_type(propagation.graph().arena())),
+      m_BySource(XrefList::allocator_type(propagation.graph().arena())),
+      m_Labels(LabelMap::key_compare(), LabelMap::allocator_type(propagation.graph().arena())),
+      m_Addresses(AddressMap::key_compare(), AddressMap::allocator_type(propagation.graph().arena())) {
+    const ControlFlowGraph &graph = propagation.graph();
+    std::map<LongAddress, LabelRank> ranks;
+    //growing a vector in an arena leaves the old buffers behind, so the references are collected on the heap first
+    std::vector<Xref> xrefs;
+
+    //code references
+    for(const ControlFlowGraph::BlockMap::value_type &block : graph.blocks()) {
+        graph.forEachInstruction(block.second, [&](LongAddress address, const Instruction & instruction,
+        const MachineState &) {
+            XrefKind kind;
+            LabelRank rank = CODE;
+            switch(instruction.controlFlow()) {
+            case ControlFlow::BRANCH:
+                kind = XrefKind::BRANCH;
+                break;
+            case ControlFlow::JUMP:
+                kind = XrefKind::JUMP;
+                break;
+            case ControlFlow::CALL:
+                kind = XrefKind::CALL;
+                rank = SUBROUTINE;
+                break;
+            default:
+                return;
+            }
+
+            Xref xref = {address, instruction.target(), kind};
+            xrefs.push_back(xref);
+            std::map<LongAddress, LabelRank>::iterator it = ranks.insert(std::make_pair(xref.to, rank)).first;
+            it->second = std::min(it->second, rank);
+        });
+    }
+
+    //data references
+    propagation.forEachResolvedOperand([&](LongAddress address, const Instruction & instruction, LongAddress target) {
+        XrefKind kind = XrefKind::READ;
+        if(isPointerMode(instruction.addressingMode())) {
+            kind = XrefKind::POINTER;
+        } else if(writesMemory(instruction)) {
+            kind = XrefKind::WRITE;
+        }
+
+        Xref xref = {address, target, kind};
+        xrefs.push_back(xref);
+        ranks.insert(std::make_pair(target, DATA));
+    });
+
+    for(const ControlFlowGraph::EntryPoint &entry : graph.entryPoints()) {
+        std::map<LongAddress, LabelRank>::iterator it = ranks.insert(std::make_pair(entry.address, CODE)).first;
+        it->second = std::min(it->second, CODE);
+    }
+
+    std::sort(xrefs.begin(), xrefs.end(), bySource);
+    xrefs.erase(std::unique(xrefs.begin(), xrefs.end(), [](const Xref & a, const Xref & b) {
+        return a.from == b.from && a.to == b.to && a.kind == b.kind;
+    }), xrefs.end());
+    m_BySource.assign(xrefs.begin(), xrefs.end());
+    m_ByTarget.assign(xrefs.begin(), xrefs.end());
+    std::sort(m_ByTarget.begin(), m_ByTarget.end(), byTarget);
+
+    //the vectors are named after their interrupt
+    if(graph.rom().header()) {
+        const SNESROMHeader &header = graph.rom().header();
+        const std::pair<ROMAddress *, const char *> vectors[] = {
+            std::make_pair(header.getInterruptDest(EmulationIV::RESET()), "reset"),
+            std::make_pair(header.getInterruptDest(NativeIV::NMT()), "nmi"),
+            std::make_pair(header.getInterruptDest(NativeIV::IRQ()), "irq"),
+            std::make_pair(header.getInterruptDest(NativeIV::BRK()), "brk"),
+            std::make_pair(header.getInterruptDest(NativeIV::COP()), "cop")
+        };
+        for(const std::pair<ROMAddress *, const char *> &vector : vectors) {
+            const LongAddress address = (vector.first->bank() << 16) | vector.first->bankAddress();
+            if(graph.blocks().count(address) != 0 && m_Labels.count(address) == 0) {
+                addLabel(address, vector.second);
+                ranks.erase(address);
+            }
+            delete vector.first;
+        }
+    }
+
+    for(const std::map<LongAddress, LabelRank>::value_type &entry : ranks) {
+        switch(entry.second) {
+        case SUBROUTINE:
+            addLabel(entry.first, makeLabel("sub", entry.first));
+            break;
+        case CODE:
+            addLabel(entry.first, makeLabel("loc", entry.first));
+            break;
+        default:
+            addLabel(entry.first, makeLabel(dataPrefix(graph.rom(), entry.first), entry.first));
+            break;
+        }
+    }
+}
+
+void CrossReferences::addLabel(LongAddress address, const std::string &name) {
+    m_Labels[address] = name;
+    m_Addresses[name] = address;
+}
+
+std::pair<CrossReferences::XrefList::const_iterator, CrossReferences::XrefList::const_iterator>
+CrossReferences::xrefsTo(LongAddress address) const {
+    const Xref first = {0, address, XrefKind::BRANCH};
+    const Xref last = {0xFFFFFFFF, address, XrefKind::BRANCH};
+    return std::make_pair(std::lower_bound(m_ByTarget.begin(), m_ByTarget.end(), first, byTarget),
+                          std::upper_bound(m_ByTarget.begin(), m_ByTarget.end(), last, byTarget));
+}
+
+std::pair<CrossReferences::XrefList::const_iterator, CrossReferences::XrefList::const_iterator>
+CrossReferences::xrefsFrom(LongAddress address) const {
+    const Xref first = {address, 0, XrefKind::BRANCH};
+    const Xref last = {address, 0xFFFFFFFF, XrefKind::BRANCH};
+    return std::make_pair(std::lower_bound(m_BySource.begin(), m_BySource.end(), first, bySource),
+                          std::upper_bound(m_BySource.begin(), m_BySource.end(), last, bySource));
+}
+
+const std::string *CrossReferences::labelAt(LongAddress address) const {
+    LabelMap::const_iterator it = m_Labels.find(address);
+    return it != m_Labels.end() ? &it->second : nullptr;
+}
+
+bool CrossReferences::addressOf(const std::string &label, LongAddress &address) const {
+    AddressMap::const_iterator it = m_Addresses.find(label);
+    if(it == m_Addresses.end()) {
+        return false;
+    }
+    address = it->second;
+    return true;
+}
+
+const char *CrossReferences::kindName(XrefKind kind) {
+    static const char *names[] = {"branch", "jump", "call", "read", "write", "pointer"};
+    return names[static_cast<unsigned int>(kind)];
+}
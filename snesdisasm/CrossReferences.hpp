@@ -0,0 +1,99 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CROSSREFERENCES_HPP
+#define CROSSREFERENCES_HPP
+
+#include "ConstantPropagation.hpp"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*! \brief How an instruction refers to an address
+ */
+enum class XrefKind : unsigned char {
+    BRANCH,  //conditional or unconditional relative branch
+    JUMP,    //JMP or JML to an operand encoded target
+    CALL,    //JSR or JSL to an operand encoded target
+    READ,    //the instruction reads the memory
+    WRITE,   //the instruction writes (or modifies) the memory
+    POINTER  //the memory holds a pointer the instruction dereferences
+};
+
+/*! \brief A reference from an instruction to an address
+ */
+struct Xref {
+    LongAddress from; //the address of the referencing instruction
+    LongAddress to;
+    XrefKind kind;
+};
+
+/*! \brief The cross references and generated labels of an analysed ROM
+ *
+ *  Code references are taken from the edges of the \see ControlFlowGraph, data references from the operands
+ *  the \see ConstantPropagation could resolve. Every referenced address gets a label whose prefix tells what
+ *  it is: the vectors are named after their interrupt, then sub_ for call targets, loc_ for other code,
+ *  data_ for ROM, ram_ for work RAM and reg_ for I/O registers. The suffix is the hexadecimal address.
+ */
+class CrossReferences {
+  public:
+    typedef std::vector<Xref, ArenaAllocator<Xref> > XrefList;
+    typedef std::map<LongAddress, std::string, std::less<LongAddress>,
+            ArenaAllocator<std::pair<const LongAddress, std::string> > > LabelMap;
+  private:
+    typedef std::map<std::string, LongAddress, std::less<std::string>,
+            ArenaAllocator<std::pair<const std::string, LongAddress> > > AddressMap;
+
+    XrefList m_ByTarget; //sorted by target, then source
+    XrefList m_BySource; //sorted by source, then target
+    LabelMap m_Labels;
+    AddressMap m_Addresses;
+
+    void addLabel(LongAddress address, const std::string &name);
+  public:
+    /*! \brief Collects all references of a finished propagation. They are allocated from the arena of its graph.
+     */
+    explicit CrossReferences(const ConstantPropagation &propagation);
+
+    const XrefList &xrefs() const { return m_ByTarget; }
+    const LabelMap &labels() const { return m_Labels; }
+
+    /*! \brief Returns the range of all references to address
+     */
+    std::pair<XrefList::const_iterator, XrefList::const_iterator> xrefsTo(LongAddress address) const;
+
+    /*! \brief Returns the range of all references made by the instruction at address
+     */
+    std::pair<XrefList::const_iterator, XrefList::const_iterator> xrefsFrom(LongAddress address) const;
+
+    /*! \brief Returns the label at address or nullptr if there is none
+     */
+    const std::string *labelAt(LongAddress address) const;
+
+    /*! \brief Looks up the address of a label
+     *
+     *  \return false if there is no such label
+     */
+    bool addressOf(const std::string &label, LongAddress &address) const;
+
+    /*! \brief Returns the name of a kind, e.g. "call"
+     */
+    static const char *kindName(XrefKind kind);
+};
+
+#endif // CROSSREFERENCES_HPP
@@ -15,31 +15,47 @@
  */
 
 #include "Disasm.hpp"
+#include "Instrumentation.hpp"
 
 Disasm::Disasm(SNESROM  &&rom)
-    : m_ROM(std::forward<SNESROM>(rom)) {
+    : m_ROM(std::forward<SNESROM>(rom)),
+      m_State(MEMORY_SELECT | INDEX_SELECT) {
 }
 
-const SNESROM &Disasm::rom() {
+const SNESROM &Disasm::rom() const {
     return m_ROM;
 }
 
-Disasm::Section Disasm::disasmUntilJump(ROMAddress* start, unsigned int maxInstructions) const {
+Disasm::Section Disasm::disasmUntilJump(const ROMAddress* start, unsigned int maxInstructions) const {
+    INSTRUMENT_PHASE(DECODE);
     Section section;
-    section.start = start;
-    ROMAddress* pos = start;
+    section.start.reset(start->clone());
+    Cursor cursor(*this, *start, m_State);
 
     for(unsigned int i = 0; i < maxInstructions; ++i) {
-        Instruction inst(m_State, m_ROM[pos]);
+        Instruction inst = cursor.next();
         section.instructions.push_back(inst);
-        (*pos) += inst.size();
 
         if(inst.isJump()) {
             break;
         }
     }
 
-    section.end = pos;
+    section.end.reset(cursor.position().clone());
+    INSTRUMENT_COUNT(INSTRUCTIONS_DECODED, section.instructions.size());
 
     return section;
 }
+
+Disasm::Cursor::Cursor(const Disasm &disasm, const ROMAddress &start, const MachineState &state)
+    : m_Disasm(disasm),
+      m_Position(start.clone()),
+      m_State(state) {
+}
+
+Instruction Disasm::Cursor::next() {
+    Instruction inst(m_State, m_Disasm.m_ROM[m_Position.get()], (m_Position->bank() << 16) | m_Position->bankAddress());
+    m_State.update(inst);
+    (*m_Position) += inst.size();
+    return inst;
+}
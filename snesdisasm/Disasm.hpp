@@ -28,31 +28,60 @@
  *
  *  This class consumes a \see SNESROM and offers the interface to generate sequences of
  *  instructions from the binary data.
+ *
+ *  A disassembler is immutable once constructed. All methods are const and only read the rom, so a single
+ *  instance (e.g. held by a std::shared_ptr<const Disasm>) may be queried by any number of threads at once
+ *  without locking. State that changes while walking through code lives in a \see Disasm::Cursor, of which
+ *  every thread keeps its own.
  */
 class Disasm
 {    
 public:
     /*! \brief A sequence of instructions
      *
-     *  \todo Add better interface to this type. It is still possible to invalidate the invarance if start and
-     *        end to point at the correct bytes.
+     *  The section owns its addresses. They are independent of the address disassembling started at.
      */
     struct Section{
         /*! \brief The first byte of the first instruction within the sequence
          */
-        ROMAddress* start;
+        std::unique_ptr<ROMAddress> start;
 
         /*! \brief The first byte after the last instruction within the sequence
          */
-        ROMAddress* end;
+        std::unique_ptr<ROMAddress> end;
         
         /*! \brief The vector of instructions contained within the sequence
          */
         std::vector<Instruction> instructions;
     };
+
+    /*! \brief A position within the rom together with the state needed to decode the instruction there
+     *
+     *  A cursor is cheap to create and must not be shared between threads. The disassembler has to outlive it.
+     */
+    class Cursor {
+    private:
+        const Disasm &m_Disasm;
+        std::unique_ptr<ROMAddress> m_Position;
+        MachineState m_State;
+    public:
+        /*! \brief Constructs a cursor at a copy of start
+         *
+         *  The default state has 8 bit registers like the CPU after RESET.
+         */
+        Cursor(const Disasm &disasm, const ROMAddress &start,
+               const MachineState &state = MachineState(MEMORY_SELECT | INDEX_SELECT));
+
+        /*! \brief Decodes the instruction at the position and advances past it
+         */
+        Instruction next();
+
+        const ROMAddress &position() const { return *m_Position; }
+        const MachineState &state() const { return m_State; }
+    };
 private:
-    SNESROM m_ROM;
-    MachineState m_State;
+    const SNESROM m_ROM;
+    const MachineState m_State; //the state after RESET, which runs in emulation mode
 public:
     /*! \brief Constructs disassembler. This constructor will take ownership of the given rom.
      *  \param rom the rom to disassemble
@@ -60,20 +89,18 @@ public:
     Disasm(SNESROM && rom);
 
     /*! \brief Returns a reference to the stored rom.
-     *
-     * \todo this might be a leak of internal state. we should better provide the needed interface directly in Disasm
      */
-    const SNESROM& rom();
+    const SNESROM& rom() const;
     
     /*! \brief Constructs a \see Section starting at start
      *
      *  This method will fetch consectuive instructions beginning at start until it reaches a maximum instruction limit
-     *  or until it encounters a jump instruction (branches, conditional jumps and the like).
+     *  or until it encounters a jump instruction (branches, conditional jumps and the like). start is not modified.
      *
      *  \param start the address to start disassembling at
      *  \param max_instructions the maximum number of instructions to fetch
      */
-    Section disasmUntilJump(ROMAddress* start, unsigned int maxInstructions = 30) const;
+    Section disasmUntilJump(const ROMAddress* start, unsigned int maxInstructions = 30) const;
 };
 
 #endif // DISASM_HPP
@@ -0,0 +1,451 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ExecutionLog.hpp"
+#include "InstructionLengths.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+#include "Logger.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+namespace {
+
+const LongAddress NoAddress = 0xFFFFFFFF;
+//smaller trace logs are not worth splitting
+const std::size_t MinPieceSize = 1024 * 1024;
+
+struct HexDigits {
+    int8_t values[256];
+
+    HexDigits() {
+        std::fill(values, values + 256, -1);
+        for(int i = 0; i < 10; ++i) {
+            values['0' + i] = i;
+        }
+        for(int i = 0; i < 6; ++i) {
+            values['a' + i] = values['A' + i] = 10 + i;
+        }
+    }
+};
+
+const HexDigits hexDigits;
+
+bool isLetter(uint8_t c) {
+    return (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+}
+
+/*! \brief Parses the flags as the 8 letters nvmxdizc, upper case if set. In emulation mode m and x may be shown
+ *         as 1 and b.
+ */
+bool parseFlagLetters(const uint8_t *text, uint8_t &flags) {
+    static const char letters[] = "nvmxdizc";
+    uint8_t result = 0;
+    for(unsigned int i = 0; i < 8; ++i) {
+        const uint8_t c = text[i];
+        if((c | 0x20) == letters[i]) {
+            result |= (c & 0x20) == 0 ? 0x80 >> i : 0;
+        } else if(i == 2 && c == '1') {
+            result |= MEMORY_SELECT;
+        } else if(i == 3 && (c | 0x20) == 'b') {
+            result |= INDEX_SELECT;
+        } else {
+            return false;
+        }
+    }
+    flags = result;
+    return true;
+}
+
+/*! \brief Finds the processor flags in the rest of a trace line
+ *
+ *  The flags are near the end in all formats, so the line is searched backwards. Snes9x puts the emulation flag
+ *  in front of the letters (EnvMXdIzc), which makes the registers 8 bit when set.
+ */
+bool findFlags(const uint8_t *text, const uint8_t *end, uint8_t &flags) {
+    for(const uint8_t *position = end - 4; position >= text; --position) {
+        if(position[0] == 'P' && position[1] == ':' && hexDigits.values[position[2]] >= 0 &&
+           hexDigits.values[position[3]] >= 0 && (position + 4 == end || hexDigits.values[position[4]] < 0)) {
+            flags = (hexDigits.values[position[2]] << 4) | hexDigits.values[position[3]];
+            return true;
+        }
+        if((position[0] | 0x20) != 'n' || position + 8 > end || (position + 8 != end && isLetter(position[8]))) {
+            continue;
+        }
+        const uint8_t *start = position;
+        if(start > text && (start[-1] | 0x20) == 'e') {
+            --start;
+        }
+        if((start == text || !isLetter(start[-1])) && parseFlagLetters(position, flags)) {
+            if(start[0] == 'E') {
+                flags |= MEMORY_SELECT | INDEX_SELECT;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! \brief Parses the address at the start of a trace line and moves text past it
+ */
+bool parseAddress(const uint8_t *&text, const uint8_t *end, LongAddress &address) {
+    while(text < end && (*text == ' ' || *text == '\t')) {
+        ++text;
+    }
+    if(text < end && *text == '$') {
+        ++text;
+    }
+
+    unsigned int digits = 0;
+    address = 0;
+    for(; text < end && digits < 6; ++text) {
+        const int8_t value = hexDigits.values[*text];
+        if(value >= 0) {
+            address = (address << 4) | value;
+            ++digits;
+        } else if(digits != 2 || (*text != ':' && *text != '/')) {
+            break;
+        }
+    }
+    return digits == 6;
+}
+
+uint8_t sizeBit(uint8_t flags) {
+    return 1 << ((flags & (MEMORY_SELECT | INDEX_SELECT)) >> 4);
+}
+
+uint8_t sizeFlags(unsigned int sizeIndex) {
+    return (sizeIndex << 4) & (MEMORY_SELECT | INDEX_SELECT);
+}
+
+void setBits(std::atomic<uint8_t> &value, uint8_t bits) {
+    //almost always set already, so a plain load avoids most locked operations
+    if((value.load(std::memory_order_relaxed) & bits) != bits) {
+        value.fetch_or(bits, std::memory_order_relaxed);
+    }
+}
+
+struct TraceCounts {
+    uint64_t lines;
+    uint64_t skipped;
+};
+
+/*! \brief The image offsets of the 32 KB pieces of the address space, within which the mapping is contiguous.
+ *         Pieces only partly in the image are mapped by the rom.
+ */
+class PieceMap {
+  private:
+    const SNESROM &m_ROM;
+    ImageAddress m_Pieces[0x200];
+  public:
+    explicit PieceMap(const SNESROM &rom) : m_ROM(rom) {
+        for(LongAddress piece = 0; piece < 0x200; ++piece) {
+            const LongAddress start = piece << 15;
+            const ImageAddress first = rom.imageAddress(start);
+            const ImageAddress last = rom.imageAddress(start + 0x7FFF);
+            m_Pieces[piece] = first != ImageAddress(-1) && last == first + 0x7FFF ? first : ImageAddress(-1);
+        }
+    }
+
+    ImageAddress imageAddress(LongAddress address) const {
+        const ImageAddress first = m_Pieces[address >> 15];
+        return first != ImageAddress(-1) ? ImageAddress(first + (address & 0x7FFF)) : m_ROM.imageAddress(address);
+    }
+};
+
+/*! \brief Returns the address of the last line in [text, end) with an address and flags, or NoAddress
+ */
+LongAddress lastAddress(const uint8_t *text, const uint8_t *end) {
+    while(end > text) {
+        const uint8_t *lineEnd = end[-1] == '\n' ? end - 1 : end;
+        const uint8_t *lineStart = lineEnd;
+        while(lineStart > text && lineStart[-1] != '\n') {
+            --lineStart;
+        }
+        const uint8_t *position = lineStart;
+        LongAddress address;
+        uint8_t flags;
+        if(parseAddress(position, lineEnd, address) && findFlags(position, lineEnd, flags)) {
+            return address;
+        }
+        end = lineStart;
+    }
+    return NoAddress;
+}
+
+/*! \brief Parses the lines in [text, end) of a trace log
+ *
+ *  \param previous the address of the line before text, see \see lastAddress
+ *  \param sizes the register sizes every image offset started an instruction with
+ *  \param entries the register sizes every CPU address was jumped to with
+ */
+void parseTrace(const uint8_t *text, const uint8_t *end, LongAddress previous, const PieceMap &pieces,
+                std::atomic<uint8_t> *sizes, std::atomic<uint8_t> *entries, TraceCounts &counts) {
+    TRACE_SCOPE("trace_import");
+    counts.lines = counts.skipped = 0;
+    while(text < end) {
+        const uint8_t *lineEnd = static_cast<const uint8_t *>(std::memchr(text, '\n', end - text));
+        if(lineEnd == nullptr) {
+            lineEnd = end;
+        }
+        ++counts.lines;
+
+        LongAddress address;
+        uint8_t flags;
+        if(!parseAddress(text, lineEnd, address) || !findFlags(text, lineEnd, flags)) {
+            ++counts.skipped;
+            text = lineEnd + 1;
+            continue;
+        }
+
+        const ImageAddress offset = pieces.imageAddress(address);
+        if(offset != ImageAddress(-1)) {
+            setBits(sizes[offset], sizeBit(flags));
+            //instructions are at most 4 bytes long and MVN and MVP repeat themselves
+            const bool sequential = previous != NoAddress && (previous >> 16) == (address >> 16) &&
+                                    address >= previous && address - previous <= 4;
+            if(!sequential) {
+                setBits(entries[address], sizeBit(flags));
+            }
+        }
+        previous = address;
+        text = lineEnd + 1;
+    }
+    TRACE_ITERATIONS(counts.lines);
+}
+
+}
+
+ExecutionLog::ExecutionLog()
+    : m_Lines(0),
+      m_Skipped(0) {
+}
+
+bool ExecutionLog::prepare(const SNESROM &rom) {
+    if(m_States.empty()) {
+        m_States.assign(rom.imageSize(), 0);
+    }
+    if(m_States.size() != rom.imageSize()) {
+        LOG_SRC(ERROR, "The logs were recorded for ROMs of different sizes");
+        return false;
+    }
+    return true;
+}
+
+bool ExecutionLog::registerSizes(std::size_t offset, uint8_t &flags) const {
+    const uint8_t sizes = state(offset) & SIZES;
+    if(sizes == 0 || (sizes & (sizes - 1)) != 0) {
+        return false;
+    }
+    unsigned int index = 0;
+    while((sizes >> index) != 1) {
+        ++index;
+    }
+    flags = sizeFlags(index);
+    return true;
+}
+
+void ExecutionLog::addEntryPoint(LongAddress address, uint8_t flags) {
+    const ControlFlowGraph::EntryPoint entry = {address, flags};
+    m_EntryPoints.push_back(entry);
+}
+
+void ExecutionLog::sortEntryPoints() {
+    std::sort(m_EntryPoints.begin(), m_EntryPoints.end(), [](const ControlFlowGraph::EntryPoint & a,
+    const ControlFlowGraph::EntryPoint & b) {
+        return a.address < b.address || (a.address == b.address && a.flags < b.flags);
+    });
+    m_EntryPoints.erase(std::unique(m_EntryPoints.begin(), m_EntryPoints.end(), [](
+    const ControlFlowGraph::EntryPoint & a, const ControlFlowGraph::EntryPoint & b) {
+        return a.address == b.address && a.flags == b.flags;
+    }), m_EntryPoints.end());
+}
+
+bool ExecutionLog::importCDL(const SNESROM &rom, const std::string &path) {
+    INSTRUMENT_PHASE(LOAD);
+    const MappedFile file(path);
+    if(!file.isOpen()) {
+        LOG_SRC(ERROR, "Cannot read the code/data log " + path);
+        return false;
+    }
+
+    const uint8_t *data = file.data();
+    std::size_t size = file.size();
+    if(size >= 9 && std::memcmp(data, "CDLv2", 5) == 0) {
+        data += 9; //and the CRC-32 of the ROM
+        size -= 9;
+    }
+    if(size != rom.imageSize()) {
+        LOG_SRC(ERROR, "The code/data log " + path + " does not match the size of the ROM");
+        return false;
+    }
+    if(!prepare(rom)) {
+        return false;
+    }
+
+    //FastROM games jump into the mirror of their RESET vector, which is where the log's jump targets are put then
+    LongAddress mirror = 0;
+    if(rom.header() && rom.layout() == RomLayout::LoROM()) {
+        ROMAddress *reset = rom.header().getInterruptDest(EmulationIV::RESET());
+        mirror = reset->bank() & 0x80;
+        delete reset;
+    }
+
+    ROMAddress *address = getROMAddressObject(rom.layout());
+    for(std::size_t offset = 0; offset < size; ++offset) {
+        const uint8_t flags = data[offset];
+        if((flags & 0x02) != 0) {
+            m_States[offset] |= DATA;
+        }
+        if((flags & 0x01) == 0) {
+            continue;
+        }
+        m_States[offset] |= CODE;
+
+        if((flags & 0x0C) != 0 && offset < (rom.layout() == RomLayout::ExHiROM() ? 0x800000u : 0x400000u)) {
+            address->fromImageAddress(ImageAddress(offset));
+            LongAddress target = (address->bank() << 16) | address->bankAddress();
+            if(rom.imageAddress(target | (mirror << 16)) == offset) {
+                target |= mirror << 16;
+            }
+            if(rom.imageAddress(target) == offset) {
+                m_States[offset] |= sizeBit(flags);
+                addEntryPoint(target, flags & (MEMORY_SELECT | INDEX_SELECT));
+            }
+        }
+    }
+    delete address;
+
+    sortEntryPoints();
+    return true;
+}
+
+bool ExecutionLog::importTrace(const SNESROM &rom, const std::string &path, unsigned int threads) {
+    INSTRUMENT_PHASE(LOAD);
+    const MappedFile file(path);
+    if(!file.isOpen()) {
+        LOG_SRC(ERROR, "Cannot read the trace log " + path);
+        return false;
+    }
+    if(!prepare(rom)) {
+        return false;
+    }
+
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const uint8_t *end = file.data() + file.size();
+    const std::size_t pieces = std::max<std::size_t>(1, std::min<std::size_t>(threads, file.size() / MinPieceSize));
+    //every piece starts at a line
+    std::vector<const uint8_t *> bounds(pieces + 1, end);
+    bounds[0] = file.data();
+    for(std::size_t i = 1; i < pieces; ++i) {
+        const uint8_t *start = std::max(bounds[i - 1], file.data() + file.size() / pieces * i);
+        const uint8_t *newline = static_cast<const uint8_t *>(std::memchr(start, '\n', end - start));
+        bounds[i] = newline != nullptr ? newline + 1 : end;
+    }
+
+    std::unique_ptr<std::atomic<uint8_t>[]> sizes(new std::atomic<uint8_t>[m_States.size()]());
+    std::unique_ptr<std::atomic<uint8_t>[]> entries(new std::atomic<uint8_t>[0x1000000]());
+    const PieceMap map(rom);
+    std::vector<TraceCounts> counts(pieces);
+    std::atomic<std::size_t> next(0);
+    auto work = [&]() {
+        for(std::size_t i = next++; i < pieces; i = next++) {
+            //the line before a piece decides whether its first line was jumped to
+            const LongAddress previous = i != 0 ? lastAddress(bounds[0], bounds[i]) : NoAddress;
+            parseTrace(bounds[i], bounds[i + 1], previous, map, sizes.get(), entries.get(), counts[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for(std::size_t i = 1; i < pieces; ++i) {
+        workers.push_back(std::thread(work));
+    }
+    work();
+    for(std::thread &worker : workers) {
+        worker.join();
+    }
+
+    for(const TraceCounts &count : counts) {
+        m_Lines += count.lines;
+        m_Skipped += count.skipped;
+    }
+
+    //a trace only names the first byte of every instruction
+    const InstructionLengths lengths(rom.image(), rom.imageSize());
+    for(std::size_t offset = 0; offset < m_States.size(); ++offset) {
+        const uint8_t executed = sizes[offset].load(std::memory_order_relaxed);
+        if(executed == 0) {
+            continue;
+        }
+        m_States[offset] |= executed;
+        for(unsigned int i = 0; i < 4; ++i) {
+            if((executed & (1 << i)) != 0) {
+                const std::size_t instructionEnd = std::min(m_States.size(), offset + lengths.length(offset, sizeFlags(i)));
+                for(std::size_t byte = offset; byte < instructionEnd; ++byte) {
+                    m_States[byte] |= CODE;
+                }
+            }
+        }
+    }
+
+    for(LongAddress address = 0; address < 0x1000000; ++address) {
+        const uint8_t entry = entries[address].load(std::memory_order_relaxed);
+        for(unsigned int i = 0; entry != 0 && i < 4; ++i) {
+            if((entry & (1 << i)) != 0) {
+                addEntryPoint(address, sizeFlags(i));
+            }
+        }
+    }
+    sortEntryPoints();
+    return true;
+}
+
+std::size_t ExecutionLog::memoryUsage() const {
+    return m_States.capacity() + m_EntryPoints.capacity() * sizeof(ControlFlowGraph::EntryPoint);
+}
+
+void ExecutionLog::addEntryPointsTo(ControlFlowGraph &graph) const {
+    for(const ControlFlowGraph::EntryPoint &entry : m_EntryPoints) {
+        graph.addEntryPoint(entry.address, entry.flags);
+    }
+}
+
+void ExecutionLog::annotate(Annotations &annotations) const {
+    auto kind = [this](std::size_t offset) {
+        return (m_States[offset] & CODE) != 0 ? CODE : m_States[offset] & DATA;
+    };
+
+    for(std::size_t offset = 0; offset < m_States.size();) {
+        const uint8_t first = kind(offset);
+        std::size_t end = offset + 1;
+        while(end < m_States.size() && kind(end) == first) {
+            ++end;
+        }
+        if(first == CODE) {
+            annotations.add(offset, end, RegionKind::CODE, "executed");
+        } else if(first == DATA) {
+            annotations.add(offset, end, RegionKind::DATA, "read");
+        }
+        offset = end;
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EXECUTIONLOG_HPP
+#define EXECUTIONLOG_HPP
+
+#include "SNESROM.hpp"
+#include "ControlFlowGraph.hpp"
+#include "Annotations.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*! \brief What emulator logs say about a ROM: the executed code, the register sizes it ran with and the data
+ *         it read
+ *
+ *  Two kinds of logs are imported, any number of them into the same log:
+ *
+ *  - Code/data logs as written by Mesen: one byte per image offset, optionally preceded by "CDLv2" and a
+ *    CRC-32. Bit 0 marks code, bit 1 data, bits 2 and 3 jump targets and subroutines, bits 4 and 5 8 bit index
+ *    registers and accumulator.
+ *  - CPU trace logs in text form, one executed instruction per line. A line starts with the address
+ *    (808000, 80:8000, $80/8000) and contains the processor flags either as letters (nvMXdIzc, upper case
+ *    being set, optionally preceded by the emulation flag as in EnvMXdIzc) or as P:xx in hexadecimal, which
+ *    covers the logs of bsnes, Mesen and Geiger's Snes9x. Lines without both are skipped.
+ *
+ *  Files are mapped into memory and parsed in place. Trace logs are split into one piece per thread, which
+ *  makes importing them about as fast as reading them.
+ *
+ *  Every instruction of a trace whose predecessor is not right before it was reached by a jump and becomes an
+ *  entry point, as do the jump targets and subroutines of code/data logs.
+ */
+class ExecutionLog {
+  public:
+    enum : uint8_t {
+        SIZES = 0x0F, //bit ((M << 1) | X) is set for every combination of register sizes an instruction started with
+        CODE = 0x10, //an executed byte, whether opcode or operand
+        DATA = 0x20  //a byte that was read as data
+    };
+  private:
+    std::vector<uint8_t> m_States; //per image offset
+    std::vector<ControlFlowGraph::EntryPoint> m_EntryPoints; //sorted by address and flags
+    uint64_t m_Lines;
+    uint64_t m_Skipped;
+
+    bool prepare(const SNESROM &rom);
+    void addEntryPoint(LongAddress address, uint8_t flags);
+    void sortEntryPoints();
+  public:
+    ExecutionLog();
+
+    /*! \brief Imports a code/data log of rom. Errors are logged.
+     *
+     *  \return false if the file cannot be read or does not match the size of rom
+     */
+    bool importCDL(const SNESROM &rom, const std::string &path);
+
+    /*! \brief Imports a trace log of rom, using threads threads or one per core if threads is 0. Errors are logged.
+     *
+     *  \return false if the file cannot be read
+     */
+    bool importTrace(const SNESROM &rom, const std::string &path, unsigned int threads = 0);
+
+    /*! \brief Returns the state bits of an image offset
+     */
+    uint8_t state(std::size_t offset) const { return offset < m_States.size() ? m_States[offset] : 0; }
+
+    const std::vector<ControlFlowGraph::EntryPoint> &entryPoints() const { return m_EntryPoints; }
+
+    /*! \brief Tells the register sizes of the instructions executed at an image offset
+     *
+     *  \return false if no instruction was executed there or the instructions ran with different sizes. Otherwise
+     *          flags is set to the MEMORY_SELECT and INDEX_SELECT bits they ran with.
+     */
+    bool registerSizes(std::size_t offset, uint8_t &flags) const;
+
+    /*! \brief Returns the number of trace lines imported so far, including the skipped ones
+     */
+    uint64_t lines() const { return m_Lines; }
+
+    /*! \brief Returns the number of trace lines without an address or flags
+     */
+    uint64_t skipped() const { return m_Skipped; }
+
+    bool empty() const { return m_States.empty(); }
+
+    std::size_t memoryUsage() const;
+
+    /*! \brief Calls f(offset, sizes) for every image offset an instruction was executed at, in ascending order
+     *
+     *  sizes is a bitmask as in \see SIZES
+     */
+    template<class F>
+    void forEachExecuted(F f) const;
+
+    /*! \brief Adds all entry points to graph
+     */
+    void addEntryPointsTo(ControlFlowGraph &graph) const;
+
+    /*! \brief Annotates the executed ranges as CODE and the ranges read but never executed as DATA
+     */
+    void annotate(Annotations &annotations) const;
+};
+
+template<class F>
+void ExecutionLog::forEachExecuted(F f) const {
+    for(std::size_t offset = 0; offset < m_States.size(); ++offset) {
+        if((m_States[offset] & SIZES) != 0) {
+            f(offset, static_cast<uint8_t>(m_States[offset] & SIZES));
+        }
+    }
+}
+
+#endif // EXECUTIONLOG_HPP
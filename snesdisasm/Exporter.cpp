@@ -0,0 +1,244 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Exporter.hpp"
+#include "Instrumentation.hpp"
+
+namespace {
+
+const char hexDigits[] = "0123456789ABCDEF";
+
+void appendNumber(std::string &s, uint32_t value) {
+    char buffer[10];
+    int length = 0;
+    do {
+        buffer[length++] = '0' + value % 10;
+        value /= 10;
+    } while(value != 0);
+    while(length > 0) {
+        s += buffer[--length];
+    }
+}
+
+void appendBytes(std::string &s, const Instruction &instruction) {
+    const uint32_t operand = instruction.operand();
+    s += hexDigits[instruction.opCode() >> 4];
+    s += hexDigits[instruction.opCode() & 0x0F];
+    for(unsigned int i = 0; i + 1 < instruction.size(); ++i) {
+        const uint8_t byte = operand >> (8 * i);
+        s += hexDigits[byte >> 4];
+        s += hexDigits[byte & 0x0F];
+    }
+}
+
+void appendString(std::string &s, const char *value) {
+    s += '"';
+    for(; *value != '\0'; ++value) {
+        if(*value == '"' || *value == '\\') {
+            s += '\\';
+        }
+        s += *value;
+    }
+    s += '"';
+}
+
+const char *controlFlowNames[] = {
+    "sequential", "branch", "jump", "indirect_jump", "call", "indirect_call", "return", "interrupt", "halt"
+};
+
+const char *edgeKindNames[] = {"fallthrough", "branch", "jump", "call"};
+
+}
+
+JSONLinesWriter::JSONLinesWriter(std::ostream &stream)
+    : m_Stream(stream) {
+}
+
+void JSONLinesWriter::flushLine() {
+    m_Line += '\n';
+    m_Stream.write(m_Line.data(), m_Line.size());
+    m_Line.clear();
+}
+
+void JSONLinesWriter::writeInstruction(LongAddress address, const Instruction &instruction, uint8_t flags) {
+    m_Line += "{\"type\":\"instruction\",\"address\":";
+    appendNumber(m_Line, address);
+    m_Line += ",\"bytes\":\"";
+    appendBytes(m_Line, instruction);
+    m_Line += "\",\"mnemonic\":";
+    appendString(m_Line, instruction.mnemonic());
+    m_Line += ",\"mode\":";
+    appendString(m_Line, addressingModeName(instruction.addressingMode()));
+    m_Line += ",\"operand\":";
+    appendNumber(m_Line, instruction.operand());
+    m_Line += ",\"flags\":";
+    appendNumber(m_Line, flags);
+    m_Line += '}';
+    flushLine();
+}
+
+void JSONLinesWriter::writeBlock(const BasicBlock &block) {
+    m_Line += "{\"type\":\"block\",\"start\":";
+    appendNumber(m_Line, block.start);
+    m_Line += ",\"end\":";
+    appendNumber(m_Line, block.end);
+    m_Line += ",\"flags\":";
+    appendNumber(m_Line, block.entryFlags);
+    m_Line += ",\"exit\":";
+    appendString(m_Line, controlFlowNames[static_cast<unsigned int>(block.exit)]);
+    m_Line += ",\"instructions\":";
+    appendNumber(m_Line, block.instructionCount);
+    m_Line += ",\"successors\":[";
+    for(std::size_t i = 0; i < block.successors.size(); ++i) {
+        m_Line += i != 0 ? ",{\"target\":" : "{\"target\":";
+        appendNumber(m_Line, block.successors[i].target);
+        m_Line += ",\"kind\":";
+        appendString(m_Line, edgeKindNames[static_cast<unsigned int>(block.successors[i].kind)]);
+        m_Line += '}';
+    }
+    m_Line += "]}";
+    flushLine();
+}
+
+void JSONLinesWriter::writeXref(const Xref &xref) {
+    m_Line += "{\"type\":\"xref\",\"from\":";
+    appendNumber(m_Line, xref.from);
+    m_Line += ",\"to\":";
+    appendNumber(m_Line, xref.to);
+    m_Line += ",\"kind\":";
+    appendString(m_Line, CrossReferences::kindName(xref.kind));
+    m_Line += '}';
+    flushLine();
+}
+
+void JSONLinesWriter::writeLabel(LongAddress address, const std::string &name) {
+    m_Line += "{\"type\":\"label\",\"address\":";
+    appendNumber(m_Line, address);
+    m_Line += ",\"name\":";
+    appendString(m_Line, name.c_str());
+    m_Line += '}';
+    flushLine();
+}
+
+void JSONLinesWriter::finish() {
+    m_Stream.flush();
+}
+
+BinaryRecordWriter::BinaryRecordWriter(std::ostream &stream)
+    : m_Stream(stream) {
+    m_Record = "SNDX";
+    put16(Version);
+    m_Stream.write(m_Record.data(), m_Record.size());
+    m_Record.clear();
+}
+
+void BinaryRecordWriter::put16(uint16_t value) {
+    put8(value);
+    put8(value >> 8);
+}
+
+void BinaryRecordWriter::put32(uint32_t value) {
+    put16(value);
+    put16(value >> 16);
+}
+
+void BinaryRecordWriter::begin(RecordType type) {
+    m_Record.assign(4, '\0'); //the length is filled in by end()
+    put8(static_cast<uint8_t>(type));
+}
+
+void BinaryRecordWriter::end() {
+    const uint32_t length = m_Record.size() - 4;
+    for(unsigned int i = 0; i < 4; ++i) {
+        m_Record[i] = static_cast<char>(length >> (8 * i));
+    }
+    m_Stream.write(m_Record.data(), m_Record.size());
+}
+
+void BinaryRecordWriter::writeInstruction(LongAddress address, const Instruction &instruction, uint8_t flags) {
+    begin(RecordType::INSTRUCTION);
+    put32(address);
+    put8(flags);
+    put8(instruction.size());
+    put8(instruction.opCode());
+    const uint32_t operand = instruction.operand();
+    for(unsigned int i = 0; i + 1 < instruction.size(); ++i) {
+        put8(operand >> (8 * i));
+    }
+    end();
+}
+
+void BinaryRecordWriter::writeBlock(const BasicBlock &block) {
+    begin(RecordType::BLOCK);
+    put32(block.start);
+    put32(block.end);
+    put8(block.entryFlags);
+    put8(static_cast<uint8_t>(block.exit));
+    put16(block.instructionCount);
+    put16(block.successors.size());
+    for(const Edge &edge : block.successors) {
+        put32(edge.target);
+        put8(static_cast<uint8_t>(edge.kind));
+    }
+    end();
+}
+
+void BinaryRecordWriter::writeXref(const Xref &xref) {
+    begin(RecordType::XREF);
+    put32(xref.from);
+    put32(xref.to);
+    put8(static_cast<uint8_t>(xref.kind));
+    end();
+}
+
+void BinaryRecordWriter::writeLabel(LongAddress address, const std::string &name) {
+    begin(RecordType::LABEL);
+    put32(address);
+    put16(name.size());
+    m_Record += name;
+    end();
+}
+
+void BinaryRecordWriter::finish() {
+    m_Stream.flush();
+}
+
+Exporter::Exporter(const ControlFlowGraph &graph, const CrossReferences &xrefs)
+    : m_Graph(graph),
+      m_Xrefs(xrefs) {
+}
+
+void Exporter::write(RecordWriter &writer) const {
+    INSTRUMENT_PHASE(OUTPUT);
+
+    for(const ControlFlowGraph::BlockMap::value_type &block : m_Graph.blocks()) {
+        writer.writeBlock(block.second);
+        m_Graph.forEachInstruction(block.second, [&writer](LongAddress address, const Instruction & instruction,
+        const MachineState & state) {
+            writer.writeInstruction(address, instruction, state.getCPUStateRef().FlagRegister());
+        });
+    }
+
+    for(const Xref &xref : m_Xrefs.xrefs()) {
+        writer.writeXref(xref);
+    }
+
+    for(const CrossReferences::LabelMap::value_type &label : m_Xrefs.labels()) {
+        writer.writeLabel(label.first, label.second);
+    }
+
+    writer.finish();
+}
@@ -0,0 +1,128 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef EXPORTER_HPP
+#define EXPORTER_HPP
+
+#include "ControlFlowGraph.hpp"
+#include "CrossReferences.hpp"
+
+#include <ostream>
+#include <string>
+
+/*! \brief Receives the records of an \see Exporter one by one
+ */
+class RecordWriter {
+  public:
+    virtual ~RecordWriter() {}
+
+    /*! \brief Writes an instruction
+     *
+     *  \param flags the processorflags the instruction was decoded with
+     */
+    virtual void writeInstruction(LongAddress address, const Instruction &instruction, uint8_t flags) = 0;
+    virtual void writeBlock(const BasicBlock &block) = 0;
+    virtual void writeXref(const Xref &xref) = 0;
+    virtual void writeLabel(LongAddress address, const std::string &name) = 0;
+
+    /*! \brief Called after the last record
+     */
+    virtual void finish() {}
+};
+
+/*! \brief Writes one JSON object per line
+ *
+ *  Every object has a "type" member which is one of "instruction", "block", "xref" or "label". Addresses are
+ *  written as numbers, instruction bytes as a string of hexadecimal digits.
+ */
+class JSONLinesWriter : public RecordWriter {
+  private:
+    std::ostream &m_Stream;
+    std::string m_Line;
+
+    void flushLine();
+  public:
+    explicit JSONLinesWriter(std::ostream &stream);
+
+    void writeInstruction(LongAddress address, const Instruction &instruction, uint8_t flags) override;
+    void writeBlock(const BasicBlock &block) override;
+    void writeXref(const Xref &xref) override;
+    void writeLabel(LongAddress address, const std::string &name) override;
+    void finish() override;
+};
+
+/*! \brief Writes length-prefixed binary records
+ *
+ *  The stream starts with the magic "SNDX" and a 16 bit version. Each record follows as a 32 bit length, which
+ *  counts the type byte and the payload, a \see BinaryRecordWriter::RecordType byte and the payload. All
+ *  numbers are little-endian, addresses take 4 bytes.
+ *
+ *  - INSTRUCTION: address, flags (1), size (1), the instruction bytes (size)
+ *  - BLOCK: start, end, entry flags (1), \see ControlFlow of the exit (1), instruction count (2),
+ *    successor count (2) and for each successor its target and \see EdgeKind (1)
+ *  - XREF: source, target, \see XrefKind (1)
+ *  - LABEL: address, name length (2), name
+ *
+ *  Readers should skip records of unknown types.
+ */
+class BinaryRecordWriter : public RecordWriter {
+  public:
+    enum class RecordType : uint8_t {
+        INSTRUCTION = 1,
+        BLOCK = 2,
+        XREF = 3,
+        LABEL = 4
+    };
+
+    static const uint16_t Version = 1;
+  private:
+    std::ostream &m_Stream;
+    std::string m_Record;
+
+    void begin(RecordType type);
+    void put8(uint8_t value) { m_Record += static_cast<char>(value); }
+    void put16(uint16_t value);
+    void put32(uint32_t value);
+    void end();
+  public:
+    explicit BinaryRecordWriter(std::ostream &stream);
+
+    void writeInstruction(LongAddress address, const Instruction &instruction, uint8_t flags) override;
+    void writeBlock(const BasicBlock &block) override;
+    void writeXref(const Xref &xref) override;
+    void writeLabel(LongAddress address, const std::string &name) override;
+    void finish() override;
+};
+
+/*! \brief Streams the results of an analysis to a \see RecordWriter
+ *
+ *  The blocks are written in ascending order, each followed by its instructions, then all cross references
+ *  and finally all labels. Instructions are decoded again while writing, so memory use does not grow with
+ *  the size of the output.
+ */
+class Exporter {
+  private:
+    const ControlFlowGraph &m_Graph;
+    const CrossReferences &m_Xrefs;
+  public:
+    /*! \brief Constructs the exporter. Both arguments have to outlive it.
+     */
+    Exporter(const ControlFlowGraph &graph, const CrossReferences &xrefs);
+
+    void write(RecordWriter &writer) const;
+};
+
+#endif // EXPORTER_HPP
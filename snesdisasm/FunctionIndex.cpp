@@ -0,0 +1,476 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FunctionIndex.hpp"
+#include "Logger.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+
+const char FunctionMagic[4] = {'S', 'N', 'F', 'I'};
+const char BucketMagic[4] = {'S', 'N', 'F', 'B'};
+const char *const TemporaryExtension = ".tmp";
+
+const std::size_t FunctionHeaderSize = 12;
+const std::size_t FunctionRecordSize = 16 + 4 * FunctionIndex::SignatureSize;
+const std::size_t BucketHeaderSize = 24;
+const std::size_t PostingSize = 12;
+
+//a bucket file is written in pieces of this size
+const std::size_t WriteBufferSize = 1024 * 1024;
+
+//the pending buckets are merged into the bucket file once there are more than this many functions or a quarter of
+//the index pending
+const std::size_t MinCompaction = 65536;
+
+class Writer {
+  private:
+    std::string m_Data;
+  public:
+    const std::string &data() const { return m_Data; }
+    void clear() { m_Data.clear(); }
+
+    void put16(uint16_t value) {
+        m_Data += static_cast<char>(value);
+        m_Data += static_cast<char>(value >> 8);
+    }
+    void put32(uint32_t value) {
+        put16(value);
+        put16(value >> 16);
+    }
+    void put64(uint64_t value) {
+        put32(value);
+        put32(value >> 32);
+    }
+    void putBytes(const char *data, std::size_t length) { m_Data.append(data, length); }
+};
+
+uint16_t get16(const uint8_t *data) {
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t get32(const uint8_t *data) {
+    return get16(data) | (static_cast<uint32_t>(get16(data + 2)) << 16);
+}
+
+uint64_t get64(const uint8_t *data) {
+    return get32(data) | (static_cast<uint64_t>(get32(data + 4)) << 32);
+}
+
+//the finalisation step of MurmurHash3
+uint64_t finalize(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    return value ^ (value >> 33);
+}
+
+/*
+ * The token of an instruction is its opcode and, for operands that do not depend on where the code and its data
+ * were linked to, the operand. Immediates, direct page and stack offsets and short branches are kept, absolute
+ * and long addresses, block moves and long branches are masked.
+ */
+uint32_t token(const Instruction &instruction) {
+    switch(instruction.addressingMode()) {
+    case IMMEDIATE:
+    case DIRECT:
+    case DIRECT_INDEXED_WITH_X:
+    case DIRECT_INDEXED_WITH_Y:
+    case DIRECT_INDIRECT:
+    case DIRECT_INDEXED_INDIRECT:
+    case DIRECT_INDIRECT_INDEXED:
+    case DIRECT_INDIRECT_LONG:
+    case DIRECT_INDIRECT_INDEXED_LONG:
+    case DIRECT_INDIRECT_INDEXED_WITH_Y:
+    case DIRECT_INDIRECT_LONG_INDEXED_WITH_Y:
+    case STACK_RELATIVE:
+    case STACK_RELATIVE_INDIRECT_INDEXED:
+    case RELATIVE:
+    case PROGRAMMCOUNTER_RELATIVE:
+        return instruction.opCode() | (instruction.operand() << 8);
+    default:
+        return instruction.opCode();
+    }
+}
+
+uint64_t bandKey(unsigned int band, const FunctionIndex::Signature &signature) {
+    uint64_t key = band + 1;
+    for(unsigned int row = 0; row < FunctionIndex::RowsPerBand; ++row) {
+        key = finalize(key * 0x9E3779B97F4A7C15ULL + signature[band * FunctionIndex::RowsPerBand + row]);
+    }
+    return key;
+}
+
+bool writeAll(std::ofstream &file, Writer &writer) {
+    file.write(writer.data().data(), writer.data().size());
+    writer.clear();
+    return static_cast<bool>(file);
+}
+
+}
+
+FunctionIndex::FunctionIndex(const std::string &directory)
+    : m_Directory(directory),
+      m_MappedFunctions(0),
+      m_BucketFunctions(0),
+      m_BucketCount(0) {
+    load();
+}
+
+std::string FunctionIndex::functionPath() const {
+    return m_Directory + "/functions.snfi";
+}
+
+std::string FunctionIndex::bucketPath() const {
+    return m_Directory + "/buckets.snfb";
+}
+
+bool FunctionIndex::load() {
+    if(mkdir(m_Directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        LOG_SRC(ERROR, "Cannot create the function index " + m_Directory);
+        return false;
+    }
+
+    const std::string functions = functionPath();
+    if(access(functions.c_str(), F_OK) != 0) {
+        Writer writer;
+        writer.putBytes(FunctionMagic, sizeof(FunctionMagic));
+        writer.put16(FormatVersion);
+        writer.put16(SignatureSize);
+        writer.put32(0);
+        std::ofstream file(functions, std::ofstream::binary | std::ofstream::trunc);
+        if(!writeAll(file, writer)) {
+            LOG_SRC(ERROR, "Cannot create " + functions);
+            return false;
+        }
+    }
+
+    m_Functions.reset(new MappedFile(functions, false));
+    const uint8_t *data = m_Functions->data();
+    if(!m_Functions->isOpen() || m_Functions->size() < FunctionHeaderSize ||
+            std::memcmp(data, FunctionMagic, sizeof(FunctionMagic)) != 0 || get16(data + 4) != FormatVersion ||
+            get16(data + 6) != SignatureSize) {
+        LOG_SRC(ERROR, functions + " is not a function index of this version");
+        m_Functions.reset();
+        return false;
+    }
+
+    //a writer may have been stopped in the middle of a record
+    m_MappedFunctions = (m_Functions->size() - FunctionHeaderSize) / FunctionRecordSize;
+    const std::size_t complete = FunctionHeaderSize + m_MappedFunctions * FunctionRecordSize;
+    if(complete != m_Functions->size()) {
+        LOG_SRC(WARNING, "Dropping an incomplete function at the end of " + functions);
+        m_Functions.reset();
+        if(truncate(functions.c_str(), complete) != 0) {
+            LOG_SRC(ERROR, "Cannot truncate " + functions);
+            return false;
+        }
+        m_Functions.reset(new MappedFile(functions, false));
+    }
+
+    m_Buckets.reset(new MappedFile(bucketPath(), false));
+    data = m_Buckets->data();
+    if(m_Buckets->isOpen()) {
+        const bool valid = m_Buckets->size() >= BucketHeaderSize &&
+                           std::memcmp(data, BucketMagic, sizeof(BucketMagic)) == 0 &&
+                           get16(data + 4) == FormatVersion && get16(data + 6) == Bands &&
+                           get32(data + 8) <= m_MappedFunctions &&
+                           m_Buckets->size() == BucketHeaderSize + 8 * static_cast<uint64_t>(get32(data + 12)) +
+                           PostingSize * get64(data + 16);
+        if(valid) {
+            m_BucketFunctions = get32(data + 8);
+            m_BucketCount = get64(data + 16);
+            for(uint32_t i = 0; i < get32(data + 12); ++i) {
+                m_ROMs.insert(get64(data + BucketHeaderSize + 8 * i));
+            }
+        } else {
+            LOG_SRC(WARNING, "Ignoring the damaged bucket file " + bucketPath());
+            m_Buckets.reset();
+        }
+    } else {
+        m_Buckets.reset();
+    }
+
+    for(uint32_t id = m_BucketFunctions; id < m_MappedFunctions; ++id) {
+        addPending(id, signatureOf(id));
+        m_ROMs.insert(entry(id).romHash);
+    }
+
+    m_Appender.open(functions, std::ofstream::binary | std::ofstream::app);
+    if(!m_Appender) {
+        LOG_SRC(ERROR, "Cannot open " + functions + " for writing");
+        return false;
+    }
+    return true;
+}
+
+void FunctionIndex::addPending(uint32_t id, const Signature &signature) {
+    for(unsigned int band = 0; band < Bands; ++band) {
+        const uint64_t key = bandKey(band, signature);
+        uint32_t &newest = m_PendingBuckets[key];
+        Posting posting = {key, id, newest};
+        m_Postings.push_back(posting);
+        newest = m_Postings.size();
+    }
+}
+
+FunctionIndex::Entry FunctionIndex::entry(uint32_t id) const {
+    if(id >= m_MappedFunctions) {
+        return m_NewEntries[id - m_MappedFunctions];
+    }
+    const uint8_t *record = m_Functions->data() + FunctionHeaderSize + id * FunctionRecordSize;
+    Entry entry = {get64(record), get32(record + 8), get32(record + 12)};
+    return entry;
+}
+
+FunctionIndex::Signature FunctionIndex::signatureOf(uint32_t id) const {
+    if(id >= m_MappedFunctions) {
+        return m_NewSignatures[id - m_MappedFunctions];
+    }
+    const uint8_t *record = m_Functions->data() + FunctionHeaderSize + id * FunctionRecordSize + 16;
+    Signature signature;
+    for(std::size_t i = 0; i < SignatureSize; ++i) {
+        signature[i] = get32(record + 4 * i);
+    }
+    return signature;
+}
+
+bool FunctionIndex::signature(const Analysis &analysis, std::size_t index, Signature &signature,
+                              uint32_t &instructions) {
+    const Function &function = analysis.callGraph().functions()[index];
+    const ControlFlowGraph &graph = analysis.graph();
+
+    std::vector<uint32_t> tokens;
+    for(LongAddress start : function.blocks) {
+        ControlFlowGraph::BlockMap::const_iterator block = graph.blocks().find(start);
+        if(block == graph.blocks().end()) {
+            continue;
+        }
+        graph.forEachInstruction(block->second, [&tokens](LongAddress, const Instruction & instruction,
+        const MachineState &) {
+            tokens.push_back(token(instruction));
+        });
+    }
+    instructions = tokens.size();
+    if(tokens.size() < MinInstructions) {
+        return false;
+    }
+
+    //every minhash takes the smallest value of its own hash function over the shingles of three tokens
+    signature.fill(0xFFFFFFFF);
+    for(std::size_t i = 0; i + 2 < tokens.size(); ++i) {
+        const uint64_t shingle = finalize(((static_cast<uint64_t>(tokens[i]) << 32) | tokens[i + 1]) ^
+                                          finalize(tokens[i + 2]));
+        for(std::size_t j = 0; j < SignatureSize; ++j) {
+            const uint32_t value = finalize(shingle + j * 0x9E3779B97F4A7C15ULL) >> 32;
+            signature[j] = std::min(signature[j], value);
+        }
+    }
+    return true;
+}
+
+bool FunctionIndex::add(const Entry &entry, const Signature &signature) {
+    if(!m_Functions || !m_Appender.is_open()) {
+        return false;
+    }
+
+    Writer writer;
+    writer.put64(entry.romHash);
+    writer.put32(entry.address);
+    writer.put32(entry.instructions);
+    for(uint32_t value : signature) {
+        writer.put32(value);
+    }
+    if(!writeAll(m_Appender, writer)) {
+        LOG_SRC(ERROR, "Cannot write to " + functionPath());
+        return false;
+    }
+
+    const uint32_t id = size();
+    m_NewEntries.push_back(entry);
+    m_NewSignatures.push_back(signature);
+    addPending(id, signature);
+    m_ROMs.insert(entry.romHash);
+
+    if(pending() > std::max(MinCompaction, size() / 4)) {
+        compact();
+    }
+    return true;
+}
+
+std::size_t FunctionIndex::add(const Analysis &analysis) {
+    TRACE_SCOPE("function_index_add");
+    const uint64_t romHash = analysis.rom().contentHash();
+    if(containsROM(romHash)) {
+        return 0;
+    }
+
+    std::size_t added = 0;
+    const CallGraph::FunctionList &functions = analysis.callGraph().functions();
+    for(std::size_t i = 0; i < functions.size(); ++i) {
+        Entry entry = {romHash, functions[i].entry, 0};
+        Signature signature;
+        if(FunctionIndex::signature(analysis, i, signature, entry.instructions) && add(entry, signature)) {
+            ++added;
+        }
+    }
+    m_Appender.flush();
+    TRACE_ITERATIONS(functions.size());
+    return added;
+}
+
+std::vector<FunctionIndex::Match> FunctionIndex::similar(const Signature &signature, std::size_t k) const {
+    std::vector<uint32_t> candidates;
+    for(unsigned int band = 0; band < Bands; ++band) {
+        const uint64_t key = bandKey(band, signature);
+        std::size_t taken = 0;
+
+        if(m_Buckets) {
+            const uint8_t *postings = m_Buckets->data() + BucketHeaderSize + 8 * get32(m_Buckets->data() + 12);
+            uint64_t low = 0;
+            uint64_t high = m_BucketCount;
+            while(low < high) {
+                const uint64_t middle = low + (high - low) / 2;
+                if(get64(postings + middle * PostingSize) < key) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            for(; low < m_BucketCount && taken < MaxBucketCandidates &&
+                    get64(postings + low * PostingSize) == key; ++low, ++taken) {
+                candidates.push_back(get32(postings + low * PostingSize + 8));
+            }
+        }
+
+        std::unordered_map<uint64_t, uint32_t>::const_iterator pending = m_PendingBuckets.find(key);
+        if(pending != m_PendingBuckets.end()) {
+            for(uint32_t i = pending->second; i != 0 && taken < MaxBucketCandidates; ++taken) {
+                candidates.push_back(m_Postings[i - 1].id);
+                i = m_Postings[i - 1].next;
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<Match> matches;
+    matches.reserve(candidates.size());
+    for(uint32_t id : candidates) {
+        const Signature other = signatureOf(id);
+        std::size_t equal = 0;
+        for(std::size_t i = 0; i < SignatureSize; ++i) {
+            equal += signature[i] == other[i] ? 1 : 0;
+        }
+        Match match = {id, entry(id), static_cast<double>(equal) / SignatureSize};
+        matches.push_back(match);
+    }
+
+    k = std::min(k, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + k, matches.end(), [](const Match & a, const Match & b) {
+        return a.similarity > b.similarity || (a.similarity == b.similarity && a.id < b.id);
+    });
+    matches.resize(k);
+    return matches;
+}
+
+bool FunctionIndex::compact() {
+    if(!m_Functions) {
+        return false;
+    }
+    TRACE_SCOPE("function_index_compact");
+
+    //the bucket file must not cover functions that are not in the function file yet
+    m_Appender.flush();
+    if(!m_Appender) {
+        LOG_SRC(ERROR, "Cannot write to " + functionPath());
+        return false;
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t> > pending;
+    pending.reserve(m_Postings.size());
+    for(const Posting &posting : m_Postings) {
+        pending.push_back(std::make_pair(posting.key, posting.id));
+    }
+    std::sort(pending.begin(), pending.end());
+
+    std::ostringstream temporary;
+    temporary << bucketPath() << '.' << getpid() << TemporaryExtension;
+    std::ofstream file(temporary.str(), std::ofstream::binary | std::ofstream::trunc);
+
+    Writer writer;
+    writer.putBytes(BucketMagic, sizeof(BucketMagic));
+    writer.put16(FormatVersion);
+    writer.put16(Bands);
+    writer.put32(size());
+    writer.put32(m_ROMs.size());
+    writer.put64(m_BucketCount + pending.size());
+    for(uint64_t romHash : m_ROMs) {
+        writer.put64(romHash);
+    }
+
+    //the pending functions were added after the ones in the file, so equal keys stay sorted by id
+    const uint8_t *postings = m_Buckets ? m_Buckets->data() + BucketHeaderSize + 8 * get32(m_Buckets->data() + 12)
+                              : nullptr;
+    uint64_t old = 0;
+    std::size_t next = 0;
+    bool written = true;
+    while(written && (old < m_BucketCount || next < pending.size())) {
+        if(old < m_BucketCount && (next == pending.size() ||
+                                   get64(postings + old * PostingSize) <= pending[next].first)) {
+            writer.putBytes(reinterpret_cast<const char *>(postings + old * PostingSize), PostingSize);
+            ++old;
+        } else {
+            writer.put64(pending[next].first);
+            writer.put32(pending[next].second);
+            ++next;
+        }
+        if(writer.data().size() >= WriteBufferSize) {
+            written = writeAll(file, writer);
+        }
+    }
+    written = written && writeAll(file, writer);
+    file.close();
+
+    if(!written || !file || std::rename(temporary.str().c_str(), bucketPath().c_str()) != 0) {
+        LOG_SRC(ERROR, "Cannot write the bucket file " + bucketPath());
+        std::remove(temporary.str().c_str());
+        return false;
+    }
+
+    m_Buckets.reset(new MappedFile(bucketPath(), false));
+    m_BucketFunctions = size();
+    m_BucketCount += pending.size();
+    m_PendingBuckets.clear();
+    m_Postings.clear();
+
+    m_Functions.reset(new MappedFile(functionPath(), false));
+    m_MappedFunctions = size();
+    m_NewEntries.clear();
+    m_NewSignatures.clear();
+    return true;
+}
@@ -0,0 +1,149 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FUNCTIONINDEX_HPP
+#define FUNCTIONINDEX_HPP
+
+#include "Analysis.hpp"
+#include "MappedFile.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! \brief An on-disk index of the functions of many ROMs for finding the same routine in different games
+ *
+ *  A function is normalised into one token per instruction: the opcode and, unless it is an absolute address,
+ *  the operand. Immediates, direct page and stack offsets and short branches are kept, since they do not change
+ *  when a routine is linked to another address. Every three consecutive tokens form a shingle, and the shingles
+ *  are condensed into a MinHash signature, whose equal values estimate the Jaccard similarity of two functions.
+ *
+ *  The signatures are split into Bands bands. Functions agreeing in a whole band are candidates of each other
+ *  (locality sensitive hashing), so a query only compares the signatures of a few candidates, found by binary
+ *  searches in a sorted bucket file, no matter how many functions the index holds.
+ *
+ *  The index is a directory with two files. The function file holds the entries and signatures in the order
+ *  they were added, new ones are appended at once. The bucket file is sorted and covers the functions up to
+ *  some point; the buckets of newer functions are kept in memory until \see compact merges them into the file,
+ *  which happens automatically once there are enough of them. Only one process may add to an index at a time.
+ */
+class FunctionIndex {
+  public:
+    enum { FormatVersion = 1, SignatureSize = 64, Bands = 16, RowsPerBand = SignatureSize / Bands };
+    //functions this short are too generic to say anything
+    enum { MinInstructions = 6 };
+    //a query looks at this many functions of a bucket at most, larger ones hold boilerplate
+    enum { MaxBucketCandidates = 1024 };
+
+    typedef std::array<uint32_t, SignatureSize> Signature;
+
+    struct Entry {
+        uint64_t romHash; //the content hash of the ROM, see SNESROM::contentHash
+        LongAddress address;
+        uint32_t instructions;
+    };
+
+    struct Match {
+        uint32_t id;
+        Entry entry;
+        double similarity; //the estimated Jaccard similarity of the shingles
+    };
+  private:
+    std::string m_Directory;
+    std::unique_ptr<MappedFile> m_Functions;
+    std::unique_ptr<MappedFile> m_Buckets;
+    std::ofstream m_Appender;
+    uint32_t m_MappedFunctions; //the functions in m_Functions
+    uint32_t m_BucketFunctions; //the functions covered by m_Buckets
+    uint64_t m_BucketCount;
+
+    //the functions added after the function file was mapped
+    std::vector<Entry> m_NewEntries;
+    std::vector<Signature> m_NewSignatures;
+    /*! \brief A bucket entry of a function not covered by the bucket file
+     */
+    struct Posting {
+        uint64_t key;
+        uint32_t id;
+        uint32_t next; //the index of the previous posting with the same key plus 1, 0 ends the bucket
+    };
+    std::vector<Posting> m_Postings;
+    std::unordered_map<uint64_t, uint32_t> m_PendingBuckets; //the index of the newest posting of a key plus 1
+    std::set<uint64_t> m_ROMs;
+
+    std::string functionPath() const;
+    std::string bucketPath() const;
+    bool load();
+    void addPending(uint32_t id, const Signature &signature);
+    Signature signatureOf(uint32_t id) const;
+  public:
+    /*! \brief Opens the index in directory, which is created if needed. Errors are logged.
+     */
+    explicit FunctionIndex(const std::string &directory);
+
+    FunctionIndex(const FunctionIndex &) = delete;
+    FunctionIndex &operator=(const FunctionIndex &) = delete;
+
+    const std::string &directory() const { return m_Directory; }
+
+    /*! \brief Returns the number of functions in the index
+     */
+    std::size_t size() const { return m_MappedFunctions + m_NewEntries.size(); }
+
+    /*! \brief Returns the number of functions whose buckets are not in the bucket file yet
+     */
+    std::size_t pending() const { return size() - m_BucketFunctions; }
+
+    bool containsROM(uint64_t romHash) const { return m_ROMs.count(romHash) != 0; }
+
+    Entry entry(uint32_t id) const;
+
+    /*! \brief Computes the signature of the function of analysis at index of its \see CallGraph
+     *
+     *  \return false if the function has less than MinInstructions instructions
+     */
+    static bool signature(const Analysis &analysis, std::size_t index, Signature &signature,
+                          uint32_t &instructions);
+
+    /*! \brief Adds a function
+     *
+     *  \return false if it could not be written
+     */
+    bool add(const Entry &entry, const Signature &signature);
+
+    /*! \brief Adds all functions of analysis unless its ROM is in the index already
+     *
+     *  \return the number of functions added
+     */
+    std::size_t add(const Analysis &analysis);
+
+    /*! \brief Returns up to k functions sharing a band with signature, the most similar first
+     */
+    std::vector<Match> similar(const Signature &signature, std::size_t k) const;
+
+    /*! \brief Merges the pending buckets into the bucket file
+     *
+     *  \return false if the bucket file could not be written
+     */
+    bool compact();
+};
+
+#endif // FUNCTIONINDEX_HPP
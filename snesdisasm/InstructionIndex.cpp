@@ -0,0 +1,95 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "InstructionIndex.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <utility>
+
+InstructionIndex::InstructionIndex(const ControlFlowGraph &graph)
+    : m_ROM(graph.rom()),
+      m_Starts(ArenaAllocator<uint64_t>(graph.arena())),
+      m_Ranks(ArenaAllocator<uint32_t>(graph.arena())),
+      m_Flags(ArenaAllocator<uint8_t>(graph.arena())),
+      m_Pieces(ArenaAllocator<LongAddress>(graph.arena())) {
+    INSTRUMENT_PHASE(ANALYSIS);
+
+    const std::size_t imageSize = m_ROM.imageSize();
+    m_Starts.assign((imageSize + 63) / 64, 0);
+    //images are mapped in pieces of at least 32 KB, within them CPU and image addresses are contiguous
+    m_Pieces.assign((imageSize + 0x7FFF) / 0x8000, 0);
+
+    //the offset and flags of every start, collected in the order of the CPU addresses
+    std::vector<std::pair<uint32_t, uint8_t> > starts;
+    for(const ControlFlowGraph::BlockMap::value_type &block : graph.blocks()) {
+        uint8_t blockStart = BLOCK_START;
+        graph.forEachInstruction(block.second, [&](LongAddress address, const Instruction &,
+        const MachineState & state) {
+            const ImageAddress offset = m_ROM.imageAddress(address);
+            if(offset != ImageAddress(-1) && !contains(offset)) {
+                if(m_Pieces[offset / 0x8000] == 0) {
+                    m_Pieces[offset / 0x8000] = address - offset % 0x8000;
+                }
+                m_Starts[offset / 64] |= 1ULL << (offset % 64);
+                const uint8_t flags = state.getCPUStateRef().FlagRegister() & (MEMORY_SELECT | INDEX_SELECT);
+                starts.push_back(std::make_pair(static_cast<uint32_t>(offset), static_cast<uint8_t>(flags | blockStart)));
+            }
+            blockStart = 0;
+        });
+    }
+    std::sort(starts.begin(), starts.end());
+
+    for(const ControlFlowGraph::EntryPoint &entry : graph.entryPoints()) {
+        const ImageAddress offset = m_ROM.imageAddress(entry.address);
+        if(offset == ImageAddress(-1) || !contains(offset)) {
+            continue;
+        }
+        std::vector<std::pair<uint32_t, uint8_t> >::iterator it = std::lower_bound(starts.begin(), starts.end(),
+                std::make_pair(static_cast<uint32_t>(offset), static_cast<uint8_t>(0)));
+        if(it != starts.end() && it->first == offset) {
+            it->second |= ENTRY_POINT;
+        }
+    }
+
+    m_Flags.reserve(starts.size());
+    for(const std::pair<uint32_t, uint8_t> &start : starts) {
+        m_Flags.push_back(start.second);
+    }
+
+    const std::size_t wordsPerRank = RankInterval / 64;
+    m_Ranks.reserve(m_Starts.size() / wordsPerRank + 1);
+    uint32_t count = 0;
+    for(std::size_t word = 0; word < m_Starts.size(); ++word) {
+        if(word % wordsPerRank == 0) {
+            m_Ranks.push_back(count);
+        }
+        count += __builtin_popcountll(m_Starts[word]);
+    }
+}
+
+std::size_t InstructionIndex::rank(uint32_t offset) const {
+    const std::size_t word = offset / 64;
+    if(word >= m_Starts.size()) {
+        return m_Flags.size();
+    }
+
+    std::size_t count = m_Ranks[offset / RankInterval];
+    for(std::size_t i = word - word % (RankInterval / 64); i < word; ++i) {
+        count += __builtin_popcountll(m_Starts[i]);
+    }
+    return count + __builtin_popcountll(m_Starts[word] & ((1ULL << (offset % 64)) - 1));
+}
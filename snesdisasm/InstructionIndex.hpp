@@ -0,0 +1,126 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INSTRUCTIONINDEX_HPP
+#define INSTRUCTIONINDEX_HPP
+
+#include "ControlFlowGraph.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*! \brief A compact table of all analysed instructions of an image
+ *
+ *  Instead of decoded instructions the index keeps one bit per image byte telling whether an instruction starts
+ *  there, and one flags byte per instruction. The instructions are decoded again from the image when they are
+ *  visited. A rank directory with a count for every \see RankInterval bits maps an image offset to the number
+ *  of the instruction starting there in O(1), so a lookup needs neither a search nor a pointer per instruction.
+ *
+ *  For every byte of the image the index takes 1/8 byte for the bitmap and 1/128 byte for the ranks, plus
+ *  one byte for every instruction.
+ *
+ *  Instructions are identified by image offset, so mirrors share them. If an offset was decoded with different
+ *  register sizes, the flags of the lowest CPU address are kept.
+ */
+class InstructionIndex {
+  public:
+    /*! \brief The bits of the flags byte. MEMORY_SELECT and INDEX_SELECT keep their positions of the
+     *         processorflags, the other bits are used as follows.
+     */
+    enum Flag : uint8_t {
+        BLOCK_START = 0x01, //the first instruction of a basic block
+        ENTRY_POINT = 0x02  //an entry point of the graph
+    };
+
+    enum { RankInterval = 512 };
+  private:
+    //all tables are sized before they are filled, so nothing is left behind in the arena
+    const SNESROM &m_ROM;
+    std::vector<uint64_t, ArenaAllocator<uint64_t> > m_Starts;
+    std::vector<uint32_t, ArenaAllocator<uint32_t> > m_Ranks; //the number of starts before each interval of RankInterval bits
+    std::vector<uint8_t, ArenaAllocator<uint8_t> > m_Flags;  //in ascending order of offset
+    //the CPU address of every 32 KB piece of the image the instructions are decoded at
+    std::vector<LongAddress, ArenaAllocator<LongAddress> > m_Pieces;
+  public:
+    /*! \brief Indexes all instructions of a built graph. The rom of the graph has to outlive the index.
+     *
+     *  The tables are allocated from the arena of the graph.
+     */
+    explicit InstructionIndex(const ControlFlowGraph &graph);
+
+    /*! \brief Returns the number of instructions
+     */
+    std::size_t size() const { return m_Flags.size(); }
+
+    /*! \brief Returns true if an instruction starts at offset
+     */
+    bool contains(uint32_t offset) const {
+        return offset / 64 < m_Starts.size() && (m_Starts[offset / 64] >> (offset % 64) & 1) != 0;
+    }
+
+    /*! \brief Returns the number of instructions starting before offset
+     */
+    std::size_t rank(uint32_t offset) const;
+
+    /*! \brief Returns the flags of the instruction at offset, which has to be \see contains
+     */
+    uint8_t flags(uint32_t offset) const { return m_Flags[rank(offset)]; }
+
+    /*! \brief Calls f(offset, instruction, state) for every instruction starting in the image range [start, end)
+     *         in ascending order
+     *
+     *  The instructions are decoded at the lowest CPU address any of them in the same 32 KB piece was analysed at.
+     */
+    template<class F>
+    void forEachIn(uint32_t start, uint32_t end, F f) const;
+
+    /*! \brief Returns the number of bytes the index occupies
+     */
+    std::size_t memoryUsage() const {
+        return sizeof(*this) + m_Starts.capacity() * sizeof(uint64_t) + m_Ranks.capacity() * sizeof(uint32_t) +
+               m_Flags.capacity() + m_Pieces.capacity() * sizeof(LongAddress);
+    }
+};
+
+template<class F>
+void InstructionIndex::forEachIn(uint32_t start, uint32_t end, F f) const {
+    end = std::min<uint32_t>(end, m_Starts.size() * 64);
+    if(start >= end) {
+        return;
+    }
+
+    std::size_t index = rank(start);
+    for(uint32_t word = start / 64; word * 64 < end; ++word) {
+        uint64_t bits = m_Starts[word];
+        if(word == start / 64) {
+            bits &= ~0ULL << (start % 64);
+        }
+        while(bits != 0) {
+            const uint32_t offset = word * 64 + __builtin_ctzll(bits);
+            if(offset >= end) {
+                return;
+            }
+            const MachineState state(m_Flags[index]);
+            const LongAddress address = m_Pieces[offset / 0x8000] + offset % 0x8000;
+            f(offset, Instruction(state, m_ROM.image() + offset, address), state);
+            ++index;
+            bits &= bits - 1;
+        }
+    }
+}
+
+#endif // INSTRUCTIONINDEX_HPP
@@ -0,0 +1,212 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "InstructionLengths.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SNESDISASM_X86
+#endif
+
+namespace {
+
+/*! \brief The tables of the vectorised lookup
+ *
+ *  The four packed lengths of an opcode take only a few distinct values. Every opcode gets the number of its
+ *  value as a 4 bit class, and the classes of two opcodes with equal low nibble and high nibbles 2p and 2p + 1
+ *  share one byte of the table of p. A lookup by low nibble in each of the 8 tables followed by a selection by the
+ *  bits 7 to 4 of the opcode yields its class, which a last lookup turns into its lengths.
+ */
+struct PackedLengthTable {
+    uint8_t lengths[256]; //the four lengths minus one, in the 2 bit fields of InstructionLengths::shift
+    alignas(16) uint8_t classes[8][16];
+    alignas(16) uint8_t values[16]; //the lengths of each class
+
+    PackedLengthTable() : classes(), values() {
+        unsigned int count = 0;
+        for(unsigned int opCode = 0; opCode < 256; ++opCode) {
+            lengths[opCode] = 0;
+            for(unsigned int flags = 0; flags < 4; ++flags) {
+                const uint8_t size = instructionSize(opCode, flags & 0x02, flags & 0x01);
+                lengths[opCode] |= (size - 1) << (2 * flags);
+            }
+
+            unsigned int id = std::find(values, values + count, lengths[opCode]) - values;
+            if(id == count) {
+                assert(count < 16);
+                values[count++] = lengths[opCode];
+            }
+            classes[opCode >> 5][opCode & 0x0F] |= id << (opCode & 0x10 ? 4 : 0);
+        }
+    }
+};
+
+const PackedLengthTable &packedLengths() {
+    static const PackedLengthTable table;
+    return table;
+}
+
+void computeScalar(const uint8_t *data, std::size_t start, std::size_t size, uint8_t *out) {
+    const uint8_t *lengths = packedLengths().lengths;
+    for(std::size_t i = start; i < size; ++i) {
+        out[i] = lengths[data[i]];
+    }
+}
+
+#ifdef SNESDISASM_X86
+
+//picks the bytes of a whose bit 7 of mask is set, otherwise those of b
+__attribute__((target("ssse3")))
+inline __m128i select(__m128i mask, __m128i a, __m128i b) {
+    const __m128i set = _mm_cmplt_epi8(mask, _mm_setzero_si128());
+    return _mm_or_si128(_mm_and_si128(set, a), _mm_andnot_si128(set, b));
+}
+
+__attribute__((target("ssse3")))
+std::size_t computeSSSE3(const uint8_t *data, std::size_t size, uint8_t *out) {
+    const PackedLengthTable &table = packedLengths();
+    __m128i classes[8];
+    for(unsigned int p = 0; p < 8; ++p) {
+        classes[p] = _mm_load_si128(reinterpret_cast<const __m128i *>(table.classes[p]));
+    }
+    const __m128i values = _mm_load_si128(reinterpret_cast<const __m128i *>(table.values));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    std::size_t i = 0;
+    for(; i + 16 <= size; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i low = _mm_and_si128(bytes, nibble);
+        //shifting the 16 bit lanes moves bit n of each byte to bit 7 of the same byte
+        const __m128i bit6 = _mm_slli_epi16(bytes, 1);
+        const __m128i bit5 = _mm_slli_epi16(bytes, 2);
+        const __m128i bit4 = _mm_slli_epi16(bytes, 3);
+
+        __m128i pairs[4];
+        for(unsigned int p = 0; p < 4; ++p) {
+            pairs[p] = select(bit5, _mm_shuffle_epi8(classes[2 * p + 1], low), _mm_shuffle_epi8(classes[2 * p], low));
+        }
+        const __m128i pair = select(bytes, select(bit6, pairs[3], pairs[2]), select(bit6, pairs[1], pairs[0]));
+        const __m128i id = _mm_and_si128(select(bit4, _mm_srli_epi16(pair, 4), pair), nibble);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_shuffle_epi8(values, id));
+    }
+    return i;
+}
+
+//the same with 32 bytes per step. vpshufb looks up within each 128 bit lane, so the tables are in both lanes.
+__attribute__((target("avx2")))
+std::size_t computeAVX2(const uint8_t *data, std::size_t size, uint8_t *out) {
+    const PackedLengthTable &table = packedLengths();
+    __m256i classes[8];
+    for(unsigned int p = 0; p < 8; ++p) {
+        classes[p] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(table.classes[p])));
+    }
+    const __m256i values = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(table.values)));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    std::size_t i = 0;
+    for(; i + 32 <= size; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i low = _mm256_and_si256(bytes, nibble);
+        const __m256i bit6 = _mm256_slli_epi16(bytes, 1);
+        const __m256i bit5 = _mm256_slli_epi16(bytes, 2);
+        const __m256i bit4 = _mm256_slli_epi16(bytes, 3);
+
+        __m256i pairs[4];
+        for(unsigned int p = 0; p < 4; ++p) {
+            pairs[p] = _mm256_blendv_epi8(_mm256_shuffle_epi8(classes[2 * p], low),
+                                          _mm256_shuffle_epi8(classes[2 * p + 1], low), bit5);
+        }
+        const __m256i pair = _mm256_blendv_epi8(_mm256_blendv_epi8(pairs[0], pairs[1], bit6),
+                                                _mm256_blendv_epi8(pairs[2], pairs[3], bit6), bytes);
+        const __m256i id = _mm256_and_si256(_mm256_blendv_epi8(pair, _mm256_srli_epi16(pair, 4), bit4), nibble);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_shuffle_epi8(values, id));
+    }
+    return i;
+}
+
+#endif
+
+enum class Kernel {
+    SCALAR,
+    SSSE3,
+    AVX2
+};
+
+Kernel detectKernel() {
+#ifdef SNESDISASM_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return Kernel::AVX2;
+    }
+    if(__builtin_cpu_supports("ssse3")) {
+        return Kernel::SSSE3;
+    }
+#endif
+    return Kernel::SCALAR;
+}
+
+Kernel kernel() {
+    static const Kernel detected = detectKernel();
+    return detected;
+}
+
+}
+
+InstructionLengths::InstructionLengths(const uint8_t *data, std::size_t size)
+    : m_Data(data),
+      m_Lengths(size) {
+    INSTRUMENT_COUNT(BYTES_VISITED, size);
+
+    std::size_t done = 0;
+#ifdef SNESDISASM_X86
+    switch(::kernel()) {
+    case Kernel::AVX2:
+        done = computeAVX2(data, size, m_Lengths.data());
+        break;
+    case Kernel::SSSE3:
+        done = computeSSSE3(data, size, m_Lengths.data());
+        break;
+    default:
+        break;
+    }
+#endif
+    //the tail shorter than a vector
+    computeScalar(data, done, size, m_Lengths.data());
+}
+
+std::size_t InstructionLengths::chainLength(std::size_t offset, uint8_t flags, std::size_t count) const {
+    std::size_t chain = 0;
+    while(chain < count && offset < m_Lengths.size() && step(offset, flags)) {
+        ++chain;
+    }
+    return chain;
+}
+
+const char *InstructionLengths::kernel() {
+    switch(::kernel()) {
+    case Kernel::AVX2:
+        return "avx2";
+    case Kernel::SSSE3:
+        return "ssse3";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef INSTRUCTIONLENGTHS_HPP
+#define INSTRUCTIONLENGTHS_HPP
+
+#include "InstructionTables.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*! \brief The length of the instruction at every byte offset of a buffer, for all four register sizes
+ *
+ *  Every offset takes one byte holding four 2 bit fields with the length minus one, one for each combination
+ *  of MEMORY_SELECT and INDEX_SELECT (see \see shift). The lengths are computed with 256 entry table lookups
+ *  split into 16 byte shuffles (pshufb) over the low nibble, one per high nibble, which processes 16 or 32
+ *  bytes per step. AVX2 or SSSE3 are picked at runtime, other CPUs use a scalar loop.
+ *
+ *  With the lengths at hand, a linear sweep or the question whether N instructions in a row start at an offset
+ *  are walks over the array that do not decode anything. Every opcode is valid on the 65816, so a chain is only
+ *  broken by the end of the buffer. REP and SEP change the register sizes along the way like they do in
+ *  \see decodeSequence.
+ */
+class InstructionLengths {
+  private:
+    const uint8_t *m_Data;
+    std::vector<uint8_t> m_Lengths;
+
+    static uint8_t updateFlags(const uint8_t *instruction, uint8_t flags) {
+        if(instruction[0] == 0xC2) { //REP
+            return flags & ~instruction[1];
+        }
+        if(instruction[0] == 0xE2) { //SEP
+            return flags | instruction[1];
+        }
+        return flags;
+    }
+  public:
+    /*! \brief Computes the lengths of all offsets of data. data has to outlive the lengths.
+     */
+    InstructionLengths(const uint8_t *data, std::size_t size);
+
+    std::size_t size() const { return m_Lengths.size(); }
+
+    /*! \brief Returns the position of the 2 bit field of the register sizes in flags
+     */
+    static unsigned int shift(uint8_t flags) { return (flags & (MEMORY_SELECT | INDEX_SELECT)) >> 3; }
+
+    /*! \brief Returns the four packed lengths of offset
+     */
+    uint8_t packed(std::size_t offset) const { return m_Lengths[offset]; }
+
+    /*! \brief Returns the length of the instruction at offset decoded with the register sizes of flags
+     */
+    unsigned int length(std::size_t offset, uint8_t flags) const {
+        return ((m_Lengths[offset] >> shift(flags)) & 0x03) + 1;
+    }
+
+    /*! \brief Moves offset and flags past the instruction at offset. Returns false and leaves them unchanged if it
+     *         does not fit into the buffer.
+     */
+    bool step(std::size_t &offset, uint8_t &flags) const {
+        const unsigned int length = this->length(offset, flags);
+        if(length > m_Lengths.size() - offset) {
+            return false;
+        }
+        flags = updateFlags(m_Data + offset, flags);
+        offset += length;
+        return true;
+    }
+
+    /*! \brief Returns the number of consecutive instructions starting at offset that lie within the buffer, at
+     *         most count
+     */
+    std::size_t chainLength(std::size_t offset, uint8_t flags, std::size_t count) const;
+
+    /*! \brief Returns true if count consecutive instructions starting at offset lie within the buffer
+     */
+    bool startsChain(std::size_t offset, uint8_t flags, std::size_t count) const {
+        return chainLength(offset, flags, count) == count;
+    }
+
+    /*! \brief Calls f(offset, flags) for the instructions of a linear sweep starting at offset until one starts at
+     *         or after end or does not fit into the buffer
+     *
+     *  flags are the processorflags at offset and are updated to the ones after the sweep.
+     *
+     *  \return the offset after the last instruction, or size() if an instruction did not fit
+     */
+    template<class F>
+    std::size_t sweep(std::size_t offset, std::size_t end, uint8_t &flags, F f) const;
+
+    std::size_t memoryUsage() const { return sizeof(*this) + m_Lengths.capacity(); }
+
+    /*! \brief Returns the name of the code computing the lengths on this CPU: "avx2", "ssse3" or "scalar"
+     */
+    static const char *kernel();
+};
+
+template<class F>
+std::size_t InstructionLengths::sweep(std::size_t offset, std::size_t end, uint8_t &flags, F f) const {
+    while(offset < end) {
+        const std::size_t start = offset;
+        const uint8_t startFlags = flags;
+        if(!step(offset, flags)) {
+            return m_Lengths.size();
+        }
+        f(start, startFlags);
+    }
+    return offset;
+}
+
+#endif // INSTRUCTIONLENGTHS_HPP
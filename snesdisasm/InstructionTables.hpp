@@ -0,0 +1,138 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INSTRUCTIONTABLES_HPP
+#define INSTRUCTIONTABLES_HPP
+
+#include "CPUState.hpp"
+
+#include <cstdint>
+
+/*! \brief The size of each instruction with 8 bit registers
+ */
+constexpr uint8_t opCodeByteSize[256] = {
+    /* +         0x00   0x01   0x02   0x03   0x04   0x05   0x06   0x07   0x08   0x09   0x0A   0x0B   0x0C   0x0D   0x0E   0x0F*/
+    /*0x00*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0x10*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
+    /*0x20*/      3,     2,     4,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0x30*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
+    /*0x40*/      1,     2,     2,     2,     3,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0x50*/      2,     2,     2,     2,     3,     2,     2,     2,     1,     3,     1,     1,     4,     3,     3,     4,
+    /*0x60*/      1,     2,     3,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0x70*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
+    /*0x80*/      2,     2,     3,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0x90*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
+    /*0xA0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0xB0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
+    /*0xC0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0xD0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
+    /*0xE0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
+    /*0xF0*/      2,     2,     2,     2,     3,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4
+};
+
+/*! \brief Returns the size of an instruction with the given register sizes
+ *
+ *  A cleared MEMORY_SELECT flag makes the immediate of the accumulator instructions 16 bit, a cleared INDEX_SELECT
+ *  flag those of LDX, LDY, CPX and CPY.
+ */
+constexpr uint8_t instructionSize(uint8_t opCode, bool memory8, bool index8) {
+    return opCodeByteSize[opCode] + (!memory8 && (opCode & 0x1F) == 0x09 ? 1 : 0) +
+           (!index8 && (opCode == 0xA0 || opCode == 0xA2 || opCode == 0xC0 || opCode == 0xE0) ? 1 : 0);
+}
+
+template<unsigned int... OpCodes>
+struct OpCodeSequence {};
+
+template<unsigned int Count, unsigned int... OpCodes>
+struct MakeOpCodeSequence : MakeOpCodeSequence < Count - 1, Count - 1, OpCodes... > {};
+
+template<unsigned int... OpCodes>
+struct MakeOpCodeSequence<0, OpCodes...> {
+    typedef OpCodeSequence<OpCodes...> type;
+};
+
+template<bool Memory8, bool Index8, class Sequence>
+struct InstructionSizeTable;
+
+/*! \brief The sizes of all 256 instructions for one combination of register sizes, generated at compile time
+ */
+template<bool Memory8, bool Index8, unsigned int... OpCodes>
+struct InstructionSizeTable<Memory8, Index8, OpCodeSequence<OpCodes...> > {
+    static constexpr uint8_t sizes[256] = {instructionSize(OpCodes, Memory8, Index8)...};
+};
+
+template<bool Memory8, bool Index8, unsigned int... OpCodes>
+constexpr uint8_t InstructionSizeTable<Memory8, Index8, OpCodeSequence<OpCodes...> >::sizes[256];
+
+/*! \brief The size table for Memory8 and Index8, which correspond to set MEMORY_SELECT and INDEX_SELECT flags
+ */
+template<bool Memory8, bool Index8>
+struct InstructionSizes : InstructionSizeTable<Memory8, Index8, MakeOpCodeSequence<256>::type> {};
+
+static_assert(InstructionSizes<true, true>::sizes[0xA9] == 2 && InstructionSizes<false, true>::sizes[0xA9] == 3 &&
+              InstructionSizes<false, true>::sizes[0xA2] == 2 && InstructionSizes<true, false>::sizes[0xA2] == 3 &&
+              InstructionSizes<false, false>::sizes[0x22] == 4, "the size tables are inconsistent");
+
+/*! \brief How the operand of an instruction resolves to the target returned by Instruction::target
+ */
+enum TargetKind : uint8_t {
+    NO_TARGET,
+    RELATIVE_TARGET,      //8 bit displacement from the next instruction, wrapping within the program bank
+    RELATIVE_LONG_TARGET, //16 bit displacement from the next instruction, wrapping within the program bank
+    BANK_TARGET,          //16 bit address in the program bank
+    LONG_TARGET           //24 bit address
+};
+
+/*! \brief Returns the \see TargetKind of an opcode
+ *
+ *  These are the branches, PER and BRL, the absolute JMP and JSR and the long JML and JSL.
+ */
+constexpr uint8_t targetKind(uint8_t opCode) {
+    return (opCode & 0x1F) == 0x10 || opCode == 0x80 ? RELATIVE_TARGET :
+           opCode == 0x62 || opCode == 0x82 ? RELATIVE_LONG_TARGET :
+           opCode == 0x20 || opCode == 0x4C ? BANK_TARGET :
+           opCode == 0x22 || opCode == 0x5C ? LONG_TARGET : NO_TARGET;
+}
+
+template<class Sequence>
+struct TargetKindTable;
+
+template<unsigned int... OpCodes>
+struct TargetKindTable<OpCodeSequence<OpCodes...> > {
+    static constexpr uint8_t kinds[256] = {targetKind(OpCodes)...};
+};
+
+template<unsigned int... OpCodes>
+constexpr uint8_t TargetKindTable<OpCodeSequence<OpCodes...> >::kinds[256];
+
+/*! \brief The \see TargetKind of all 256 instructions, generated at compile time
+ */
+struct InstructionTargetKinds : TargetKindTable<MakeOpCodeSequence<256>::type> {};
+
+static_assert(InstructionTargetKinds::kinds[0xF0] == RELATIVE_TARGET &&
+              InstructionTargetKinds::kinds[0x6C] == NO_TARGET, "the target kind table is inconsistent");
+
+/*! \brief Returns the size table for the MEMORY_SELECT and INDEX_SELECT bits of flags
+ */
+inline const uint8_t *instructionSizes(uint8_t flags) {
+    static const uint8_t *const tables[4] = {
+        InstructionSizes<false, false>::sizes, InstructionSizes<false, true>::sizes,
+        InstructionSizes<true, false>::sizes, InstructionSizes<true, true>::sizes
+    };
+    return tables[(flags & (MEMORY_SELECT | INDEX_SELECT)) >> 4];
+}
+
+#endif // INSTRUCTIONTABLES_HPP
@@ -16,69 +16,10 @@
 
 #include "Instructions.hpp"
 #include "Logger.hpp"
+#include "Instrumentation.hpp"
 
 #include <sstream>
 
-//http://wiki.superfamicom.org/snes/show/Jay's+ASM+Tutorial
-enum AddressingMode : unsigned char {
-    //der wert des parameters sei v
-    //konkatenierung von daten sei :
-    //      a : b, wenn a und b bytes sind ist demnach: (a << 8) | b
-    //      a +: b, bedeutet, dass b an a konkateniert wird, aber a (temp) um 1 erhöht, wenn b überläuft. demnach: (a << 8) + b
-    //      [s] sei der wert der, in der zelle mit adresse s steht
-    //      flag(x) ist das flag x
-    //      das ergebnis jeder gleichung ist eine adresse. eine ausnahme bildet IMMEDIATE, welches ein wert ist
-    //      RX, RY, SR = RegisterX, RegisterY, StackRegister
-    //      RX(H), RX(L) = Register X Hight, Register X Low
-    //
-    IMMEDIATE,               //               v        v ist 1 oder 2 byte, je nach operation
-    //                                                 operationen mit 2 byte haben einen anderen opCode als solche mit
-    //                                                 einem byte. vielleicht sollte man IMMEDIATE deshalb auftrennen
-    ABSOLUTE,                // DBR :     v            v ist 2 byte. DRB ist das data bank register
-    DIRECT,  //Zero page     //  00 : (DPR + v)        v ist 1 byte. DPR(H) ist 00 im emulationsmodus
-    //                                                 soll wirklich byte 0000:v adressiert werden, muss !v stehen
-    ABSOLUTE_INDEXED_WITH_X, //  RX + (DBR : v)        v ist 2 byte, RX ist je nach flag(x) 1 oder 2 byte
-    ABSOLUTE_INDEXED_WITH_Y, //  RY + (DBR : v)        ist v < 100, muss es !v sein
-    ABSOLUTE_LONG,           //           v            v ist volle 3 byte
-    DIRECT_INDEXED_WITH_X,   //  00 : (DPR + v + RX)   immer in bank 0. im 6502 emulation mode,
-    DIRECT_INDEXED_WITH_Y,   //  00 : (DPR + v + RY)   ist es auch immer in page DPR. sonst springt es auf die nächste
-    ACCUMULATOR,             //       A                es wird direkt im akkumulator gearbeitet
-    IMPLIED,                 //                        vom opCode bestimmt
-    STACK,                   //       SR               die adresse liegt in SR
-    DIRECT_INDIRECT,         // DBR : s=[00 : DPR + v] v ist 1 byte. s sind 2 byte: (low : high)
-
-
-
-
-    //IMMEDIATE_MEMORY_FLAG,           //
-    //IMMEDIATE_INDEX_FLAG,            //
-    //IMMEDIATE_8_BIT,                 //
-    RELATIVE,                        //
-    RELATIVE_LONG,                   //
-    DIRECT_INDEXED_INDIRECT,         //registerDBR : (DataAt(value+registerD+registerX))
-    DIRECT_INDIRECT_INDEXED,         //registerDBR : DataAt(??(maybe RAM?) : registerD+value) + registerY
-    DIRECT_INDIRECT_LONG,            //long3Bytes(DataAt((value+registerD))
-    DIRECT_INDIRECT_INDEXED_LONG,    //DataAt(long3Bytes(registerD + value)) + registerY
-    ABSOLUTE_INDEXED_LONG,           //long3Bytes(value+registerX)
-    STACK_RELATIVE,                  //value + stackValue
-    STACK_RELATIVE_INDIRECT_INDEXED, //registerDBR : (value+stackValue+registerY)
-    ABSOLUTE_INDIRECT,               //??(maybe RAM?) : DataAt(??(maybe DBR?) : value)
-    ABSOLUTE_INDIRECT_LONG,          //
-    ABSOLUTE_INDEXED_INDIRECT,       //     ??     : DataAt(value + registerX)
-    IMPLIED_ACCUMULATOR,             //
-    BLOCK_MOVE,                      //move #registerA bytes from value1:registerY to value2:registerX
-
-
-
-    ABSOLUTE_INDEXED_LONG_WITH_X,
-    PROGRAMMCOUNTER_RELATIVE,
-    PROGRAMMCOUNTER_RELATIVE_LONG,
-    STACK_INTERRUPT,
-    RESERVED,
-    DIRECT_INDIRECT_INDEXED_WITH_Y,
-    DIRECT_INDIRECT_LONG_INDEXED_WITH_Y
-};
-
 /*
  * Direct Indexed Indirect (d,x)
  * Direct Indirect Indexed (d),y
@@ -115,109 +56,129 @@ const char opCodes[256][4] = {
     /*0xF0*/    "BEQ", "SBC", "SBC", "SBC", "PEA", "SBC", "INC", "SBC", "SED", "SBC", "PLX", "XCE", "JSR", "SBC", "INC", "SBC"
 };
 
-uint8_t opCodeByteSize[256] = {
-    /* +         0x00   0x01   0x02   0x03   0x04   0x05   0x06   0x07   0x08   0x09   0x0A   0x0B   0x0C   0x0D   0x0E   0x0F*/
-    /*0x00*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0x10*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
-    /*0x20*/      3,     2,     4,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0x30*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
-    /*0x40*/      1,     2,     2,     2,     3,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0x50*/      2,     2,     2,     2,     3,     2,     2,     2,     1,     3,     1,     1,     4,     3,     3,     4,
-    /*0x60*/      1,     2,     3,     2,     2,     2,     2,     2,     1,     2,     3,     1,     3,     3,     3,     4,
-    /*0x70*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
-    /*0x80*/      2,     2,     3,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0x90*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
-    /*0xA0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0xB0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
-    /*0xC0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0xD0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4,
-    /*0xE0*/      2,     2,     2,     2,     2,     2,     2,     2,     1,     2,     1,     1,     3,     3,     3,     4,
-    /*0xF0*/      2,     2,     2,     2,     3,     2,     2,     2,     1,     3,     1,     1,     3,     3,     3,     4
+const AddressingMode opCodeAddressingMode[256] = {
+    /* +                0x00                    0x01                            0x02                         0x03                        0x04                    0x05                 0x06                           0x07                   0x08             0x09              0x0A       0x0B            0x0C                          0x0D                     0x0E                     0x0F                */
+    /*0x00*/ STACK                   , DIRECT_INDEXED_INDIRECT, STACK                        , STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0x10*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, DIRECT               , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, ACCUMULATOR, IMPLIED, ABSOLUTE                 , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0x20*/ ABSOLUTE                , DIRECT_INDEXED_INDIRECT, ABSOLUTE_LONG                , STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0x30*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, ACCUMULATOR, IMPLIED, ABSOLUTE_INDEXED_WITH_X  , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0x40*/ STACK                   , DIRECT_INDEXED_INDIRECT, RESERVED                     , STACK_RELATIVE                 , BLOCK_MOVE           , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0x50*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, BLOCK_MOVE           , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_LONG            , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0x60*/ STACK                   , DIRECT_INDEXED_INDIRECT, STACK                        , STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE_INDIRECT        , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0x70*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_INDEXED_INDIRECT, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0x80*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDEXED_INDIRECT, PROGRAMMCOUNTER_RELATIVE_LONG, STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0x90*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_Y, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, IMPLIED    , IMPLIED, ABSOLUTE                 , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0xA0*/ IMMEDIATE               , DIRECT_INDEXED_INDIRECT, IMMEDIATE                    , STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0xB0*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_Y, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, IMPLIED    , IMPLIED, ABSOLUTE_INDEXED_WITH_X  , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_Y, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0xC0*/ IMMEDIATE               , DIRECT_INDEXED_INDIRECT, IMMEDIATE                    , STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , IMPLIED, ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0xD0*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, STACK                , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_INDIRECT_LONG   , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
+    /*0xE0*/ IMMEDIATE               , DIRECT_INDEXED_INDIRECT, IMMEDIATE                    , STACK_RELATIVE                 , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , IMPLIED, ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
+    /*0xF0*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , STACK_RELATIVE_INDIRECT_INDEXED, STACK                , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_INDEXED_INDIRECT, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X
 };
 
-AddressingMode opCodeAddressingMode[256] = {
-    /* +                0x00                    0x01                            0x02                        0x03                        0x04                    0x05                 0x06                           0x07                   0x08             0x09              0x0A       0x0B            0x0C                          0x0D                     0x0E                     0x0F                */
-    /*0x00*/ STACK                   , DIRECT_INDEXED_INDIRECT, STACK                        , STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0x10*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, DIRECT               , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, ACCUMULATOR, IMPLIED, ABSOLUTE                 , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0x20*/ ABSOLUTE                , DIRECT_INDEXED_INDIRECT, ABSOLUTE_LONG                , STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0x30*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, ACCUMULATOR, IMPLIED, ABSOLUTE_INDEXED_WITH_X  , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0x40*/ STACK                   , DIRECT_INDEXED_INDIRECT, RESERVED                     , STACK_RELATIVE                , BLOCK_MOVE           , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0x50*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, BLOCK_MOVE           , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_LONG            , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0x60*/ STACK                   , DIRECT_INDEXED_INDIRECT, STACK                        , STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , STACK  , IMMEDIATE              , ACCUMULATOR, STACK  , ABSOLUTE_INDIRECT        , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0x70*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_INDEXED_INDIRECT, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0x80*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDEXED_INDIRECT, PROGRAMMCOUNTER_RELATIVE_LONG, STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0x90*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_Y, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, IMPLIED    , IMPLIED, ABSOLUTE                 , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0xA0*/ IMMEDIATE               , DIRECT_INDEXED_INDIRECT, IMMEDIATE                    , STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , STACK  , ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0xB0*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_Y, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, IMPLIED    , IMPLIED, ABSOLUTE_INDEXED_WITH_X  , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_Y, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0xC0*/ IMMEDIATE               , DIRECT_INDEXED_INDIRECT, IMMEDIATE                    , STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , IMPLIED, ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0xD0*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, STACK                , STACK                , DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_INDIRECT_LONG   , ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X,
-    /*0xE0*/ IMMEDIATE               , DIRECT_INDEXED_INDIRECT, IMMEDIATE                    , STACK_RELATIVE                , DIRECT               , DIRECT               , DIRECT               , DIRECT_INDIRECT_LONG               , IMPLIED, IMMEDIATE              , IMPLIED    , IMPLIED, ABSOLUTE                 , ABSOLUTE               , ABSOLUTE               , ABSOLUTE_LONG,
-    /*0xF0*/ PROGRAMMCOUNTER_RELATIVE, DIRECT_INDIRECT_INDEXED, DIRECT_INDIRECT              , DIRECT_INDIRECT_INDEXED_WITH_Y, STACK                , DIRECT_INDEXED_WITH_X, DIRECT_INDEXED_WITH_X, DIRECT_INDIRECT_LONG_INDEXED_WITH_Y, IMPLIED, ABSOLUTE_INDEXED_WITH_Y, STACK      , IMPLIED, ABSOLUTE_INDEXED_INDIRECT, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_WITH_X, ABSOLUTE_INDEXED_LONG_WITH_X
+const char *const addressingModeNames[] = {
+    "IMMEDIATE",
+    "ABSOLUTE",
+    "DIRECT",
+    "ABSOLUTE_INDEXED_WITH_X",
+    "ABSOLUTE_INDEXED_WITH_Y",
+    "ABSOLUTE_LONG",
+    "DIRECT_INDEXED_WITH_X",
+    "DIRECT_INDEXED_WITH_Y",
+    "ACCUMULATOR",
+    "IMPLIED",
+    "STACK",
+    "DIRECT_INDIRECT",
+    "RELATIVE",
+    "RELATIVE_LONG",
+    "DIRECT_INDEXED_INDIRECT",
+    "DIRECT_INDIRECT_INDEXED",
+    "DIRECT_INDIRECT_LONG",
+    "DIRECT_INDIRECT_INDEXED_LONG",
+    "ABSOLUTE_INDEXED_LONG",
+    "STACK_RELATIVE",
+    "STACK_RELATIVE_INDIRECT_INDEXED",
+    "ABSOLUTE_INDIRECT",
+    "ABSOLUTE_INDIRECT_LONG",
+    "ABSOLUTE_INDEXED_INDIRECT",
+    "IMPLIED_ACCUMULATOR",
+    "BLOCK_MOVE",
+    "ABSOLUTE_INDEXED_LONG_WITH_X",
+    "PROGRAMMCOUNTER_RELATIVE",
+    "PROGRAMMCOUNTER_RELATIVE_LONG",
+    "STACK_INTERRUPT",
+    "RESERVED",
+    "DIRECT_INDIRECT_INDEXED_WITH_Y",
+    "DIRECT_INDIRECT_LONG_INDEXED_WITH_Y"
 };
 
-Instruction::Instruction(const MachineState &state, const uint8_t *data)
-    : m_OpCode {data[0]} {
-
-    m_Size = opCodeByteSize[m_OpCode];
-
-    if(state.getCPUStateRef().areFlagsSet(MEMORY_SELECT)) {
-        switch(m_OpCode) {
-        case 0x09:
-        case 0x29:
-        case 0x49:
-        case 0x69:
-        case 0x89:
-        case 0xA9:
-        case 0xC9:
-        case 0xE9:
-            ++m_Size;
-        }
-    }
-
-    if(state.getCPUStateRef().areFlagsSet(INDEX_SELECT)) {
-        switch(m_OpCode) {
-        case 0xA0:
-        case 0xA2:
-        case 0xC0:
-        case 0xE0:
-            ++m_Size;
-        }
-    }
+const char *addressingModeName(AddressingMode mode) {
+    return addressingModeNames[mode];
+}
 
-    switch(m_Size) {
-    case 4:
-        m_Argument.at3 = data[3];
-    case 3:
-        m_Argument.at2 = data[2];
-    case 2:
-        m_Argument.at1 = data[1];
-    }
+Instruction::Instruction(const MachineState &state, const uint8_t *data, LongAddress address)
+    : Instruction(data, instructionSizes(state.getCPUStateRef().FlagRegister())[data[0]], address) {
 }
 
 uint8_t Instruction::size() const {
     return m_Size;
 }
 
-bool Instruction::isJump() const {
+const char *Instruction::mnemonic() const {
+    return opCodes[m_OpCode];
+}
+
+AddressingMode Instruction::addressingMode() const {
+    return opCodeAddressingMode[m_OpCode];
+}
+
+uint32_t Instruction::operand() const {
+    return (m_Argument.at3 << 16) | (m_Argument.at2 << 8) | m_Argument.at1;
+}
+
+ControlFlow Instruction::controlFlow() const {
     switch(m_OpCode) {
     case 0x10: //Branch if Plus
-    case 0x20: //Jump to Subroutine
     case 0x30: //Branch if Minus
-    case 0x22: //Jump to Subroutine
+    case 0x50: //Branch if Overflow Clear
+    case 0x70: //Branch if Overflow Set
+    case 0x90: //Branch if Carry Clear
+    case 0xB0: //Branch if Carry Set
+    case 0xD0: //Branch if Not Equal
+    case 0xF0: //Branch if Equal
+        return ControlFlow::BRANCH;
     case 0x4C: //Jump
-    case 0x5C: //Jump
-    case 0x6C: //Jump
-    case 0x7C: //Jump
+    case 0x5C: //Jump Long
     case 0x80: //Branch Always
-    case 0xD0: //Branch if Not Equal
-    case 0xDC: //Jump
-    case 0xFC: //Jump to Subroutine
-        return true;
+    case 0x82: //Branch Always Long
+        return ControlFlow::JUMP;
+    case 0x6C: //Jump Indirect
+    case 0x7C: //Jump Indexed Indirect
+    case 0xDC: //Jump Indirect Long
+        return ControlFlow::INDIRECT_JUMP;
+    case 0x20: //Jump to Subroutine
+    case 0x22: //Jump to Subroutine Long
+        return ControlFlow::CALL;
+    case 0xFC: //Jump to Subroutine Indexed Indirect
+        return ControlFlow::INDIRECT_CALL;
+    case 0x40: //Return from Interrupt
+    case 0x60: //Return from Subroutine
+    case 0x6B: //Return from Subroutine Long
+        return ControlFlow::RETURN;
+    case 0x00: //Break
+    case 0x02: //Coprocessor
+        return ControlFlow::INTERRUPT;
+    case 0xDB: //Stop the Processor
+        return ControlFlow::HALT;
     default:
-        return false;
+        return ControlFlow::SEQUENTIAL;
     }
 }
 
+bool Instruction::isJump() const {
+    return controlFlow() != ControlFlow::SEQUENTIAL;
+}
+
 std::string toHexStr(uint8_t s) {
     std::stringstream ss;
     ss << std::hex << int(s);
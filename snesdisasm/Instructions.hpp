@@ -18,10 +18,91 @@
 #define INSTRUCTIONS_H
 
 #include "MachineState.hpp"
+#include "InstructionTables.hpp"
+#include "Instrumentation.hpp"
+#include "ROMAddress.hpp"
 
 #include <cstdint>
 #include <string>
 
+//http://wiki.superfamicom.org/snes/show/Jay's+ASM+Tutorial
+enum AddressingMode : unsigned char {
+    //der wert des parameters sei v
+    //konkatenierung von daten sei :
+    //      a : b, wenn a und b bytes sind ist demnach: (a << 8) | b
+    //      a +: b, bedeutet, dass b an a konkateniert wird, aber a (temp) um 1 erhöht, wenn b überläuft. demnach: (a << 8) + b
+    //      [s] sei der wert der, in der zelle mit adresse s steht
+    //      flag(x) ist das flag x
+    //      das ergebnis jeder gleichung ist eine adresse. eine ausnahme bildet IMMEDIATE, welches ein wert ist
+    //      RX, RY, SR = RegisterX, RegisterY, StackRegister
+    //      RX(H), RX(L) = Register X Hight, Register X Low
+    //
+    IMMEDIATE,               //               v        v ist 1 oder 2 byte, je nach operation
+    //                                                 operationen mit 2 byte haben einen anderen opCode als solche mit
+    //                                                 einem byte. vielleicht sollte man IMMEDIATE deshalb auftrennen
+    ABSOLUTE,                // DBR :     v            v ist 2 byte. DRB ist das data bank register
+    DIRECT,  //Zero page     //  00 : (DPR + v)        v ist 1 byte. DPR(H) ist 00 im emulationsmodus
+    //                                                 soll wirklich byte 0000:v adressiert werden, muss !v stehen
+    ABSOLUTE_INDEXED_WITH_X, //  RX + (DBR : v)        v ist 2 byte, RX ist je nach flag(x) 1 oder 2 byte
+    ABSOLUTE_INDEXED_WITH_Y, //  RY + (DBR : v)        ist v < 100, muss es !v sein
+    ABSOLUTE_LONG,           //           v            v ist volle 3 byte
+    DIRECT_INDEXED_WITH_X,   //  00 : (DPR + v + RX)   immer in bank 0. im 6502 emulation mode,
+    DIRECT_INDEXED_WITH_Y,   //  00 : (DPR + v + RY)   ist es auch immer in page DPR. sonst springt es auf die nächste
+    ACCUMULATOR,             //       A                es wird direkt im akkumulator gearbeitet
+    IMPLIED,                 //                        vom opCode bestimmt
+    STACK,                   //       SR               die adresse liegt in SR
+    DIRECT_INDIRECT,         // DBR : s=[00 : DPR + v] v ist 1 byte. s sind 2 byte: (low : high)
+
+
+
+
+    //IMMEDIATE_MEMORY_FLAG,           //
+    //IMMEDIATE_INDEX_FLAG,            //
+    //IMMEDIATE_8_BIT,                 //
+    RELATIVE,                        //
+    RELATIVE_LONG,                   //
+    DIRECT_INDEXED_INDIRECT,         //registerDBR : (DataAt(value+registerD+registerX))
+    DIRECT_INDIRECT_INDEXED,         //registerDBR : DataAt(??(maybe RAM?) : registerD+value) + registerY
+    DIRECT_INDIRECT_LONG,            //long3Bytes(DataAt((value+registerD))
+    DIRECT_INDIRECT_INDEXED_LONG,    //DataAt(long3Bytes(registerD + value)) + registerY
+    ABSOLUTE_INDEXED_LONG,           //long3Bytes(value+registerX)
+    STACK_RELATIVE,                  //value + stackValue
+    STACK_RELATIVE_INDIRECT_INDEXED, //registerDBR : (value+stackValue+registerY)
+    ABSOLUTE_INDIRECT,               //??(maybe RAM?) : DataAt(??(maybe DBR?) : value)
+    ABSOLUTE_INDIRECT_LONG,          //
+    ABSOLUTE_INDEXED_INDIRECT,       //     ??     : DataAt(value + registerX)
+    IMPLIED_ACCUMULATOR,             //
+    BLOCK_MOVE,                      //move #registerA bytes from value1:registerY to value2:registerX
+
+
+
+    ABSOLUTE_INDEXED_LONG_WITH_X,
+    PROGRAMMCOUNTER_RELATIVE,
+    PROGRAMMCOUNTER_RELATIVE_LONG,
+    STACK_INTERRUPT,
+    RESERVED,
+    DIRECT_INDIRECT_INDEXED_WITH_Y,
+    DIRECT_INDIRECT_LONG_INDEXED_WITH_Y
+};
+
+/*! \brief Returns the name of an addressing mode as it is written in the enum, e.g. "DIRECT_INDEXED_WITH_X"
+ */
+const char *addressingModeName(AddressingMode mode);
+
+/*! \brief Describes how an instruction influences the program counter.
+ */
+enum class ControlFlow : unsigned char {
+    SEQUENTIAL,       //the next instruction follows in memory
+    BRANCH,           //conditional relative branch, continues at the target or the next instruction
+    JUMP,             //unconditional jump to an operand encoded target
+    INDIRECT_JUMP,    //unconditional jump to a target read from memory
+    CALL,             //subroutine call to an operand encoded target, returns to the next instruction
+    INDIRECT_CALL,    //subroutine call to a target read from memory
+    RETURN,           //RTS, RTL and RTI
+    INTERRUPT,        //BRK and COP, continue at a vector
+    HALT              //STP, the processor stops
+};
+
 /*! \brief A fetched instruction
  *
  *  This class contains a fetched instruction including its arguments.
@@ -49,10 +130,28 @@ class Instruction {
     uint8_t m_OpCode;
     Argument_t m_Argument;
     uint8_t m_Size;
+    LongAddress m_Address;
+    LongAddress m_Target;
+
+    enum : LongAddress { NoTarget = 0xFFFFFFFF };
+
+    Instruction(const uint8_t *data, uint8_t size, LongAddress address);
   public:
     /*! \brief Fetches a instruction from the bytes pointed at by data. It uses the given \see CPUState.
+     *
+     *  address is the CPU address of the instruction, its control flow target is resolved from it.
+     */
+    Instruction(const MachineState &state, const uint8_t *data, LongAddress address);
+
+    /*! \brief Fetches an instruction with the register sizes fixed at compile time
+     *
+     *  Memory8 and Index8 correspond to set MEMORY_SELECT and INDEX_SELECT flags. Use \see decodeSequence to
+     *  decode many instructions, it picks the instantiation once for each run of equal register sizes.
      */
-    explicit Instruction(const MachineState &state, const uint8_t *data);
+    template<bool Memory8, bool Index8>
+    static Instruction decode(const uint8_t *data, LongAddress address) {
+        return Instruction(data, InstructionSizes<Memory8, Index8>::sizes[data[0]], address);
+    }
 
     /*! \brief Returns the size of the Instruction in bytes. This includes the arguments.
      *
@@ -60,10 +159,53 @@ class Instruction {
      */
     uint8_t size() const;
 
+    /*! \brief Returns the opcode i.e. the first byte of the instruction.
+     */
+    uint8_t opCode() const { return m_OpCode; }
+
+    /*! \brief Returns the three letter mnemonic of the instruction.
+     */
+    const char *mnemonic() const;
+
+    /*! \brief Returns the addressing mode of the opcode.
+     */
+    AddressingMode addressingMode() const;
+
+    /*! \brief Returns the argument bytes as a little-endian decoded value.
+     *
+     *  Instructions without argument return 0. The result has (size() - 1) * 8 significant bits.
+     */
+    uint32_t operand() const;
+
+    /*! \brief Returns the CPU address the instruction was decoded at
+     */
+    LongAddress address() const { return m_Address; }
+
+    /*! \brief Returns the address of the following instruction. The program counter wraps within its bank.
+     */
+    LongAddress nextAddress() const { return (m_Address & 0xFF0000) | ((m_Address + m_Size) & 0xFFFF); }
+
+    /*! \brief Returns true if the operand is an address in the program flow, see \see target
+     */
+    bool hasTarget() const { return m_Target != NoTarget; }
+
+    /*! \brief Returns the 24 bit address the operand refers to in the program flow
+     *
+     *  This is the target of branches, of BRL and PER, which are relative to \see nextAddress and wrap within the
+     *  program bank, of absolute JMP and JSR, which stay in the program bank, and of JML and JSL. Only valid if
+     *  \see hasTarget. Indirect jumps have no target.
+     */
+    LongAddress target() const { return m_Target; }
+
+    /*! \brief Returns how the instruction influences the program counter.
+     */
+    ControlFlow controlFlow() const;
+
     /*! \brief Returns true if the instruction is a jump i.e. if the next instruction to
      *         execute may not be the next instruction in ROM memory.
      *
-     *  This includes (unconditional) jumps, calls, returns and branches.
+     *  This includes (unconditional) jumps, calls, returns, branches, BRK, COP and STP, i.e. every instruction
+     *  whose \see controlFlow is not SEQUENTIAL.
      */
     bool isJump() const;
 
@@ -75,4 +217,107 @@ class Instruction {
     std::string stringify() const;
 };
 
+inline Instruction::Instruction(const uint8_t *data, uint8_t size, LongAddress address)
+    : m_OpCode(data[0]),
+      m_Size(size),
+      m_Address(address),
+      m_Target(NoTarget) {
+    switch(m_Size) {
+    case 4:
+        m_Argument.at3 = data[3];
+    //fall through
+    case 3:
+        m_Argument.at2 = data[2];
+    //fall through
+    case 2:
+        m_Argument.at1 = data[1];
+    }
+
+    //most instructions have no target, so this is the only branch taken for them
+    const uint8_t kind = InstructionTargetKinds::kinds[m_OpCode];
+    if(kind != NO_TARGET) {
+        const LongAddress bank = address & 0xFF0000;
+        const uint16_t operand = m_Argument.at1 | (m_Argument.at2 << 8);
+        switch(kind) {
+        case RELATIVE_TARGET:
+            m_Target = bank | ((nextAddress() + static_cast<int8_t>(m_Argument.at1)) & 0xFFFF);
+            break;
+        case RELATIVE_LONG_TARGET:
+            m_Target = bank | ((nextAddress() + static_cast<int16_t>(operand)) & 0xFFFF);
+            break;
+        case BANK_TARGET:
+            m_Target = bank | operand;
+            break;
+        default:
+            m_Target = operand | (m_Argument.at3 << 16);
+            break;
+        }
+    }
+}
+
+//decodes instructions until the register sizes change or the visitor stops. Returns false if it stopped.
+//Adds the number of instructions and bytes decoded to the counters.
+template<bool Memory8, bool Index8, class Visitor>
+bool decodeRun(MachineState &state, Visitor &visitor, uint64_t &instructions, uint64_t &bytes) {
+    const uint8_t sizes = state.getCPUStateRef().FlagRegister() & (MEMORY_SELECT | INDEX_SELECT);
+    for(;;) {
+        LongAddress address;
+        const uint8_t *data = visitor.fetch(address);
+        if(data == nullptr) {
+            return false;
+        }
+
+        const Instruction instruction = Instruction::decode<Memory8, Index8>(data, address);
+        ++instructions;
+        bytes += instruction.size();
+        const bool next = visitor.accept(instruction, static_cast<const MachineState &>(state));
+
+        //only REP and SEP change the register sizes
+        if(instruction.opCode() == 0xC2 || instruction.opCode() == 0xE2) {
+            state.update(instruction);
+            if((state.getCPUStateRef().FlagRegister() & (MEMORY_SELECT | INDEX_SELECT)) != sizes) {
+                return next;
+            }
+        }
+        if(!next) {
+            return false;
+        }
+    }
+}
+
+/*! \brief Decodes consecutive instructions until the visitor stops
+ *
+ *  The visitor has two methods: fetch(address) returns the bytes of the next instruction (at least its size, up to
+ *  4 are read) and sets address to its CPU address, or returns nullptr to stop. accept(instruction, state) receives the instruction decoded from them together with
+ *  the state it was decoded with, and returns false to stop. state is updated with every instruction.
+ *
+ *  The register sizes only change at REP and SEP, so the decoder specialised by \see Instruction::decode is
+ *  chosen once per run of instructions with equal register sizes instead of once per instruction.
+ */
+template<class Visitor>
+void decodeSequence(MachineState &state, Visitor &visitor) {
+    //counted once per sequence, so the counters stay out of the loop
+    uint64_t instructions = 0;
+    uint64_t bytes = 0;
+    bool running = true;
+    while(running) {
+        switch(state.getCPUStateRef().FlagRegister() & (MEMORY_SELECT | INDEX_SELECT)) {
+        case 0:
+            running = decodeRun<false, false>(state, visitor, instructions, bytes);
+            break;
+        case INDEX_SELECT:
+            running = decodeRun<false, true>(state, visitor, instructions, bytes);
+            break;
+        case MEMORY_SELECT:
+            running = decodeRun<true, false>(state, visitor, instructions, bytes);
+            break;
+        default:
+            running = decodeRun<true, true>(state, visitor, instructions, bytes);
+            break;
+        }
+    }
+    INSTRUMENT_COUNT(INSTRUCTIONS_DECODED, instructions);
+    INSTRUMENT_COUNT(BYTES_VISITED, bytes);
+}
+
 #endif // INSTRUCTIONS_H
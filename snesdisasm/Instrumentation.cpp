@@ -0,0 +1,191 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const char *phaseNames[Instrumentation::PhaseCount] = {
+    "load", "header_detection", "decode", "analysis", "formatting", "output"
+};
+
+const char *counterNames[Instrumentation::CounterCount] = {
+    "instructions_decoded", "bytes_visited", "instructions_executed", "cache_hits", "cache_misses",
+    "worklist_pushes"
+};
+
+/*! \brief The global state. The counters of each thread only grow; reset() moves the baseline instead.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<Instrumentation::ThreadCounters *> threads;
+    unsigned int threadsSeen;
+    uint64_t retired[Instrumentation::CounterCount];
+    uint64_t baseline[Instrumentation::CounterCount];
+
+    std::atomic<uint64_t> wallNanoseconds[Instrumentation::PhaseCount];
+    std::atomic<uint64_t> cpuNanoseconds[Instrumentation::PhaseCount];
+    std::atomic<uint64_t> calls[Instrumentation::PhaseCount];
+
+    Registry() : threadsSeen(0) {
+        std::fill(retired, retired + Instrumentation::CounterCount, 0);
+        std::fill(baseline, baseline + Instrumentation::CounterCount, 0);
+        for(unsigned int i = 0; i < Instrumentation::PhaseCount; ++i) {
+            wallNanoseconds[i] = cpuNanoseconds[i] = calls[i] = 0;
+        }
+    }
+
+    /*! \brief Sums up the counters of all threads. The mutex has to be locked.
+     */
+    void total(uint64_t *values) const {
+        for(unsigned int i = 0; i < Instrumentation::CounterCount; ++i) {
+            values[i] = retired[i];
+            for(const Instrumentation::ThreadCounters *thread : threads) {
+                values[i] += thread->values[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+Registry &registry() {
+    //never destroyed, since threads may still exit after static destruction began
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+}
+
+thread_local Instrumentation::ThreadCounters *Instrumentation::s_ThreadCounters = nullptr;
+
+/*! \brief Owns the counters of a thread and hands them over to the registry when the thread exits
+ */
+struct Instrumentation::ThreadSlot {
+    ThreadCounters counters;
+
+    ThreadSlot() {
+        for(unsigned int i = 0; i < CounterCount; ++i) {
+            counters.values[i].store(0, std::memory_order_relaxed);
+        }
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(&counters);
+        ++r.threadsSeen;
+    }
+
+    ~ThreadSlot() {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for(unsigned int i = 0; i < CounterCount; ++i) {
+            r.retired[i] += counters.values[i].load(std::memory_order_relaxed);
+        }
+        r.threads.erase(std::find(r.threads.begin(), r.threads.end(), &counters));
+        s_ThreadCounters = nullptr;
+    }
+};
+
+Instrumentation::ThreadCounters *Instrumentation::registerThread() {
+    static thread_local ThreadSlot slot;
+    s_ThreadCounters = &slot.counters;
+    return s_ThreadCounters;
+}
+
+Instrumentation::ScopedPhase::ScopedPhase(Phase phase)
+    : m_Phase(phase),
+      m_WallStart(std::chrono::steady_clock::now()),
+      m_CPUStart(std::clock()) {
+}
+
+Instrumentation::ScopedPhase::~ScopedPhase() {
+    const std::chrono::nanoseconds wall = std::chrono::steady_clock::now() - m_WallStart;
+    const std::clock_t cpu = std::clock() - m_CPUStart;
+    addPhase(m_Phase, wall.count(), static_cast<uint64_t>(cpu) * (1000000000 / CLOCKS_PER_SEC));
+    if(Trace::enabled()) {
+        const uint64_t end = Trace::now();
+        Trace::record(name(m_Phase), end - std::min<uint64_t>(end, wall.count()), wall.count());
+    }
+}
+
+void Instrumentation::addPhase(Phase phase, uint64_t wallNanoseconds, uint64_t cpuNanoseconds) {
+    Registry &r = registry();
+    const unsigned int index = static_cast<unsigned int>(phase);
+    r.wallNanoseconds[index].fetch_add(wallNanoseconds, std::memory_order_relaxed);
+    r.cpuNanoseconds[index].fetch_add(cpuNanoseconds, std::memory_order_relaxed);
+    r.calls[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+Instrumentation::Snapshot Instrumentation::snapshot() {
+    Registry &r = registry();
+    Snapshot result;
+
+    for(unsigned int i = 0; i < PhaseCount; ++i) {
+        result.phases[i].wallNanoseconds = r.wallNanoseconds[i].load(std::memory_order_relaxed);
+        result.phases[i].cpuNanoseconds = r.cpuNanoseconds[i].load(std::memory_order_relaxed);
+        result.phases[i].calls = r.calls[i].load(std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.total(result.counters);
+    for(unsigned int i = 0; i < CounterCount; ++i) {
+        result.counters[i] -= r.baseline[i];
+    }
+    result.threads = r.threadsSeen;
+
+    return result;
+}
+
+void Instrumentation::reset() {
+    Registry &r = registry();
+
+    for(unsigned int i = 0; i < PhaseCount; ++i) {
+        r.wallNanoseconds[i].store(0, std::memory_order_relaxed);
+        r.cpuNanoseconds[i].store(0, std::memory_order_relaxed);
+        r.calls[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.total(r.baseline);
+}
+
+const char *Instrumentation::name(Phase phase) {
+    return phaseNames[static_cast<unsigned int>(phase)];
+}
+
+const char *Instrumentation::name(Counter counter) {
+    return counterNames[static_cast<unsigned int>(counter)];
+}
+
+std::string Instrumentation::Snapshot::toJSON() const {
+    std::ostringstream json;
+    json << "{\"phases\":{";
+    for(unsigned int i = 0; i < PhaseCount; ++i) {
+        json << (i != 0 ? "," : "") << "\"" << phaseNames[i] << "\":{"
+             << "\"wall_ns\":" << phases[i].wallNanoseconds << ","
+             << "\"cpu_ns\":" << phases[i].cpuNanoseconds << ","
+             << "\"calls\":" << phases[i].calls << "}";
+    }
+    json << "},\"counters\":{";
+    for(unsigned int i = 0; i < CounterCount; ++i) {
+        json << (i != 0 ? "," : "") << "\"" << counterNames[i] << "\":" << counters[i];
+    }
+    json << "},\"threads\":" << threads << "}";
+    return json.str();
+}
@@ -0,0 +1,149 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+/*! \brief Phase timers and hot path counters of the library
+ *
+ *  Counters are kept per thread in relaxed atomics, so incrementing one never contends with other threads.
+ *  \see snapshot sums them up over all threads, including threads which already exited.
+ *
+ *  The library uses the INSTRUMENT_PHASE and INSTRUMENT_COUNT macros only. Configuring with
+ *  -DSNESDISASM_INSTRUMENTATION=OFF turns them into no-ops, so the snapshot stays empty. While a \see Trace is
+ *  recorded, every phase is recorded as an event as well.
+ */
+class Instrumentation {
+  public:
+    enum class Phase : unsigned char {
+        LOAD,
+        HEADER_DETECTION,
+        DECODE,
+        ANALYSIS,
+        FORMATTING,
+        OUTPUT
+    };
+
+    enum class Counter : unsigned char {
+        INSTRUCTIONS_DECODED, //by decodeSequence and Disasm, not when analysed instructions are decoded again
+        BYTES_VISITED,
+        INSTRUCTIONS_EXECUTED,
+        CACHE_HITS,
+        CACHE_MISSES,
+        WORKLIST_PUSHES
+    };
+
+    enum { PhaseCount = 6, CounterCount = 6 };
+
+    struct PhaseTiming {
+        uint64_t wallNanoseconds;
+        /*! \brief The CPU time of the whole process. It exceeds the wall time if a phase uses several threads.
+         */
+        uint64_t cpuNanoseconds;
+        uint64_t calls;
+    };
+
+    /*! \brief The state of all timers and counters at one point in time
+     */
+    struct Snapshot {
+        PhaseTiming phases[PhaseCount];
+        uint64_t counters[CounterCount];
+        /*! \brief The number of threads that incremented a counter so far
+         */
+        unsigned int threads;
+
+        const PhaseTiming &phase(Phase phase) const { return phases[static_cast<unsigned int>(phase)]; }
+        uint64_t counter(Counter counter) const { return counters[static_cast<unsigned int>(counter)]; }
+
+        /*! \brief Returns the snapshot as a JSON object
+         */
+        std::string toJSON() const;
+    };
+
+    /*! \brief Measures the time from its construction to its destruction as part of a phase
+     */
+    class ScopedPhase {
+      private:
+        Phase m_Phase;
+        std::chrono::steady_clock::time_point m_WallStart;
+        std::clock_t m_CPUStart;
+      public:
+        explicit ScopedPhase(Phase phase);
+        ~ScopedPhase();
+
+        ScopedPhase(const ScopedPhase &) = delete;
+        ScopedPhase &operator=(const ScopedPhase &) = delete;
+    };
+
+    /*! \brief The counters of one thread. Only the owning thread writes them.
+     */
+    struct ThreadCounters {
+        std::atomic<uint64_t> values[CounterCount];
+    };
+  private:
+    struct ThreadSlot;
+    static thread_local ThreadCounters *s_ThreadCounters;
+
+    static ThreadCounters *registerThread();
+  public:
+    /*! \brief Adds value to a counter of the calling thread
+     */
+    static void add(Counter counter, uint64_t value) {
+        ThreadCounters *counters = s_ThreadCounters;
+        if(counters == nullptr) {
+            counters = registerThread();
+        }
+        //there is a single writer, so a relaxed load and store suffice instead of a locked add
+        std::atomic<uint64_t> &slot = counters->values[static_cast<unsigned int>(counter)];
+        slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /*! \brief Adds a measured interval to a phase
+     */
+    static void addPhase(Phase phase, uint64_t wallNanoseconds, uint64_t cpuNanoseconds);
+
+    /*! \brief Returns the current values of all timers and counters
+     */
+    static Snapshot snapshot();
+
+    /*! \brief Sets all timers and counters to zero
+     */
+    static void reset();
+
+    static const char *name(Phase phase);
+    static const char *name(Counter counter);
+};
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+
+#ifdef SNESDISASM_INSTRUMENTATION
+//times the rest of the enclosing scope as the given phase
+#define INSTRUMENT_PHASE(phase) \
+    Instrumentation::ScopedPhase INSTRUMENT_CONCAT(instrumentationPhase, __LINE__)(Instrumentation::Phase::phase)
+#define INSTRUMENT_COUNT(counter, value) Instrumentation::add(Instrumentation::Counter::counter, (value))
+#else
+#define INSTRUMENT_PHASE(phase) do {} while(false)
+#define INSTRUMENT_COUNT(counter, value) do {} while(false)
+#endif
+
+#endif // INSTRUMENTATION_HPP
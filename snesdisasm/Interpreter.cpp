@@ -0,0 +1,1151 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Interpreter.hpp"
+#include "Instrumentation.hpp"
+
+#include <cstring>
+
+namespace {
+
+//native and emulation mode vectors in bank 0
+const uint16_t NATIVE_COP = 0xFFE4;
+const uint16_t NATIVE_BRK = 0xFFE6;
+const uint16_t NATIVE_NMI = 0xFFEA;
+const uint16_t NATIVE_IRQ = 0xFFEE;
+const uint16_t EMULATION_COP = 0xFFF4;
+const uint16_t EMULATION_NMI = 0xFFFA;
+const uint16_t EMULATION_RESET = 0xFFFC;
+const uint16_t EMULATION_IRQ = 0xFFFE;
+
+const std::size_t WRAMSize = 0x20000;
+const std::size_t SRAMSize = 0x20000;
+
+}
+
+Interpreter::Interpreter(const SNESROM &rom)
+    : m_ROM(rom),
+      m_WRAM(WRAMSize, 0),
+      m_SRAM(SRAMSize, 0),
+      m_Steps(0),
+      m_InstructionsPerFrame(20000),
+      m_Coverage(PageCount) {
+
+    //ROM
+    for(std::size_t page = 0; page < PageCount; ++page) {
+        m_ReadPages[page] = m_ROM.data(page << PageShift, PageSize);
+        m_WritePages[page] = nullptr;
+    }
+
+    //the first 8 KB of WRAM are mirrored into the system area of every bank
+    for(unsigned int bank = 0; bank < 0x100; ++bank) {
+        if((bank & 0x40) == 0) {
+            const std::size_t page = (bank << 16) >> PageShift;
+            m_ReadPages[page] = m_WritePages[page] = &m_WRAM[0];
+        }
+    }
+    for(std::size_t i = 0; i < WRAMSize / PageSize; ++i) {
+        const std::size_t page = (0x7E0000 >> PageShift) + i;
+        m_ReadPages[page] = m_WritePages[page] = &m_WRAM[i * PageSize];
+    }
+
+    //SRAM
+    if(m_ROM.layout() == RomLayout::HiROM() || m_ROM.layout() == RomLayout::ExHiROM()) {
+        for(unsigned int bank = 0x20; bank < 0xC0; ++bank) {
+            if((bank & 0x7F) >= 0x20 && (bank & 0x7F) < 0x40) {
+                const std::size_t page = ((bank << 16) | 0x6000) >> PageShift;
+                m_ReadPages[page] = m_WritePages[page] = &m_SRAM[((bank & 0x1F) * PageSize) % SRAMSize];
+            }
+        }
+    } else {
+        for(unsigned int bank = 0x70; bank < 0x100; ++bank) {
+            if((bank >= 0x70 && bank < 0x7E) || bank >= 0xF0) {
+                for(unsigned int i = 0; i < 0x8000 / PageSize; ++i) {
+                    const std::size_t page = (bank << 16 >> PageShift) + i;
+                    m_ReadPages[page] = m_WritePages[page] = &m_SRAM[(((bank & 0x0F) * 4 + i) * PageSize) % SRAMSize];
+                }
+            }
+        }
+    }
+
+    reset();
+}
+
+void Interpreter::reset() {
+    m_A = m_X = m_Y = 0;
+    m_S = 0x01FF;
+    m_D = 0;
+    m_DBR = m_PB = 0;
+    m_P = MEMORY_SELECT | INDEX_SELECT | IRQ;
+    m_E = true;
+    m_PC = read16(EMULATION_RESET);
+
+    m_APUPorts[0] = 0xAA; //the SPC700 IPL ROM signals that it is ready
+    m_APUPorts[1] = 0xBB;
+    m_APUPorts[2] = m_APUPorts[3] = 0;
+    m_WRAMPort = 0;
+    m_NMITIMEN = 0;
+    m_NMIFlag = m_IRQFlag = false;
+    m_MultiplicandA = 0xFF;
+    m_Dividend = 0xFFFF;
+    m_MathResult = m_Quotient = 0;
+    std::memset(m_DMARegisters, 0xFF, sizeof(m_DMARegisters));
+
+    m_NextFrame = m_Steps + m_InstructionsPerFrame;
+    m_NextEventIsIRQ = false;
+    m_Halted = false;
+}
+
+void Interpreter::start(LongAddress address, const MachineState &state) {
+    m_E = false;
+    m_S = 0x1FFF;
+    m_D = 0;
+    m_PB = m_DBR = address >> 16;
+    m_PC = address & 0xFFFF;
+    setP(state.getCPUStateRef().FlagRegister());
+    m_Halted = false;
+}
+
+void Interpreter::setInstructionsPerFrame(uint64_t instructions) {
+    m_InstructionsPerFrame = instructions;
+    m_NextFrame = m_Steps + instructions;
+    m_NextEventIsIRQ = false;
+}
+
+CPUState Interpreter::cpuState() const {
+    CPUState state;
+    state.setAccumulator(m_A, true);
+    state.setIndexX(m_X, true);
+    state.setIndexY(m_Y, true);
+    state.setDataBank(m_DBR);
+    state.setDirectPage(m_D);
+    state.setProgramBank(m_PB);
+    state.setProgramCounter(m_PC);
+    state.setFlagRegister(m_P);
+    return state;
+}
+
+void Interpreter::addEntryPointsTo(ControlFlowGraph &graph) const {
+    for(const IndirectTarget &indirect : m_IndirectTargets) {
+        if(m_ROM.data(indirect.target) != nullptr) {
+            graph.addEntryPoint(indirect.target, indirect.flags);
+        }
+    }
+}
+
+Interpreter::StopReason Interpreter::run(uint64_t maxSteps) {
+    INSTRUMENT_PHASE(ANALYSIS);
+    const uint64_t end = m_Steps + maxSteps;
+    StopReason reason = StopReason::STEP_LIMIT;
+
+    while(m_Steps < end) {
+        if(m_Steps >= m_NextFrame) {
+            frameEvent();
+        }
+
+        m_InstructionAddress = (m_PB << 16) | m_PC;
+        const std::size_t page = m_InstructionAddress >> PageShift;
+        const std::size_t offset = m_InstructionAddress & (PageSize - 1);
+        if(m_ReadPages[page] == nullptr) {
+            reason = StopReason::INVALID_ADDRESS;
+            break;
+        }
+        if(!m_Coverage[page]) {
+            m_Coverage[page].reset(new uint8_t[PageSize]());
+        }
+        m_Coverage[page][offset] |= 1 << ((m8() << 1) | x8());
+
+        const uint8_t opCode = m_ReadPages[page][offset];
+        ++m_PC;
+        (this->*s_Handlers[opCode])();
+        ++m_Steps;
+
+        if(m_Halted) {
+            reason = StopReason::HALTED;
+            break;
+        }
+    }
+
+    INSTRUMENT_COUNT(INSTRUCTIONS_EXECUTED, m_Steps - (end - maxSteps));
+    return reason;
+}
+
+void Interpreter::frameEvent() {
+    if(!m_NextEventIsIRQ) {
+        //start of the vertical blank
+        m_NMIFlag = true;
+        if(m_NMITIMEN & 0x80) {
+            interrupt(NATIVE_NMI, EMULATION_NMI);
+        }
+    } else if(m_NMITIMEN & 0x30) {
+        //H/V timer
+        m_IRQFlag = true;
+        if(!(m_P & IRQ)) {
+            interrupt(NATIVE_IRQ, EMULATION_IRQ);
+        }
+    }
+
+    m_NextEventIsIRQ = !m_NextEventIsIRQ;
+    m_NextFrame += m_InstructionsPerFrame / 2;
+}
+
+void Interpreter::interrupt(uint16_t nativeVector, uint16_t emulationVector) {
+    if(!m_E) {
+        push8(m_PB);
+    }
+    push16(m_PC);
+    push8(m_P);
+    m_P = (m_P | IRQ) & ~DECIMAL;
+    m_PB = 0;
+    m_PC = read16(m_E ? emulationVector : nativeVector);
+}
+
+void Interpreter::recordIndirect(LongAddress target) {
+    IndirectTarget indirect = {m_InstructionAddress, target, m_P};
+    m_IndirectTargets.insert(indirect);
+}
+
+void Interpreter::write16(LongAddress address, uint16_t value) {
+    write8(address, value);
+    write8((address + 1) & 0xFFFFFF, value >> 8);
+}
+
+uint16_t Interpreter::fetch16() {
+    const uint16_t value = read16((m_PB << 16) | m_PC);
+    m_PC += 2;
+    return value;
+}
+
+LongAddress Interpreter::fetch24() {
+    const LongAddress value = read24((m_PB << 16) | m_PC);
+    m_PC += 3;
+    return value;
+}
+
+uint8_t Interpreter::readIO(LongAddress address) {
+    if((address >> 16) & 0x40) {
+        return 0; //open bus
+    }
+
+    const uint16_t reg = address & 0xFFFF;
+    if(reg >= 0x2140 && reg < 0x2180) {
+        return m_APUPorts[reg & 0x03];
+    }
+    if(reg >= 0x4300 && reg < 0x4380) {
+        return m_DMARegisters[(reg >> 4) & 0x07][reg & 0x0F];
+    }
+
+    switch(reg) {
+    case 0x2180: {
+        const uint8_t value = m_WRAM[m_WRAMPort];
+        m_WRAMPort = (m_WRAMPort + 1) & (WRAMSize - 1);
+        return value;
+    }
+    case 0x4210: { //RDNMI
+        const uint8_t value = (m_NMIFlag ? 0x80 : 0x00) | 0x02;
+        m_NMIFlag = false;
+        return value;
+    }
+    case 0x4211: { //TIMEUP
+        const uint8_t value = m_IRQFlag ? 0x80 : 0x00;
+        m_IRQFlag = false;
+        return value;
+    }
+    case 0x4212: { //HVBJOY, the last eighth of a frame is the vertical blank
+        const uint64_t position = (m_InstructionsPerFrame - (m_NextFrame - m_Steps)) % m_InstructionsPerFrame;
+        const bool vblank = !m_NextEventIsIRQ && position >= m_InstructionsPerFrame * 7 / 8;
+        return (vblank ? 0x80 : 0x00) | ((m_Steps & 1) << 6);
+    }
+    case 0x4214:
+        return m_Quotient;
+    case 0x4215:
+        return m_Quotient >> 8;
+    case 0x4216:
+        return m_MathResult;
+    case 0x4217:
+        return m_MathResult >> 8;
+    default:
+        return 0;
+    }
+}
+
+void Interpreter::writeIO(LongAddress address, uint8_t value) {
+    if((address >> 16) & 0x40) {
+        return;
+    }
+
+    const uint16_t reg = address & 0xFFFF;
+    if(reg >= 0x2140 && reg < 0x2180) {
+        m_APUPorts[reg & 0x03] = value; //there is no sound CPU. It just echoes
+        return;
+    }
+    if(reg >= 0x4300 && reg < 0x4380) {
+        m_DMARegisters[(reg >> 4) & 0x07][reg & 0x0F] = value;
+        return;
+    }
+
+    switch(reg) {
+    case 0x2180:
+        m_WRAM[m_WRAMPort] = value;
+        m_WRAMPort = (m_WRAMPort + 1) & (WRAMSize - 1);
+        break;
+    case 0x2181:
+        m_WRAMPort = (m_WRAMPort & 0x1FF00) | value;
+        break;
+    case 0x2182:
+        m_WRAMPort = (m_WRAMPort & 0x100FF) | (value << 8);
+        break;
+    case 0x2183:
+        m_WRAMPort = (m_WRAMPort & 0x0FFFF) | ((value & 0x01) << 16);
+        break;
+    case 0x4200:
+        m_NMITIMEN = value;
+        break;
+    case 0x4202:
+        m_MultiplicandA = value;
+        break;
+    case 0x4203:
+        m_MathResult = m_MultiplicandA * value;
+        break;
+    case 0x4204:
+        m_Dividend = (m_Dividend & 0xFF00) | value;
+        break;
+    case 0x4205:
+        m_Dividend = (m_Dividend & 0x00FF) | (value << 8);
+        break;
+    case 0x4206:
+        m_Quotient = value != 0 ? m_Dividend / value : 0xFFFF;
+        m_MathResult = value != 0 ? m_Dividend % value : m_Dividend;
+        break;
+    case 0x420B:
+        startDMA(value);
+        break;
+    }
+}
+
+void Interpreter::startDMA(uint8_t channels) {
+    for(unsigned int channel = 0; channel < 8; ++channel) {
+        if(!(channels & (1 << channel))) {
+            continue;
+        }
+
+        uint8_t *reg = m_DMARegisters[channel];
+        const bool toARegister = reg[0] & 0x80;
+        const bool fixed = reg[0] & 0x08;
+        const int step = fixed ? 0 : ((reg[0] & 0x10) ? -1 : 1);
+        uint16_t aAddress = reg[2] | (reg[3] << 8);
+        const uint8_t aBank = reg[4];
+        uint32_t count = reg[5] | (reg[6] << 8);
+        if(count == 0) {
+            count = 0x10000;
+        }
+
+        //only transfers through the WRAM port matter for executed code. All others just finish.
+        for(uint32_t i = 0; i < count; ++i) {
+            if(reg[1] == 0x80) {
+                const LongAddress a = (aBank << 16) | aAddress;
+                if(toARegister) {
+                    write8(a, readIO(0x002180));
+                } else {
+                    writeIO(0x002180, read8(a));
+                }
+            }
+            aAddress += step;
+        }
+
+        reg[2] = aAddress;
+        reg[3] = aAddress >> 8;
+        reg[5] = reg[6] = 0;
+    }
+}
+
+void Interpreter::push8(uint8_t value) {
+    write8(m_S, value);
+    m_S = m_E ? (0x0100 | ((m_S - 1) & 0xFF)) : m_S - 1;
+}
+
+void Interpreter::push16(uint16_t value) {
+    push8(value >> 8);
+    push8(value);
+}
+
+uint8_t Interpreter::pull8() {
+    m_S = m_E ? (0x0100 | ((m_S + 1) & 0xFF)) : m_S + 1;
+    return read8(m_S);
+}
+
+uint16_t Interpreter::pull16() {
+    const uint8_t low = pull8();
+    return (pull8() << 8) | low;
+}
+
+void Interpreter::setNZ(uint16_t value, bool is8Bit) {
+    if(is8Bit) {
+        setFlag(ZERO, (value & 0xFF) == 0);
+        setFlag(NEGATIVE, value & 0x80);
+    } else {
+        setFlag(ZERO, value == 0);
+        setFlag(NEGATIVE, value & 0x8000);
+    }
+}
+
+void Interpreter::setA(uint16_t value) {
+    m_A = m8() ? ((m_A & 0xFF00) | (value & 0xFF)) : value;
+    setNZ(value, m8());
+}
+
+void Interpreter::setX(uint16_t value) {
+    m_X = x8() ? (value & 0xFF) : value;
+    setNZ(value, x8());
+}
+
+void Interpreter::setY(uint16_t value) {
+    m_Y = x8() ? (value & 0xFF) : value;
+    setNZ(value, x8());
+}
+
+void Interpreter::setP(uint8_t value) {
+    m_P = value;
+    if(m_E) {
+        m_P |= MEMORY_SELECT | INDEX_SELECT;
+    }
+    if(x8()) {
+        m_X &= 0xFF;
+        m_Y &= 0xFF;
+    }
+}
+
+//addressing modes
+
+LongAddress Interpreter::immM() {
+    const LongAddress address = (m_PB << 16) | m_PC;
+    m_PC += m8() ? 1 : 2;
+    return address;
+}
+
+LongAddress Interpreter::immX() {
+    const LongAddress address = (m_PB << 16) | m_PC;
+    m_PC += x8() ? 1 : 2;
+    return address;
+}
+
+LongAddress Interpreter::dp() {
+    return (m_D + fetch8()) & 0xFFFF;
+}
+
+LongAddress Interpreter::dpx() {
+    return (m_D + fetch8() + m_X) & 0xFFFF;
+}
+
+LongAddress Interpreter::dpy() {
+    return (m_D + fetch8() + m_Y) & 0xFFFF;
+}
+
+LongAddress Interpreter::dpInd() {
+    return (m_DBR << 16) | read16(dp());
+}
+
+LongAddress Interpreter::dpIndX() {
+    return (m_DBR << 16) | read16(dpx());
+}
+
+LongAddress Interpreter::dpIndY() {
+    return ((m_DBR << 16) + read16(dp()) + m_Y) & 0xFFFFFF;
+}
+
+LongAddress Interpreter::dpIndLong() {
+    return read24(dp());
+}
+
+LongAddress Interpreter::dpIndLongY() {
+    return (read24(dp()) + m_Y) & 0xFFFFFF;
+}
+
+LongAddress Interpreter::abs() {
+    return (m_DBR << 16) | fetch16();
+}
+
+LongAddress Interpreter::absx() {
+    return ((m_DBR << 16) + fetch16() + m_X) & 0xFFFFFF;
+}
+
+LongAddress Interpreter::absy() {
+    return ((m_DBR << 16) + fetch16() + m_Y) & 0xFFFFFF;
+}
+
+LongAddress Interpreter::absLong() {
+    return fetch24();
+}
+
+LongAddress Interpreter::absLongX() {
+    return (fetch24() + m_X) & 0xFFFFFF;
+}
+
+LongAddress Interpreter::sr() {
+    return (m_S + fetch8()) & 0xFFFF;
+}
+
+LongAddress Interpreter::srIndY() {
+    return ((m_DBR << 16) + read16(sr()) + m_Y) & 0xFFFFFF;
+}
+
+//arithmetic
+
+void Interpreter::adc(uint16_t value) {
+    const bool is8Bit = m8();
+    const uint32_t mask = is8Bit ? 0xFF : 0xFFFF;
+    const uint32_t sign = is8Bit ? 0x80 : 0x8000;
+    const uint32_t a = m_A & mask;
+    const uint32_t v = value & mask;
+    uint32_t result = 0;
+
+    if(m_P & DECIMAL) {
+        uint32_t carry = (m_P & CARRY) ? 1 : 0;
+        for(unsigned int shift = 0; shift < (is8Bit ? 8u : 16u); shift += 4) {
+            uint32_t digit = ((a >> shift) & 0x0F) + ((v >> shift) & 0x0F) + carry;
+            carry = digit > 9;
+            if(carry) {
+                digit -= 10;
+            }
+            result |= (digit & 0x0F) << shift;
+        }
+        result |= carry << (is8Bit ? 8 : 16);
+    } else {
+        result = a + v + ((m_P & CARRY) ? 1 : 0);
+    }
+
+    setFlag(SIGNED_OVERFLOW, (~(a ^ v) & (a ^ result) & sign) != 0);
+    setFlag(CARRY, result > mask);
+    setA(result & mask);
+}
+
+void Interpreter::sbc(uint16_t value) {
+    if(!(m_P & DECIMAL)) {
+        adc(~value);
+        return;
+    }
+
+    const bool is8Bit = m8();
+    const uint32_t mask = is8Bit ? 0xFF : 0xFFFF;
+    const uint32_t sign = is8Bit ? 0x80 : 0x8000;
+    const uint32_t a = m_A & mask;
+    const uint32_t v = value & mask;
+    uint32_t result = 0;
+    int borrow = (m_P & CARRY) ? 0 : 1;
+
+    for(unsigned int shift = 0; shift < (is8Bit ? 8u : 16u); shift += 4) {
+        int digit = static_cast<int>((a >> shift) & 0x0F) - static_cast<int>((v >> shift) & 0x0F) - borrow;
+        borrow = digit < 0;
+        if(borrow) {
+            digit += 10;
+        }
+        result |= (digit & 0x0F) << shift;
+    }
+
+    const uint32_t binary = (a - v - ((m_P & CARRY) ? 0 : 1)) & mask;
+    setFlag(SIGNED_OVERFLOW, ((a ^ v) & (a ^ binary) & sign) != 0);
+    setFlag(CARRY, !borrow);
+    setA(result);
+}
+
+void Interpreter::compare(uint16_t reg, uint16_t value, bool is8Bit) {
+    const uint16_t mask = is8Bit ? 0xFF : 0xFFFF;
+    setFlag(CARRY, (reg & mask) >= (value & mask));
+    setNZ((reg - value) & mask, is8Bit);
+}
+
+void Interpreter::branch(bool condition) {
+    const int8_t displacement = fetch8();
+    if(condition) {
+        m_PC += displacement;
+    }
+}
+
+uint16_t Interpreter::asl(uint16_t value, bool is8Bit) {
+    setFlag(CARRY, value & (is8Bit ? 0x80 : 0x8000));
+    value <<= 1;
+    setNZ(value, is8Bit);
+    return value;
+}
+
+uint16_t Interpreter::lsr(uint16_t value, bool is8Bit) {
+    setFlag(CARRY, value & 0x01);
+    value >>= 1;
+    setNZ(value, is8Bit);
+    return value;
+}
+
+uint16_t Interpreter::rol(uint16_t value, bool is8Bit) {
+    const bool carry = m_P & CARRY;
+    setFlag(CARRY, value & (is8Bit ? 0x80 : 0x8000));
+    value = (value << 1) | (carry ? 1 : 0);
+    setNZ(value, is8Bit);
+    return value;
+}
+
+uint16_t Interpreter::ror(uint16_t value, bool is8Bit) {
+    const bool carry = m_P & CARRY;
+    setFlag(CARRY, value & 0x01);
+    value = (value >> 1) | (carry ? (is8Bit ? 0x80 : 0x8000) : 0);
+    setNZ(value, is8Bit);
+    return value;
+}
+
+uint16_t Interpreter::inc(uint16_t value, bool is8Bit) {
+    setNZ(++value, is8Bit);
+    return value;
+}
+
+uint16_t Interpreter::dec(uint16_t value, bool is8Bit) {
+    setNZ(--value, is8Bit);
+    return value;
+}
+
+uint16_t Interpreter::tsb(uint16_t value, bool is8Bit) {
+    setFlag(ZERO, (value & m_A & (is8Bit ? 0xFF : 0xFFFF)) == 0);
+    return value | m_A;
+}
+
+uint16_t Interpreter::trb(uint16_t value, bool is8Bit) {
+    setFlag(ZERO, (value & m_A & (is8Bit ? 0xFF : 0xFFFF)) == 0);
+    return value & ~m_A;
+}
+
+template<Interpreter::Modifier modifier>
+void Interpreter::modifyMemory(LongAddress address) {
+    if(m8()) {
+        write8(address, (this->*modifier)(read8(address), true));
+    } else {
+        write16(address, (this->*modifier)(read16(address), false));
+    }
+}
+
+template<Interpreter::Modifier modifier>
+void Interpreter::modifyAccumulator() {
+    const uint16_t value = (this->*modifier)(m8() ? (m_A & 0xFF) : m_A, m8());
+    m_A = m8() ? ((m_A & 0xFF00) | (value & 0xFF)) : value;
+}
+
+//operations with an addressing mode
+
+template<Interpreter::Mode mode> void Interpreter::LDA() {
+    setA(loadM((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::LDX() {
+    setX(loadX((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::LDY() {
+    setY(loadX((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::STA() {
+    const LongAddress address = (this->*mode)();
+    m8() ? write8(address, m_A) : write16(address, m_A);
+}
+
+template<Interpreter::Mode mode> void Interpreter::STX() {
+    const LongAddress address = (this->*mode)();
+    x8() ? write8(address, m_X) : write16(address, m_X);
+}
+
+template<Interpreter::Mode mode> void Interpreter::STY() {
+    const LongAddress address = (this->*mode)();
+    x8() ? write8(address, m_Y) : write16(address, m_Y);
+}
+
+template<Interpreter::Mode mode> void Interpreter::STZ() {
+    const LongAddress address = (this->*mode)();
+    m8() ? write8(address, 0) : write16(address, 0);
+}
+
+template<Interpreter::Mode mode> void Interpreter::ORA() {
+    setA(m_A | loadM((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::AND() {
+    setA(m_A & loadM((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::EOR() {
+    setA(m_A ^ loadM((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::ADC() {
+    adc(loadM((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::SBC() {
+    sbc(loadM((this->*mode)()));
+}
+
+template<Interpreter::Mode mode> void Interpreter::CMP() {
+    compare(m_A, loadM((this->*mode)()), m8());
+}
+
+template<Interpreter::Mode mode> void Interpreter::CPX() {
+    compare(m_X, loadX((this->*mode)()), x8());
+}
+
+template<Interpreter::Mode mode> void Interpreter::CPY() {
+    compare(m_Y, loadX((this->*mode)()), x8());
+}
+
+template<Interpreter::Mode mode> void Interpreter::BIT() {
+    const uint16_t value = loadM((this->*mode)());
+    const uint16_t sign = m8() ? 0x80 : 0x8000;
+    setFlag(ZERO, (value & m_A & (m8() ? 0xFF : 0xFFFF)) == 0);
+    setFlag(NEGATIVE, value & sign);
+    setFlag(SIGNED_OVERFLOW, value & (sign >> 1));
+}
+
+template<Interpreter::Mode mode> void Interpreter::ASL() {
+    modifyMemory<&Interpreter::asl>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::LSR() {
+    modifyMemory<&Interpreter::lsr>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::ROL() {
+    modifyMemory<&Interpreter::rol>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::ROR() {
+    modifyMemory<&Interpreter::ror>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::INC() {
+    modifyMemory<&Interpreter::inc>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::DEC() {
+    modifyMemory<&Interpreter::dec>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::TSB() {
+    modifyMemory<&Interpreter::tsb>((this->*mode)());
+}
+
+template<Interpreter::Mode mode> void Interpreter::TRB() {
+    modifyMemory<&Interpreter::trb>((this->*mode)());
+}
+
+template<uint8_t flag, bool set> void Interpreter::branchIf() {
+    branch(((m_P & flag) != 0) == set);
+}
+
+template<uint8_t flag, bool set> void Interpreter::setFlagOp() {
+    setFlag(flag, set);
+}
+
+//implied operations
+
+void Interpreter::BIT_imm() {
+    setFlag(ZERO, (loadM(immM()) & m_A & (m8() ? 0xFF : 0xFFFF)) == 0);
+}
+
+void Interpreter::ASL_A() {
+    modifyAccumulator<&Interpreter::asl>();
+}
+
+void Interpreter::LSR_A() {
+    modifyAccumulator<&Interpreter::lsr>();
+}
+
+void Interpreter::ROL_A() {
+    modifyAccumulator<&Interpreter::rol>();
+}
+
+void Interpreter::ROR_A() {
+    modifyAccumulator<&Interpreter::ror>();
+}
+
+void Interpreter::INC_A() {
+    modifyAccumulator<&Interpreter::inc>();
+}
+
+void Interpreter::DEC_A() {
+    modifyAccumulator<&Interpreter::dec>();
+}
+
+void Interpreter::INX() {
+    setX(m_X + 1);
+}
+
+void Interpreter::INY() {
+    setY(m_Y + 1);
+}
+
+void Interpreter::DEX() {
+    setX(m_X - 1);
+}
+
+void Interpreter::DEY() {
+    setY(m_Y - 1);
+}
+
+void Interpreter::BRA() {
+    branch(true);
+}
+
+void Interpreter::BRL() {
+    const int16_t displacement = fetch16();
+    m_PC += displacement;
+}
+
+void Interpreter::JMP_abs() {
+    m_PC = fetch16();
+}
+
+void Interpreter::JMP_ind() {
+    m_PC = read16(fetch16());
+    recordIndirect((m_PB << 16) | m_PC);
+}
+
+void Interpreter::JMP_indx() {
+    m_PC = read16((m_PB << 16) | ((fetch16() + m_X) & 0xFFFF));
+    recordIndirect((m_PB << 16) | m_PC);
+}
+
+void Interpreter::JML_abs() {
+    const LongAddress target = fetch24();
+    m_PB = target >> 16;
+    m_PC = target;
+}
+
+void Interpreter::JML_ind() {
+    const LongAddress target = read24(fetch16());
+    m_PB = target >> 16;
+    m_PC = target;
+    recordIndirect(target);
+}
+
+void Interpreter::JSR_abs() {
+    const uint16_t target = fetch16();
+    push16(m_PC - 1);
+    m_PC = target;
+}
+
+void Interpreter::JSR_indx() {
+    const uint16_t target = read16((m_PB << 16) | ((fetch16() + m_X) & 0xFFFF));
+    push16(m_PC - 1);
+    m_PC = target;
+    recordIndirect((m_PB << 16) | m_PC);
+}
+
+void Interpreter::JSL() {
+    const LongAddress target = fetch24();
+    push8(m_PB);
+    push16(m_PC - 1);
+    m_PB = target >> 16;
+    m_PC = target;
+}
+
+void Interpreter::RTS() {
+    m_PC = pull16() + 1;
+}
+
+void Interpreter::RTL() {
+    m_PC = pull16() + 1;
+    m_PB = pull8();
+}
+
+void Interpreter::RTI() {
+    setP(pull8());
+    m_PC = pull16();
+    if(!m_E) {
+        m_PB = pull8();
+    }
+}
+
+void Interpreter::BRK() {
+    fetch8(); //signature byte
+    interrupt(NATIVE_BRK, EMULATION_IRQ);
+}
+
+void Interpreter::COP() {
+    fetch8(); //signature byte
+    interrupt(NATIVE_COP, EMULATION_COP);
+}
+
+void Interpreter::REP() {
+    setP(m_P & ~fetch8());
+}
+
+void Interpreter::SEP() {
+    setP(m_P | fetch8());
+}
+
+void Interpreter::XCE() {
+    const bool carry = m_P & CARRY;
+    setFlag(CARRY, m_E);
+    m_E = carry;
+    if(m_E) {
+        m_S = 0x0100 | (m_S & 0xFF);
+        setP(m_P);
+    }
+}
+
+void Interpreter::TAX() {
+    setX(m_A);
+}
+
+void Interpreter::TAY() {
+    setY(m_A);
+}
+
+void Interpreter::TXA() {
+    setA(m_X);
+}
+
+void Interpreter::TYA() {
+    setA(m_Y);
+}
+
+void Interpreter::TXY() {
+    setY(m_X);
+}
+
+void Interpreter::TYX() {
+    setX(m_Y);
+}
+
+void Interpreter::TSX() {
+    setX(m_S);
+}
+
+void Interpreter::TXS() {
+    m_S = m_E ? (0x0100 | (m_X & 0xFF)) : m_X;
+}
+
+void Interpreter::TCS() {
+    m_S = m_E ? (0x0100 | (m_A & 0xFF)) : m_A;
+}
+
+void Interpreter::TSC() {
+    m_A = m_S;
+    setNZ(m_A, false);
+}
+
+void Interpreter::TCD() {
+    m_D = m_A;
+    setNZ(m_D, false);
+}
+
+void Interpreter::TDC() {
+    m_A = m_D;
+    setNZ(m_A, false);
+}
+
+void Interpreter::XBA() {
+    m_A = (m_A >> 8) | (m_A << 8);
+    setNZ(m_A, true);
+}
+
+void Interpreter::PHA() {
+    m8() ? push8(m_A) : push16(m_A);
+}
+
+void Interpreter::PHX() {
+    x8() ? push8(m_X) : push16(m_X);
+}
+
+void Interpreter::PHY() {
+    x8() ? push8(m_Y) : push16(m_Y);
+}
+
+void Interpreter::PHP() {
+    push8(m_P);
+}
+
+void Interpreter::PHB() {
+    push8(m_DBR);
+}
+
+void Interpreter::PHK() {
+    push8(m_PB);
+}
+
+void Interpreter::PHD() {
+    push16(m_D);
+}
+
+void Interpreter::PLA() {
+    setA(m8() ? pull8() : pull16());
+}
+
+void Interpreter::PLX() {
+    setX(x8() ? pull8() : pull16());
+}
+
+void Interpreter::PLY() {
+    setY(x8() ? pull8() : pull16());
+}
+
+void Interpreter::PLP() {
+    setP(pull8());
+}
+
+void Interpreter::PLB() {
+    m_DBR = pull8();
+    setNZ(m_DBR, true);
+}
+
+void Interpreter::PLD() {
+    m_D = pull16();
+    setNZ(m_D, false);
+}
+
+void Interpreter::PEA() {
+    push16(fetch16());
+}
+
+void Interpreter::PEI() {
+    push16(read16(dp()));
+}
+
+void Interpreter::PER() {
+    const uint16_t displacement = fetch16();
+    push16(m_PC + displacement);
+}
+
+void Interpreter::MVN() {
+    const uint8_t destination = fetch8();
+    const uint8_t source = fetch8();
+    m_DBR = destination;
+    write8((destination << 16) | m_Y, read8((source << 16) | m_X));
+    m_X = x8() ? ((m_X + 1) & 0xFF) : m_X + 1;
+    m_Y = x8() ? ((m_Y + 1) & 0xFF) : m_Y + 1;
+    if(m_A-- != 0) {
+        m_PC -= 3; //repeat until the counter underflows
+    }
+}
+
+void Interpreter::MVP() {
+    const uint8_t destination = fetch8();
+    const uint8_t source = fetch8();
+    m_DBR = destination;
+    write8((destination << 16) | m_Y, read8((source << 16) | m_X));
+    m_X = x8() ? ((m_X - 1) & 0xFF) : m_X - 1;
+    m_Y = x8() ? ((m_Y - 1) & 0xFF) : m_Y - 1;
+    if(m_A-- != 0) {
+        m_PC -= 3;
+    }
+}
+
+void Interpreter::NOP() {
+}
+
+void Interpreter::WDM() {
+    fetch8();
+}
+
+void Interpreter::WAI() {
+    //skip the time until the next interrupt
+    if((m_NMITIMEN & 0xB0) && m_NextFrame > m_Steps) {
+        m_Steps = m_NextFrame - 1;
+    }
+}
+
+void Interpreter::STP() {
+    m_Halted = true;
+}
+
+//the dispatch table. Each opcode is bound to its operation and addressing mode at compile time.
+const Interpreter::Handler Interpreter::s_Handlers[256] = {
+    /*0x00*/
+    &Interpreter::BRK, &Interpreter::ORA<&Interpreter::dpIndX>, &Interpreter::COP, &Interpreter::ORA<&Interpreter::sr>,
+    &Interpreter::TSB<&Interpreter::dp>, &Interpreter::ORA<&Interpreter::dp>, &Interpreter::ASL<&Interpreter::dp>, &Interpreter::ORA<&Interpreter::dpIndLong>,
+    &Interpreter::PHP, &Interpreter::ORA<&Interpreter::immM>, &Interpreter::ASL_A, &Interpreter::PHD,
+    &Interpreter::TSB<&Interpreter::abs>, &Interpreter::ORA<&Interpreter::abs>, &Interpreter::ASL<&Interpreter::abs>, &Interpreter::ORA<&Interpreter::absLong>,
+    /*0x10*/
+    &Interpreter::branchIf<NEGATIVE, false>, &Interpreter::ORA<&Interpreter::dpIndY>, &Interpreter::ORA<&Interpreter::dpInd>, &Interpreter::ORA<&Interpreter::srIndY>,
+    &Interpreter::TRB<&Interpreter::dp>, &Interpreter::ORA<&Interpreter::dpx>, &Interpreter::ASL<&Interpreter::dpx>, &Interpreter::ORA<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<CARRY, false>, &Interpreter::ORA<&Interpreter::absy>, &Interpreter::INC_A, &Interpreter::TCS,
+    &Interpreter::TRB<&Interpreter::abs>, &Interpreter::ORA<&Interpreter::absx>, &Interpreter::ASL<&Interpreter::absx>, &Interpreter::ORA<&Interpreter::absLongX>,
+    /*0x20*/
+    &Interpreter::JSR_abs, &Interpreter::AND<&Interpreter::dpIndX>, &Interpreter::JSL, &Interpreter::AND<&Interpreter::sr>,
+    &Interpreter::BIT<&Interpreter::dp>, &Interpreter::AND<&Interpreter::dp>, &Interpreter::ROL<&Interpreter::dp>, &Interpreter::AND<&Interpreter::dpIndLong>,
+    &Interpreter::PLP, &Interpreter::AND<&Interpreter::immM>, &Interpreter::ROL_A, &Interpreter::PLD,
+    &Interpreter::BIT<&Interpreter::abs>, &Interpreter::AND<&Interpreter::abs>, &Interpreter::ROL<&Interpreter::abs>, &Interpreter::AND<&Interpreter::absLong>,
+    /*0x30*/
+    &Interpreter::branchIf<NEGATIVE, true>, &Interpreter::AND<&Interpreter::dpIndY>, &Interpreter::AND<&Interpreter::dpInd>, &Interpreter::AND<&Interpreter::srIndY>,
+    &Interpreter::BIT<&Interpreter::dpx>, &Interpreter::AND<&Interpreter::dpx>, &Interpreter::ROL<&Interpreter::dpx>, &Interpreter::AND<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<CARRY, true>, &Interpreter::AND<&Interpreter::absy>, &Interpreter::DEC_A, &Interpreter::TSC,
+    &Interpreter::BIT<&Interpreter::absx>, &Interpreter::AND<&Interpreter::absx>, &Interpreter::ROL<&Interpreter::absx>, &Interpreter::AND<&Interpreter::absLongX>,
+    /*0x40*/
+    &Interpreter::RTI, &Interpreter::EOR<&Interpreter::dpIndX>, &Interpreter::WDM, &Interpreter::EOR<&Interpreter::sr>,
+    &Interpreter::MVP, &Interpreter::EOR<&Interpreter::dp>, &Interpreter::LSR<&Interpreter::dp>, &Interpreter::EOR<&Interpreter::dpIndLong>,
+    &Interpreter::PHA, &Interpreter::EOR<&Interpreter::immM>, &Interpreter::LSR_A, &Interpreter::PHK,
+    &Interpreter::JMP_abs, &Interpreter::EOR<&Interpreter::abs>, &Interpreter::LSR<&Interpreter::abs>, &Interpreter::EOR<&Interpreter::absLong>,
+    /*0x50*/
+    &Interpreter::branchIf<SIGNED_OVERFLOW, false>, &Interpreter::EOR<&Interpreter::dpIndY>, &Interpreter::EOR<&Interpreter::dpInd>, &Interpreter::EOR<&Interpreter::srIndY>,
+    &Interpreter::MVN, &Interpreter::EOR<&Interpreter::dpx>, &Interpreter::LSR<&Interpreter::dpx>, &Interpreter::EOR<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<IRQ, false>, &Interpreter::EOR<&Interpreter::absy>, &Interpreter::PHY, &Interpreter::TCD,
+    &Interpreter::JML_abs, &Interpreter::EOR<&Interpreter::absx>, &Interpreter::LSR<&Interpreter::absx>, &Interpreter::EOR<&Interpreter::absLongX>,
+    /*0x60*/
+    &Interpreter::RTS, &Interpreter::ADC<&Interpreter::dpIndX>, &Interpreter::PER, &Interpreter::ADC<&Interpreter::sr>,
+    &Interpreter::STZ<&Interpreter::dp>, &Interpreter::ADC<&Interpreter::dp>, &Interpreter::ROR<&Interpreter::dp>, &Interpreter::ADC<&Interpreter::dpIndLong>,
+    &Interpreter::PLA, &Interpreter::ADC<&Interpreter::immM>, &Interpreter::ROR_A, &Interpreter::RTL,
+    &Interpreter::JMP_ind, &Interpreter::ADC<&Interpreter::abs>, &Interpreter::ROR<&Interpreter::abs>, &Interpreter::ADC<&Interpreter::absLong>,
+    /*0x70*/
+    &Interpreter::branchIf<SIGNED_OVERFLOW, true>, &Interpreter::ADC<&Interpreter::dpIndY>, &Interpreter::ADC<&Interpreter::dpInd>, &Interpreter::ADC<&Interpreter::srIndY>,
+    &Interpreter::STZ<&Interpreter::dpx>, &Interpreter::ADC<&Interpreter::dpx>, &Interpreter::ROR<&Interpreter::dpx>, &Interpreter::ADC<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<IRQ, true>, &Interpreter::ADC<&Interpreter::absy>, &Interpreter::PLY, &Interpreter::TDC,
+    &Interpreter::JMP_indx, &Interpreter::ADC<&Interpreter::absx>, &Interpreter::ROR<&Interpreter::absx>, &Interpreter::ADC<&Interpreter::absLongX>,
+    /*0x80*/
+    &Interpreter::BRA, &Interpreter::STA<&Interpreter::dpIndX>, &Interpreter::BRL, &Interpreter::STA<&Interpreter::sr>,
+    &Interpreter::STY<&Interpreter::dp>, &Interpreter::STA<&Interpreter::dp>, &Interpreter::STX<&Interpreter::dp>, &Interpreter::STA<&Interpreter::dpIndLong>,
+    &Interpreter::DEY, &Interpreter::BIT_imm, &Interpreter::TXA, &Interpreter::PHB,
+    &Interpreter::STY<&Interpreter::abs>, &Interpreter::STA<&Interpreter::abs>, &Interpreter::STX<&Interpreter::abs>, &Interpreter::STA<&Interpreter::absLong>,
+    /*0x90*/
+    &Interpreter::branchIf<CARRY, false>, &Interpreter::STA<&Interpreter::dpIndY>, &Interpreter::STA<&Interpreter::dpInd>, &Interpreter::STA<&Interpreter::srIndY>,
+    &Interpreter::STY<&Interpreter::dpx>, &Interpreter::STA<&Interpreter::dpx>, &Interpreter::STX<&Interpreter::dpy>, &Interpreter::STA<&Interpreter::dpIndLongY>,
+    &Interpreter::TYA, &Interpreter::STA<&Interpreter::absy>, &Interpreter::TXS, &Interpreter::TXY,
+    &Interpreter::STZ<&Interpreter::abs>, &Interpreter::STA<&Interpreter::absx>, &Interpreter::STZ<&Interpreter::absx>, &Interpreter::STA<&Interpreter::absLongX>,
+    /*0xA0*/
+    &Interpreter::LDY<&Interpreter::immX>, &Interpreter::LDA<&Interpreter::dpIndX>, &Interpreter::LDX<&Interpreter::immX>, &Interpreter::LDA<&Interpreter::sr>,
+    &Interpreter::LDY<&Interpreter::dp>, &Interpreter::LDA<&Interpreter::dp>, &Interpreter::LDX<&Interpreter::dp>, &Interpreter::LDA<&Interpreter::dpIndLong>,
+    &Interpreter::TAY, &Interpreter::LDA<&Interpreter::immM>, &Interpreter::TAX, &Interpreter::PLB,
+    &Interpreter::LDY<&Interpreter::abs>, &Interpreter::LDA<&Interpreter::abs>, &Interpreter::LDX<&Interpreter::abs>, &Interpreter::LDA<&Interpreter::absLong>,
+    /*0xB0*/
+    &Interpreter::branchIf<CARRY, true>, &Interpreter::LDA<&Interpreter::dpIndY>, &Interpreter::LDA<&Interpreter::dpInd>, &Interpreter::LDA<&Interpreter::srIndY>,
+    &Interpreter::LDY<&Interpreter::dpx>, &Interpreter::LDA<&Interpreter::dpx>, &Interpreter::LDX<&Interpreter::dpy>, &Interpreter::LDA<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<SIGNED_OVERFLOW, false>, &Interpreter::LDA<&Interpreter::absy>, &Interpreter::TSX, &Interpreter::TYX,
+    &Interpreter::LDY<&Interpreter::absx>, &Interpreter::LDA<&Interpreter::absx>, &Interpreter::LDX<&Interpreter::absy>, &Interpreter::LDA<&Interpreter::absLongX>,
+    /*0xC0*/
+    &Interpreter::CPY<&Interpreter::immX>, &Interpreter::CMP<&Interpreter::dpIndX>, &Interpreter::REP, &Interpreter::CMP<&Interpreter::sr>,
+    &Interpreter::CPY<&Interpreter::dp>, &Interpreter::CMP<&Interpreter::dp>, &Interpreter::DEC<&Interpreter::dp>, &Interpreter::CMP<&Interpreter::dpIndLong>,
+    &Interpreter::INY, &Interpreter::CMP<&Interpreter::immM>, &Interpreter::DEX, &Interpreter::WAI,
+    &Interpreter::CPY<&Interpreter::abs>, &Interpreter::CMP<&Interpreter::abs>, &Interpreter::DEC<&Interpreter::abs>, &Interpreter::CMP<&Interpreter::absLong>,
+    /*0xD0*/
+    &Interpreter::branchIf<ZERO, false>, &Interpreter::CMP<&Interpreter::dpIndY>, &Interpreter::CMP<&Interpreter::dpInd>, &Interpreter::CMP<&Interpreter::srIndY>,
+    &Interpreter::PEI, &Interpreter::CMP<&Interpreter::dpx>, &Interpreter::DEC<&Interpreter::dpx>, &Interpreter::CMP<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<DECIMAL, false>, &Interpreter::CMP<&Interpreter::absy>, &Interpreter::PHX, &Interpreter::STP,
+    &Interpreter::JML_ind, &Interpreter::CMP<&Interpreter::absx>, &Interpreter::DEC<&Interpreter::absx>, &Interpreter::CMP<&Interpreter::absLongX>,
+    /*0xE0*/
+    &Interpreter::CPX<&Interpreter::immX>, &Interpreter::SBC<&Interpreter::dpIndX>, &Interpreter::SEP, &Interpreter::SBC<&Interpreter::sr>,
+    &Interpreter::CPX<&Interpreter::dp>, &Interpreter::SBC<&Interpreter::dp>, &Interpreter::INC<&Interpreter::dp>, &Interpreter::SBC<&Interpreter::dpIndLong>,
+    &Interpreter::INX, &Interpreter::SBC<&Interpreter::immM>, &Interpreter::NOP, &Interpreter::XBA,
+    &Interpreter::CPX<&Interpreter::abs>, &Interpreter::SBC<&Interpreter::abs>, &Interpreter::INC<&Interpreter::abs>, &Interpreter::SBC<&Interpreter::absLong>,
+    /*0xF0*/
+    &Interpreter::branchIf<ZERO, true>, &Interpreter::SBC<&Interpreter::dpIndY>, &Interpreter::SBC<&Interpreter::dpInd>, &Interpreter::SBC<&Interpreter::srIndY>,
+    &Interpreter::PEA, &Interpreter::SBC<&Interpreter::dpx>, &Interpreter::INC<&Interpreter::dpx>, &Interpreter::SBC<&Interpreter::dpIndLongY>,
+    &Interpreter::setFlagOp<DECIMAL, true>, &Interpreter::SBC<&Interpreter::absy>, &Interpreter::PLX, &Interpreter::XCE,
+    &Interpreter::JSR_indx, &Interpreter::SBC<&Interpreter::absx>, &Interpreter::INC<&Interpreter::absx>, &Interpreter::SBC<&Interpreter::absLongX>
+};
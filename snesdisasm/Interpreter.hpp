@@ -0,0 +1,337 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INTERPRETER_HPP
+#define INTERPRETER_HPP
+
+#include "SNESROM.hpp"
+#include "CPUState.hpp"
+#include "MachineState.hpp"
+#include "ControlFlowGraph.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+/*! \brief A lightweight 65816 interpreter that traces which code a game executes
+ *
+ *  The interpreter only emulates the CPU, work RAM, SRAM and a few registers needed by typical boot code
+ *  (NMI/IRQ status, multiplication and division, the WRAM port, WRAM DMA and an echoing APU port stub).
+ *  All other I/O registers read as 0 and ignore writes. Time advances per instruction; an NMI is raised
+ *  every \see setInstructionsPerFrame instructions if the game enabled it.
+ *
+ *  Every executed address is recorded together with the register sizes it was executed with, as well as
+ *  the targets of all indirect jumps and calls.
+ */
+class Interpreter {
+  public:
+    /*! \brief The target an indirect jump or call took at runtime
+     */
+    struct IndirectTarget {
+        LongAddress source;
+        LongAddress target;
+        uint8_t flags; //the processorflags at the target
+
+        bool operator<(const IndirectTarget &other) const {
+            return source != other.source ? source < other.source :
+                   target != other.target ? target < other.target : flags < other.flags;
+        }
+    };
+
+    enum class StopReason {
+        STEP_LIMIT,     //the maximum number of steps was executed
+        HALTED,         //STP was executed
+        INVALID_ADDRESS //the program counter left ROM and RAM
+    };
+  private:
+    typedef void (Interpreter::*Handler)();
+    static const Handler s_Handlers[256];
+
+    enum { PageShift = 13, PageSize = 1 << PageShift, PageCount = 0x1000000 >> PageShift };
+
+    const SNESROM &m_ROM;
+
+    //registers
+    uint16_t m_A;
+    uint16_t m_X;
+    uint16_t m_Y;
+    uint16_t m_S;
+    uint16_t m_D;
+    uint16_t m_PC;
+    uint8_t m_DBR;
+    uint8_t m_PB;
+    uint8_t m_P;
+    bool m_E;
+
+    //memory
+    std::vector<uint8_t> m_WRAM;
+    std::vector<uint8_t> m_SRAM;
+    const uint8_t *m_ReadPages[PageCount];
+    uint8_t *m_WritePages[PageCount];
+
+    //stubbed hardware
+    uint8_t m_APUPorts[4];
+    uint32_t m_WRAMPort;
+    uint8_t m_NMITIMEN;
+    bool m_NMIFlag;
+    bool m_IRQFlag;
+    uint8_t m_MultiplicandA;
+    uint16_t m_Dividend;
+    uint16_t m_MathResult;
+    uint16_t m_Quotient;
+    uint8_t m_DMARegisters[8][16];
+
+    //tracing
+    uint64_t m_Steps;
+    uint64_t m_InstructionsPerFrame;
+    uint64_t m_NextFrame;
+    bool m_NextEventIsIRQ;
+    bool m_Halted;
+    LongAddress m_InstructionAddress;
+    std::vector<std::unique_ptr<uint8_t[]>> m_Coverage;
+    std::set<IndirectTarget> m_IndirectTargets;
+
+    //memory access
+    uint8_t read8(LongAddress address) {
+        const uint8_t *page = m_ReadPages[address >> PageShift];
+        return page != nullptr ? page[address & (PageSize - 1)] : readIO(address);
+    }
+    uint16_t read16(LongAddress address) { return read8(address) | (read8((address + 1) & 0xFFFFFF) << 8); }
+    LongAddress read24(LongAddress address) { return read16(address) | (read8((address + 2) & 0xFFFFFF) << 16); }
+    void write8(LongAddress address, uint8_t value) {
+        uint8_t *page = m_WritePages[address >> PageShift];
+        page != nullptr ? void(page[address & (PageSize - 1)] = value) : writeIO(address, value);
+    }
+    void write16(LongAddress address, uint16_t value);
+    uint8_t readIO(LongAddress address);
+    void writeIO(LongAddress address, uint8_t value);
+    void startDMA(uint8_t channels);
+
+    uint8_t fetch8() { return read8((m_PB << 16) | m_PC++); }
+    uint16_t fetch16();
+    LongAddress fetch24();
+
+    void push8(uint8_t value);
+    void push16(uint16_t value);
+    uint8_t pull8();
+    uint16_t pull16();
+
+    //state
+    bool m8() const { return (m_P & MEMORY_SELECT) != 0; }
+    bool x8() const { return (m_P & INDEX_SELECT) != 0; }
+    void setFlag(uint8_t flag, bool set) { m_P = set ? (m_P | flag) : (m_P & ~flag); }
+    void setNZ(uint16_t value, bool is8Bit);
+    void setA(uint16_t value);
+    void setX(uint16_t value);
+    void setY(uint16_t value);
+    void setP(uint8_t value);
+    void interrupt(uint16_t nativeVector, uint16_t emulationVector);
+    void frameEvent();
+    void recordIndirect(LongAddress target);
+
+    //addressing modes. Each returns the effective address and advances the program counter.
+    LongAddress immM();
+    LongAddress immX();
+    LongAddress dp();
+    LongAddress dpx();
+    LongAddress dpy();
+    LongAddress dpInd();
+    LongAddress dpIndX();
+    LongAddress dpIndY();
+    LongAddress dpIndLong();
+    LongAddress dpIndLongY();
+    LongAddress abs();
+    LongAddress absx();
+    LongAddress absy();
+    LongAddress absLong();
+    LongAddress absLongX();
+    LongAddress sr();
+    LongAddress srIndY();
+
+    typedef LongAddress (Interpreter::*Mode)();
+
+    //operations
+    uint16_t loadM(LongAddress address) { return m8() ? read8(address) : read16(address); }
+    uint16_t loadX(LongAddress address) { return x8() ? read8(address) : read16(address); }
+    void adc(uint16_t value);
+    void sbc(uint16_t value);
+    void compare(uint16_t reg, uint16_t value, bool is8Bit);
+    void branch(bool condition);
+
+    //read-modify-write operations on a value of the accumulator size
+    typedef uint16_t (Interpreter::*Modifier)(uint16_t value, bool is8Bit);
+    uint16_t asl(uint16_t value, bool is8Bit);
+    uint16_t lsr(uint16_t value, bool is8Bit);
+    uint16_t rol(uint16_t value, bool is8Bit);
+    uint16_t ror(uint16_t value, bool is8Bit);
+    uint16_t inc(uint16_t value, bool is8Bit);
+    uint16_t dec(uint16_t value, bool is8Bit);
+    uint16_t tsb(uint16_t value, bool is8Bit);
+    uint16_t trb(uint16_t value, bool is8Bit);
+    template<Modifier modifier> void modifyMemory(LongAddress address);
+    template<Modifier modifier> void modifyAccumulator();
+
+    template<Mode mode> void LDA();
+    template<Mode mode> void LDX();
+    template<Mode mode> void LDY();
+    template<Mode mode> void STA();
+    template<Mode mode> void STX();
+    template<Mode mode> void STY();
+    template<Mode mode> void STZ();
+    template<Mode mode> void ORA();
+    template<Mode mode> void AND();
+    template<Mode mode> void EOR();
+    template<Mode mode> void ADC();
+    template<Mode mode> void SBC();
+    template<Mode mode> void CMP();
+    template<Mode mode> void CPX();
+    template<Mode mode> void CPY();
+    template<Mode mode> void BIT();
+    template<Mode mode> void ASL();
+    template<Mode mode> void LSR();
+    template<Mode mode> void ROL();
+    template<Mode mode> void ROR();
+    template<Mode mode> void INC();
+    template<Mode mode> void DEC();
+    template<Mode mode> void TSB();
+    template<Mode mode> void TRB();
+    template<uint8_t flag, bool set> void branchIf();
+    template<uint8_t flag, bool set> void setFlagOp();
+
+    void BIT_imm();
+    void ASL_A();
+    void LSR_A();
+    void ROL_A();
+    void ROR_A();
+    void INC_A();
+    void DEC_A();
+    void INX();
+    void INY();
+    void DEX();
+    void DEY();
+    void BRA();
+    void BRL();
+    void JMP_abs();
+    void JMP_ind();
+    void JMP_indx();
+    void JML_abs();
+    void JML_ind();
+    void JSR_abs();
+    void JSR_indx();
+    void JSL();
+    void RTS();
+    void RTL();
+    void RTI();
+    void BRK();
+    void COP();
+    void REP();
+    void SEP();
+    void XCE();
+    void TAX();
+    void TAY();
+    void TXA();
+    void TYA();
+    void TXY();
+    void TYX();
+    void TSX();
+    void TXS();
+    void TCS();
+    void TSC();
+    void TCD();
+    void TDC();
+    void XBA();
+    void PHA();
+    void PHX();
+    void PHY();
+    void PHP();
+    void PHB();
+    void PHK();
+    void PHD();
+    void PLA();
+    void PLX();
+    void PLY();
+    void PLP();
+    void PLB();
+    void PLD();
+    void PEA();
+    void PEI();
+    void PER();
+    void MVN();
+    void MVP();
+    void NOP();
+    void WDM();
+    void WAI();
+    void STP();
+  public:
+    /*! \brief Constructs an interpreter in the power on state. The rom has to outlive the interpreter.
+     */
+    explicit Interpreter(const SNESROM &rom);
+
+    /*! \brief Resets the CPU and starts at the RESET vector in emulation mode
+     */
+    void reset();
+
+    /*! \brief Starts executing at address in native mode with the processorflags of state
+     */
+    void start(LongAddress address, const MachineState &state);
+
+    /*! \brief Executes at most maxSteps instructions
+     */
+    StopReason run(uint64_t maxSteps);
+
+    /*! \brief Sets after how many instructions a frame ends and the NMI is raised. The IRQ is raised in the middle.
+     */
+    void setInstructionsPerFrame(uint64_t instructions);
+
+    /*! \brief Returns the current registers
+     */
+    CPUState cpuState() const;
+
+    /*! \brief Returns the number of instructions executed so far
+     */
+    uint64_t steps() const { return m_Steps; }
+
+    /*! \brief Calls f(address, sizes) for every executed address in ascending order
+     *
+     *  sizes is a bitmask where bit ((M << 1) | X) is set for every combination of register sizes the address
+     *  was executed with.
+     */
+    template<class F>
+    void forEachExecuted(F f) const;
+
+    const std::set<IndirectTarget> &indirectTargets() const { return m_IndirectTargets; }
+
+    /*! \brief Adds all targets of indirect jumps and calls that lie in ROM as entry points to graph
+     */
+    void addEntryPointsTo(ControlFlowGraph &graph) const;
+};
+
+template<class F>
+void Interpreter::forEachExecuted(F f) const {
+    for(std::size_t page = 0; page < m_Coverage.size(); ++page) {
+        if(!m_Coverage[page]) {
+            continue;
+        }
+        for(unsigned int offset = 0; offset < PageSize; ++offset) {
+            if(m_Coverage[page][offset] != 0) {
+                f(static_cast<LongAddress>((page << PageShift) | offset), m_Coverage[page][offset]);
+            }
+        }
+    }
+}
+
+#endif // INTERPRETER_HPP
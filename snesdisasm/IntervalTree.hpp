@@ -0,0 +1,252 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INTERVALTREE_HPP
+#define INTERVALTREE_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/*! \brief A set of half-open intervals [start, end) with values attached, answering overlap and stab queries
+ *
+ *  The tree is an AVL tree ordered by start, then end. Every node additionally knows the largest end in its
+ *  subtree, which allows skipping subtrees that end before a query range. Queries take O(log n + k) for k
+ *  reported intervals, inserts O(log n). \see assign builds a balanced tree from many intervals in O(n) if they
+ *  are already sorted.
+ *
+ *  Nodes are kept in a vector and refer to each other by index, so the tree can be copied and moved.
+ *  Several intervals may have the same bounds.
+ */
+template<class T>
+class IntervalTree {
+  public:
+    typedef uint32_t Key;
+
+    struct Interval {
+        Key start;
+        Key end;
+        T value;
+    };
+  private:
+    static const uint32_t Nil = 0xFFFFFFFF;
+
+    struct Node {
+        Interval interval;
+        Key maxEnd;     //the largest end within the subtree
+        uint32_t left;
+        uint32_t right;
+        uint8_t height; //the height of the subtree, a leaf has 1
+    };
+
+    std::vector<Node> m_Nodes;
+    uint32_t m_Root;
+
+    static bool less(const Interval &a, const Interval &b) {
+        return a.start < b.start || (a.start == b.start && a.end < b.end);
+    }
+
+    uint8_t height(uint32_t node) const { return node != Nil ? m_Nodes[node].height : 0; }
+    Key maxEnd(uint32_t node) const { return node != Nil ? m_Nodes[node].maxEnd : 0; }
+
+    void update(uint32_t node) {
+        Node &n = m_Nodes[node];
+        n.height = std::max(height(n.left), height(n.right)) + 1;
+        n.maxEnd = std::max(n.interval.end, std::max(maxEnd(n.left), maxEnd(n.right)));
+    }
+
+    uint32_t rotateLeft(uint32_t node) {
+        const uint32_t right = m_Nodes[node].right;
+        m_Nodes[node].right = m_Nodes[right].left;
+        m_Nodes[right].left = node;
+        update(node);
+        update(right);
+        return right;
+    }
+
+    uint32_t rotateRight(uint32_t node) {
+        const uint32_t left = m_Nodes[node].left;
+        m_Nodes[node].left = m_Nodes[left].right;
+        m_Nodes[left].right = node;
+        update(node);
+        update(left);
+        return left;
+    }
+
+    uint32_t balance(uint32_t node) {
+        update(node);
+        const int factor = height(m_Nodes[node].left) - height(m_Nodes[node].right);
+        if(factor > 1) {
+            const uint32_t left = m_Nodes[node].left;
+            if(height(m_Nodes[left].left) < height(m_Nodes[left].right)) {
+                m_Nodes[node].left = rotateLeft(left);
+            }
+            return rotateRight(node);
+        }
+        if(factor < -1) {
+            const uint32_t right = m_Nodes[node].right;
+            if(height(m_Nodes[right].right) < height(m_Nodes[right].left)) {
+                m_Nodes[node].right = rotateRight(right);
+            }
+            return rotateLeft(node);
+        }
+        return node;
+    }
+
+    //inserts the node added last into the subtree and returns its new root
+    uint32_t insert(uint32_t root, uint32_t node) {
+        if(root == Nil) {
+            return node;
+        }
+        if(less(m_Nodes[node].interval, m_Nodes[root].interval)) {
+            const uint32_t left = insert(m_Nodes[root].left, node);
+            m_Nodes[root].left = left;
+        } else {
+            const uint32_t right = insert(m_Nodes[root].right, node);
+            m_Nodes[root].right = right;
+        }
+        return balance(root);
+    }
+
+    //links the sorted nodes [first, last) to a balanced subtree and returns its root
+    uint32_t build(uint32_t first, uint32_t last) {
+        if(first == last) {
+            return Nil;
+        }
+        const uint32_t middle = first + (last - first) / 2;
+        m_Nodes[middle].left = build(first, middle);
+        m_Nodes[middle].right = build(middle + 1, last);
+        update(middle);
+        return middle;
+    }
+
+    template<class F>
+    void overlapping(uint32_t node, Key start, Key end, F &f) const {
+        if(node == Nil || m_Nodes[node].maxEnd <= start) {
+            return;
+        }
+        const Node &n = m_Nodes[node];
+        overlapping(n.left, start, end, f);
+        if(n.interval.start >= end) {
+            return; //so does everything to the right
+        }
+        if(n.interval.end > start) {
+            f(n.interval);
+        }
+        overlapping(n.right, start, end, f);
+    }
+
+    template<class F>
+    void inOrder(uint32_t node, F &f) const {
+        if(node != Nil) {
+            inOrder(m_Nodes[node].left, f);
+            f(m_Nodes[node].interval);
+            inOrder(m_Nodes[node].right, f);
+        }
+    }
+  public:
+    IntervalTree() : m_Root(Nil) {}
+
+    std::size_t size() const { return m_Nodes.size(); }
+    bool empty() const { return m_Nodes.empty(); }
+
+    /*! \brief Returns the number of bytes the nodes occupy
+     */
+    std::size_t memoryUsage() const { return m_Nodes.capacity() * sizeof(Node); }
+
+    void clear() {
+        m_Nodes.clear();
+        m_Root = Nil;
+    }
+
+    /*! \brief Inserts [start, end). start has to be less than end.
+     */
+    void insert(Key start, Key end, const T &value) {
+        assert(start < end);
+        Node node = {{start, end, value}, end, Nil, Nil, 1};
+        m_Nodes.push_back(node);
+        m_Root = insert(m_Root, m_Nodes.size() - 1);
+    }
+
+    /*! \brief Replaces the content with the given intervals
+     *
+     *  Intervals sorted by start, then end, are linked in O(n) without comparing them again. Others are sorted
+     *  first.
+     */
+    void assign(const std::vector<Interval> &intervals) {
+        clear();
+        m_Nodes.reserve(intervals.size());
+        for(const Interval &interval : intervals) {
+            assert(interval.start < interval.end);
+            Node node = {interval, interval.end, Nil, Nil, 1};
+            m_Nodes.push_back(node);
+        }
+        if(!std::is_sorted(m_Nodes.begin(), m_Nodes.end(), [](const Node & a, const Node & b) {
+        return less(a.interval, b.interval);
+        })) {
+            std::stable_sort(m_Nodes.begin(), m_Nodes.end(), [](const Node & a, const Node & b) {
+                return less(a.interval, b.interval);
+            });
+        }
+        m_Root = build(0, m_Nodes.size());
+    }
+
+    /*! \brief Removes all intervals for which remove(interval) returns true and rebalances the tree in O(n)
+     *
+     *  \return the number of removed intervals
+     */
+    template<class P>
+    std::size_t removeIf(P remove) {
+        std::vector<Interval> kept;
+        kept.reserve(m_Nodes.size());
+        forEach([&](const Interval & interval) {
+            if(!remove(interval)) {
+                kept.push_back(interval);
+            }
+        });
+        const std::size_t removed = m_Nodes.size() - kept.size();
+        if(removed != 0) {
+            assign(kept);
+        }
+        return removed;
+    }
+
+    /*! \brief Calls f(interval) for every interval overlapping [start, end) in ascending order
+     */
+    template<class F>
+    void forEachOverlapping(Key start, Key end, F f) const {
+        if(start < end) {
+            overlapping(m_Root, start, end, f);
+        }
+    }
+
+    /*! \brief Calls f(interval) for every interval containing key in ascending order
+     */
+    template<class F>
+    void forEachContaining(Key key, F f) const {
+        overlapping(m_Root, key, key + 1, f);
+    }
+
+    /*! \brief Calls f(interval) for all intervals in ascending order
+     */
+    template<class F>
+    void forEach(F f) const {
+        inOrder(m_Root, f);
+    }
+};
+
+#endif // INTERVALTREE_HPP
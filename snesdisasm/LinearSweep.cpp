@@ -0,0 +1,137 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "LinearSweep.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+const uint8_t RegisterSizes = MEMORY_SELECT | INDEX_SELECT;
+
+//where the sweep of a chunk left it
+struct ChunkExit {
+    std::size_t offset; //past the last instruction starting in the chunk
+    uint8_t flags;
+    std::size_t instructions;
+};
+
+}
+
+LinearSweep::LinearSweep(const SNESROM &rom, unsigned int threads)
+    : m_Instructions(0),
+      m_Chunks(0),
+      m_Stitched(0) {
+    sweep(rom.image(), rom.imageSize(), rom.bankSize(), threads);
+}
+
+LinearSweep::LinearSweep(const uint8_t *data, std::size_t size, std::size_t chunkSize, unsigned int threads)
+    : m_Instructions(0),
+      m_Chunks(0),
+      m_Stitched(0) {
+    sweep(data, size, chunkSize, threads);
+}
+
+void LinearSweep::sweep(const uint8_t *data, std::size_t size, std::size_t chunkSize, unsigned int threads) {
+    INSTRUMENT_PHASE(DECODE);
+
+    const InstructionLengths lengths(data, size);
+    m_States.assign(size, 0);
+    m_Chunks = (size + chunkSize - 1) / chunkSize;
+    if(m_Chunks == 0) {
+        return;
+    }
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    //every chunk only writes the states of its own offsets
+    std::vector<ChunkExit> exits(m_Chunks);
+    std::atomic<std::size_t> next(0);
+    auto work = [&]() {
+        TRACE_SCOPE("sweep_worker");
+        std::size_t swept = 0;
+        for(std::size_t chunk = next++; chunk < m_Chunks; chunk = next++, ++swept) {
+            ChunkExit &exit = exits[chunk];
+            exit.flags = RegisterSizes;
+            exit.instructions = 0;
+            exit.offset = lengths.sweep(chunk * chunkSize, std::min(size, (chunk + 1) * chunkSize), exit.flags,
+            [&](std::size_t offset, uint8_t flags) {
+                m_States[offset] = START | (flags & RegisterSizes);
+                ++exit.instructions;
+            });
+        }
+        TRACE_ITERATIONS(swept);
+    };
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 1; i < std::min<std::size_t>(threads, m_Chunks); ++i) {
+        workers.push_back(std::thread(work));
+    }
+    work();
+    for(std::thread &worker : workers) {
+        worker.join();
+    }
+
+    //the first chunk starts where the serial sweep does, every other one is corrected until it synchronises
+    m_Instructions = exits[0].instructions;
+    std::size_t offset = exits[0].offset;
+    uint8_t flags = exits[0].flags;
+    for(std::size_t chunk = 1; chunk < m_Chunks; ++chunk) {
+        const std::size_t end = std::min(size, (chunk + 1) * chunkSize);
+        std::size_t instructions = exits[chunk].instructions;
+        std::size_t cleared = chunk * chunkSize; //the states before are final
+
+        bool synchronised = false;
+        while(offset < end) {
+            synchronised = m_States[offset] == (START | (flags & RegisterSizes));
+
+            //the states of the chunk's sweep up to here are not on the path of the serial sweep
+            for(; cleared < offset + (synchronised ? 0 : 1); ++cleared) {
+                instructions -= m_States[cleared] & START;
+                m_States[cleared] = 0;
+            }
+            if(synchronised) {
+                break;
+            }
+            const std::size_t instruction = offset;
+            const uint8_t instructionFlags = flags;
+            if(!lengths.step(offset, flags)) {
+                offset = size; //the image ends within the instruction
+                break;
+            }
+            m_States[instruction] = START | (instructionFlags & RegisterSizes);
+            ++instructions;
+            ++m_Stitched;
+        }
+
+        if(synchronised) {
+            offset = exits[chunk].offset;
+            flags = exits[chunk].flags;
+        } else {
+            for(; cleared < end; ++cleared) {
+                instructions -= m_States[cleared] & START;
+                m_States[cleared] = 0;
+            }
+        }
+        m_Instructions += instructions;
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LINEARSWEEP_HPP
+#define LINEARSWEEP_HPP
+
+#include "SNESROM.hpp"
+#include "InstructionLengths.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*! \brief A linear sweep over a whole image as a baseline coverage map
+ *
+ *  The sweep starts at the first byte with 8 bit registers, follows REP and SEP and continues over bank
+ *  boundaries until the last instruction that fits into the image. Nothing but the \see InstructionLengths is
+ *  looked at, so data is swept like code.
+ *
+ *  The image is split into chunks of one bank, which are swept by several threads. Each chunk is swept from its
+ *  first byte with 8 bit registers, as if no instruction reached into it. Afterwards the chunks are stitched
+ *  together in order: starting where the last instruction of the previous chunk ends, with its register sizes,
+ *  the true instructions are walked until one starts where the chunk's sweep has one with the same register
+ *  sizes. Both sweeps are equal from there on, so only the instructions before it are replaced. A linear sweep
+ *  synchronises itself within a few instructions, so the result is the one of a serial sweep at a fraction of
+ *  the time. If a chunk never synchronises, its stitching amounts to sweeping it serially.
+ */
+class LinearSweep {
+  public:
+    enum { START = 0x01 }; //the bit of a state telling that an instruction starts at the offset
+  private:
+    std::vector<uint8_t> m_States; //START and the register size flags for every offset, 0 if nothing starts
+    std::size_t m_Instructions;
+    std::size_t m_Chunks;
+    std::size_t m_Stitched; //the number of instructions replaced while stitching
+
+    void sweep(const uint8_t *data, std::size_t size, std::size_t chunkSize, unsigned int threads);
+  public:
+    /*! \brief Sweeps the image of rom in chunks of one bank
+     *
+     *  \param threads the number of threads sweeping chunks. 0 uses one per hardware thread.
+     */
+    explicit LinearSweep(const SNESROM &rom, unsigned int threads = 0);
+
+    /*! \brief Sweeps size bytes in chunks of chunkSize
+     */
+    LinearSweep(const uint8_t *data, std::size_t size, std::size_t chunkSize, unsigned int threads = 0);
+
+    std::size_t size() const { return m_States.size(); }
+
+    /*! \brief Returns true if an instruction starts at offset
+     */
+    bool contains(std::size_t offset) const { return (m_States[offset] & START) != 0; }
+
+    /*! \brief Returns the MEMORY_SELECT and INDEX_SELECT flags of the instruction at offset
+     */
+    uint8_t flags(std::size_t offset) const { return m_States[offset] & (MEMORY_SELECT | INDEX_SELECT); }
+
+    /*! \brief Returns the number of instructions found
+     */
+    std::size_t instructions() const { return m_Instructions; }
+
+    std::size_t chunks() const { return m_Chunks; }
+
+    /*! \brief Returns the number of instructions the stitching had to replace
+     */
+    std::size_t stitched() const { return m_Stitched; }
+
+    std::size_t memoryUsage() const { return sizeof(*this) + m_States.capacity(); }
+
+    /*! \brief Calls f(offset, flags) for every instruction starting in [start, end) in ascending order
+     */
+    template<class F>
+    void forEachIn(std::size_t start, std::size_t end, F f) const;
+};
+
+template<class F>
+void LinearSweep::forEachIn(std::size_t start, std::size_t end, F f) const {
+    for(std::size_t offset = start; offset < end && offset < m_States.size(); ++offset) {
+        if(m_States[offset] & START) {
+            f(offset, flags(offset));
+        }
+    }
+}
+
+#endif // LINEARSWEEP_HPP
@@ -0,0 +1,486 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Listing.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const char hexDigits[] = "0123456789ABCDEF";
+
+const std::size_t CommentColumn = 32;
+
+void appendHex(std::string &s, uint32_t value, unsigned int digits) {
+    while(digits > 0) {
+        --digits;
+        s += hexDigits[(value >> (4 * digits)) & 0x0F];
+    }
+}
+
+//prefix and suffix around the hexadecimal operand of each addressing mode
+struct OperandSyntax {
+    const char *prefix;
+    const char *suffix;
+};
+
+OperandSyntax operandSyntax(AddressingMode mode) {
+    switch(mode) {
+    case IMMEDIATE:
+        return {"#$", ""};
+    case ABSOLUTE_INDEXED_WITH_X:
+    case DIRECT_INDEXED_WITH_X:
+    case ABSOLUTE_INDEXED_LONG:
+    case ABSOLUTE_INDEXED_LONG_WITH_X:
+        return {"$", ",X"};
+    case ABSOLUTE_INDEXED_WITH_Y:
+    case DIRECT_INDEXED_WITH_Y:
+        return {"$", ",Y"};
+    case DIRECT_INDIRECT:
+    case ABSOLUTE_INDIRECT:
+        return {"($", ")"};
+    case DIRECT_INDEXED_INDIRECT:
+    case ABSOLUTE_INDEXED_INDIRECT:
+        return {"($", ",X)"};
+    case DIRECT_INDIRECT_INDEXED:
+    case DIRECT_INDIRECT_INDEXED_WITH_Y:
+        return {"($", "),Y"};
+    case DIRECT_INDIRECT_LONG:
+    case ABSOLUTE_INDIRECT_LONG:
+        return {"[$", "]"};
+    case DIRECT_INDIRECT_INDEXED_LONG:
+    case DIRECT_INDIRECT_LONG_INDEXED_WITH_Y:
+        return {"[$", "],Y"};
+    case STACK_RELATIVE:
+        return {"$", ",S"};
+    case STACK_RELATIVE_INDIRECT_INDEXED:
+        return {"($", ",S),Y"};
+    default:
+        return {"$", ""};
+    }
+}
+
+void appendAddress(std::string &s, LongAddress address) {
+    appendHex(s, address >> 16, 2);
+    s += ':';
+    appendHex(s, address, 4);
+}
+
+//appends the comment column with the address and the bytes of a line and ends it
+void finishLine(std::string &out, std::size_t lineStart, LongAddress address, const uint8_t *bytes,
+                std::size_t count) {
+    const std::size_t length = out.size() - lineStart;
+    out.append(length < CommentColumn ? CommentColumn - length : 1, ' ');
+    out += "; ";
+    appendAddress(out, address);
+    if(count != 0) {
+        out += ' ';
+    }
+    for(std::size_t i = 0; i < count; ++i) {
+        out += ' ';
+        appendHex(out, bytes[i], 2);
+    }
+    out += '\n';
+}
+
+}
+
+ListingWriter::ListingWriter(const Analysis &analysis)
+    : m_Analysis(analysis) {
+}
+
+std::string ListingWriter::format(const Instruction &instruction) const {
+    std::string s(instruction.mnemonic());
+    const AddressingMode mode = instruction.addressingMode();
+    if(instruction.size() == 1) {
+        if(mode == ACCUMULATOR) {
+            s += " A";
+        }
+        return s;
+    }
+
+    s += ' ';
+    if(instruction.hasTarget()) {
+        const LongAddress target = instruction.target();
+        const std::string *label = m_Analysis.xrefs().labelAt(target);
+        if(label != nullptr) {
+            s += *label;
+        } else if(instruction.size() == 4) {
+            s += '$';
+            appendHex(s, target, 6);
+        } else {
+            s += '$';
+            appendHex(s, target, 4);
+        }
+    } else if(mode == BLOCK_MOVE) {
+        //the destination bank is encoded first, but the source is written first
+        s += "$";
+        appendHex(s, instruction.operand() >> 8, 2);
+        s += ",$";
+        appendHex(s, instruction.operand(), 2);
+    } else {
+        const OperandSyntax syntax = operandSyntax(mode);
+        s += syntax.prefix;
+        appendHex(s, instruction.operand(), 2 * (instruction.size() - 1));
+        s += syntax.suffix;
+    }
+    return s;
+}
+
+void ListingWriter::writeAnnotations(std::string &out, LongAddress start, LongAddress end) const {
+    const ImageAddress offset = m_Analysis.rom().imageAddress(start);
+    if(offset == ImageAddress(-1)) {
+        return;
+    }
+
+    m_Analysis.annotations().forEachOverlapping(offset, offset + (end - start),
+    [&](const Annotations::Region & region) {
+        if(region.start < offset) {
+            return; //started on an earlier line
+        }
+        out += "; ";
+        if(region.value.kind != RegionKind::COMMENT) {
+            out += Annotations::kindName(region.value.kind);
+            if(!region.value.text.empty()) {
+                out += ": ";
+            }
+        }
+        out += region.value.text;
+        out += '\n';
+    });
+}
+
+bool ListingWriter::dataLine(LongAddress position, LongAddress end, LongAddress &lineEnd, bool &text) const {
+    const SNESROM &rom = m_Analysis.rom();
+
+    //images are mapped in pieces of at least 32 KB, within them CPU and image addresses are contiguous
+    const LongAddress pieceEnd = std::min<LongAddress>(end, (position | 0x7FFF) + 1);
+    if(rom.data(position) == nullptr) {
+        lineEnd = pieceEnd;
+        return false;
+    }
+
+    const uint32_t offset = rom.imageAddress(position);
+    const Annotations::Region *data = m_Analysis.annotations().dataAt(offset);
+    text = data != nullptr && data->value.kind == RegionKind::TEXT;
+    lineEnd = std::min<LongAddress>(pieceEnd, position + (text ? CharactersPerLine : BytesPerLine));
+
+    //a line does not cross the bounds of an annotation or a label
+    m_Analysis.annotations().forEachOverlapping(offset, offset + (lineEnd - position),
+    [&](const Annotations::Region & region) {
+        if(region.start > offset) {
+            lineEnd = std::min<LongAddress>(lineEnd, position + (region.start - offset));
+        }
+        if(region.end < offset + (lineEnd - position)) {
+            lineEnd = std::min<LongAddress>(lineEnd, position + (region.end - offset));
+        }
+    });
+    const CrossReferences::LabelMap &labels = m_Analysis.xrefs().labels();
+    CrossReferences::LabelMap::const_iterator label = labels.upper_bound(position);
+    if(label != labels.end() && label->first < lineEnd) {
+        lineEnd = label->first;
+    }
+    while(rom.data(position, lineEnd - position) == nullptr) {
+        --lineEnd; //the image ends within the line
+    }
+    return true;
+}
+
+void ListingWriter::writeData(std::string &out, const ListingLine &line) const {
+    const uint8_t *bytes = m_Analysis.rom().data(line.address);
+    const std::size_t lineStart = out.size();
+    const std::size_t count = line.end - line.address;
+    out += "    db ";
+    if(line.text) {
+        bool quoted = false;
+        for(std::size_t i = 0; i < count; ++i) {
+            const bool printable = bytes[i] >= 0x20 && bytes[i] < 0x7F && bytes[i] != '"';
+            if(printable && !quoted) {
+                out += i != 0 ? ",\"" : "\"";
+                quoted = true;
+            } else if(!printable && quoted) {
+                out += "\",";
+                quoted = false;
+            } else if(!printable && i != 0) {
+                out += ',';
+            }
+            if(printable) {
+                out += static_cast<char>(bytes[i]);
+            } else {
+                out += '$';
+                appendHex(out, bytes[i], 2);
+            }
+        }
+        if(quoted) {
+            out += '"';
+        }
+    } else {
+        for(std::size_t i = 0; i < count; ++i) {
+            out += i != 0 ? ",$" : "$";
+            appendHex(out, bytes[i], 2);
+        }
+    }
+    finishLine(out, lineStart, line.address, bytes, line.text ? 0 : count);
+}
+
+std::size_t ListingWriter::lineCount(const ListingLine &line) const {
+    std::size_t count = 1;
+    const ImageAddress offset = m_Analysis.rom().imageAddress(line.address);
+    if(offset != ImageAddress(-1)) {
+        m_Analysis.annotations().forEachOverlapping(offset, offset + (line.end - line.address),
+        [&](const Annotations::Region & region) {
+            if(region.start >= offset) {
+                ++count;
+            }
+        });
+    }
+    if(m_Analysis.xrefs().labelAt(line.address) != nullptr) {
+        ++count;
+    }
+    return count;
+}
+
+void ListingWriter::writeLine(std::string &out, const ListingLine &line) const {
+    writeAnnotations(out, line.address, line.end);
+    const std::string *label = m_Analysis.xrefs().labelAt(line.address);
+    if(label != nullptr) {
+        out += *label;
+        out += ":\n";
+    }
+
+    if(line.instruction == nullptr) {
+        writeData(out, line);
+        return;
+    }
+    const std::size_t lineStart = out.size();
+    out += "    ";
+    out += format(*line.instruction);
+    finishLine(out, lineStart, line.address, m_Analysis.rom().data(line.address), line.instruction->size());
+}
+
+void ListingWriter::render(std::string &out, LongAddress start, LongAddress end) const {
+    forEachLine(start, end, [&](const ListingLine & line) {
+        writeLine(out, line);
+        return true;
+    });
+}
+
+void ListingWriter::write(std::string &out, LongAddress start, LongAddress end) const {
+    INSTRUMENT_PHASE(FORMATTING);
+    render(out, start, end);
+}
+
+void ListingWriter::write(std::ostream &stream, LongAddress start, LongAddress end, unsigned int threads) const {
+    INSTRUMENT_PHASE(FORMATTING);
+
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const std::vector<LongAddress> bounds = chunkBounds(start, end);
+    if(threads > 1 && bounds.size() > 2) {
+        renderParallel(stream, bounds, threads);
+        return;
+    }
+
+    std::string out;
+    render(out, start, end);
+    stream.write(out.data(), out.size());
+}
+
+std::vector<LongAddress> ListingWriter::chunkBounds(LongAddress start, LongAddress end) const {
+    std::vector<LongAddress> bounds(1, start);
+    if(start >= end) {
+        return bounds;
+    }
+
+    //like render, only consider blocks from the one before start on
+    const ControlFlowGraph::BlockMap &blocks = m_Analysis.graph().blocks();
+    ControlFlowGraph::BlockMap::const_iterator it = blocks.upper_bound(start);
+    if(it != blocks.begin()) {
+        --it;
+    }
+
+    LongAddress reach = 0; //the largest end of all blocks starting before the candidate
+    for(LongAddress bound = (start | (ChunkSize - 1)) + 1; bound < end; bound += ChunkSize) {
+        for(; it != blocks.end() && it->first < bound; ++it) {
+            reach = std::max(reach, it->second.end);
+        }
+        if(reach <= bound) {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+void ListingWriter::renderParallel(std::ostream &stream, const std::vector<LongAddress> &bounds,
+                                   unsigned int threads) const {
+    struct Chunk {
+        std::string text;
+        bool done;
+    };
+    const std::size_t count = bounds.size() - 1;
+    std::vector<Chunk> chunks(count, Chunk{std::string(), false});
+    std::atomic<std::size_t> next(0);
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    //workers take the chunks in address order, so the earliest ones are done first
+    auto work = [&]() {
+        TRACE_SCOPE("render_worker");
+        std::size_t rendered = 0;
+        for(std::size_t i = next++; i < count; i = next++) {
+            std::string text;
+            render(text, bounds[i], bounds[i + 1]);
+            ++rendered;
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks[i].text.swap(text);
+            chunks[i].done = true;
+            finished.notify_all();
+        }
+        TRACE_ITERATIONS(rendered);
+    };
+
+    std::vector<std::thread> workers;
+    for(unsigned int i = 0; i < std::min<std::size_t>(threads, count); ++i) {
+        workers.push_back(std::thread(work));
+    }
+
+    //chunks are written as soon as all before them are, so finished text does not pile up
+    for(std::size_t i = 0; i < count; ++i) {
+        std::string text;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]() {
+                return chunks[i].done;
+            });
+            text.swap(chunks[i].text);
+        }
+        stream.write(text.data(), text.size());
+    }
+
+    for(std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+ListingIndex::ListingIndex(const Analysis &analysis, LongAddress start, LongAddress end)
+    : m_Writer(analysis),
+      m_Start(start),
+      m_End(end),
+      m_Lines(0) {
+    //starting at start trivially yields the same lines
+    m_Checkpoints.push_back(Checkpoint{start, 0});
+    m_Writer.forEachLine(start, end, [this](const ListingLine & line) {
+        if(line.resumable && m_Lines - m_Checkpoints.back().line >= CheckpointInterval) {
+            m_Checkpoints.push_back(Checkpoint{line.address, static_cast<uint32_t>(m_Lines)});
+        }
+        m_Lines += m_Writer.lineCount(line);
+        return true;
+    });
+    m_Checkpoints.shrink_to_fit();
+}
+
+const ListingIndex::Checkpoint &ListingIndex::checkpointBeforeLine(std::size_t line) const {
+    std::vector<Checkpoint>::const_iterator it = std::upper_bound(m_Checkpoints.begin(), m_Checkpoints.end(), line,
+    [](std::size_t line, const Checkpoint & checkpoint) {
+        return line < checkpoint.line;
+    });
+    return *std::prev(it); //the first checkpoint is line 0
+}
+
+bool ListingIndex::addressOf(std::size_t line, LongAddress &address) const {
+    if(line >= m_Lines) {
+        return false;
+    }
+
+    const Checkpoint &checkpoint = checkpointBeforeLine(line);
+    std::size_t current = checkpoint.line;
+    m_Writer.forEachLine(checkpoint.address, m_End, [&](const ListingLine & listingLine) {
+        current += m_Writer.lineCount(listingLine);
+        if(current <= line) {
+            return true;
+        }
+        address = listingLine.address;
+        return false;
+    });
+    return true;
+}
+
+bool ListingIndex::lineOf(LongAddress address, std::size_t &line) const {
+    if(address < m_Start || address >= m_End) {
+        return false;
+    }
+
+    //the addresses of the lines ascend, so do the ones of the checkpoints
+    std::vector<Checkpoint>::const_iterator it = std::upper_bound(m_Checkpoints.begin(), m_Checkpoints.end(),
+    address, [](LongAddress address, const Checkpoint & checkpoint) {
+        return address < checkpoint.address;
+    });
+    const Checkpoint &checkpoint = *std::prev(it); //the first checkpoint is m_Start
+    std::size_t current = checkpoint.line;
+    return !m_Writer.forEachLine(checkpoint.address, m_End, [&](const ListingLine & listingLine) {
+        if(listingLine.end <= address) {
+            current += m_Writer.lineCount(listingLine);
+            return true;
+        }
+        line = current;
+        return false;
+    });
+}
+
+std::size_t ListingIndex::write(std::string &out, std::size_t first, std::size_t count) const {
+    if(first >= m_Lines || count == 0) {
+        return 0;
+    }
+    const std::size_t last = std::min(m_Lines, first + count);
+
+    const Checkpoint &checkpoint = checkpointBeforeLine(first);
+    std::size_t current = checkpoint.line;
+    std::string lines;
+    m_Writer.forEachLine(checkpoint.address, m_End, [&](const ListingLine & line) {
+        const std::size_t lineCount = m_Writer.lineCount(line);
+        if(current + lineCount <= first) {
+            current += lineCount;
+            return true;
+        }
+
+        //the label and annotation lines of the first one may lie before the window
+        lines.clear();
+        m_Writer.writeLine(lines, line);
+        std::size_t begin = 0;
+        for(; current < first; ++current) {
+            begin = lines.find('\n', begin) + 1;
+        }
+        std::size_t finish = begin;
+        for(; current < last && finish < lines.size(); ++current) {
+            finish = lines.find('\n', finish) + 1;
+        }
+        out.append(lines, begin, finish - begin);
+        return current < last;
+    });
+    return last - first;
+}
+
+std::size_t ListingIndex::memoryUsage() const {
+    return sizeof(*this) + m_Checkpoints.capacity() * sizeof(Checkpoint);
+}
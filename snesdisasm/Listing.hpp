@@ -0,0 +1,212 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LISTING_HPP
+#define LISTING_HPP
+
+#include "Analysis.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*! \brief One instruction or run of data bytes of a listing, written as one line after the comment lines of the
+ *         annotations starting within it and the line of its label
+ */
+struct ListingLine {
+    LongAddress address;
+    LongAddress end; //the first address after its bytes
+    const Instruction *instruction; //nullptr for data
+    bool text; //data within a TEXT region
+    bool resumable; //starting at address yields the same lines from here on as starting before it
+};
+
+/*! \brief Writes an assembler-like text listing of an \see Analysis
+ *
+ *  Every line holds one instruction or a run of data bytes, followed by a comment with its address and bytes.
+ *  Labels get a line of their own, annotations a comment line where they start. Bytes that are not part of a
+ *  basic block are written as data, in text form within TEXT regions. Data lines are cut at labels and at the
+ *  bounds of annotations.
+ *
+ *  Labels and annotations are looked up once per line in O(log n), so writing a range takes time proportional
+ *  to its length.
+ *
+ *  Large ranges can be formatted by several threads. The range is split into chunks at multiples of
+ *  \see ChunkSize that no instruction crosses. Data lines never cross such a multiple either, so every chunk
+ *  starts with the same line the serial writer would write there and the concatenated chunks are identical to
+ *  its output.
+ */
+class ListingWriter {
+  public:
+    enum { BytesPerLine = 8, CharactersPerLine = 32, ChunkSize = 0x8000 };
+  private:
+    const Analysis &m_Analysis;
+
+    void render(std::string &out, LongAddress start, LongAddress end) const;
+    void renderParallel(std::ostream &stream, const std::vector<LongAddress> &bounds, unsigned int threads) const;
+
+    bool dataLine(LongAddress position, LongAddress end, LongAddress &lineEnd, bool &text) const;
+    void writeData(std::string &out, const ListingLine &line) const;
+    void writeAnnotations(std::string &out, LongAddress start, LongAddress end) const;
+  public:
+    /*! \brief Constructs the writer. The analysis has to outlive it.
+     */
+    explicit ListingWriter(const Analysis &analysis);
+
+    /*! \brief Appends the lines of the CPU addresses [start, end) to out
+     *
+     *  Addresses that do not map into the image are skipped.
+     */
+    void write(std::string &out, LongAddress start, LongAddress end) const;
+
+    /*! \brief Writes the lines of [start, end) to stream
+     *
+     *  \param threads the number of threads formatting chunks of the range. 0 uses one per hardware thread.
+     */
+    void write(std::ostream &stream, LongAddress start, LongAddress end, unsigned int threads = 1) const;
+
+    /*! \brief Returns the bounds of the chunks [bounds[i], bounds[i + 1]) [start, end) is split into
+     */
+    std::vector<LongAddress> chunkBounds(LongAddress start, LongAddress end) const;
+
+    /*! \brief Returns the assembler syntax of an instruction, e.g. "LDA $1234,X"
+     *
+     *  The \see Instruction::target of branches, jumps, calls and PER is replaced by their label if there is one.
+     */
+    std::string format(const Instruction &instruction) const;
+
+    /*! \brief Calls f(line) with every \see ListingLine of [start, end) in order until it returns false
+     *
+     *  Nothing is formatted, so this is much cheaper than writing the lines.
+     *
+     *  \return false if f stopped the iteration
+     */
+    template<class F>
+    bool forEachLine(LongAddress start, LongAddress end, F f) const;
+
+    /*! \brief Returns the number of text lines line is written as, including its label and annotations
+     */
+    std::size_t lineCount(const ListingLine &line) const;
+
+    /*! \brief Appends the \see lineCount text lines of line to out
+     */
+    void writeLine(std::string &out, const ListingLine &line) const;
+};
+
+template<class F>
+bool ListingWriter::forEachLine(LongAddress start, LongAddress end, F f) const {
+    const ControlFlowGraph &graph = m_Analysis.graph();
+    const ControlFlowGraph::BlockMap &blocks = graph.blocks();
+    ControlFlowGraph::BlockMap::const_iterator it = blocks.upper_bound(start);
+    if(it != blocks.begin()) {
+        --it; //the previous block may reach into the range
+    }
+
+    LongAddress position = start;
+    while(position < end) {
+        while(it != blocks.end() && it->second.end <= position && it->first < position) {
+            ++it;
+        }
+        const LongAddress next = it != blocks.end() && it->first < end ? std::max(it->first, position) : end;
+        if(position < next) {
+            //every block starting before position ends before it, so data lines are always resumable
+            ListingLine line = {position, position, nullptr, false, true};
+            if(dataLine(position, next, line.end, line.text) && !f(line)) {
+                return false;
+            }
+            position = line.end;
+            continue;
+        }
+
+        bool stopped = false;
+        graph.forEachInstruction(it->second, [&](LongAddress address, const Instruction & instruction,
+        const MachineState &) {
+            if(stopped || address < position || address >= end) {
+                return;
+            }
+            //starting at address finds this block again unless an overlapping one starts between them
+            const ListingLine line = {address, address + instruction.size(), &instruction, false,
+                                      address == position && std::prev(blocks.upper_bound(address)) == it
+                                     };
+            stopped = !f(line);
+            position = instruction.nextAddress();
+        });
+        if(stopped) {
+            return false;
+        }
+        position = std::max(position, it->second.end);
+        ++it;
+    }
+    return true;
+}
+
+/*! \brief Random access to the lines of a listing for viewers
+ *
+ *  The lines of a range are counted once without formatting them. Every \see CheckpointInterval lines, the
+ *  line number and address of a resumable \see ListingLine are kept as a checkpoint. Both the address of a line
+ *  and the line of an address are found by a binary search over the checkpoints and counting from the nearest
+ *  one, and only the lines of the requested window are formatted.
+ */
+class ListingIndex {
+  public:
+    enum { CheckpointInterval = 64 };
+  private:
+    struct Checkpoint {
+        LongAddress address;
+        uint32_t line;
+    };
+
+    ListingWriter m_Writer;
+    LongAddress m_Start;
+    LongAddress m_End;
+    std::vector<Checkpoint> m_Checkpoints;
+    std::size_t m_Lines;
+
+    const Checkpoint &checkpointBeforeLine(std::size_t line) const;
+  public:
+    /*! \brief Counts the lines of [start, end). The analysis has to outlive the index.
+     */
+    ListingIndex(const Analysis &analysis, LongAddress start, LongAddress end);
+
+    LongAddress start() const { return m_Start; }
+    LongAddress end() const { return m_End; }
+
+    /*! \brief Returns the number of lines of the listing
+     */
+    std::size_t size() const { return m_Lines; }
+
+    /*! \brief Returns the address of the instruction or data a line belongs to, false if line is past the end
+     */
+    bool addressOf(std::size_t line, LongAddress &address) const;
+
+    /*! \brief Returns the first line of the instruction or data containing address, or of the next one if no line
+     *         contains it. False if there is none.
+     */
+    bool lineOf(LongAddress address, std::size_t &line) const;
+
+    /*! \brief Appends the lines [first, first + count) to out
+     *
+     *  \return the number of lines appended, less than count at the end of the listing
+     */
+    std::size_t write(std::string &out, std::size_t first, std::size_t count) const;
+
+    std::size_t memoryUsage() const;
+};
+
+#endif // LISTING_HPP
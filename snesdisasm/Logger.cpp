@@ -17,6 +17,7 @@ Logger &Logger::Instance() {
 }
 
 void Logger::closeLog() {
+    std::lock_guard<std::mutex> lock(mMutex);
     mLogStream.close();
 }
 
@@ -26,6 +27,7 @@ void Logger::writeLog(const std::string &kindOfMessage, const std::string &messa
 }
 
 void Logger::log(Logger::LogType type, const string &message, const string &location) {
+    std::lock_guard<std::mutex> lock(mMutex);
     switch(type) {
     case Logger::LogType::ERROR:
         writeLog("FEHLER : ", message, location);
@@ -47,13 +49,15 @@ void Logger::log(Logger::LogType type, const string &message, const string &loca
 
 //Einsatz um etwas voneinander deutlich abzutrennen (Beispiel nach ProgrammEnde um vom nchsten Start abgetrennt zu sein)
 void Logger::logBreak() {
+    std::lock_guard<std::mutex> lock(mMutex);
     mLastLog.clear();
     mLastLog.resize(256);
     mLastLog.assign(253, '-');
     mLogStream << mLastLog << std::endl;
 }
 
-const std::string &Logger::lastLog() const {
+std::string Logger::lastLog() const {
+    std::lock_guard<std::mutex> lock(mMutex);
     return mLastLog;
 }
 
@@ -2,17 +2,21 @@
 #define LOGGER_H
 
 #include <fstream>
+#include <mutex>
 #include <string>
 
 //shorthand for the lazy
 #define LOG_SRC(type, msg) Logger::Instance().log((Logger::LogType::type), (msg), (__FILE__":") + std::to_string(__LINE__))
 
 /*! \brief A Logger to write additional status informations of the program to a file.
+ *
+ *  All methods may be called from several threads at once. Entries are serialized by a mutex.
  */
 class Logger {
   private:
     std::ofstream mLogStream;
     std::string mLastLog;
+    mutable std::mutex mMutex;
 
     void writeLog(const std::string &kindOfMessage, const std::string &message, const std::string &location);
   public:
@@ -63,9 +67,9 @@ class Logger {
      */
     void logBreak();
 
-    /*! \brief Return the last line as it was written to the log file
+    /*! \brief Return a copy of the last line as it was written to the log file
      */
-    const std::string &lastLog() const;
+    std::string lastLog() const;
 };
 
 #endif // LOGGER_H
@@ -15,6 +15,7 @@
  */
 
 #include "MachineState.hpp"
+#include "Instructions.hpp"
 
 MachineState::MachineState() {
 
@@ -23,3 +24,22 @@ MachineState::MachineState() {
 const CPUState &MachineState::getCPUStateRef() const {
     return m_CPUState;
 }
+
+MachineState::MachineState(uint8_t flagRegister) {
+    m_CPUState.setFlagRegister(flagRegister);
+}
+
+CPUState &MachineState::getCPUStateRef() {
+    return m_CPUState;
+}
+
+void MachineState::update(const Instruction &instruction) {
+    switch(instruction.opCode()) {
+    case 0xC2: //Reset Processor Status Bits
+        m_CPUState.resetFlagRegister(instruction.operand());
+        break;
+    case 0xE2: //Set Processor Status Bits
+        m_CPUState.setFlagRegister(instruction.operand());
+        break;
+    }
+}
@@ -19,6 +19,8 @@
 
 #include "CPUState.hpp"
 
+class Instruction;
+
 /*! \brief This class represents an incomplete cpu state that controls parsing
  */
 class MachineState {
@@ -27,7 +29,18 @@ private:
 public:
     MachineState();
 
+    /*! \brief Constructs a state whose processorflags are set to flagRegister
+     */
+    explicit MachineState(uint8_t flagRegister);
+
     const CPUState& getCPUStateRef() const;
+    CPUState& getCPUStateRef();
+
+    /*! \brief Applies the effects of an executed instruction that influence parsing
+     *
+     *  Currently these are REP and SEP which change the register sizes and thus the size of immediates.
+     */
+    void update(const Instruction &instruction);
 };
 
 #endif // MACHINESTATE_HPP
@@ -0,0 +1,47 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path, bool sequential)
+    : m_Data(nullptr),
+      m_Size(0) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if(file < 0) {
+        return;
+    }
+    struct stat status;
+    if(fstat(file, &status) == 0 && status.st_size > 0) {
+        void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if(data != MAP_FAILED) {
+            madvise(data, status.st_size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+            m_Data = static_cast<const uint8_t *>(data);
+            m_Size = status.st_size;
+        }
+    }
+    close(file);
+}
+
+MappedFile::~MappedFile() {
+    if(m_Data != nullptr) {
+        munmap(const_cast<uint8_t *>(m_Data), m_Size);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*! \brief A file mapped read-only into memory
+ *
+ *  Empty files and files that cannot be opened are not mapped, \see isOpen tells. The mapping is advised for
+ *  sequential reading unless random access is requested.
+ */
+class MappedFile {
+  private:
+    const uint8_t *m_Data;
+    std::size_t m_Size;
+  public:
+    explicit MappedFile(const std::string &path, bool sequential = true);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return m_Data != nullptr; }
+    const uint8_t *data() const { return m_Data; }
+    std::size_t size() const { return m_Size; }
+};
+
+#endif // MAPPEDFILE_HPP
@@ -0,0 +1,53 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MemoryReport.hpp"
+
+#include <sstream>
+
+void MemoryReport::add(const std::string &name, std::size_t count, std::size_t bytes) {
+    Part part = {name, count, bytes};
+    m_Parts.push_back(part);
+}
+
+void MemoryReport::setArena(std::size_t used, std::size_t reserved) {
+    m_ArenaUsed = used;
+    m_ArenaReserved = reserved;
+}
+
+std::size_t MemoryReport::total() const {
+    std::size_t total = 0;
+    for(const Part &part : m_Parts) {
+        total += part.bytes;
+    }
+    return total;
+}
+
+std::string MemoryReport::toJSON() const {
+    std::ostringstream json;
+    json << "{\"total\":" << total() << ",\"arena_used\":" << m_ArenaUsed << ",\"arena_reserved\":"
+         << m_ArenaReserved << ",\"parts\":{";
+    for(std::size_t i = 0; i < m_Parts.size(); ++i) {
+        const Part &part = m_Parts[i];
+        json << (i != 0 ? "," : "") << "\"" << part.name << "\":{"
+             << "\"count\":" << part.count << ","
+             << "\"bytes\":" << part.bytes << ","
+             << "\"bytes_per_item\":" << (part.count != 0 ? static_cast<double>(part.bytes) / part.count : 0.0)
+             << "}";
+    }
+    json << "}}";
+    return json.str();
+}
@@ -0,0 +1,72 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MEMORYREPORT_HPP
+#define MEMORYREPORT_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*! \brief The memory taken by the parts of an analysis
+ *
+ *  Every part has a number of items, e.g. blocks or instructions, and the bytes they occupy. Containers are
+ *  measured by their capacity. Nodes of maps are estimated as their value plus four pointers (three links and
+ *  the color, padded), which is what the common implementations allocate. Heap memory owned by the values
+ *  themselves, e.g. long label names, is not counted.
+ */
+class MemoryReport {
+  public:
+    struct Part {
+        std::string name;
+        std::size_t count;
+        std::size_t bytes;
+    };
+  private:
+    std::vector<Part> m_Parts;
+    std::size_t m_ArenaUsed;
+    std::size_t m_ArenaReserved;
+  public:
+    MemoryReport() : m_ArenaUsed(0), m_ArenaReserved(0) {}
+
+    void add(const std::string &name, std::size_t count, std::size_t bytes);
+
+    /*! \brief Records the state of the arena the parts are allocated from. It is not part of the total.
+     */
+    void setArena(std::size_t used, std::size_t reserved);
+
+    const std::vector<Part> &parts() const { return m_Parts; }
+
+    /*! \brief Returns the sum of all parts
+     */
+    std::size_t total() const;
+
+    /*! \brief Returns the report as a JSON object with the bytes per item of every part
+     */
+    std::string toJSON() const;
+
+    template<class Vector>
+    static std::size_t vectorBytes(const Vector &vector) {
+        return vector.capacity() * sizeof(typename Vector::value_type);
+    }
+
+    template<class Map>
+    static std::size_t mapBytes(const Map &map) {
+        return map.size() * (sizeof(typename Map::value_type) + 4 * sizeof(void *));
+    }
+};
+
+#endif // MEMORYREPORT_HPP
@@ -16,7 +16,7 @@ std::ostream& operator<<(std::ostream &stream, const RomLayout &layout)
         stream << "ExLoROM (unsupported)";
         break;
     case 3:
-        stream << "ExHiROM (unsupported)";
+        stream << "ExHiROM";
         break;
     default: stream << "Error";
     }
@@ -99,7 +99,7 @@ ImageAddress LoROMAddress::toImageAddress() const {
         return ImageAddress(-1); //the address is actually a RAM address
     } else {
         //it is actually a ROM address
-        imageAddress = (bank & 0x7F)*0x10000/2+bankAddress()&0x7FFF;
+        imageAddress = (bank & 0x7F)*0x8000 + (bankAddress() & 0x7FFF);
     }
 
     return ImageAddress(imageAddress);
@@ -118,6 +118,10 @@ void LoROMAddress::fromImageAddress(ImageAddress imageAdress) {
     m_Address = (bank << 16) | bankAddress;
 }
 
+ROMAddress *LoROMAddress::clone() const {
+    return new LoROMAddress(*this);
+}
+
 HiROMAddress::HiROMAddress()
     : ROMAddress()
 {
@@ -163,15 +167,65 @@ ImageAddress HiROMAddress::toImageAddress() const {
 void HiROMAddress::fromImageAddress(ImageAddress imageAdress) {
     assert(imageAdress < 0x400000);
 
-    uint8_t bank = imageAdress / 0x10000;
-    uint16_t bankAddress = imageAdress % 0xFFFF;
-    if(imageAdress > 0x3DFFFF) {
-        //we have to use the second mirror because otherwise we would refer to system RAM
-        bank += 0x80;
+    //only the banks C0-FF show the whole 64 KB of a bank
+    uint8_t bank = 0xC0 | (imageAdress >> 16);
+    uint16_t bankAddress = imageAdress & 0xFFFF;
+    m_Address = (bank << 16) | bankAddress;
+}
+
+ROMAddress *HiROMAddress::clone() const {
+    return new HiROMAddress(*this);
+}
+
+ExHiROMAddress::ExHiROMAddress()
+    : ROMAddress()
+{
+
+}
+
+ExHiROMAddress::ExHiROMAddress(ImageAddress imageAddress)
+{
+    fromImageAddress(imageAddress);
+}
+
+ExHiROMAddress::ExHiROMAddress(uint8_t bankID, uint16_t bankAddress)
+    : ROMAddress(bankID, bankAddress)
+{
+
+}
+
+ImageAddress ExHiROMAddress::toImageAddress() const {
+    uint8_t bank = this->bank();
+
+    if(bank == 0x7E || bank == 0x7F) {
+        return ImageAddress(-1); //the address is actually a RAM address
+    }
+    if((bank & 0x7F) < 0x40) {
+        //mirrors 3 and 4 are only accepted in the upper half
+        assert(bankAddress() > 0x7FFF);
     }
+
+    //the banks 80-FF show the lower 4 MB, 00-7D the upper ones
+    const uint32_t half = (bank & 0x80) != 0 ? 0 : 0x400000;
+    return ImageAddress(half + ((bank & 0x3F) << 16) + bankAddress());
+}
+
+void ExHiROMAddress::fromImageAddress(ImageAddress imageAdress) {
+    assert(imageAdress < 0x800000);
+
+    //the banks C0-FF and 40-7D show the whole 64 KB of a bank, the last 128 KB only appear in 3E and 3F
+    uint8_t bank = imageAdress < 0x400000 ? 0xC0 | (imageAdress >> 16) : 0x40 | ((imageAdress >> 16) & 0x3F);
+    if(bank == 0x7E || bank == 0x7F) {
+        bank &= 0x3F;
+    }
+    uint16_t bankAddress = imageAdress & 0xFFFF;
     m_Address = (bank << 16) | bankAddress;
 }
 
+ROMAddress *ExHiROMAddress::clone() const {
+    return new ExHiROMAddress(*this);
+}
+
 ROMAddress* getROMAddressObject(RomLayout layout) {
     if(layout==RomLayout::LoROM()) {
         return new LoROMAddress();
@@ -179,5 +233,8 @@ ROMAddress* getROMAddressObject(RomLayout layout) {
     if(layout==RomLayout::HiROM()) {
         return new HiROMAddress();
     }
+    if(layout==RomLayout::ExHiROM()) {
+        return new ExHiROMAddress();
+    }
     //!ToDo Throw exceptions. EXCEPTIONS FOR EVERYONE!!!
 }
@@ -14,12 +14,15 @@ class RomLayout{
 public:
     static RomLayout LoROM(){ return RomLayout(0); }
     static RomLayout HiROM(){ return RomLayout(1); }
-    static RomLayout ExLoROM(){ return RomLayout(2);} //this and
-    static RomLayout ExHiROM(){ return RomLayout(3);} //this is currently not supported
+    static RomLayout ExLoROM(){ return RomLayout(2);} //this is currently not supported
+    static RomLayout ExHiROM(){ return RomLayout(3);}
     static RomLayout Error(){ return RomLayout(4);}
 
     bool isLoROM() const { return m_layout == 0; }
-    static RomLayout fromByteCode(uint8_t code){ if((code & 0x01) != 0x01) return LoROM(); else return HiROM();}
+    static RomLayout fromByteCode(uint8_t code){
+        if((code & 0x0F) == 0x05) return ExHiROM();
+        if((code & 0x01) != 0x01) return LoROM(); else return HiROM();
+    }
     bool operator==(const RomLayout& other) const { return m_layout == other.m_layout; }
 
     friend std::ostream& operator<<(std::ostream &stream, const RomLayout &layout);
@@ -27,6 +30,11 @@ public:
 
 STRONG_TYPEDEF(uint32_t, ImageAddress)
 
+/*!
+ * \brief A 24 bit address as seen by the CPU i.e. (bank << 16) | bankAddress.
+ */
+typedef uint32_t LongAddress;
+
 class ROMAddress {
 protected:
     uint32_t m_Address;
@@ -76,11 +84,18 @@ public:
 
     /*!
      * \brief calculates the ROM address from a given image offset.
-     * \param layout is the layout of the ROM, should be RomLayout::LoROM() or RomLayout::HiROM().
+     * \param layout is the layout of the ROM, should be RomLayout::LoROM(), RomLayout::HiROM() or RomLayout::ExHiROM().
      * \param imageOffset is the offset in the image from which the class evaluates it's ROM address.
      */
     virtual void fromImageAddress(ImageAddress imageAddress) = 0;
 
+    /*!
+     * \brief returns a heap allocated copy of the same type. The caller owns it.
+     */
+    virtual ROMAddress *clone() const = 0;
+
+    virtual ~ROMAddress() {}
+
     uint8_t bank() const { return (m_Address & 0xFF0000) >> 16; }
     uint16_t bankAddress() const { return m_Address & 0x00FFFF; }
     uint8_t page() const { return (m_Address & 0x00FF00) >> 8; }
@@ -114,6 +129,7 @@ public:
     LoROMAddress(uint8_t bankID, uint16_t bankAddress);
     virtual ImageAddress toImageAddress() const override;
     virtual void fromImageAddress(ImageAddress imageAddress) override;
+    virtual ROMAddress *clone() const override;
 };
 
 class HiROMAddress : public ROMAddress {
@@ -135,6 +151,34 @@ public:
     HiROMAddress(uint8_t bankID, uint16_t bankAddress);
     virtual ImageAddress toImageAddress() const override;
     virtual void fromImageAddress(ImageAddress imageAddress) override;
+    virtual ROMAddress *clone() const override;
+};
+
+/*!
+ * \brief An address in a ROM of up to 8 MB. The first 4 MB are mapped like a HiROM into the banks C0-FF and their
+ * mirrors 80-BF, the upper 4 MB into the banks 40-7D and 00-3F. The end of the image is only visible in the upper
+ * halves of 3E and 3F, since 7E and 7F are work RAM.
+ */
+class ExHiROMAddress : public ROMAddress {
+public:
+    /*!
+     * \brief Default constructs an address pointing at 00:0000
+     */
+    ExHiROMAddress();
+    /*!
+     * \brief Construct the ExHiROMAddress from a given Image Address.
+     * \param imageAddress is the address in an image the object will point to.
+     */
+    explicit ExHiROMAddress(ImageAddress imageAddress);
+    /*!
+     * \brief ExHiROMAddress creates an address object at bankID:bankAddress.
+     * \param bankID the ID of the bank.
+     * \param bankAddress the address in a bank.
+     */
+    ExHiROMAddress(uint8_t bankID, uint16_t bankAddress);
+    virtual ImageAddress toImageAddress() const override;
+    virtual void fromImageAddress(ImageAddress imageAddress) override;
+    virtual ROMAddress *clone() const override;
 };
 
 
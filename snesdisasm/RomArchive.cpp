@@ -0,0 +1,262 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "RomArchive.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+#ifdef SNESDISASM_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+const std::size_t InputChunkSize = 64 * 1024;
+//the largest ROMs are 8 MB, anything announcing much more is damaged
+const uint32_t MaxImageSize = 64 * 1024 * 1024;
+
+uint32_t read16(const uint8_t *data) {
+    return data[0] | (data[1] << 8);
+}
+
+uint32_t read32(const uint8_t *data) {
+    return read16(data) | (read16(data + 2) << 16);
+}
+
+//the magic and the compression method, which is always deflate
+bool isGzip(const uint8_t *data, std::size_t length) {
+    return length >= 3 && data[0] == 0x1F && data[1] == 0x8B && data[2] == 0x08;
+}
+
+bool isZip(const uint8_t *data, std::size_t length) {
+    return length >= 4 && read32(data) == 0x04034B50;
+}
+
+/*! \brief Reads length bytes at offset of in
+ */
+bool readAt(std::istream &in, uint64_t offset, uint8_t *destination, std::size_t length) {
+    in.clear();
+    in.seekg(offset);
+    in.read(reinterpret_cast<char *>(destination), length);
+    return static_cast<std::size_t>(in.gcount()) == length;
+}
+
+bool hasROMExtension(const std::string &name) {
+    const char *extensions[] = {".sfc", ".smc", ".swc", ".fig"};
+    if(name.size() < 4) {
+        return false;
+    }
+    std::string extension = name.substr(name.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    return std::find(extensions, extensions + 4, extension) != extensions + 4;
+}
+
+#ifdef SNESDISASM_ZLIB
+
+/*! \brief Inflates the compressed bytes following the current position of in into image, which already has
+ *         the final size
+ *
+ *  \param windowBits selects the format as for inflateInit2
+ *  \param compressedSize the number of compressed bytes or 0 to read until the stream ends
+ */
+bool inflateInto(std::istream &in, int windowBits, uint64_t compressedSize, std::vector<uint8_t> &image) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    if(inflateInit2(&stream, windowBits) != Z_OK) {
+        return false;
+    }
+
+    std::vector<uint8_t> input(InputChunkSize);
+    stream.next_out = image.data();
+    stream.avail_out = image.size();
+    uint64_t remaining = compressedSize != 0 ? compressedSize : ~uint64_t(0);
+    int result = Z_OK;
+    while(result == Z_OK) {
+        if(stream.avail_in == 0) {
+            in.read(reinterpret_cast<char *>(input.data()), std::min<uint64_t>(input.size(), remaining));
+            stream.avail_in = in.gcount();
+            stream.next_in = input.data();
+            remaining -= stream.avail_in;
+            if(stream.avail_in == 0) {
+                break; //truncated
+            }
+        }
+        //the output never grows, a ROM larger than announced fails with Z_BUF_ERROR
+        result = inflate(&stream, Z_NO_FLUSH);
+    }
+
+    const bool complete = result == Z_STREAM_END && stream.avail_out == 0;
+    inflateEnd(&stream);
+    return complete;
+}
+
+bool readGzip(std::istream &in, uint64_t base, uint64_t size, std::vector<uint8_t> &image) {
+    //the trailer ends with the uncompressed size modulo 2^32, which is plenty for ROMs
+    uint8_t trailer[4];
+    if(size < 18 || !readAt(in, base + size - 4, trailer, sizeof(trailer)) || read32(trailer) > MaxImageSize) {
+        return false;
+    }
+    image.resize(read32(trailer));
+
+    in.clear();
+    in.seekg(base);
+    return inflateInto(in, 16 + MAX_WBITS, 0, image); //the gzip wrapper verifies the CRC-32 itself
+}
+
+bool readZip(std::istream &in, uint64_t base, uint64_t size, std::vector<uint8_t> &image) {
+    //the end of central directory record is followed by a comment of at most 64 KB
+    const std::size_t EndRecordSize = 22;
+    if(size < EndRecordSize) {
+        return false;
+    }
+    std::vector<uint8_t> tail(std::min<uint64_t>(size, EndRecordSize + 0xFFFF));
+    if(!readAt(in, base + size - tail.size(), tail.data(), tail.size())) {
+        return false;
+    }
+    std::size_t end = tail.size() - EndRecordSize + 1;
+    do {
+        --end;
+    } while(end != 0 && read32(&tail[end]) != 0x06054B50);
+    if(read32(&tail[end]) != 0x06054B50) {
+        return false;
+    }
+
+    const uint32_t entries = read16(&tail[end + 10]);
+    const uint32_t directorySize = read32(&tail[end + 12]);
+    const uint32_t directoryOffset = read32(&tail[end + 16]);
+    std::vector<uint8_t> directory(directorySize);
+    if(uint64_t(directoryOffset) + directorySize > size ||
+       !readAt(in, base + directoryOffset, directory.data(), directory.size())) {
+        return false;
+    }
+
+    //the first ROM, or the first file if none is named like one
+    const std::size_t EntrySize = 46;
+    std::size_t chosen = directory.size();
+    bool chosenROM = false;
+    std::size_t position = 0;
+    for(uint32_t i = 0; i < entries && position + EntrySize <= directory.size(); ++i) {
+        const uint8_t *entry = &directory[position];
+        if(read32(entry) != 0x02014B50) {
+            return false;
+        }
+        const std::size_t nameLength = read16(entry + 28);
+        if(position + EntrySize + nameLength > directory.size()) {
+            return false;
+        }
+        const bool rom = hasROMExtension(std::string(reinterpret_cast<const char *>(entry + EntrySize), nameLength));
+        if(read32(entry + 24) != 0 && (chosen == directory.size() || (rom && !chosenROM))) {
+            chosen = position;
+            chosenROM = rom;
+        }
+        position += EntrySize + nameLength + read16(entry + 30) + read16(entry + 32);
+    }
+    if(chosen == directory.size()) {
+        LOG_SRC(ERROR, "The zip archive contains no file");
+        return false;
+    }
+
+    const uint8_t *entry = &directory[chosen];
+    const uint32_t flags = read16(entry + 8);
+    const uint32_t method = read16(entry + 10);
+    const uint32_t crc = read32(entry + 16);
+    const uint32_t compressedSize = read32(entry + 20);
+    const uint32_t uncompressedSize = read32(entry + 24);
+    const uint32_t localOffset = read32(entry + 42);
+    if((flags & 1) != 0 || (method != 0 && method != 8) || compressedSize == 0xFFFFFFFF ||
+       uncompressedSize > MaxImageSize) {
+        LOG_SRC(ERROR, "The ROM in the zip archive is encrypted, too large or compressed with an unsupported method");
+        return false;
+    }
+
+    uint8_t local[30];
+    if(!readAt(in, base + localOffset, local, sizeof(local)) || read32(local) != 0x04034B50) {
+        return false;
+    }
+    const uint64_t dataOffset = uint64_t(localOffset) + sizeof(local) + read16(local + 26) + read16(local + 28);
+    if(dataOffset + compressedSize > size) {
+        return false;
+    }
+
+    image.resize(uncompressedSize);
+    if(method == 0) {
+        if(compressedSize != uncompressedSize || !readAt(in, base + dataOffset, image.data(), image.size())) {
+            return false;
+        }
+    } else {
+        in.clear();
+        in.seekg(base + dataOffset);
+        if(!inflateInto(in, -MAX_WBITS, compressedSize, image)) {
+            return false;
+        }
+    }
+    return crc32(crc32(0, Z_NULL, 0), image.data(), image.size()) == crc;
+}
+
+#endif
+
+}
+
+bool RomArchive::isArchive(const uint8_t *data, std::size_t length) {
+    return isGzip(data, length) || isZip(data, length);
+}
+
+bool RomArchive::read(std::istream &in, std::vector<uint8_t> &image) {
+    image.clear();
+
+    //offsets in the archive are relative to where it starts
+    in.clear();
+    const std::streamoff start = in.tellg();
+    in.seekg(0, std::ios_base::end);
+    const std::streamoff end = in.tellg();
+    uint8_t magic[4];
+    if(start < 0 || end < start || !readAt(in, start, magic, std::min<uint64_t>(end - start, sizeof(magic)))) {
+        return false;
+    }
+    const uint64_t base = start;
+    const uint64_t size = end - start;
+
+#ifdef SNESDISASM_ZLIB
+    bool read = false;
+    if(isGzip(magic, size)) {
+        read = readGzip(in, base, size, image);
+    } else if(isZip(magic, size)) {
+        read = readZip(in, base, size, image);
+    } else {
+        return false;
+    }
+
+    if(!read) {
+        LOG_SRC(ERROR, "The archive is damaged");
+        image.clear();
+    }
+    return read;
+#else
+    if(isArchive(magic, size)) {
+        LOG_SRC(ERROR, "Reading archives needs a build with zlib");
+    }
+    return false;
+#endif
+}
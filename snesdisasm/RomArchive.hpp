@@ -0,0 +1,50 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ROMARCHIVE_HPP
+#define ROMARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+/*! \brief Reads ROMs compressed as gzip files or zip archives
+ *
+ *  The uncompressed size is taken from the gzip trailer or the zip central directory, so the image is inflated
+ *  straight into a buffer of its final size while the compressed data is read in small pieces. Of a zip archive
+ *  the first entry named like a ROM (.sfc, .smc, .swc or .fig) is read, or the first entry at all if there is
+ *  none. The checksums of both formats are verified. Images announcing more than 64 MB, zip64 archives, encrypted entries and methods other than
+ *  stored and deflated are not supported.
+ *
+ *  The library has to be built with zlib, otherwise \see read always fails.
+ */
+class RomArchive {
+  public:
+    /*! \brief Returns whether data starts like a gzip file or a zip archive
+     */
+    static bool isArchive(const uint8_t *data, std::size_t length);
+
+    /*! \brief Decompresses the ROM in the archive in into image
+     *
+     *  in has to be seekable, the archive runs from its current position to its end. Errors are logged.
+     *
+     *  \return false if in is no supported archive, is damaged or contains no ROM. image is empty then.
+     */
+    static bool read(std::istream &in, std::vector<uint8_t> &image);
+};
+
+#endif // ROMARCHIVE_HPP
@@ -0,0 +1,225 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "RomDiff.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const uint64_t HashBase = 0x100000001B3ull;
+
+uint64_t hashWindow(const uint8_t *data) {
+    uint64_t hash = 0;
+    for(unsigned int i = 0; i < RomDiff::Window; ++i) {
+        hash = hash * HashBase + data[i];
+    }
+    return hash;
+}
+
+bool isConstant(const uint8_t *data) {
+    //fill bytes would match everywhere
+    for(unsigned int i = 1; i < RomDiff::Window; ++i) {
+        if(data[i] != data[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+RomDiff::RomDiff(const SNESROM &first, const SNESROM &second) {
+    INSTRUMENT_PHASE(ANALYSIS);
+    findChanges(first.image(), first.imageSize(), second.image(), second.imageSize());
+    findRelocations(first.image(), first.imageSize(), second.image());
+
+    for(std::size_t i = 0; i < m_Relocations.size(); ++i) {
+        m_BySource.push_back(i);
+    }
+    std::sort(m_BySource.begin(), m_BySource.end(), [this](std::size_t a, std::size_t b) {
+        return m_Relocations[a].from < m_Relocations[b].from;
+    });
+}
+
+std::size_t RomDiff::equalPrefix(const uint8_t *a, const uint8_t *b, std::size_t length) {
+    std::size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 64 <= length; i += 64) {
+        const __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        const __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 16)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 16)));
+        const __m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 32)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 32)));
+        const __m128i eq3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i + 48)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i + 48)));
+        const __m128i all = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+        if(_mm_movemask_epi8(all) != 0xFFFF) {
+            break; //the difference lies within these 64 bytes
+        }
+    }
+    for(; i + 16 <= length; i += 16) {
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i))));
+        if(mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#else
+    for(; i + 64 <= length && std::memcmp(a + i, b + i, 64) == 0; i += 64) {
+    }
+#endif
+    while(i < length && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+void RomDiff::findChanges(const uint8_t *first, std::size_t firstSize, const uint8_t *second,
+                          std::size_t secondSize) {
+    const std::size_t size = std::min(firstSize, secondSize);
+    std::size_t pos = 0;
+
+    while(pos < size) {
+        pos += equalPrefix(first + pos, second + pos, size - pos);
+        if(pos == size) {
+            break;
+        }
+
+        ImageRange range = {pos, pos + 1};
+        while(range.end < size) {
+            if(first[range.end] != second[range.end]) {
+                ++range.end;
+                continue;
+            }
+            const std::size_t equal = equalPrefix(first + range.end, second + range.end,
+                                                  std::min<std::size_t>(MergeGap, size - range.end));
+            if(equal == MergeGap || range.end + equal == size) {
+                break;
+            }
+            range.end += equal;
+        }
+
+        m_Changes.push_back(range);
+        pos = range.end;
+    }
+
+    //a larger second image simply has additional bytes
+    if(secondSize > size) {
+        ImageRange range = {size, secondSize};
+        if(!m_Changes.empty() && m_Changes.back().end + MergeGap >= size) {
+            m_Changes.back().end = secondSize;
+        } else {
+            m_Changes.push_back(range);
+        }
+    }
+}
+
+void RomDiff::findRelocations(const uint8_t *first, std::size_t firstSize, const uint8_t *second) {
+    if(m_Changes.empty() || firstSize < Window) {
+        return;
+    }
+
+    //index the first image at every Window bytes. Any run of 2 * Window moved bytes covers an indexed window.
+    std::unordered_map<uint64_t, std::size_t> index;
+    index.reserve(firstSize / Window);
+    for(std::size_t offset = 0; offset + Window <= firstSize; offset += Window) {
+        if(!isConstant(first + offset)) {
+            index.insert(std::make_pair(hashWindow(first + offset), offset));
+        }
+    }
+
+    uint64_t highestPower = 1;
+    for(unsigned int i = 1; i < Window; ++i) {
+        highestPower *= HashBase;
+    }
+
+    for(const ImageRange &range : m_Changes) {
+        std::size_t low = range.start; //relocations must not overlap
+        std::size_t pos = range.start;
+        if(range.end - pos < Window) {
+            continue;
+        }
+        uint64_t hash = hashWindow(second + pos);
+
+        for(;;) {
+            std::unordered_map<uint64_t, std::size_t>::const_iterator hit = index.find(hash);
+            if(hit != index.end() && hit->second != pos &&
+               std::memcmp(first + hit->second, second + pos, Window) == 0) {
+                std::size_t from = hit->second;
+                std::size_t to = pos;
+                while(to > low && from > 0 && first[from - 1] == second[to - 1]) {
+                    --from;
+                    --to;
+                }
+                const std::size_t length = (pos - to) + Window +
+                                           equalPrefix(first + hit->second + Window, second + pos + Window,
+                                                       std::min(firstSize - hit->second, range.end - pos) - Window);
+                if(length >= MinRelocation) {
+                    Relocation relocation = {from, to, length};
+                    m_Relocations.push_back(relocation);
+                    low = pos = to + length;
+                    if(range.end - pos < Window) {
+                        break;
+                    }
+                    hash = hashWindow(second + pos);
+                    continue;
+                }
+            }
+
+            if(pos + Window >= range.end) {
+                break;
+            }
+            hash = (hash - second[pos] * highestPower) * HashBase + second[pos + Window];
+            ++pos;
+        }
+    }
+}
+
+bool RomDiff::relocated(std::size_t start, std::size_t end, std::size_t &to) const {
+    //the last relocation starting at or before start. Sources may overlap if a run was copied twice, the
+    //earlier ones are not looked at then.
+    std::vector<std::size_t>::const_iterator it = std::upper_bound(m_BySource.begin(), m_BySource.end(), start,
+    [this](std::size_t offset, std::size_t index) {
+        return offset < m_Relocations[index].from;
+    });
+    if(it == m_BySource.begin()) {
+        return false;
+    }
+    const Relocation &relocation = m_Relocations[*(it - 1)];
+    if(end > relocation.from + relocation.length) {
+        return false;
+    }
+    to = relocation.to + (start - relocation.from);
+    return true;
+}
+
+bool RomDiff::changed(std::size_t start, std::size_t end) const {
+    //the first change that ends after start
+    std::vector<ImageRange>::const_iterator it = std::upper_bound(m_Changes.begin(), m_Changes.end(), start,
+    [](std::size_t offset, const ImageRange & range) {
+        return offset < range.end;
+    });
+    return it != m_Changes.end() && it->start < end;
+}
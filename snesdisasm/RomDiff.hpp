@@ -0,0 +1,84 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ROMDIFF_HPP
+#define ROMDIFF_HPP
+
+#include "SNESROM.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/*! \brief A range [start, end) of image offsets
+ */
+struct ImageRange {
+    std::size_t start;
+    std::size_t end;
+};
+
+/*! \brief A run of bytes that was moved from one image offset to another
+ */
+struct Relocation {
+    std::size_t from;   //the offset in the first image
+    std::size_t to;     //the offset in the second image
+    std::size_t length;
+};
+
+/*! \brief The differences between two images of the same game, e.g. two revisions or a hack and its original
+ *
+ *  Both images are compared at the same offsets. Differing bytes closer than \see MergeGap are merged into one
+ *  changed range. Within the changed ranges of the second image, runs of at least \see MinRelocation bytes that
+ *  exist elsewhere in the first image are reported as relocations. Those are found with a rolling hash over
+ *  windows of \see Window bytes.
+ *
+ *  The diff only keeps offsets, so both roms may be moved or destroyed afterwards.
+ */
+class RomDiff {
+  public:
+    enum { MergeGap = 16, Window = 32, MinRelocation = 64 };
+  private:
+    std::vector<ImageRange> m_Changes;
+    std::vector<Relocation> m_Relocations;
+    std::vector<std::size_t> m_BySource; //indices into m_Relocations, ordered by from
+
+    void findChanges(const uint8_t *first, std::size_t firstSize, const uint8_t *second, std::size_t secondSize);
+    void findRelocations(const uint8_t *first, std::size_t firstSize, const uint8_t *second);
+  public:
+    RomDiff(const SNESROM &first, const SNESROM &second);
+
+    /*! \brief The changed ranges in ascending order
+     */
+    const std::vector<ImageRange> &changes() const { return m_Changes; }
+
+    const std::vector<Relocation> &relocations() const { return m_Relocations; }
+
+    /*! \brief Tells where [start, end) of the first image went if it lies within a relocation
+     *
+     *  \return false if no relocation covers the whole range. Otherwise to is set to the offset of start in the
+     *          second image.
+     */
+    bool relocated(std::size_t start, std::size_t end, std::size_t &to) const;
+
+    /*! \brief Returns true if any byte in [start, end) differs
+     */
+    bool changed(std::size_t start, std::size_t end) const;
+
+    /*! \brief Returns the number of leading bytes that are equal in a and b, at most length
+     */
+    static std::size_t equalPrefix(const uint8_t *a, const uint8_t *b, std::size_t length);
+};
+
+#endif // ROMDIFF_HPP
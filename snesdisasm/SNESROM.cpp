@@ -1,34 +1,84 @@
 #include "SNESROM.hpp"
 #include "Logger.hpp"
+#include "Instrumentation.hpp"
+#include "RomArchive.hpp"
 #include <fstream>
+#include <iterator>
+#include <cstring>
 #include <assert.h>
 
-std::vector<uint8_t> readBytesFromFile(const std::string &fileName)
+std::vector<uint8_t> readBytesFromStream(std::istream &imageDataStream)
 {
+    INSTRUMENT_PHASE(LOAD);
     std::vector<uint8_t> vec;
-    std::ifstream imageDataStream(fileName, std::ifstream::in | std::ifstream::binary);
 
-    if(!imageDataStream.is_open()) {
-        return vec;
+    //the image starts at the current position, tellg fails for streams that cannot seek
+    const std::streamoff start = imageDataStream.tellg();
+    char magic[4] = {};
+    imageDataStream.read(magic, sizeof(magic));
+    if(start >= 0 && RomArchive::isArchive(reinterpret_cast<const uint8_t*>(magic), imageDataStream.gcount())) {
+        imageDataStream.clear();
+        imageDataStream.seekg(start);
+        if(RomArchive::read(imageDataStream, vec)) {
+            return vec;
+        }
+        //a headerless ROM may start with the same bytes
+        LOG_SRC(HINT, "Reading the image as it is");
     }
 
+    imageDataStream.clear();
     imageDataStream.seekg(0, std::ios_base::end);
-    const auto fileSize = imageDataStream.tellg();
-    imageDataStream.seekg(0, std::ios_base::beg);
+    const std::streamoff fileSize = start >= 0 ? static_cast<std::streamoff>(imageDataStream.tellg()) - start : 0;
+    imageDataStream.seekg(start >= 0 ? start : 0, std::ios_base::beg);
 
-    vec.resize(fileSize);
-    char *target = reinterpret_cast<char*>(&vec[0]);
+    if(fileSize > 0) {
+        //read straight into a buffer of the final size
+        vec.resize(fileSize);
+        imageDataStream.read(reinterpret_cast<char*>(&vec[0]), fileSize);
+        vec.resize(imageDataStream.gcount());
+    } else {
+        //not seekable
+        imageDataStream.clear();
+        vec.insert(vec.end(), reinterpret_cast<const uint8_t*>(magic), reinterpret_cast<const uint8_t*>(magic) + imageDataStream.gcount());
+        vec.insert(vec.end(), std::istreambuf_iterator<char>(imageDataStream), std::istreambuf_iterator<char>());
+    }
 
-    imageDataStream.read(target, fileSize);
-    imageDataStream.close();
+    return vec;
+}
 
-    vec.shrink_to_fit();
+std::vector<uint8_t> readBytesFromFile(const std::string &fileName)
+{
+    std::ifstream imageDataStream(fileName, std::ifstream::in | std::ifstream::binary);
 
-    return vec;
+    if(!imageDataStream.is_open()) {
+        return std::vector<uint8_t>();
+    }
+    return readBytesFromStream(imageDataStream);
 }
 
 #include <iostream>
 
+namespace {
+
+uint64_t rotateLeft(uint64_t value, unsigned int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+//the mixing steps of MurmurHash3
+uint64_t mix(uint64_t value) {
+    return rotateLeft(value * 0x87C37B91114253D5ULL, 31) * 0x4CF5AD432745937FULL;
+}
+
+uint64_t finalize(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    return value ^ (value >> 33);
+}
+
+}
+
 int imageAddressToROMAddress(ImageAddress imageAddress, bool m_isLoROM) {
     int ROMAddress;
 
@@ -49,34 +99,71 @@ int imageAddressToROMAddress(ImageAddress imageAddress, bool m_isLoROM) {
 
 
 SNESROM::SNESROM(const std::string &ROMImagePath)
-    : m_actualImageData(readBytesFromFile(ROMImagePath)),
-      m_headerlessImageData(nullptr){
+    : SNESROM(readBytesFromFile(ROMImagePath)){
+}
+
+SNESROM::SNESROM(std::istream &in)
+    : SNESROM(readBytesFromStream(in)){
+}
+
+SNESROM::SNESROM(std::vector<uint8_t> &&image)
+    : m_actualImageData(std::move(image)),
+      m_ImageData(m_actualImageData.data()),
+      m_ImageDataSize(m_actualImageData.size()),
+      m_headerlessImageData(nullptr),
+      m_ContentHash(0){
+    detectHeaders();
+}
+
+SNESROM::SNESROM(const uint8_t *data, std::size_t size)
+    : m_ImageData(data),
+      m_ImageDataSize(size),
+      m_headerlessImageData(nullptr),
+      m_ContentHash(0){
+    detectHeaders();
+}
 
-    assert( m_actualImageData.size() % 512 == 0);
-    assert( m_actualImageData.size() > 0);
+void SNESROM::detectHeaders() {
+    INSTRUMENT_PHASE(HEADER_DETECTION);
+
+    //images may come from anywhere, so a short or odd-sized one must give a rom without header, not a crash
+    if(m_ImageDataSize % 512 != 0) {
+        LOG_SRC(WARNING, "The image size is not a multiple of 512 bytes");
+    }
 
-    m_headerlessImageData = &m_actualImageData[0] +  m_actualImageData.size() % 1024;
+    m_headerlessImageData = m_ImageData + (m_ImageDataSize % 1024 >= 512 ? 512 : 0);
+
+    //an ExHiROM keeps its header in the upper 4 MB, which neither the SMC header nor the checks below know about
+    const ImageAddress exHiROMHeader(0x40ffc0);
+    if(fitsHeader(exHiROMHeader) && SNESROMHeader::mayBeThere(m_headerlessImageData + exHiROMHeader)){
+        SNESROMHeader header(m_headerlessImageData + exHiROMHeader);
+        if(header.layout() == RomLayout::ExHiROM()){
+            m_SNESROMHeader = std::move(header);
+        }
+    }
 
     //this implies a SMC header
-    if( m_actualImageData.size() % 1024 != 0){
-        m_SMCHeader.load(&m_actualImageData[0]);
+    if(m_headerlessImageData != m_ImageData){
+        m_SMCHeader.load(m_ImageData);
         LOG_SRC(STATE, "ROM has a SMC-Header");
 
         //since we have a SMC header, we ask it for lo/hi-rom status
         //not that this might be faulty so we gonna ignore that anyway
         RomLayout layout = m_SMCHeader.layout();
 
-        //now that we know what rom-type it is, we can use that to find the header
-        ROMAddress* SNESHeaderROMAddress = getROMAddressObject(layout);
-        SNESHeaderROMAddress->setROMAddress(0x00FFC0);
-        ImageAddress headerAddress = SNESHeaderROMAddress->toImageAddress();
-        delete SNESHeaderROMAddress;
+        if(!m_SNESROMHeader){
+            //now that we know what rom-type it is, we can use that to find the header
+            ROMAddress* SNESHeaderROMAddress = getROMAddressObject(layout);
+            SNESHeaderROMAddress->setROMAddress(0x00FFC0);
+            ImageAddress headerAddress = SNESHeaderROMAddress->toImageAddress();
+            delete SNESHeaderROMAddress;
 
-        //it is there. nice
-        if(SNESROMHeader::mayBeThere(m_headerlessImageData + headerAddress)){
-           m_SNESROMHeader = SNESROMHeader(m_headerlessImageData + headerAddress);
-        }else{
-            LOG_SRC(WARNING, "SMC-Header lies about ROM layout");
+            //it is there. nice
+            if(fitsHeader(headerAddress) && SNESROMHeader::mayBeThere(m_headerlessImageData + headerAddress)){
+               m_SNESROMHeader = SNESROMHeader(m_headerlessImageData + headerAddress);
+            }else{
+                LOG_SRC(WARNING, "SMC-Header lies about ROM layout");
+            }
         }
 
 
@@ -85,23 +172,34 @@ SNESROM::SNESROM(const std::string &ROMImagePath)
     }
 
     if(!m_SNESROMHeader){
-        if(SNESROMHeader::mayBeThere(m_headerlessImageData + 0x7fc0)){
+        if(fitsHeader(ImageAddress(0x7fc0)) && SNESROMHeader::mayBeThere(m_headerlessImageData + 0x7fc0)){
             //headerless lorom
             m_SNESROMHeader = SNESROMHeader(m_headerlessImageData + 0x7fc0);
-        }else if(SNESROMHeader::mayBeThere(m_headerlessImageData + 0xffc0)){
+        }else if(fitsHeader(ImageAddress(0xffc0)) && SNESROMHeader::mayBeThere(m_headerlessImageData + 0xffc0)){
             //headerless hirom
             m_SNESROMHeader = SNESROMHeader(m_headerlessImageData + 0xffc0);
         }else{
             LOG_SRC(ERROR, "There is no SNES header");
         }
     }
+
+    m_ContentHash = hash(m_headerlessImageData, imageSize());
+}
+
+bool SNESROM::fitsHeader(ImageAddress offset) const {
+    return offset != ImageAddress(-1) && offset + SNESROMHeader::Size <= imageSize();
 }
 
 SNESROM::SNESROM(SNESROM &&other)
     : m_actualImageData(std::move(other.m_actualImageData)),
+      m_ImageData(other.m_ImageData), //moving the vector keeps its buffer
+      m_ImageDataSize(other.m_ImageDataSize),
       m_headerlessImageData(other.m_headerlessImageData),
       m_SNESROMHeader(std::move(other.m_SNESROMHeader)),
-      m_SMCHeader(std::move(other.m_SMCHeader)){
+      m_SMCHeader(std::move(other.m_SMCHeader)),
+      m_ContentHash(other.m_ContentHash){
+    other.m_ImageData = nullptr;
+    other.m_ImageDataSize = 0;
     other.m_headerlessImageData = nullptr;
 }
 
@@ -117,12 +215,15 @@ void SNESROM::copyBytes(uint8_t *destination, ROMAddress* rom_address, size_t nu
 RomLayout SNESROM::checkRomLayout() {
     LoROMAddress possibleLoROMSNESHeader(ImageAddress(0x00FFD5));
     HiROMAddress possibleHiROMSNESHeader(ImageAddress(0x00FFD5));
-    uint8_t ROMLayoutAccordingToTheSNESHeader = m_headerlessImageData[possibleLoROMSNESHeader.toImageAddress()];
+    //a byte past the image end counts as no layout
+    const ImageAddress loROMLayout = possibleLoROMSNESHeader.toImageAddress();
+    const ImageAddress hiROMLayout = possibleHiROMSNESHeader.toImageAddress();
+    uint8_t ROMLayoutAccordingToTheSNESHeader = loROMLayout < imageSize() ? m_headerlessImageData[loROMLayout] : 0;
     RomLayout resultingRomLayout(RomLayout::Error());
     if(ROMLayoutAccordingToTheSNESHeader != 0x20 &&
        ROMLayoutAccordingToTheSNESHeader != 0x30) {
         //it's not a LoROM
-        ROMLayoutAccordingToTheSNESHeader = m_headerlessImageData[possibleHiROMSNESHeader.toImageAddress()];
+        ROMLayoutAccordingToTheSNESHeader = hiROMLayout < imageSize() ? m_headerlessImageData[hiROMLayout] : 0;
         if(ROMLayoutAccordingToTheSNESHeader != 0x20 &&
            ROMLayoutAccordingToTheSNESHeader != 0x30) {
             //it's not a HiROM either
@@ -143,6 +244,88 @@ const uint8_t *SNESROM::operator[](ROMAddress* rom_address) const {
     return &m_headerlessImageData[rom_address->toImageAddress()];
 }
 
+ImageAddress SNESROM::imageAddress(LongAddress address) const {
+    const uint8_t bank = address >> 16;
+    const uint16_t bankAddress = address & 0xFFFF;
+
+    if(bank == 0x7E || bank == 0x7F) {
+        return ImageAddress(-1); //work RAM
+    }
+
+    ImageAddress result(-1);
+    if(layout() == RomLayout::HiROM()) {
+        if((bank & 0x7F) < 0x40 && bankAddress < 0x8000) {
+            return ImageAddress(-1); //system area
+        }
+        result = HiROMAddress(bank, bankAddress).toImageAddress();
+    } else if(layout() == RomLayout::ExHiROM()) {
+        if((bank & 0x7F) < 0x40 && bankAddress < 0x8000) {
+            return ImageAddress(-1); //system area
+        }
+        result = ExHiROMAddress(bank, bankAddress).toImageAddress();
+    } else {
+        if(bankAddress < 0x8000) {
+            return ImageAddress(-1); //system area or SRAM
+        }
+        result = LoROMAddress(bank, bankAddress).toImageAddress();
+    }
+
+    if(result >= imageSize()) {
+        return ImageAddress(-1);
+    }
+    return result;
+}
+
+const uint8_t *SNESROM::data(LongAddress address, std::size_t length) const {
+    const ImageAddress offset = imageAddress(address);
+    if(offset == ImageAddress(-1) || offset + length > imageSize()) {
+        return nullptr;
+    }
+    return &m_headerlessImageData[offset];
+}
+
+RomLayout SNESROM::layout() const {
+    if(m_SNESROMHeader) {
+        return m_SNESROMHeader.layout();
+    }
+    return RomLayout::LoROM();
+}
+
+std::size_t SNESROM::bankSize() const {
+    return layout() == RomLayout::LoROM() ? 0x8000 : 0x10000;
+}
+
+std::size_t SNESROM::imageSize() const {
+    if(m_headerlessImageData == nullptr) {
+        return 0;
+    }
+    return m_ImageDataSize - (m_headerlessImageData - m_ImageData);
+}
+
 const SNESROMHeader &SNESROM::header() const {
     return m_SNESROMHeader;
 }
+
+std::vector<uint8_t> SNESROM::readImage(const std::string &path) {
+    return readBytesFromFile(path);
+}
+
+uint64_t SNESROM::hash(const uint8_t *data, std::size_t length) {
+    //four independent lanes keep the multipliers busy
+    uint64_t lanes[4] = {length, 0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL};
+    std::size_t offset = 0;
+
+    for(; offset + 32 <= length; offset += 32) {
+        for(unsigned int i = 0; i < 4; ++i) {
+            uint64_t word;
+            std::memcpy(&word, data + offset + 8 * i, sizeof(word));
+            lanes[i] = rotateLeft(lanes[i] ^ mix(word), 27) * 5 + 0x52DCE729;
+        }
+    }
+
+    uint64_t result = lanes[0] ^ rotateLeft(lanes[1], 16) ^ rotateLeft(lanes[2], 32) ^ rotateLeft(lanes[3], 48);
+    for(; offset < length; ++offset) {
+        result = (result ^ data[offset]) * 0x100000001B3ULL;
+    }
+    return finalize(result ^ mix(result));
+}
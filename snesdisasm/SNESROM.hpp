@@ -8,24 +8,60 @@
 
 #include "ROMAddress.hpp"
 
+#include <istream>
 #include <memory>
 #include <vector>
 
 class SNESROM {
   private:
-    std::vector<uint8_t> m_actualImageData; //this is the complete data of the ROM-Image
-    uint8_t *m_headerlessImageData;    //this is a pointer which points to the beginning of the ROM-Image data ignoring the SMC-header,
+    std::vector<uint8_t> m_actualImageData; //this is the complete data of the ROM-Image if the rom owns it, empty if it is borrowed
+    const uint8_t *m_ImageData;     //the complete data of the ROM-Image, owned or borrowed
+    std::size_t m_ImageDataSize;
+    const uint8_t *m_headerlessImageData;    //this is a pointer which points to the beginning of the ROM-Image data ignoring the SMC-header,
     //  this is the same as m_actualROMData when no SMC-header or with an offset +512 if containing a SMC-header
     SNESROMHeader m_SNESROMHeader;  //the header of the SNES ROM
     SMCHeader m_SMCHeader;
+    uint64_t m_ContentHash;         //the hash of the headerless image
 
     //prevent copying a rom
     SNESROM(const SNESROM &other) = delete;
     SNESROM &operator=(const SNESROM &other) = delete;
+
+    /**
+     * \brief Finds the SMC and the SNES header and hashes the image. Every constructor ends with it.
+     */
+    void detectHeaders();
+
+    /**
+     * \brief Returns true if a SNES header at offset of the image without SMC header lies within the image
+     */
+    bool fitsHeader(ImageAddress offset) const;
   public:
     typedef SNESROMHeader::Address Address;
 
+    /**
+     * \brief Reads the ROM from a file. gzip files and zip archives are decompressed, see RomArchive.
+     */
     SNESROM(const std::string &ROMImagePath);
+
+    /**
+     * \brief Reads the ROM from the current position of a stream to its end, e.g. one received over a socket.
+     *        Seekable streams holding a gzip file or a zip archive are decompressed, see RomArchive. If that fails
+     *        the bytes are taken as they are, headerless ROMs can start like an archive.
+     */
+    explicit SNESROM(std::istream &in);
+
+    /**
+     * \brief Takes over an image that is already in memory without copying it
+     */
+    explicit SNESROM(std::vector<uint8_t> &&image);
+
+    /**
+     * \brief Uses size bytes at data as the image without copying them. The rom only borrows them, they have to
+     *        outlive it and must not change.
+     */
+    SNESROM(const uint8_t *data, std::size_t size);
+
     SNESROM(SNESROM &&other);
     ~SNESROM();
 
@@ -36,7 +72,55 @@ class SNESROM {
      */
     const uint8_t *operator[](ROMAddress* rom_address) const;
 
+    /**
+     * \brief Returns a ptr to the byte at the given CPU address or nullptr if the address does not map
+     *        length consecutive bytes of the image. This is the case for RAM, I/O and addresses past the image end.
+     */
+    const uint8_t *data(LongAddress address, std::size_t length = 1) const;
+
+    /**
+     * \brief Returns the image offset of a CPU address or ImageAddress(-1) if it does not map into the image.
+     */
+    ImageAddress imageAddress(LongAddress address) const;
+
+    /**
+     * \brief Returns the layout according to the SNES header. LoROM is assumed if there is no header.
+     */
+    RomLayout layout() const;
+
+    /**
+     * \brief Returns the number of image bytes a bank holds: 32 KB on LoROM, 64 KB on HiROM and ExHiROM.
+     */
+    std::size_t bankSize() const;
+
+    /**
+     * \brief Returns the size of the image without the SMC header.
+     */
+    std::size_t imageSize() const;
+
+    /**
+     * \brief Returns the image without the SMC header. It is imageSize() bytes long.
+     */
+    const uint8_t *image() const { return m_headerlessImageData; }
+
     const SNESROMHeader &header() const;
+
+    /**
+     * \brief Returns the hash of the image without the SMC header. Copies of a ROM with and without SMC header
+     *        share it.
+     */
+    uint64_t contentHash() const { return m_ContentHash; }
+
+    /**
+     * \brief Reads the image in a file like the constructor does, gzip files and zip archives are decompressed.
+     *        Returns an empty image if the file cannot be read.
+     */
+    static std::vector<uint8_t> readImage(const std::string &path);
+
+    /**
+     * \brief Computes a 64 bit non-cryptographic hash of length bytes
+     */
+    static uint64_t hash(const uint8_t *data, std::size_t length);
 };
 
 #endif // SNESROM_HPP
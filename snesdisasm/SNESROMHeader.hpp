@@ -88,6 +88,8 @@ class SNESROMHeader {
   public:
     typedef unsigned int size_type;
     typedef uint16_t Address;
+
+    static constexpr std::size_t Size = 64; //the bytes of the header including the interrupt vectors
   private:
     static constexpr uint8_t m_ROMNameIndex = 0;
     static constexpr uint8_t m_ROMNameLength = 21;
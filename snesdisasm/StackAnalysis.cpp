@@ -0,0 +1,206 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StackAnalysis.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <map>
+
+namespace {
+
+const int UnknownDepth = INT_MIN;
+
+const char *eventNames[] = {"dispatch", "unresolved_dispatch", "return_address_pulled", "unbalanced_join",
+                            "stack_switch"
+                           };
+
+}
+
+StackAnalysis::StackAnalysis(const CallGraph &calls, const ConstantPropagation &propagation)
+    : m_Calls(calls),
+      m_Propagation(propagation),
+      m_Notes(NoteList::allocator_type(calls.arena())),
+      m_Dispatches(DispatchList::allocator_type(calls.arena())),
+      m_Frames(FrameList::allocator_type(calls.arena())) {
+    INSTRUMENT_PHASE(ANALYSIS);
+
+    m_Frames.reserve(calls.functions().size());
+    for(std::size_t i = 0; i < calls.functions().size(); ++i) {
+        analyse(i);
+    }
+
+    //code shared by several functions is visited once for each of them
+    std::sort(m_Notes.begin(), m_Notes.end(), [](const StackNote & a, const StackNote & b) {
+        return a.address < b.address || (a.address == b.address && a.event < b.event);
+    });
+    m_Notes.erase(std::unique(m_Notes.begin(), m_Notes.end(), [](const StackNote & a, const StackNote & b) {
+        return a.address == b.address && a.event == b.event;
+    }), m_Notes.end());
+    std::sort(m_Dispatches.begin(), m_Dispatches.end(), [](const Dispatch & a, const Dispatch & b) {
+        return a.source < b.source || (a.source == b.source && a.target < b.target);
+    });
+    m_Dispatches.erase(std::unique(m_Dispatches.begin(), m_Dispatches.end(), [](const Dispatch & a,
+    const Dispatch & b) {
+        return a.source == b.source && a.target == b.target;
+    }), m_Dispatches.end());
+}
+
+void StackAnalysis::analyse(std::size_t index) {
+    const ControlFlowGraph &graph = m_Propagation.graph();
+    const Function &function = m_Calls.functions()[index];
+    TRACE_FUNCTION("stack_function", function.entry);
+    StackFrame frame = {0, true};
+
+    auto note = [&](LongAddress address, StackEvent event, int depth) {
+        StackNote stackNote = {address, event, static_cast<int16_t>(depth)};
+        m_Notes.push_back(stackNote);
+        frame.balanced = frame.balanced && event == StackEvent::DISPATCH;
+    };
+
+    std::map<LongAddress, int> depths; //at the entry of every block visited
+    std::vector<LongAddress> worklist(1, function.entry);
+    depths[function.entry] = 0;
+
+    uint64_t iterations = 0;
+    while(!worklist.empty()) {
+        const LongAddress start = worklist.back();
+        worklist.pop_back();
+        ++iterations;
+        ControlFlowGraph::BlockMap::const_iterator block = graph.blocks().find(start);
+        if(block == graph.blocks().end()) {
+            continue;
+        }
+
+        int depth = depths[start];
+        //the pushed values come from the propagation, which tracks them per subroutine as well
+        ConstantPropagation::StateMap::const_iterator entry = m_Propagation.entryStates().find(start);
+        RegisterState values = entry != m_Propagation.entryStates().end() ? entry->second : RegisterState::unknown();
+
+        graph.forEachInstruction(block->second, [&](LongAddress address, const Instruction & instruction,
+        const MachineState & state) {
+            const ControlFlow flow = instruction.controlFlow();
+            const StackEffect stackEffect = effect(instruction, state);
+
+            if(depth != UnknownDepth && flow == ControlFlow::RETURN) {
+                if(depth > 0 && depth >= stackEffect.pulled && instruction.opCode() != 0x40) {
+                    RegisterState pulled = values;
+                    const AbstractValue word = pulled.pull16();
+                    const AbstractValue bank = instruction.opCode() == 0x6B ? pulled.pull()
+                                               : AbstractValue::constant(address >> 16);
+                    const LongAddress target = ((bank.value & 0xFFu) << 16) | ((word.value + 1u) & 0xFFFFu);
+                    const Dispatch dispatch = {address, target, state.getCPUStateRef().FlagRegister()};
+                    if(word.isKnown() && bank.isKnown(0x00FF) && graph.rom().data(dispatch.target) != nullptr) {
+                        m_Dispatches.push_back(dispatch);
+                        note(address, StackEvent::DISPATCH, depth);
+                    } else {
+                        note(address, StackEvent::UNRESOLVED_DISPATCH, depth);
+                    }
+                } else if(depth != 0) {
+                    note(address, StackEvent::RETURN_ADDRESS_PULLED, depth);
+                }
+            } else if(depth != UnknownDepth && depth >= 0 && depth < stackEffect.pulled) {
+                note(address, StackEvent::RETURN_ADDRESS_PULLED, depth);
+            }
+
+            //calls and interrupts return with the depth they were made at
+            if(depth != UnknownDepth && flow != ControlFlow::CALL && flow != ControlFlow::INDIRECT_CALL &&
+               flow != ControlFlow::INTERRUPT) {
+                depth += stackEffect.pushed - stackEffect.pulled;
+                frame.maxDepth = std::max<int>(frame.maxDepth, depth);
+            }
+            if(instruction.opCode() == 0x1B || instruction.opCode() == 0x9A) { //TCS, TXS
+                note(address, StackEvent::STACK_SWITCH, depth != UnknownDepth ? depth : 0);
+                depth = UnknownDepth;
+            }
+            ConstantPropagation::step(values, address, instruction, state);
+        });
+
+        for(const Edge &edge : block->second.successors) {
+            const std::size_t callee = m_Calls.indexOf(edge.target);
+            if(edge.kind == EdgeKind::CALL || (callee < m_Calls.functions().size() && callee != index)) {
+                continue; //not part of this function
+            }
+
+            std::map<LongAddress, int>::iterator known = depths.find(edge.target);
+            if(known == depths.end()) {
+                depths.insert(std::make_pair(edge.target, depth));
+                worklist.push_back(edge.target);
+            } else if(known->second != depth && known->second != UnknownDepth) {
+                if(depth != UnknownDepth) {
+                    note(edge.target, StackEvent::UNBALANCED_JOIN, known->second);
+                }
+                known->second = UnknownDepth;
+                worklist.push_back(edge.target);
+            }
+        }
+    }
+    TRACE_ITERATIONS(iterations);
+
+    m_Frames.push_back(frame);
+}
+
+StackEffect StackAnalysis::effect(const Instruction &instruction, const MachineState &state) {
+    const uint8_t memory = state.getCPUStateRef().areFlagsSet(MEMORY_SELECT) ? 1 : 2;
+    const uint8_t index = state.getCPUStateRef().areFlagsSet(INDEX_SELECT) ? 1 : 2;
+
+    switch(instruction.opCode()) {
+    case 0x08: //PHP
+    case 0x4B: //PHK
+    case 0x8B: //PHB
+        return {0, 1};
+    case 0x0B: //PHD
+    case 0xF4: //PEA
+    case 0xD4: //PEI
+    case 0x62: //PER
+    case 0x20: //JSR
+    case 0xFC: //JSR (a,X)
+        return {0, 2};
+    case 0x22: //JSL
+        return {0, 3};
+    case 0x00: //BRK
+    case 0x02: //COP
+        return {0, 4};
+    case 0x48: //PHA
+        return {0, memory};
+    case 0xDA: //PHX
+    case 0x5A: //PHY
+        return {0, index};
+    case 0x28: //PLP
+    case 0xAB: //PLB
+        return {1, 0};
+    case 0x2B: //PLD
+    case 0x60: //RTS
+        return {2, 0};
+    case 0x6B: //RTL
+        return {3, 0};
+    case 0x40: //RTI
+        return {4, 0};
+    case 0x68: //PLA
+        return {memory, 0};
+    case 0xFA: //PLX
+    case 0x7A: //PLY
+        return {index, 0};
+    default:
+        return {0, 0};
+    }
+}
+
+const char *StackAnalysis::eventName(StackEvent event) {
+    return eventNames[static_cast<unsigned int>(event)];
+}
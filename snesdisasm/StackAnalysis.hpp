@@ -0,0 +1,120 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STACKANALYSIS_HPP
+#define STACKANALYSIS_HPP
+
+#include "CallGraph.hpp"
+#include "ConstantPropagation.hpp"
+
+#include <vector>
+
+/*! \brief The number of bytes an instruction pulls from and then pushes onto the stack
+ */
+struct StackEffect {
+    uint8_t pulled;
+    uint8_t pushed;
+};
+
+/*! \brief Something about the stack of a function that breaks the usual call and return discipline
+ */
+enum class StackEvent : unsigned char {
+    DISPATCH,              //a return to an address pushed within the function, e.g. PEA target-1 and RTS
+    UNRESOLVED_DISPATCH,   //a return with bytes pushed within the function whose values are unknown
+    RETURN_ADDRESS_PULLED, //the function pulls the return address of its caller
+    UNBALANCED_JOIN,       //paths with different stack depths meet
+    STACK_SWITCH           //TCS or TXS, the depth is unknown afterwards
+};
+
+struct StackNote {
+    LongAddress address; //the instruction the event happens at
+    StackEvent event;
+    int16_t depth;       //the bytes pushed within the function before the instruction
+};
+
+/*! \brief A return whose target is known, an edge the \see ControlFlowGraph lacks
+ */
+struct Dispatch {
+    LongAddress source; //the RTS or RTL
+    LongAddress target;
+    uint8_t flags;      //the processorflags at the target
+};
+
+/*! \brief The stack usage of a function
+ */
+struct StackFrame {
+    /*! \brief The largest number of bytes the function itself has pushed at any point
+     */
+    uint16_t maxDepth;
+
+    /*! \brief True if every return happens at depth 0 and no event other than DISPATCH was noted
+     */
+    bool balanced;
+};
+
+/*! \brief Tracks the stack depth through every function of a \see CallGraph
+ *
+ *  The depth counts the bytes pushed by the function itself, starting with 0 at its entry. Calls are assumed to
+ *  return with the depth they were made at, so they count as neither push nor pull. The width of PHA, PHX, PHY
+ *  and their pulls depends on the register sizes. The native mode is assumed for BRK, COP and RTI.
+ *
+ *  A return at a positive depth does not leave the function but dispatches to an address pushed before. If the
+ *  \see ConstantPropagation knows the pushed bytes, the target is reported as a \see Dispatch. A negative depth
+ *  means the function removed its own return address, e.g. to return to its caller's caller or to read inline
+ *  arguments. Both are noted, as are joins of paths with different depths and writes to the stack pointer.
+ *
+ *  Everything is allocated from the arena of the call graph.
+ */
+class StackAnalysis {
+  public:
+    typedef std::vector<StackNote, ArenaAllocator<StackNote> > NoteList;
+    typedef std::vector<Dispatch, ArenaAllocator<Dispatch> > DispatchList;
+    typedef std::vector<StackFrame, ArenaAllocator<StackFrame> > FrameList;
+  private:
+    const CallGraph &m_Calls;
+    const ConstantPropagation &m_Propagation;
+    NoteList m_Notes;
+    DispatchList m_Dispatches;
+    FrameList m_Frames;
+
+    void analyse(std::size_t index);
+  public:
+    /*! \brief Analyses all functions. Both arguments have to be built from the same graph and outlive the analysis.
+     */
+    StackAnalysis(const CallGraph &calls, const ConstantPropagation &propagation);
+
+    /*! \brief The notes of all functions in ascending order of their address
+     */
+    const NoteList &notes() const { return m_Notes; }
+
+    /*! \brief All resolved dispatches in ascending order of their source
+     */
+    const DispatchList &dispatches() const { return m_Dispatches; }
+
+    /*! \brief The stack frame of every function, in the order of \see CallGraph::functions
+     */
+    const FrameList &frames() const { return m_Frames; }
+
+    /*! \brief Returns the stack effect of an instruction decoded with state
+     */
+    static StackEffect effect(const Instruction &instruction, const MachineState &state);
+
+    /*! \brief Returns the name of an event, e.g. "dispatch"
+     */
+    static const char *eventName(StackEvent event);
+};
+
+#endif // STACKANALYSIS_HPP
@@ -0,0 +1,159 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Trace.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+/*! \brief The events of one thread. The mutex is only contended while the events are collected.
+ */
+struct Trace::Ring {
+    std::mutex mutex;
+    Event events[RingCapacity];
+    uint64_t written;
+
+    Ring() : written(0) {}
+};
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Trace::Ring *> rings;
+    std::vector<Trace::Ring *> unused; //the rings of exited threads
+    uint32_t threads;
+    std::chrono::steady_clock::time_point epoch;
+
+    Registry() : threads(0), epoch(std::chrono::steady_clock::now()) {}
+};
+
+/*! \brief Writes nanoseconds as microseconds, which is the unit of the trace event format
+ */
+void writeMicroseconds(std::ostream &out, uint64_t nanoseconds) {
+    const uint64_t fraction = nanoseconds % 1000;
+    out << nanoseconds / 1000 << '.' << fraction / 100 << fraction / 10 % 10 << fraction % 10;
+}
+
+Registry &registry() {
+    //never destroyed, since threads may still exit after static destruction began
+    static Registry *instance = new Registry;
+    return *instance;
+}
+
+}
+
+std::atomic<bool> Trace::s_Enabled(false);
+
+/*! \brief Takes a ring for the calling thread and hands it back when the thread exits
+ */
+struct Trace::ThreadSlot {
+    Ring *ring;
+    uint32_t thread;
+
+    ThreadSlot() {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if(r.unused.empty()) {
+            //rings are never freed, so the events of exited threads can still be collected
+            ring = new Ring;
+            r.rings.push_back(ring);
+        } else {
+            ring = r.unused.back();
+            r.unused.pop_back();
+        }
+        thread = ++r.threads;
+    }
+
+    ~ThreadSlot() {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.unused.push_back(ring);
+    }
+};
+
+void Trace::start() {
+    registry(); //fixes the epoch
+    s_Enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop() {
+    s_Enabled.store(false, std::memory_order_relaxed);
+}
+
+void Trace::clear() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for(Ring *ring : r.rings) {
+        std::lock_guard<std::mutex> ringLock(ring->mutex);
+        ring->written = 0;
+    }
+}
+
+uint64_t Trace::now() {
+    const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - registry().epoch;
+    return elapsed.count();
+}
+
+void Trace::record(const char *name, uint64_t start, uint64_t duration, uint32_t address, uint32_t iterations) {
+    static thread_local ThreadSlot slot;
+    Ring &ring = *slot.ring;
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    Event &event = ring.events[ring.written % RingCapacity];
+    event.name = name;
+    event.start = start;
+    event.duration = duration;
+    event.address = address;
+    event.iterations = iterations;
+    event.thread = slot.thread;
+    ++ring.written;
+}
+
+std::string Trace::toJSON() {
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::ostringstream json;
+    json << "{\"traceEvents\":[";
+    uint64_t dropped = 0;
+    bool first = true;
+    for(Ring *ring : r.rings) {
+        std::lock_guard<std::mutex> ringLock(ring->mutex);
+        const uint64_t begin = ring->written > RingCapacity ? ring->written - RingCapacity : 0;
+        dropped += begin;
+        for(uint64_t i = begin; i < ring->written; ++i) {
+            const Event &event = ring->events[i % RingCapacity];
+            json << (first ? "" : ",") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                 << event.thread << ",\"ts\":";
+            writeMicroseconds(json, event.start);
+            json << ",\"dur\":";
+            writeMicroseconds(json, event.duration);
+            json << ",\"args\":{";
+            if(event.address != NoValue) {
+                json << "\"address\":" << event.address;
+            }
+            if(event.iterations != NoValue) {
+                json << (event.address != NoValue ? "," : "") << "\"iterations\":" << event.iterations;
+            }
+            json << "}}";
+            first = false;
+        }
+    }
+    json << "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << dropped << "}}";
+    return json.str();
+}
@@ -0,0 +1,132 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*! \brief Scoped trace events of the library, exported as Chrome trace event JSON
+ *
+ *  Every thread records its events into a ring buffer of its own, so recording never contends with other threads
+ *  and the oldest events are overwritten once a ring is full. The rings of exited threads are handed to new
+ *  threads, their events are kept until overwritten. \see toJSON collects the events of all rings in the format
+ *  chrome://tracing and Perfetto load.
+ *
+ *  Recording is off until \see start. While it is off a scope costs a relaxed load, while it is on two clock
+ *  reads and an uncontended lock, so it can be left on for a sample of runs. Besides the TRACE_SCOPE macros the
+ *  phases of \see Instrumentation are recorded as well. Configuring with -DSNESDISASM_INSTRUMENTATION=OFF turns
+ *  the macros into no-ops.
+ */
+class Trace {
+  public:
+    enum { RingCapacity = 4096 };
+    enum : uint32_t { NoValue = 0xFFFFFFFF };
+
+    /*! \brief A complete event. name has to be a string literal, it is not copied.
+     */
+    struct Event {
+        const char *name;
+        uint64_t start; //nanoseconds since the first use of the trace
+        uint64_t duration;
+        uint32_t address; //the function analysed or NoValue
+        uint32_t iterations; //the worklist iterations or NoValue
+        uint32_t thread;
+    };
+
+    /*! \brief Records an event from its construction to its destruction if recording was on at its construction
+     */
+    class Scope {
+      private:
+        const char *m_Name;
+        uint64_t m_Start;
+        uint32_t m_Address;
+        uint32_t m_Iterations;
+        bool m_Active;
+      public:
+        explicit Scope(const char *name, uint32_t address = NoValue)
+            : m_Name(name), m_Start(0), m_Address(address), m_Iterations(NoValue), m_Active(enabled()) {
+            if(m_Active) {
+                m_Start = now();
+            }
+        }
+
+        ~Scope() {
+            if(m_Active) {
+                record(m_Name, m_Start, now() - m_Start, m_Address, m_Iterations);
+            }
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        void setIterations(uint64_t iterations) {
+            m_Iterations = iterations < NoValue ? static_cast<uint32_t>(iterations) : NoValue - 1;
+        }
+    };
+
+    /*! \brief The events of one thread
+     */
+    struct Ring;
+  private:
+    struct ThreadSlot;
+    static std::atomic<bool> s_Enabled;
+  public:
+    /*! \brief Turns recording on
+     */
+    static void start();
+
+    /*! \brief Turns recording off. The recorded events are kept.
+     */
+    static void stop();
+
+    static bool enabled() { return s_Enabled.load(std::memory_order_relaxed); }
+
+    /*! \brief Drops all recorded events
+     */
+    static void clear();
+
+    /*! \brief Returns the nanoseconds since the first use of the trace
+     */
+    static uint64_t now();
+
+    /*! \brief Records an event in the ring of the calling thread
+     */
+    static void record(const char *name, uint64_t start, uint64_t duration, uint32_t address = NoValue,
+                       uint32_t iterations = NoValue);
+
+    /*! \brief Returns all recorded events as a Chrome trace event JSON object. The number of events overwritten
+     *         in full rings is given as otherData.dropped.
+     */
+    static std::string toJSON();
+};
+
+#ifdef SNESDISASM_INSTRUMENTATION
+//records the rest of the enclosing scope as an event, at most one per scope
+#define TRACE_SCOPE(name) Trace::Scope traceScope(name)
+//the same for the analysis of the function at address
+#define TRACE_FUNCTION(name, address) Trace::Scope traceScope(name, (address))
+//sets the worklist iterations of the event of the enclosing scope
+#define TRACE_ITERATIONS(iterations) traceScope.setIterations(iterations)
+#else
+#define TRACE_SCOPE(name) do {} while(false)
+#define TRACE_FUNCTION(name, address) do {} while(false)
+#define TRACE_ITERATIONS(iterations) do { (void)(iterations); } while(false)
+#endif
+
+#endif // TRACE_HPP
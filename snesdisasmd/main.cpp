@@ -0,0 +1,799 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * snesdisasmd keeps analysed ROMs in memory and answers queries about them over a Unix domain socket.
+ *
+ * usage: snesdisasmd <socket path> [--cache[=<directory>]] [--index=<directory>] [--trace] [name=rom path ...]
+ *
+ * With --cache, analysis results are kept in an AnalysisCache (by default in ~/.cache/snesdisasm), so loading
+ * a ROM that was analysed before only reads the cached result. With --index, the functions of analysed ROMs can be
+ * added to a FunctionIndex in directory to find similar functions in other ROMs. With --trace, a Trace is recorded
+ * from the start.
+ *
+ * Every request and every response is a frame: a 32 bit little-endian length followed by that many bytes.
+ * A request is a command line, its words separated by spaces:
+ *
+ *   load <name> <rom path> [<base>] [--trace-steps <n>]
+ *                                   analyse a ROM and keep it as name. With a base only the parts that differ
+ *                                   from the loaded ROM base are analysed again. With --trace-steps the ROM is
+ *                                   run from RESET for at most n instructions first, see Interpreter, and the
+ *                                   targets of the indirect jumps it took are followed as well
+ *   open <name> <rom path> [<kb>]   keep a ROM as name without analysing it. Banks are swept on first access and
+ *                                   kept in a cache of at most kb KB
+ *   unload <name>
+ *   list                            the names of all loaded ROMs
+ *   disasm <name> <start> <end>     the instructions in [start, end)
+ *   browse <name> <start> <end>     the instructions in [start, end) of an opened ROM
+ *   xrefs <name> <address>          all references to address
+ *   label <name> <label|address>    the label at an address or the address of a label
+ *   block <name> <address>          the basic block containing address
+ *   diff <name> <other name>        the changed ranges and relocations from name to other name
+ *   memory <name>                   the memory taken by the analysis, see MemoryReport
+ *   export <name> <jsonl|binary> <path>
+ *                                   write all blocks, instructions, xrefs and labels to the file path as JSON
+ *                                   Lines or as length-prefixed binary records, see Exporter
+ *   sweep <name>                    a linear sweep over the whole image, see LinearSweep. For an analysed ROM it
+ *                                   tells how many of the analysed instructions the sweep found as well
+ *   listing <name> <start> <end>    a text listing of [start, end) instead of JSON Lines
+ *   lines <name> <start> <end> <first> <count>
+ *                                   the lines [first, first + count) of the listing of [start, end), after a
+ *                                   JSON line with the total number of lines. The lines of the last range are
+ *                                   counted once per name, so scrolling through it only formats the lines shown
+ *   lineof <name> <start> <end> <address>
+ *                                   the line of the listing of [start, end) address is shown on
+ *   annotate <name> <start> <end> <kind> [<text>]
+ *                                   annotate [start, end) of the image offsets as code, data, text, graphics,
+ *                                   compressed or comment. Annotations are kept per name and used by the next
+ *                                   load of name, the analysis does not follow the control flow into data
+ *   unannotate <name> <start> <end> remove the annotations overlapping [start, end)
+ *   regions <name> <start> <end>    the annotations overlapping [start, end)
+ *   import <name> <cdl|trace> <path>
+ *                                   import a code/data log or a CPU trace log of the loaded or opened ROM name, see
+ *                                   ExecutionLog. The logs are kept per name and used by the next load of name: their
+ *                                   entry points are followed and their code and data ranges annotate the analysis
+ *   index <name>                    add the functions of name to the function index unless its ROM is in it already
+ *   similar <name> <address> [<k>] the k (10) indexed functions most similar to the function at address, with
+ *                                   the content hash of their ROM and their estimated similarity
+ *   trace [start|stop|clear]        start, stop or clear recording a Trace. Without an argument the recorded
+ *                                   events as Chrome trace event JSON, which chrome://tracing and Perfetto load
+ *
+ * Addresses are hexadecimal with an optional $ or 0x prefix and an optional colon after the bank
+ * ($80:8000). Labels may be used wherever an address is expected.
+ *
+ * A rom path may name a gzip file or a zip archive as well, see RomArchive.
+ *
+ * A response starts with the line "ok" or "error <message>", followed by the results as JSON Lines in the
+ * format of JSONLinesWriter.
+ */
+
+#include "snesdisasm/Analysis.hpp"
+#include "snesdisasm/Exporter.hpp"
+#include "snesdisasm/BankCache.hpp"
+#include "snesdisasm/AnalysisCache.hpp"
+#include "snesdisasm/Listing.hpp"
+#include "snesdisasm/LinearSweep.hpp"
+#include "snesdisasm/Trace.hpp"
+#include "snesdisasm/ExecutionLog.hpp"
+#include "snesdisasm/FunctionIndex.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const std::size_t MaxRequestSize = 64 * 1024;
+const std::size_t MinImageSize = 0x8000; //without an SMC header
+
+volatile std::sig_atomic_t s_Stop = 0;
+
+void stop(int) {
+    s_Stop = 1;
+}
+
+typedef std::map<std::string, std::unique_ptr<Analysis>> AnalysisMap;
+
+/*! \brief A ROM opened for browsing. Its banks are swept lazily.
+ */
+struct LazyROM {
+    SNESROM rom;
+    BankCache cache;
+
+    LazyROM(std::vector<uint8_t> &&image, std::size_t budget) : rom(std::move(image)), cache(rom, budget) {}
+};
+
+typedef std::map<std::string, std::unique_ptr<LazyROM>> LazyMap;
+
+typedef std::map<std::string, std::unique_ptr<ListingIndex>> ListingMap;
+
+struct ROMs {
+    AnalysisMap analyses;
+    LazyMap lazy;
+    ListingMap listings; //refer to the analysis of the same name
+    std::unique_ptr<AnalysisCache> cache; //may be empty
+    std::map<std::string, Annotations> annotations;
+    std::map<std::string, ExecutionLog> logs;
+    std::unique_ptr<FunctionIndex> index; //may be empty
+};
+
+struct Client {
+    int socket;
+    std::string input;
+};
+
+bool parseAddress(const CrossReferences *xrefs, const std::string &text, LongAddress &address) {
+    if(xrefs != nullptr && xrefs->addressOf(text, address)) {
+        return true;
+    }
+
+    std::string digits;
+    std::size_t start = 0;
+    if(text.compare(0, 1, "$") == 0) {
+        start = 1;
+    } else if(text.compare(0, 2, "0x") == 0 || text.compare(0, 2, "0X") == 0) {
+        start = 2;
+    }
+    for(std::size_t i = start; i < text.size(); ++i) {
+        if(text[i] != ':') {
+            digits += text[i];
+        }
+    }
+    if(digits.empty() || digits.size() > 6) {
+        return false;
+    }
+
+    char *end = nullptr;
+    address = std::strtoul(digits.c_str(), &end, 16);
+    return *end == '\0';
+}
+
+std::string error(const std::string &message) {
+    return "error " + message + "\n";
+}
+
+//decompresses zipped and gzipped roms as well. Rejects images without room for a LoROM header at $7FC0, so
+//a bad file cannot take down the roms already loaded.
+bool readImage(const std::string &path, std::vector<uint8_t> &image) {
+    image = SNESROM::readImage(path);
+    return image.size() % 512 == 0 && image.size() - image.size() % 1024 >= MinImageSize;
+}
+
+//the annotation commands do not need a loaded rom and use image offsets as addresses
+std::string handleAnnotations(Annotations &annotations, const std::vector<std::string> &args) {
+    const std::string &command = args[0];
+    LongAddress start;
+    LongAddress end;
+    if(args.size() < 4 || !parseAddress(nullptr, args[2], start) || !parseAddress(nullptr, args[3], end)) {
+        return error("missing or invalid offset");
+    }
+
+    std::ostringstream out;
+    if(command == "annotate") {
+        RegionKind kind;
+        if(args.size() < 5 || !Annotations::parseKind(args[4], kind)) {
+            return error("missing or invalid kind");
+        }
+        std::string text;
+        for(std::size_t i = 5; i < args.size(); ++i) {
+            text += (i != 5 ? " " : "") + args[i];
+        }
+        annotations.add(start, end, kind, text);
+        out << "ok\n";
+    } else if(command == "unannotate") {
+        out << "ok\n{\"removed\":" << annotations.remove(start, end) << "}\n";
+    } else {
+        out << "ok\n";
+        annotations.forEachOverlapping(start, end, [&out](const Annotations::Region & region) {
+            out << "{\"type\":\"region\",\"start\":" << region.start << ",\"end\":" << region.end << ",\"kind\":\""
+                << Annotations::kindName(region.value.kind) << "\",\"text\":\"";
+            for(char c : region.value.text) {
+                if(c == '"' || c == '\\') {
+                    out << '\\';
+                }
+                out << c;
+            }
+            out << "\"}\n";
+        });
+    }
+    return out.str();
+}
+
+/*! \brief Sweeps the image of rom and summarises the result
+ *
+ *  \param analysed the instructions of the analysis of rom, may be nullptr
+ */
+std::string handleSweep(const SNESROM &rom, const InstructionIndex *analysed) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const LinearSweep sweep(rom);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream out;
+    out << "ok\n{\"instructions\":" << sweep.instructions() << ",\"chunks\":" << sweep.chunks() << ",\"stitched\":"
+        << sweep.stitched() << ",\"seconds\":" << seconds;
+    if(analysed != nullptr) {
+        std::size_t agreeing = 0;
+        sweep.forEachIn(0, sweep.size(), [&](std::size_t offset, uint8_t) {
+            agreeing += analysed->contains(offset) ? 1 : 0;
+        });
+        out << ",\"analysed\":" << analysed->size() << ",\"agreeing\":" << agreeing;
+    }
+    out << "}\n";
+    return out.str();
+}
+
+std::string handleImport(ROMs &roms, const std::vector<std::string> &args) {
+    if(args.size() != 4 || (args[2] != "cdl" && args[2] != "trace")) {
+        return error("usage: import <name> <cdl|trace> <path>");
+    }
+    const SNESROM *rom = nullptr;
+    if(roms.analyses.count(args[1]) != 0) {
+        rom = &roms.analyses[args[1]]->rom();
+    } else if(roms.lazy.count(args[1]) != 0) {
+        rom = &roms.lazy[args[1]]->rom;
+    } else {
+        return error("no rom named " + args[1]);
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ExecutionLog &log = roms.logs[args[1]];
+    if(!(args[2] == "cdl" ? log.importCDL(*rom, args[3]) : log.importTrace(*rom, args[3]))) {
+        if(log.empty()) {
+            roms.logs.erase(args[1]);
+        }
+        return error("cannot import " + args[3]);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::size_t executed = 0;
+    log.forEachExecuted([&](std::size_t, uint8_t) {
+        ++executed;
+    });
+    std::ostringstream out;
+    out << "ok\n{\"lines\":" << log.lines() << ",\"skipped\":" << log.skipped() << ",\"entry_points\":"
+        << log.entryPoints().size() << ",\"executed\":" << executed << ",\"seconds\":" << seconds << "}\n";
+    return out.str();
+}
+
+std::string handleSimilar(const FunctionIndex &index, const Analysis &analysis, LongAddress address,
+                          const std::vector<std::string> &args) {
+    std::size_t k = 10;
+    if(args.size() == 4) {
+        char *end = nullptr;
+        k = std::strtoul(args[3].c_str(), &end, 10);
+        if(*end != '\0' || k == 0) {
+            return error("invalid count " + args[3]);
+        }
+    }
+    const std::size_t function = analysis.callGraph().indexOf(address);
+    if(function == analysis.callGraph().functions().size()) {
+        return error("no function");
+    }
+    FunctionIndex::Signature signature;
+    uint32_t instructions;
+    if(!FunctionIndex::signature(analysis, function, signature, instructions)) {
+        return error("the function is too short");
+    }
+
+    //the function itself is found if its rom was indexed
+    const uint64_t romHash = analysis.rom().contentHash();
+    std::ostringstream out;
+    out << "ok\n";
+    for(const FunctionIndex::Match &match : index.similar(signature, k + 1)) {
+        if(match.entry.romHash == romHash && match.entry.address == address) {
+            continue;
+        }
+        if(k == 0) {
+            break;
+        }
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(match.entry.romHash));
+        out << "{\"rom\":\"" << hash << "\",\"address\":" << match.entry.address << ",\"instructions\":"
+            << match.entry.instructions << ",\"similarity\":" << match.similarity << "}\n";
+        --k;
+    }
+    return out.str();
+}
+
+std::string handleExport(const Analysis &analysis, const std::vector<std::string> &args) {
+    if(args.size() != 4 || (args[2] != "jsonl" && args[2] != "binary")) {
+        return error("usage: export <name> <jsonl|binary> <path>");
+    }
+    std::ofstream file(args[3], std::ofstream::binary | std::ofstream::trunc);
+    if(!file) {
+        return error("cannot write " + args[3]);
+    }
+
+    std::unique_ptr<RecordWriter> writer;
+    if(args[2] == "jsonl") {
+        writer.reset(new JSONLinesWriter(file));
+    } else {
+        writer.reset(new BinaryRecordWriter(file));
+    }
+    Exporter(analysis.graph(), analysis.xrefs()).write(*writer);
+    if(!file) {
+        return error("cannot write " + args[3]);
+    }
+
+    std::ostringstream out;
+    out << "ok\n{\"bytes\":" << file.tellp() << "}\n";
+    return out.str();
+}
+
+std::string handleLazy(LazyMap &lazy, const std::vector<std::string> &args) {
+    const std::string &command = args[0];
+    LazyROM &rom = *lazy[args[1]];
+
+    if(command == "unload") {
+        lazy.erase(args[1]);
+        return "ok\n";
+    }
+
+    if(command == "sweep") {
+        return handleSweep(rom.rom, nullptr);
+    }
+
+    if(command != "browse") {
+        return error(command + " needs an analysed rom");
+    }
+    LongAddress start;
+    LongAddress end;
+    if(args.size() < 4 || !parseAddress(nullptr, args[2], start) || !parseAddress(nullptr, args[3], end)) {
+        return error("missing or invalid address");
+    }
+
+    std::ostringstream out;
+    JSONLinesWriter writer(out);
+    out << "ok\n";
+    rom.cache.forEachInstructionIn(start, end, [&writer](LongAddress address, const Instruction & instruction,
+    const MachineState & state) {
+        writer.writeInstruction(address, instruction, state.getCPUStateRef().FlagRegister());
+    });
+    return out.str();
+}
+
+std::string handle(ROMs &roms, const std::string &request) {
+    std::istringstream words(request);
+    std::vector<std::string> args;
+    for(std::string word; words >> word;) {
+        args.push_back(word);
+    }
+    if(args.empty()) {
+        return error("empty request");
+    }
+
+    const std::string &command = args[0];
+    std::ostringstream out;
+    JSONLinesWriter writer(out);
+
+    AnalysisMap &analyses = roms.analyses;
+
+    if(command == "list") {
+        out << "ok\n";
+        for(const AnalysisMap::value_type &entry : analyses) {
+            out << "{\"name\":\"" << entry.first << "\",\"blocks\":" << entry.second->graph().blocks().size()
+                << ",\"labels\":" << entry.second->xrefs().labels().size() << "}\n";
+        }
+        for(const LazyMap::value_type &entry : roms.lazy) {
+            const BankCache &cache = entry.second->cache;
+            out << "{\"name\":\"" << entry.first << "\",\"lazy\":true,\"banks\":" << cache.cachedBanks()
+                << ",\"memory\":" << cache.memoryUsage() << ",\"budget\":" << cache.budget()
+                << ",\"hits\":" << cache.hits() << ",\"misses\":" << cache.misses() << "}\n";
+        }
+        return out.str();
+    }
+
+    if(command == "trace" && args.size() <= 2) {
+        if(args.size() == 1) {
+            return "ok\n" + Trace::toJSON() + "\n";
+        } else if(args[1] == "start") {
+            Trace::start();
+        } else if(args[1] == "stop") {
+            Trace::stop();
+        } else if(args[1] == "clear") {
+            Trace::clear();
+        } else {
+            return error("unknown trace command " + args[1]);
+        }
+        return "ok\n";
+    }
+
+    if(command == "open" && (args.size() == 3 || args.size() == 4)) {
+        std::vector<uint8_t> image;
+        if(!readImage(args[2], image)) {
+            return error("cannot read " + args[2] + " as a rom image");
+        }
+        std::size_t budget = BankCache::DefaultBudget;
+        if(args.size() == 4) {
+            char *end = nullptr;
+            budget = std::strtoul(args[3].c_str(), &end, 10) * 1024;
+            if(*end != '\0' || budget == 0) {
+                return error("invalid budget " + args[3]);
+            }
+        }
+        roms.listings.erase(args[1]);
+        analyses.erase(args[1]);
+        roms.lazy[args[1]].reset(new LazyROM(std::move(image), budget));
+        return "ok\n";
+    }
+
+    uint64_t traceSteps = 0;
+    if(command == "load" && args.size() >= 5 && args[args.size() - 2] == "--trace-steps") {
+        char *end = nullptr;
+        traceSteps = std::strtoull(args.back().c_str(), &end, 10);
+        if(*end != '\0' || traceSteps == 0) {
+            return error("invalid number of steps " + args.back());
+        }
+        args.resize(args.size() - 2);
+    }
+
+    if(command == "load" && (args.size() == 3 || args.size() == 4)) {
+        if(args.size() == 4 && traceSteps != 0) {
+            return error("--trace-steps needs a full analysis, not one based on " + args[3]);
+        }
+        std::vector<uint8_t> image;
+        if(!readImage(args[2], image)) {
+            return error("cannot read " + args[2] + " as a rom image");
+        }
+
+        std::unique_ptr<Analysis> analysis;
+        if(args.size() == 4) {
+            AnalysisMap::const_iterator base = analyses.find(args[3]);
+            if(base == analyses.end()) {
+                return error("no rom named " + args[3]);
+            }
+            SNESROM rom(std::move(image));
+            const RomDiff diff(base->second->rom(), rom);
+            analysis.reset(new Analysis(std::move(rom), *base->second, diff));
+        } else if((roms.annotations.count(args[1]) != 0 && !roms.annotations[args[1]].empty()) ||
+                  roms.logs.count(args[1]) != 0 || traceSteps != 0) {
+            //cached results do not depend on annotations, logs and traces
+            Annotations annotations = roms.annotations[args[1]];
+            const ExecutionLog *log = roms.logs.count(args[1]) != 0 ? &roms.logs[args[1]] : nullptr;
+            if(log != nullptr) {
+                log->annotate(annotations);
+            }
+            analysis.reset(new Analysis(SNESROM(std::move(image)), annotations, log, traceSteps));
+        } else if(roms.cache) {
+            analysis.reset(new Analysis(SNESROM(std::move(image)), *roms.cache));
+        } else {
+            analysis.reset(new Analysis(SNESROM(std::move(image))));
+        }
+        roms.lazy.erase(args[1]);
+        roms.listings.erase(args[1]);
+        analyses[args[1]] = std::move(analysis);
+        return "ok\n";
+    }
+
+    if(args.size() < 2) {
+        return error("usage: " + command + " <name> ...");
+    }
+    if(command == "annotate" || command == "unannotate" || command == "regions") {
+        return handleAnnotations(roms.annotations[args[1]], args);
+    }
+    if(command == "import") {
+        return handleImport(roms, args);
+    }
+    if(roms.lazy.count(args[1]) != 0) {
+        return handleLazy(roms.lazy, args);
+    }
+    AnalysisMap::const_iterator it = analyses.find(args[1]);
+    if(it == analyses.end()) {
+        return error("no rom named " + args[1]);
+    }
+    const Analysis &analysis = *it->second;
+
+    if(command == "unload") {
+        roms.listings.erase(args[1]);
+        analyses.erase(args[1]);
+        return "ok\n";
+    }
+
+    if(command == "diff" && args.size() == 3) {
+        AnalysisMap::const_iterator other = analyses.find(args[2]);
+        if(other == analyses.end()) {
+            return error("no rom named " + args[2]);
+        }
+        const RomDiff diff(analysis.rom(), other->second->rom());
+        out << "ok\n";
+        for(const ImageRange &range : diff.changes()) {
+            out << "{\"type\":\"change\",\"start\":" << range.start << ",\"end\":" << range.end << "}\n";
+        }
+        for(const Relocation &relocation : diff.relocations()) {
+            out << "{\"type\":\"relocation\",\"from\":" << relocation.from << ",\"to\":" << relocation.to
+                << ",\"length\":" << relocation.length << "}\n";
+        }
+        return out.str();
+    }
+
+    if(command == "memory") {
+        return "ok\n" + analysis.memoryReport().toJSON() + "\n";
+    }
+
+    if(command == "export") {
+        return handleExport(analysis, args);
+    }
+
+    if(command == "sweep") {
+        return handleSweep(analysis.rom(), &analysis.instructions());
+    }
+
+    if((command == "index" || command == "similar") && !roms.index) {
+        return error("there is no function index, see --index");
+    }
+    if(command == "index") {
+        const std::size_t added = roms.index->add(analysis);
+        out << "ok\n{\"added\":" << added << ",\"functions\":" << roms.index->size() << "}\n";
+        return out.str();
+    }
+
+    LongAddress address;
+    if(args.size() < 3 || !parseAddress(&analysis.xrefs(), args[2], address)) {
+        return error("missing or invalid address");
+    }
+
+    if(command == "disasm") {
+        LongAddress end;
+        if(args.size() < 4 || !parseAddress(&analysis.xrefs(), args[3], end)) {
+            return error("missing or invalid end address");
+        }
+        out << "ok\n";
+        analysis.forEachInstructionIn(address, end, [&writer](LongAddress address, const Instruction & instruction,
+        const MachineState & state) {
+            writer.writeInstruction(address, instruction, state.getCPUStateRef().FlagRegister());
+        });
+    } else if(command == "listing") {
+        LongAddress end;
+        if(args.size() < 4 || !parseAddress(&analysis.xrefs(), args[3], end)) {
+            return error("missing or invalid end address");
+        }
+        out << "ok\n";
+        ListingWriter(analysis).write(out, address, end, 0);
+    } else if(command == "lines" || command == "lineof") {
+        const bool lines = command == "lines";
+        LongAddress end;
+        if(args.size() != (lines ? 6u : 5u) || !parseAddress(&analysis.xrefs(), args[3], end)) {
+            return error("usage: " + command + " <name> <start> <end> " + (lines ? "<first> <count>" : "<address>"));
+        }
+        std::unique_ptr<ListingIndex> &index = roms.listings[args[1]];
+        if(!index || index->start() != address || index->end() != end) {
+            index.reset(new ListingIndex(analysis, address, end));
+        }
+
+        if(!lines) {
+            LongAddress target;
+            std::size_t line;
+            if(!parseAddress(&analysis.xrefs(), args[4], target)) {
+                return error("invalid address " + args[4]);
+            }
+            if(!index->lineOf(target, line)) {
+                return error("no line");
+            }
+            out << "ok\n{\"line\":" << line << ",\"lines\":" << index->size() << "}\n";
+            return out.str();
+        }
+
+        char *firstEnd = nullptr;
+        char *countEnd = nullptr;
+        const std::size_t first = std::strtoul(args[4].c_str(), &firstEnd, 10);
+        const std::size_t count = std::strtoul(args[5].c_str(), &countEnd, 10);
+        if(*firstEnd != '\0' || *countEnd != '\0') {
+            return error("invalid line range");
+        }
+        std::string text;
+        index->write(text, first, count);
+        out << "ok\n{\"lines\":" << index->size() << "}\n" << text;
+    } else if(command == "similar" && args.size() <= 4) {
+        return handleSimilar(*roms.index, analysis, address, args);
+    } else if(command == "xrefs") {
+        out << "ok\n";
+        auto range = analysis.xrefs().xrefsTo(address);
+        for(CrossReferences::XrefList::const_iterator xref = range.first; xref != range.second; ++xref) {
+            writer.writeXref(*xref);
+        }
+    } else if(command == "label") {
+        const std::string *label = analysis.xrefs().labelAt(address);
+        if(label == nullptr) {
+            return error("no label");
+        }
+        out << "ok\n";
+        writer.writeLabel(address, *label);
+    } else if(command == "block") {
+        const BasicBlock *block = analysis.graph().blockAt(address);
+        if(block == nullptr) {
+            return error("no block");
+        }
+        out << "ok\n";
+        writer.writeBlock(*block);
+    } else {
+        return error("unknown command " + command);
+    }
+
+    return out.str();
+}
+
+bool sendAll(int socket, const char *data, std::size_t length) {
+    while(length > 0) {
+        const ssize_t sent = send(socket, data, length, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if(sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+/*! \brief Answers all complete requests in the input buffer of a client
+ *
+ *  \return false if the connection should be closed
+ */
+bool serve(ROMs &roms, Client &client) {
+    for(;;) {
+        if(client.input.size() < 4) {
+            return true;
+        }
+        const unsigned char *header = reinterpret_cast<const unsigned char *>(client.input.data());
+        const uint32_t length = header[0] | (header[1] << 8) | (header[2] << 16) | (header[3] << 24);
+        if(length > MaxRequestSize) {
+            return false;
+        }
+        if(client.input.size() < 4 + length) {
+            return true;
+        }
+
+        const std::string response = handle(roms, client.input.substr(4, length));
+        client.input.erase(0, 4 + length);
+
+        char frame[4];
+        for(unsigned int i = 0; i < 4; ++i) {
+            frame[i] = static_cast<char>(response.size() >> (8 * i));
+        }
+        if(!sendAll(client.socket, frame, 4) || !sendAll(client.socket, response.data(), response.size())) {
+            return false;
+        }
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <socket path> [--cache[=<directory>]] [--index=<directory>] [--trace] "
+                  << "[name=rom path ...]"
+                  << std::endl;
+        return 1;
+    }
+
+    ROMs roms;
+    for(int i = 2; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        if(arg == "--cache" || arg.compare(0, 8, "--cache=") == 0) {
+            roms.cache.reset(new AnalysisCache(arg.size() > 8 ? arg.substr(8) : AnalysisCache::defaultDirectory()));
+            continue;
+        }
+        if(arg.compare(0, 8, "--index=") == 0 && arg.size() > 8) {
+            roms.index.reset(new FunctionIndex(arg.substr(8)));
+            continue;
+        }
+        if(arg == "--trace") {
+            Trace::start();
+            continue;
+        }
+        const std::size_t separator = arg.find('=');
+        if(separator == std::string::npos) {
+            std::cerr << "expected name=rom path instead of " << arg << std::endl;
+            return 1;
+        }
+        const std::string response = handle(roms, "load " + arg.substr(0, separator) + " " +
+                                            arg.substr(separator + 1));
+        if(response != "ok\n") {
+            std::cerr << response;
+            return 1;
+        }
+    }
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(std::strlen(argv[1]) >= sizeof(address.sun_path)) {
+        std::cerr << "the socket path is too long" << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, argv[1]);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(argv[1]);
+    if(listener < 0 || bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+       listen(listener, 16) != 0) {
+        std::cerr << "cannot listen on " << argv[1] << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+
+    std::vector<Client> clients;
+    while(!s_Stop) {
+        std::vector<pollfd> fds(1 + clients.size());
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for(std::size_t i = 0; i < clients.size(); ++i) {
+            fds[i + 1].fd = clients[i].socket;
+            fds[i + 1].events = POLLIN;
+        }
+
+        if(poll(&fds[0], fds.size(), -1) < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        //serve the clients first, since accepting changes the list
+        for(std::size_t i = clients.size(); i-- > 0;) {
+            if(fds[i + 1].revents == 0) {
+                continue;
+            }
+
+            char buffer[4096];
+            const ssize_t received = recv(clients[i].socket, buffer, sizeof(buffer), 0);
+            bool keep = received > 0 || (received < 0 && errno == EINTR);
+            if(received > 0) {
+                clients[i].input.append(buffer, received);
+                keep = serve(roms, clients[i]);
+            }
+            if(!keep) {
+                close(clients[i].socket);
+                clients.erase(clients.begin() + i);
+            }
+        }
+
+        if(fds[0].revents & POLLIN) {
+            const int socket = accept(listener, nullptr, nullptr);
+            if(socket >= 0) {
+                Client client = {socket, std::string()};
+                clients.push_back(client);
+            }
+        }
+    }
+
+    for(const Client &client : clients) {
+        close(client.socket);
+    }
+    close(listener);
+    unlink(argv[1]);
+
+    return 0;
+}
@@ -4,6 +4,10 @@
 #include "snesdisasm/Logger.hpp"
 #include "snesdisasm/SNESROM.hpp"
 #include "snesdisasm/Disasm.hpp"
+#include "snesdisasm/Instrumentation.hpp"
+
+#include <sstream>
+#include <vector>
 
 
 using namespace std;
@@ -20,14 +24,31 @@ int main() {
     //disassemble until you hit a jump instruction
     Disasm::Section section = disasm.disasmUntilJump(pos);
 
-    //print out all found instructions
-    for(const Instruction &ins : section.instructions) {
-        std::cout << *pos << ": \t" << ins.stringify() << std::endl;
-        (*pos) += ins.size();
+    //format all found instructions
+    std::vector<std::string> lines;
+    {
+        INSTRUMENT_PHASE(FORMATTING);
+        for(const Instruction &ins : section.instructions) {
+            std::ostringstream line;
+            line << *pos << ": \t" << ins.stringify();
+            lines.push_back(line.str());
+            (*pos) += ins.size();
+        }
     }
 
     delete pos;
 
+    //and print them out
+    {
+        INSTRUMENT_PHASE(OUTPUT);
+        for(const std::string &line : lines) {
+            std::cout << line << std::endl;
+        }
+    }
+
+    //where the time went
+    std::cerr << Instrumentation::snapshot().toJSON() << std::endl;
+
     return 0;
 }
 
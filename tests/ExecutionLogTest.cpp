@@ -0,0 +1,172 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Imports trace logs written in the formats of bsnes, Mesen and Snes9x and checks the register sizes and entry
+ * points found in them, and that an analysis decodes with the register sizes a trace recorded.
+ */
+
+#include "snesdisasm/ExecutionLog.hpp"
+#include "snesdisasm/Analysis.hpp"
+
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int s_Failures = 0;
+
+void check(bool condition, const std::string &what) {
+    if(!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++s_Failures;
+    }
+}
+
+//a LoROM of four banks whose RESET vector points to $8000
+std::vector<uint8_t> makeImage() {
+    std::vector<uint8_t> image(0x8000 * 4, 0xEA);
+    const char title[] = "EXECUTIONLOG TEST     ";
+    std::copy(title, title + 21, image.begin() + 0x7FC0);
+    image[0x7FD5] = 0x20;
+    image[0x7FD7] = 0x07;
+    image[0x7FD9] = 0x01;
+    image[0x7FFC] = 0x00;
+    image[0x7FFD] = 0x80;
+    return image;
+}
+
+void writeFile(const std::string &path, const std::string &text) {
+    std::ofstream file(path, std::ofstream::binary | std::ofstream::trunc);
+    file << text;
+}
+
+void testFormats(const SNESROM &rom) {
+    const std::string path = "executionlogtest-formats.log";
+    writeFile(path,
+              //bsnes
+              "008000 sei                    A:0000 X:0000 Y:0000 S:01ff D:0000 B:00 nvMXdIzc V:  0 H:  186\n"
+              //Mesen
+              "00:8003 $C2 $30    REP #$30                 A:0000 X:0000 Y:0000 S:01FF D:0000 DB:00 P:04 V:0\n"
+              //Snes9x, the emulation flag makes the registers 8 bit
+              "$00/8005 A9 12       LDA #$12                A:0000 X:0000 Y:0000 D:0000 DB:00 S:01FF "
+              "P:EnvmxdIzc HC:0186 VC:000 FC:00\n"
+              "$00/8007 A9 12       LDA #$12                A:0000 X:0000 Y:0000 D:0000 DB:00 S:01FF "
+              "P:envMxdIzc HC:0186 VC:000 FC:00\n");
+
+    ExecutionLog log;
+    check(log.importTrace(rom, path, 1), "importing the formats");
+    check(log.lines() == 4 && log.skipped() == 0, "all lines of the formats are parsed");
+    check((log.state(0) & ExecutionLog::SIZES) == 0x08, "bsnes letters");
+    check((log.state(3) & ExecutionLog::SIZES) == 0x01, "Mesen P:xx");
+    check((log.state(5) & ExecutionLog::SIZES) == 0x08, "Snes9x letters in emulation mode");
+    check((log.state(7) & ExecutionLog::SIZES) == 0x04, "Snes9x letters in native mode");
+    std::remove(path.c_str());
+}
+
+//the entry points must not depend on where the log is split between the threads
+void testPieces(const SNESROM &rom) {
+    const std::string path = "executionlogtest-pieces.log";
+    std::ostringstream text;
+    //a loop over four instructions, large enough to be split into four pieces
+    while(text.tellp() < 5 * 1024 * 1024) {
+        for(unsigned int address = 0x8010; address < 0x8018; address += 2) {
+            text << "00" << std::hex << address << " nop                    A:0000 X:0000 Y:0000 S:01ff D:0000 "
+                 "B:00 nvMXdIzc V:  0 H:  186\n";
+        }
+    }
+    writeFile(path, text.str());
+
+    ExecutionLog single;
+    ExecutionLog split;
+    check(single.importTrace(rom, path, 1) && split.importTrace(rom, path, 4), "importing the loop");
+    check(single.entryPoints().size() == 1 && single.entryPoints()[0].address == 0x8010,
+          "the loop has one entry point");
+    check(split.entryPoints().size() == single.entryPoints().size(), "four threads find the same entry points");
+    std::remove(path.c_str());
+}
+
+std::vector<LongAddress> instructionsOf(const Analysis &analysis, LongAddress start, LongAddress end) {
+    std::vector<LongAddress> addresses;
+    analysis.forEachInstructionIn(start, end, [&addresses](LongAddress address, const Instruction &,
+    const MachineState &) {
+        addresses.push_back(address);
+    });
+    return addresses;
+}
+
+//PLP restores 8 bit registers after REP, which only the trace knows
+void testRegisterSizes() {
+    std::vector<uint8_t> image = makeImage();
+    const uint8_t code[] = {
+        0x78,       //8000 SEI
+        0x18,       //8001 CLC
+        0xFB,       //8002 XCE
+        0xE2, 0x30, //8003 SEP #$30
+        0x08,       //8005 PHP
+        0xC2, 0x30, //8006 REP #$30
+        0x28,       //8008 PLP
+        0xA9, 0x12, //8009 LDA #$12
+        0xA2, 0x34, //800B LDX #$34
+        0x80, 0xFE  //800D BRA $800D
+    };
+    std::copy(code, code + sizeof(code), image.begin());
+
+    const std::string path = "executionlogtest-sizes.log";
+    std::ostringstream text;
+    const unsigned int addresses[] = {0x8000, 0x8001, 0x8002, 0x8003, 0x8005, 0x8006, 0x8008, 0x8009, 0x800B, 0x800D};
+    for(unsigned int address : addresses) {
+        text << "00" << std::hex << address << (address == 0x8008 ? " nvmxdIzc\n" : " nvMXdIzc\n");
+    }
+    writeFile(path, text.str());
+
+    ExecutionLog log;
+    check(log.importTrace(SNESROM(std::vector<uint8_t>(image)), path, 1), "importing the PLP trace");
+    std::remove(path.c_str());
+
+    const Analysis guessed{SNESROM(std::vector<uint8_t>(image))};
+    const std::vector<LongAddress> guessedAddresses = instructionsOf(guessed, 0x8009, 0x8010);
+    check(std::find(guessedAddresses.begin(), guessedAddresses.end(), 0x800B) == guessedAddresses.end(),
+          "without the trace LDA is decoded with a 16 bit immediate");
+
+    const Analysis traced(SNESROM(std::vector<uint8_t>(image)), Annotations(), &log);
+    const std::vector<LongAddress> tracedAddresses = instructionsOf(traced, 0x8009, 0x8010);
+    const LongAddress expected[] = {0x8009, 0x800B, 0x800D};
+    check(tracedAddresses == std::vector<LongAddress>(expected, expected + 3),
+          "with the trace LDA and LDX are decoded with 8 bit immediates");
+}
+
+}
+
+int main() {
+    testRegisterSizes();
+
+    const SNESROM rom(makeImage());
+    testFormats(rom);
+    testPieces(rom);
+
+    if(s_Failures != 0) {
+        std::cerr << s_Failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Exports an analysis as binary records and as JSON Lines, reads the binary records back and checks them against
+ * the analysis.
+ */
+
+#include "snesdisasm/Exporter.hpp"
+#include "snesdisasm/Analysis.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int s_Failures = 0;
+
+void check(bool condition, const std::string &what) {
+    if(!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++s_Failures;
+    }
+}
+
+//a LoROM of four banks whose RESET vector points to $8000
+std::vector<uint8_t> makeImage() {
+    std::vector<uint8_t> image(0x8000 * 4, 0xEA);
+    const char title[] = "EXPORTER TEST        ";
+    std::copy(title, title + 21, image.begin() + 0x7FC0);
+    image[0x7FD5] = 0x20;
+    image[0x7FD7] = 0x07;
+    image[0x7FD9] = 0x01;
+    image[0x7FFC] = 0x00;
+    image[0x7FFD] = 0x80;
+    return image;
+}
+
+//calls a subroutine that reads a table and branches, then loops forever
+std::vector<uint8_t> makeROM() {
+    std::vector<uint8_t> image = makeImage();
+    const uint8_t main[] = {0x20, 0x00, 0x81, 0x80, 0xFE}; //8000 JSR $8100, BRA *
+    std::copy(main, main + sizeof(main), image.begin());
+    const uint8_t routine[] = {
+        0xAD, 0x00, 0x90, //8100 LDA $9000
+        0xF0, 0x01,       //8103 BEQ $8106
+        0x1A,             //8105 INC A
+        0x8D, 0x00, 0x02, //8106 STA $0200
+        0x60              //8109 RTS
+    };
+    std::copy(routine, routine + sizeof(routine), image.begin() + 0x100);
+    return image;
+}
+
+//reads the little-endian binary records
+class RecordReader {
+  private:
+    const std::string &m_Data;
+    std::size_t m_Position;
+  public:
+    explicit RecordReader(const std::string &data, std::size_t position = 0) : m_Data(data), m_Position(position) {}
+
+    bool atEnd() const { return m_Position >= m_Data.size(); }
+    std::size_t position() const { return m_Position; }
+    void seek(std::size_t position) { m_Position = position; }
+
+    uint32_t get(unsigned int bytes) {
+        uint32_t value = 0;
+        for(unsigned int i = 0; i < bytes && m_Position < m_Data.size(); ++i) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(m_Data[m_Position++])) << (8 * i);
+        }
+        return value;
+    }
+
+    std::string string(std::size_t length) {
+        const std::string text = m_Data.substr(m_Position, length);
+        m_Position += length;
+        return text;
+    }
+};
+
+void testBinary(const Analysis &analysis) {
+    std::ostringstream stream;
+    BinaryRecordWriter writer(stream);
+    Exporter(analysis.graph(), analysis.xrefs()).write(writer);
+    const std::string data = stream.str();
+
+    check(data.compare(0, 4, "SNDX") == 0, "the stream starts with the magic");
+    RecordReader header(data, 4);
+    check(header.get(2) == BinaryRecordWriter::Version, "the version follows the magic");
+
+    std::vector<BasicBlock> blocks;
+    std::vector<LongAddress> instructions;
+    std::vector<Xref> xrefs;
+    std::vector<std::pair<LongAddress, std::string> > labels;
+    RecordReader reader(data, 6);
+    while(!reader.atEnd()) {
+        const uint32_t length = reader.get(4);
+        const std::size_t end = reader.position() + length;
+        if(end > data.size()) {
+            check(false, "a record ends after the stream");
+            break;
+        }
+        switch(static_cast<BinaryRecordWriter::RecordType>(reader.get(1))) {
+        case BinaryRecordWriter::RecordType::INSTRUCTION: {
+            const LongAddress address = reader.get(4);
+            const uint8_t flags = reader.get(1);
+            const uint8_t size = reader.get(1);
+            const std::string bytes = reader.string(size);
+            const uint8_t *image = analysis.rom().data(address, size);
+            check(image != nullptr && bytes == std::string(reinterpret_cast<const char *>(image), size),
+                  "the bytes of the instruction at " + std::to_string(address));
+            check((flags & MEMORY_SELECT) != 0, "the instruction at " + std::to_string(address) + " has 8 bit A");
+            instructions.push_back(address);
+            break;
+        }
+        case BinaryRecordWriter::RecordType::BLOCK: {
+            BasicBlock block;
+            block.start = reader.get(4);
+            block.end = reader.get(4);
+            block.entryFlags = reader.get(1);
+            block.exit = static_cast<ControlFlow>(reader.get(1));
+            block.instructionCount = reader.get(2);
+            for(uint32_t count = reader.get(2); count != 0; --count) {
+                const LongAddress target = reader.get(4);
+                block.successors.push_back(Edge(target, static_cast<EdgeKind>(reader.get(1))));
+            }
+            blocks.push_back(block);
+            break;
+        }
+        case BinaryRecordWriter::RecordType::XREF: {
+            Xref xref;
+            xref.from = reader.get(4);
+            xref.to = reader.get(4);
+            xref.kind = static_cast<XrefKind>(reader.get(1));
+            xrefs.push_back(xref);
+            break;
+        }
+        case BinaryRecordWriter::RecordType::LABEL: {
+            const LongAddress address = reader.get(4);
+            labels.push_back(std::make_pair(address, reader.string(reader.get(2))));
+            break;
+        }
+        default:
+            check(false, "unknown record type");
+        }
+        check(reader.position() == end, "a record has the length of its prefix");
+        reader.seek(end); //skips records of unknown types
+    }
+
+    const ControlFlowGraph::BlockMap &graph = analysis.graph().blocks();
+    check(blocks.size() == graph.size(), "every block is written");
+    std::size_t instructionCount = 0;
+    for(const BasicBlock &block : blocks) {
+        const ControlFlowGraph::BlockMap::const_iterator it = graph.find(block.start);
+        if(it == graph.end()) {
+            check(false, "the block at " + std::to_string(block.start) + " is in the graph");
+            continue;
+        }
+        const BasicBlock &expected = it->second;
+        check(block.end == expected.end && block.entryFlags == expected.entryFlags && block.exit == expected.exit &&
+              block.instructionCount == expected.instructionCount, "the block at " + std::to_string(block.start));
+        check(std::equal(block.successors.begin(), block.successors.end(), expected.successors.begin(),
+        [](const Edge & a, const Edge & b) {
+            return a.target == b.target && a.kind == b.kind;
+        }) && block.successors.size() == expected.successors.size(),
+        "the edges of the block at " + std::to_string(block.start));
+        instructionCount += expected.instructionCount;
+    }
+    check(instructions.size() == instructionCount, "every instruction is written");
+    check(std::find(instructions.begin(), instructions.end(), 0x8105) != instructions.end(),
+          "the instruction at $8105 is written");
+
+    check(xrefs.size() == analysis.xrefs().xrefs().size(), "every xref is written");
+    for(std::size_t i = 0; i < xrefs.size() && i < analysis.xrefs().xrefs().size(); ++i) {
+        const Xref &expected = analysis.xrefs().xrefs()[i];
+        check(xrefs[i].from == expected.from && xrefs[i].to == expected.to && xrefs[i].kind == expected.kind,
+              "xref " + std::to_string(i));
+    }
+    check(labels.size() == analysis.xrefs().labels().size(), "every label is written");
+    for(const std::pair<LongAddress, std::string> &label : labels) {
+        const std::string *expected = analysis.xrefs().labelAt(label.first);
+        check(expected != nullptr && *expected == label.second, "the label " + label.second);
+    }
+    check(!labels.empty() && !xrefs.empty(), "the rom has labels and xrefs");
+}
+
+void testJSONLines(const Analysis &analysis) {
+    std::ostringstream stream;
+    JSONLinesWriter writer(stream);
+    Exporter(analysis.graph(), analysis.xrefs()).write(writer);
+
+    std::size_t instructions = 0;
+    for(const ControlFlowGraph::BlockMap::value_type &block : analysis.graph().blocks()) {
+        instructions += block.second.instructionCount;
+    }
+    const std::size_t records = analysis.graph().blocks().size() + instructions +
+                                analysis.xrefs().xrefs().size() + analysis.xrefs().labels().size();
+
+    std::istringstream lines(stream.str());
+    std::size_t count = 0;
+    for(std::string line; std::getline(lines, line); ++count) {
+        check(line.size() > 2 && line[0] == '{' && line[line.size() - 1] == '}', "line " + std::to_string(count));
+    }
+    check(count == records, "one line per record");
+}
+
+}
+
+int main() {
+    const Analysis analysis{SNESROM(makeROM())};
+    testBinary(analysis);
+    testJSONLines(analysis);
+
+    if(s_Failures != 0) {
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Runs a small rom that jumps through a table indexed by a multiplication result with the Interpreter and checks
+ * the executed addresses, their register sizes and the indirect target, which only an analysis with a trace
+ * follows.
+ */
+
+#include "snesdisasm/Interpreter.hpp"
+#include "snesdisasm/Analysis.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+int s_Failures = 0;
+
+void check(bool condition, const std::string &what) {
+    if(!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++s_Failures;
+    }
+}
+
+//a LoROM of four banks whose RESET vector points to $8000
+std::vector<uint8_t> makeImage() {
+    std::vector<uint8_t> image(0x8000 * 4, 0xEA);
+    const char title[] = "INTERPRETER TEST     ";
+    std::copy(title, title + 21, image.begin() + 0x7FC0);
+    image[0x7FD5] = 0x20;
+    image[0x7FD7] = 0x07;
+    image[0x7FD9] = 0x01;
+    image[0x7FFC] = 0x00;
+    image[0x7FFD] = 0x80;
+    return image;
+}
+
+//switches to native mode with 16 bit index registers, multiplies 2 by 1 and jumps to the second entry of a table
+std::vector<uint8_t> makeROM() {
+    std::vector<uint8_t> image = makeImage();
+    const uint8_t code[] = {
+        0x18,             //8000 CLC
+        0xFB,             //8001 XCE
+        0xC2, 0x10,       //8002 REP #$10
+        0xA9, 0x02,       //8004 LDA #$02
+        0x8D, 0x02, 0x42, //8006 STA $4202
+        0xA9, 0x01,       //8009 LDA #$01
+        0x8D, 0x03, 0x42, //800B STA $4203
+        0xAE, 0x16, 0x42, //800E LDX $4216
+        0x7C, 0x00, 0x81  //8011 JMP ($8100,X)
+    };
+    std::copy(code, code + sizeof(code), image.begin());
+    const uint8_t table[] = {0x00, 0x82, 0x00, 0x83};
+    std::copy(table, table + sizeof(table), image.begin() + 0x100);
+    image[0x200] = 0xDB; //8200 STP
+    const uint8_t target[] = {0xE2, 0x30, 0xDB}; //8300 SEP #$30, STP
+    std::copy(target, target + sizeof(target), image.begin() + 0x300);
+    return image;
+}
+
+void testRun(const SNESROM &rom) {
+    Interpreter interpreter(rom);
+    check(interpreter.run(100) == Interpreter::StopReason::HALTED, "the run ends at STP");
+    check(interpreter.steps() == 11, "11 instructions are executed, not " + std::to_string(interpreter.steps()));
+
+    std::map<LongAddress, uint8_t> executed;
+    interpreter.forEachExecuted([&executed](LongAddress address, uint8_t sizes) {
+        executed[address] = sizes;
+    });
+    const LongAddress addresses[] = {0x8000, 0x8001, 0x8002, 0x8004, 0x8006, 0x8009, 0x800B, 0x800E, 0x8011,
+                                     0x8300, 0x8302
+                                    };
+    check(executed.size() == sizeof(addresses) / sizeof(addresses[0]), "only the executed addresses are recorded");
+    for(LongAddress address : addresses) {
+        check(executed.count(address) != 0, "executed " + std::to_string(address));
+    }
+    //bit ((M << 1) | X) tells the register sizes
+    check(executed[0x8002] == 0x08, "REP #$10 runs with 8 bit registers");
+    check(executed[0x800E] == 0x04, "LDX runs with 16 bit index registers");
+    check(executed[0x8300] == 0x04, "the target runs with 16 bit index registers");
+    check(executed[0x8302] == 0x08, "STP runs with 8 bit registers");
+
+    const std::set<Interpreter::IndirectTarget> &targets = interpreter.indirectTargets();
+    check(targets.size() == 1, "one indirect target is recorded");
+    if(!targets.empty()) {
+        const Interpreter::IndirectTarget &indirect = *targets.begin();
+        check(indirect.source == 0x8011 && indirect.target == 0x8300, "JMP ($8100,X) goes to $8300");
+        check((indirect.flags & (MEMORY_SELECT | INDEX_SELECT)) == MEMORY_SELECT,
+              "the target is entered with 8 bit accumulator and 16 bit index registers");
+    }
+}
+
+void testAnalysis(const std::vector<uint8_t> &image) {
+    const Analysis guessed{SNESROM(std::vector<uint8_t>(image))};
+    check(guessed.graph().blocks().count(0x8300) == 0, "without a trace the target is not found");
+
+    const Analysis traced(SNESROM(std::vector<uint8_t>(image)), Annotations(), nullptr, 100);
+    const ControlFlowGraph::BlockMap::const_iterator block = traced.graph().blocks().find(0x8300);
+    check(block != traced.graph().blocks().end(), "with a trace the target is analysed");
+    if(block != traced.graph().blocks().end()) {
+        check((block->second.entryFlags & (MEMORY_SELECT | INDEX_SELECT)) == MEMORY_SELECT,
+              "the target is analysed with the traced register sizes");
+        check(block->second.end == 0x8303, "the target is decoded with an 8 bit immediate");
+    }
+}
+
+}
+
+int main() {
+    const std::vector<uint8_t> image = makeROM();
+    testRun(SNESROM(std::vector<uint8_t>(image)));
+    testAnalysis(image);
+
+    if(s_Failures != 0) {
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Analyses a rom again after a routine was moved and checks that the blocks of the moved routine are taken over
+ * rather than decoded again, and that the result matches analysing the changed rom from scratch. Also checks
+ * that blocks a change made unreachable are not taken over.
+ */
+
+#include "snesdisasm/Analysis.hpp"
+#include "snesdisasm/RomDiff.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int s_Failures = 0;
+
+void check(bool condition, const std::string &what) {
+    if(!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++s_Failures;
+    }
+}
+
+//a LoROM of four banks whose RESET vector points to $8000
+std::vector<uint8_t> makeImage() {
+    std::vector<uint8_t> image(0x8000 * 4, 0xEA);
+    const char title[] = "ROMDIFF TEST         ";
+    std::copy(title, title + 21, image.begin() + 0x7FC0);
+    image[0x7FD5] = 0x20;
+    image[0x7FD7] = 0x07;
+    image[0x7FD9] = 0x01;
+    image[0x7FFC] = 0x00;
+    image[0x7FFD] = 0x80;
+    return image;
+}
+
+//JSR routine, BRA * at $8000 and at routine a routine of 28 blocks that loads and conditionally increments
+std::vector<uint8_t> makeROM(uint16_t routine) {
+    std::vector<uint8_t> image = makeImage();
+    const uint8_t main[] = {0x20, static_cast<uint8_t>(routine), static_cast<uint8_t>(routine >> 8), 0x80, 0xFE};
+    std::copy(main, main + sizeof(main), image.begin());
+
+    std::vector<uint8_t>::iterator code = image.begin() + (routine - 0x8000);
+    for(unsigned int i = 0; i < 14; ++i) {
+        const uint8_t group[] = {0xAD, static_cast<uint8_t>(i * 3), 0x10, 0xF0, 0x01, 0x1A}; //LDA $10xx, BEQ, INC A
+        code = std::copy(group, group + sizeof(group), code);
+    }
+    *code = 0x60; //RTS
+    return image;
+}
+
+struct BlockSummary {
+    LongAddress start;
+    LongAddress end;
+    std::vector<LongAddress> targets;
+
+    bool operator==(const BlockSummary &other) const {
+        return start == other.start && end == other.end && targets == other.targets;
+    }
+};
+
+std::vector<BlockSummary> blocksOf(const Analysis &analysis) {
+    std::vector<BlockSummary> blocks;
+    for(const ControlFlowGraph::BlockMap::value_type &block : analysis.graph().blocks()) {
+        BlockSummary summary = {block.second.start, block.second.end, std::vector<LongAddress>()};
+        for(const Edge &edge : block.second.successors) {
+            summary.targets.push_back(edge.target);
+        }
+        std::sort(summary.targets.begin(), summary.targets.end());
+        blocks.push_back(summary);
+    }
+    return blocks;
+}
+
+void testRelocation(unsigned int shift) {
+    const Analysis before{SNESROM(makeROM(0x8100))};
+    const std::vector<uint8_t> image = makeROM(0x8100 + shift);
+    const RomDiff diff(before.rom(), SNESROM(std::vector<uint8_t>(image)));
+    const Analysis after(SNESROM(std::vector<uint8_t>(image)), before, diff);
+    const Analysis fresh{SNESROM(std::vector<uint8_t>(image))};
+
+    const std::string name = "routine shifted by " + std::to_string(shift) + ": ";
+    check(!diff.relocations().empty(), name + "the move is found");
+    //the JSR block is the only one whose bytes changed
+    check(after.graph().decodedBlocks() == 1, name + "only the changed block is decoded again, not " +
+          std::to_string(after.graph().decodedBlocks()));
+    check(blocksOf(after) == blocksOf(fresh), name + "the blocks match a fresh analysis");
+    check(after.graph().blocks().count(0x8100 + shift + 6) == 1, name + "the second block of the routine moved");
+}
+
+//$8100 jumps to $8300 at first and returns right away after the change, so $8300 becomes unreachable
+void testUnreachable() {
+    std::vector<uint8_t> image = makeImage();
+    const uint8_t main[] = {0x20, 0x00, 0x81, 0x80, 0xFE}; //8000 JSR $8100, BRA *
+    std::copy(main, main + sizeof(main), image.begin());
+    const uint8_t jump[] = {0x4C, 0x00, 0x83}; //8100 JMP $8300
+    std::copy(jump, jump + sizeof(jump), image.begin() + 0x100);
+    const uint8_t target[] = {0xA9, 0x01, 0x60}; //8300 LDA #$01, RTS
+    std::copy(target, target + sizeof(target), image.begin() + 0x300);
+
+    const Analysis before{SNESROM(std::vector<uint8_t>(image))};
+    check(before.graph().blocks().count(0x8300) == 1, "the jump target is analysed at first");
+
+    image[0x100] = 0x60; //8100 RTS
+    const RomDiff diff(before.rom(), SNESROM(std::vector<uint8_t>(image)));
+    const Analysis after(SNESROM(std::vector<uint8_t>(image)), before, diff);
+    const Analysis fresh{SNESROM(std::vector<uint8_t>(image))};
+
+    check(after.graph().blocks().count(0x8300) == 0, "the former jump target is not taken over");
+    check(blocksOf(after) == blocksOf(fresh), "the blocks after removing a jump match a fresh analysis");
+}
+
+}
+
+int main() {
+    testRelocation(0x10);
+    testRelocation(0x35);
+    testUnreachable();
+
+    if(s_Failures != 0) {
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Constructs roms from short and odd-sized buffers, as they may arrive over a socket, and checks that header
+ * detection stays within the buffer and only finds headers that fit. Also checks the ExHiROM mapping.
+ */
+
+#include "snesdisasm/SNESROM.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int s_Failures = 0;
+
+void check(bool condition, const std::string &what) {
+    if(!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++s_Failures;
+    }
+}
+
+//an image of size bytes with a LoROM header at $7FC0 if it fits, after an SMC header of smc bytes
+std::vector<uint8_t> makeImage(std::size_t size, std::size_t smc) {
+    std::vector<uint8_t> image(size, 0);
+    if(size >= smc + 0x8000) {
+        image[smc + 0x7FD5] = 0x20;
+        image[smc + 0x7FFC] = 0x00;
+        image[smc + 0x7FFD] = 0x80;
+    }
+    return image;
+}
+
+void testSizes() {
+    const std::size_t sizes[] = {0, 1, 100, 511, 512, 513, 1024, 1536, 0x7FC0, 0x7FFF, 0xFFC0 + 512};
+    for(std::size_t size : sizes) {
+        const std::string name = std::to_string(size) + " bytes: ";
+        const std::vector<uint8_t> image(size, 0x20);
+
+        //every constructor taking a buffer
+        const SNESROM borrowed(image.data(), image.size());
+        check(!borrowed.header(), name + "no header fits");
+        check(borrowed.imageSize() <= size, name + "the image lies within the buffer");
+        const SNESROM owned{std::vector<uint8_t>(image)};
+        check(!owned.header(), name + "no header fits into an owned image");
+        std::istringstream stream(std::string(image.begin(), image.end()));
+        const SNESROM streamed(stream);
+        check(!streamed.header(), name + "no header fits into a streamed image");
+        check(streamed.imageSize() == owned.imageSize(), name + "streamed and owned images match");
+    }
+}
+
+void testSMCHeader() {
+    //an SMC header claiming HiROM in front of a LoROM image too small for a header at $FFC0
+    std::vector<uint8_t> image = makeImage(0x8000 + 512, 512);
+    image[2] = 0xFF;
+    const SNESROM rom(image.data(), image.size());
+    check(rom.imageSize() == 0x8000, "the SMC header is skipped");
+    check(rom.header() && rom.layout() == RomLayout::LoROM(), "the LoROM header is found");
+
+    const std::vector<uint8_t> odd = makeImage(0x8000 + 100, 0);
+    const SNESROM oddROM(odd.data(), odd.size());
+    check(oddROM.imageSize() == odd.size() && oddROM.header(), "an odd-sized image keeps its header");
+}
+
+void testExHiROM() {
+    //4.125 MB with a header at $00FFC0, which is at the end of the first bank of the upper 4 MB
+    std::vector<uint8_t> image(0x420000 + 512, 0);
+    image[2] = 0xFF; //the SMC header claims HiROM
+    image[512 + 0x40FFD5] = 0x35;
+    image[512 + 0x40FFFD] = 0x80;
+    const SNESROM rom(image.data(), image.size());
+    check(rom.header() && rom.layout() == RomLayout::ExHiROM(), "the ExHiROM header is found");
+    check(rom.bankSize() == 0x10000, "an ExHiROM bank holds 64 KB");
+    check(rom.imageAddress(0xC00000) == ImageAddress(0) && rom.imageAddress(0x808000) == ImageAddress(0x8000),
+          "the banks 80-FF show the lower 4 MB");
+    check(rom.imageAddress(0x410000) == ImageAddress(0x410000) && rom.imageAddress(0x018000) == ImageAddress(0x418000),
+          "the banks 00-7D show the upper 4 MB");
+    check(rom.imageAddress(0x000000) == ImageAddress(-1) && rom.imageAddress(0x7E0000) == ImageAddress(-1) &&
+          rom.imageAddress(0x420000) == ImageAddress(-1), "system area, work RAM and addresses past the end");
+
+    const ExHiROMAddress last{ImageAddress(0x7E8000)};
+    check(last.bank() == 0x3E && last.bankAddress() == 0x8000 && last.toImageAddress() == ImageAddress(0x7E8000),
+          "the end of an 8 MB image is mapped into bank 3E");
+    const ExHiROMAddress upper{ImageAddress(0x410000)};
+    check(upper.bank() == 0x41 && upper.bankAddress() == 0, "the upper 4 MB are mapped into bank 41");
+
+    //a HiROM whose byte at the place of the ExHiROM layout is merely plausible
+    std::vector<uint8_t> hiROM(0x420000, 0);
+    hiROM[0xFFD5] = 0x21;
+    hiROM[0x40FFD5] = 0x21;
+    const SNESROM hiROMROM(hiROM.data(), hiROM.size());
+    check(hiROMROM.header() && hiROMROM.layout() == RomLayout::HiROM(), "a large HiROM stays a HiROM");
+}
+
+}
+
+int main() {
+    testSizes();
+    testSMCHeader();
+    testExHiROM();
+
+    if(s_Failures != 0) {
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}